@@ -0,0 +1,156 @@
+#ifndef _ASYNCREADER_HPP_INCLUDED_
+#define _ASYNCREADER_HPP_INCLUDED_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! Default quantity of reads that can be waiting on the device at once
+#define ASYNC_QUEUE_DEPTH 64
+
+//! Threads used to serve reads when io_uring is not available
+#define ASYNC_FALLBACK_THREADS 8
+
+//! Positional reader that keeps many reads in flight
+/*!
+ * Reads are submitted with AsyncReader::submit and return immediately. Once
+ * a read is done, AsyncReader::wait hands it back, so that whoever submitted
+ * it can carry on. Completions come back in whatever order the device
+ * finishes them, not in submission order.
+ *
+ * On Linux the reads go through io_uring, using raw system calls. If the
+ * kernel refuses to set up a ring, or can't read through one (old kernel,
+ * seccomp filter, etc.), a small thread pool calling `pread` is used instead.
+ * Both behave the same from the caller's point of view. A read the ring
+ * won't take is served on the spot, and if the ring stops working, the reads
+ * in it are cancelled and served again, and the thread pool takes over.
+ *
+ * Example usage:
+ * \code
+ * AsyncReader reader;
+ * AsyncReader::Request r;
+ * r.fd = fd; r.offset = 0; r.buffer = buffer; r.size = 4096;
+ * reader.submit(r);
+ * auto& done = reader.wait(); // &done == &r
+ * \endcode
+ *
+ * AsyncReader isn't thread-safe: submit and wait must be called from the same
+ * thread.
+ */
+class AsyncReader {
+public:
+	//! A single positional read
+	/*!
+	 * The request must stay alive, at the same address, until it's returned
+	 * by AsyncReader::wait.
+	 */
+	struct Request {
+		int fd; //!< File descriptor to read from
+		long offset; //!< Position in the file
+		void *buffer; //!< Where the data will be written
+		std::size_t size; //!< Quantity of bytes to read
+		long result; //!< Bytes read once completed, or a negative errno value on failure
+		void *userData; //!< Free for the caller to identify the request on completion
+	};
+	
+	//! Sets up the ring, or the thread pool if the ring isn't available
+	/*!
+	 * @param queueDepth Maximum quantity of requests in flight at once
+	 */
+	explicit AsyncReader(unsigned int queueDepth = ASYNC_QUEUE_DEPTH);
+	
+	//! Destructor
+	/*! Waits for the worker threads, if any, and releases the ring */
+	~AsyncReader();
+	
+	AsyncReader(const AsyncReader&) = delete;
+	AsyncReader& operator=(const AsyncReader&) = delete;
+	
+	//! Maximum quantity of requests in flight at once
+	std::size_t queueDepth() const;
+	
+	//! True if reads are going through io_uring, false if through the thread pool
+	bool usingIoUring() const;
+	
+	//! Submits a read without waiting for it
+	/*!
+	 * The caller is responsible for never having more than
+	 * AsyncReader::queueDepth requests in flight.
+	 *
+	 * @param request Read to submit
+	 */
+	void submit(Request& request);
+	
+	//! Blocks until any submitted read completes
+	/*!
+	 * Must only be called while there's at least one request in flight.
+	 *
+	 * @return The completed request
+	 */
+	Request& wait();
+
+private:
+	unsigned int m_queueDepth; //!< Maximum quantity of requests in flight
+	
+	//! io_uring state, valid if m_ringFd >= 0
+	struct Ring {
+		void *sqMap; //!< Submission queue ring mapping
+		std::size_t sqMapSize; //!< Size of the submission queue ring mapping
+		void *cqMap; //!< Completion queue ring mapping (may be the same as sqMap)
+		std::size_t cqMapSize; //!< Size of the completion queue ring mapping
+		void *sqes; //!< Submission queue entries mapping
+		std::size_t sqesSize; //!< Size of the submission queue entries mapping
+		unsigned int *sqTail; //!< Submission queue tail
+		unsigned int *sqMask; //!< Submission queue index mask
+		unsigned int *sqArray; //!< Submission queue index array
+		unsigned int *cqHead; //!< Completion queue head
+		unsigned int *cqTail; //!< Completion queue tail
+		unsigned int *cqMask; //!< Completion queue index mask
+		void *cqes; //!< Completion queue entries
+	};
+	
+	int m_ringFd; //!< io_uring file descriptor, -1 if the thread pool is in use
+	Ring m_ring; //!< io_uring mappings
+	std::vector<Request*> m_inRing; //!< Requests submitted to the ring and not completed yet
+	
+	std::vector<std::thread> m_workers; //!< Thread pool used when io_uring isn't available
+	std::mutex m_mutex; //!< Guards both queues below
+	std::condition_variable m_submitted; //!< Signals the workers that there's work to do
+	std::condition_variable m_completed; //!< Signals AsyncReader::wait that a read is done
+	std::deque<Request*> m_pending; //!< Requests waiting for a worker
+	std::deque<Request*> m_done; //!< Requests waiting to be returned by AsyncReader::wait, including those served without the ring
+	bool m_stopping; //!< Tells the workers to finish
+	
+	//! Tries to set up the io_uring instance
+	/*!
+	 * The ring is only used if the kernel can read through it, which is
+	 * asked with IORING_REGISTER_PROBE.
+	 *
+	 * @return True if the ring is ready to be used
+	 */
+	bool setupRing();
+	
+	//! Unmaps and closes the ring
+	void releaseRing();
+	
+	//! Switches to the thread pool once the ring stops working
+	/*!
+	 * The requests still in the ring are cancelled, and their completions
+	 * reaped, before the ring is released: until then, the kernel may still
+	 * write in their buffers. Those that didn't complete are then served, and
+	 * all of them queued to be returned by AsyncReader::wait. Must be called
+	 * with m_mutex held.
+	 */
+	void abandonRing();
+	
+	//! Reads a request with `pread`, on the calling thread
+	void serve(Request& request);
+	
+	//! Body of each thread pool worker
+	void work();
+};
+
+#endif // _ASYNCREADER_HPP_INCLUDED_
@@ -0,0 +1,304 @@
+#ifndef _BEPSILONTREE_HPP_INCLUDED_
+#define _BEPSILONTREE_HPP_INCLUDED_
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "Block.hpp"
+#include "BlockCache.hpp"
+#include "BlockFile.hpp"
+#include "LeafLayout.hpp"
+#include "NodeLayout.hpp"
+
+//! Write-optimized B-epsilon tree class
+/*!
+ * Laid out like a BPlusTree, with separators in the internal nodes and values
+ * in linked leaves, but each internal node only takes part of its block for
+ * separators and children: the rest is a buffer of values on their way down.
+ *
+ * Values are inserted in the root's buffer. When a buffer overflows, the
+ * values headed to the child with the most of them are moved down to it in a
+ * single batch, and so on down to the leaves. Each block read or written
+ * while inserting moves many values at once instead of a single one, which is
+ * a much smaller cost per value than BPlusTree::insert reading and rewriting a
+ * whole path for each of them, at the price of a smaller fanout. The root
+ * stays in memory and is only written when its buffer overflows.
+ *
+ * Lookups check the buffer of each node they go through, so they read as many
+ * blocks as in a BPlusTree of the same height.
+ *
+ * It's used like BPlusTree: BEpsilonTree::create, insertions and
+ * BEpsilonTree::finishInsertions to write it, BEpsilonTree::load to read it.
+ * Subtree counts aren't kept: a value's count would have to be updated in
+ * every node it goes through.
+ *
+ * @tparam T Type of the data to be stored, see BPlusTree
+ * @tparam Key Type of the separators, see BPlusTree
+ * @tparam KeyOf Functor type returning the key of a value, see BPlusTree
+ *
+ * @tparam MI Internal node order. Each internal node will store up to 2MI
+ * keys and have up to 2MI + 1 children.
+ *
+ * @tparam BufferCapacity Quantity of values that fit in an internal node's
+ * buffer
+ *
+ * @tparam Leaf Layout of the values in the leaves, see BPlusTree
+ * @tparam BlockSize %Block size to use, in bytes (see IdealBEpsilonTree)
+ */
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize = BLOCK_SIZE>
+class BEpsilonTree {
+public:
+	//! Type of the stored values
+	typedef T ValueType;
+	
+	//! Type of the separators
+	typedef Key KeyType;
+	
+	//! Internal node order
+	static constexpr auto InternalOrder = MI;
+	
+	//! Quantity of values in an internal node's buffer
+	static constexpr auto BufferSize = BufferCapacity;
+	
+	//! %Block size in bytes
+	static constexpr auto BlockSizeInUse = BlockSize;
+	
+	//! Default constructor
+	BEpsilonTree();
+	
+	//! Destructor
+	/*! Closes the file if it's open */
+	~BEpsilonTree();
+	
+	//! Switches the tree to direct I/O through the provided cache
+	/*!
+	 * Same as BPlusTree::useCache.
+	 *
+	 * @param cache Cache to use, or null to go back to stdio
+	 */
+	void useCache(BlockCache *cache);
+	
+	//! Initializes BEpsilonTree for writing
+	/*!
+	 * Same as BPlusTree::create.
+	 *
+	 * @param filepath Path to the file where the tree data will be written
+	 *
+	 * @return True if the file was created successfully
+	 */
+	bool create(const char* filepath);
+	
+	//! Initializes BEpsilonTree for reading only
+	/*!
+	 * Same as BPlusTree::load.
+	 *
+	 * @param filepath Path to the file where tree data can be found
+	 *
+	 * @return True if it was possible to open the file in filepath and it was
+	 * written in the current format, with the same block size and internal
+	 * node order
+	 */
+	bool load(const char* filepath);
+	
+	//! Inserts a value in the tree
+	/*!
+	 * Values equivalent to ones already in the tree are inserted after them.
+	 * Reads and writes no blocks at all unless the root's buffer overflows.
+	 *
+	 * @param value Value to insert
+	 */
+	void insert(const T& value);
+	
+	//! Seeks a value that's equivalent to the one provided
+	/*!
+	 * Same as BPlusTree::seek. Buffers are checked on the way down, so
+	 * values still in them are found as well.
+	 */
+	template <typename U>
+	std::unique_ptr<T> seek(const U& key);
+	
+	//! Visits, in order, every value between two keys
+	/*!
+	 * Same as BPlusTree::scan. Values still in buffers are carried down to
+	 * the leaves they're headed to and visited along with their values, so
+	 * each internal node whose range overlaps the keys is read once.
+	 */
+	template <typename U, typename Visit>
+	bool scan(const U& lo, const U& hi, Visit visit);
+	
+	//! BEpsilonTree usage analytics
+	struct Statistics {
+		std::uint64_t blocksRead; //!< Quantity of blocks read since the tree was initialized
+		std::uint64_t blocksWritten; //!< Quantity of blocks written since the tree was initialized
+		std::uint64_t blocksCreated; //!< Quantity of blocks created since the tree was initialized
+		std::uint64_t blocksInDisk; //!< Quantity of blocks stored in disk
+	};
+	
+	//! Returns the BEpsilonTree usage statistics so far
+	/*!
+	 * Same as BPlusTree::getStatistics.
+	 */
+	const Statistics& getStatistics(bool includeFileBlockCount = false) const;
+	
+	//! Reset all statistics values to 0
+	/*! Use with caution */
+	void resetStatistics();
+	
+	//! Writes the root and updates the header with the total blocks in the file
+	/*!
+	 * Very important to be used once you've finished using a tree that was
+	 * initialized with BEpsilonTree::create, since the root's buffer is
+	 * only kept in memory until then.
+	 */
+	void finishInsertions();
+
+private:
+	//! File header data for BEpsilonTree indexes
+	struct FileHeader {
+		std::uint32_t version; //!< Format version, see FORMAT_VERSION
+		std::uint32_t blockSize; //!< %Block size the tree was created with
+		std::uint32_t order; //!< Internal node order the tree was created with, see BEpsilonTree::InternalOrder
+		long rootAddress;
+		std::uint64_t blockCount;
+	};
+	
+	//! File header block
+	typedef Block<FileHeader, BlockSize> FileHeaderBlock;
+	
+	//! Internal node, with separators, children and a buffer of values
+	/*!
+	 * Separators work as in BPlusTree::InternalNode. A buffered value is
+	 * headed to the child that InternalNode::child gives for its key.
+	 */
+	struct InternalNode : NodeHeader<BlockSize> {
+		std::uint64_t bufferSize; //!< Quantity of values in the buffer
+		long children[2 * MI + 1]; //!< Children offsets
+		Key keys[2 * MI]; //!< Separators
+		T buffer[BufferCapacity]; //!< Values not yet moved down, sorted, older first among equivalent ones
+		
+		//! Child whose subtree holds a key, see BPlusTree::InternalNode::child
+		template <typename U>
+		std::size_t child(const U& key, bool leftmost = false) const;
+	};
+	
+	//! Leaf node, same as BPlusTree::LeafNode
+	struct LeafNode : NodeHeader<BlockSize> {
+		long next; //!< Offset of the next leaf, -1 if it's the last one
+		Leaf entries; //!< Values, sorted
+	};
+	
+	//! Node of either kind, as read from a block
+	union Node {
+		NodeHeader<BlockSize> header; //!< Part shared by both layouts
+		InternalNode internal; //!< Layout of internal nodes
+		LeafNode leaf; //!< Layout of leaves
+		
+		//! Initializes an empty node
+		/*!
+		 * @param isLeaf True if the node will be a leaf, false if it will be an
+		 * internal node
+		 */
+		void initialize(bool isLeaf);
+	};
+	
+	static_assert(sizeof(Node) <= BlockSize, "B-epsilon tree nodes don't fit in a block, consider decreasing the order or the buffer");
+	static_assert(2 * MI <= NODE_MAX_SIZE && Leaf::Capacity <= NODE_MAX_SIZE, "B-epsilon tree nodes too big for the node header");
+	static_assert(MI >= 1 && BufferCapacity >= 1, "B-epsilon tree internal nodes need room for keys and buffered values");
+	
+	//! Node block
+	typedef Block<Node, BlockSize> NodeBlock;
+	
+	//! Internal node while it's being changed
+	/*!
+	 * Flushing a buffer can make a node hold more keys than fit in a block
+	 * for a while, until it's split, so changes are made on this copy.
+	 */
+	struct Unpacked {
+		std::vector<Key> keys; //!< Separators
+		std::vector<long> children; //!< Children offsets
+		std::vector<T> buffer; //!< Buffered values
+	};
+	
+	//! Node created to the right of another when it was split
+	struct Sibling {
+		Key separator; //!< Smallest key under the node
+		long offset; //!< Offset of the node
+	};
+	
+	BlockFile m_file; //!< File where data will be stored
+	NodeBlock m_root; //!< Root node of the tree
+	bool m_rootChanged; //!< True if m_root has changes which haven't been written
+	mutable Statistics m_stats; //!< Where BEpsilonTree stores its read and write statistics
+	
+	//! Reads the node in the block at the provided offset
+	/*!
+	 * Same as BPlusTree::readFromDisk.
+	 */
+	NodeBlock readFromDisk(long offset);
+	
+	//! Writes the node to disk
+	/*!
+	 * Same as BPlusTree::writeToDisk.
+	 */
+	void writeToDisk(NodeBlock& node);
+	
+	//! Reads the file header
+	FileHeaderBlock readHeader() const;
+	
+	//! Updates the file header in disk
+	void writeHeader(const FileHeaderBlock& header);
+	
+	//! Copies an internal node so that it can be changed
+	static Unpacked unpack(const InternalNode& node);
+	
+	//! Adds a batch of values to a node's subtree, and writes the node
+	/*!
+	 * A leaf takes the values in; if they don't fit, it's split in as many
+	 * leaves as needed. An internal node takes them in its buffer; if it
+	 * overflows, it's flushed (see BEpsilonTree::flush), and if the node
+	 * then has too many keys, it's split.
+	 *
+	 * @param node Node to add the values to
+	 * @param batch Values headed to the node, sorted
+	 * @param siblings Nodes created to the right of the node, in order, for
+	 * the parent to add
+	 */
+	void push(NodeBlock& node, const std::vector<T>& batch, std::vector<Sibling>& siblings);
+	
+	//! Moves values from a node's buffer down to its children until it no longer overflows
+	/*!
+	 * The values headed to the child with the most of them are moved down
+	 * each time, see BEpsilonTree::push.
+	 */
+	void flush(Unpacked& node);
+	
+	//! Writes an internal node, split in as many nodes as it needs
+	/*!
+	 * @param node Node to write
+	 * @param block Block where the node was read from; the first of the
+	 * nodes is written there
+	 * @param siblings Nodes created to its right, see BEpsilonTree::push
+	 */
+	void writeInternal(const Unpacked& node, NodeBlock& block, std::vector<Sibling>& siblings);
+	
+	//! Makes the root the parent of itself and the siblings created when it was split
+	/*!
+	 * Repeated while the new root has to be split in turn.
+	 */
+	void growRoot(std::vector<Sibling>& siblings);
+	
+	//! Internal method for BEpsilonTree::scan
+	/*!
+	 * @param node Node whose subtree to scan
+	 * @param pending Values between lo and hi buffered above the node and
+	 * headed to its subtree, sorted
+	 */
+	template <typename U, typename Visit>
+	bool scan(const NodeBlock& node, const U& lo, const U& hi, const std::vector<T>& pending, Visit& visit);
+};
+
+#include "BEpsilonTree.inl"
+
+#endif // _BEPSILONTREE_HPP_INCLUDED_
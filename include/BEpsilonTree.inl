@@ -0,0 +1,460 @@
+#include <algorithm>
+#include <iterator>
+
+// --- //
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+template <typename U>
+std::size_t BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::InternalNode::child(const U& key, bool leftmost) const {
+	auto last = keys + this->size;
+	auto it = leftmost? std::lower_bound(keys, last, key) : std::upper_bound(keys, last, key);
+	return it - keys;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+void BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::Node::initialize(bool isLeaf) {
+	header.block = 0;
+	header.isLeaf = isLeaf;
+	header.size = 0;
+	
+	if (isLeaf) leaf.next = -1;
+	else internal.bufferSize = 0;
+}
+
+// --- //
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::BEpsilonTree()
+	: m_rootChanged(false), m_stats({ 0, 0, 0, 0 })
+{	}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::~BEpsilonTree() {
+	m_file.close();
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+void BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::useCache(BlockCache *cache) {
+	m_file.useCache(cache);
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+bool BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::create(const char* filepath) {
+	if (m_file.create(filepath)) {
+		resetStatistics();
+		
+		FileHeaderBlock header;
+		header.var.version = FORMAT_VERSION;
+		header.var.blockSize = BlockSize;
+		header.var.order = MI;
+		writeHeader(header);
+		++m_stats.blocksCreated;
+		
+		m_root.var.initialize(true); // Root begins as a leaf
+		writeToDisk(m_root);
+		m_rootChanged = false;
+		
+		header.var.rootAddress = m_root.var.header.offset();
+		header.var.blockCount = m_stats.blocksCreated;
+		writeHeader(header);
+		
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+bool BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::load(const char* filepath) {
+	if (m_file.open(filepath)) {
+		FileHeaderBlock header = readHeader();
+		
+		// Nodes of another format, size or order would be read wrong
+		bool compatible = header.var.version == FORMAT_VERSION && header.var.blockSize == BlockSize && header.var.order == MI;
+		
+		if (!compatible) {
+			m_file.close();
+			return false;
+		}
+		
+		m_root = readFromDisk(header.var.rootAddress);
+		m_rootChanged = false;
+		++m_stats.blocksRead;
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+void BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::insert(const T& value) {
+	std::vector<Sibling> siblings;
+	
+	if (m_root.var.header.isLeaf) {
+		push(m_root, std::vector<T>(1, value), siblings);
+	}
+	else {
+		// Most insertions only change the root's buffer, which is kept in
+		// memory until it overflows
+		auto& root = m_root.var.internal;
+		
+		if (root.bufferSize < BufferCapacity) {
+			auto last = root.buffer + root.bufferSize;
+			auto it = std::upper_bound(root.buffer, last, value);
+			
+			std::copy_backward(it, last, last + 1);
+			*it = value;
+			++root.bufferSize;
+			
+			m_rootChanged = true;
+			return;
+		}
+		
+		push(m_root, std::vector<T>(1, value), siblings);
+	}
+	
+	m_rootChanged = false;
+	growRoot(siblings);
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+template <typename U>
+std::unique_ptr<T> BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::seek(const U& key) {
+	NodeBlock node = m_root;
+	
+	while (!node.var.header.isLeaf) {
+		auto& n = node.var.internal;
+		
+		auto last = n.buffer + n.bufferSize;
+		auto it = std::lower_bound(n.buffer, last, key);
+		if (it != last && !(key < *it)) return std::make_unique<T>(*it);
+		
+		node = readFromDisk(n.children[n.child(key)]);
+	}
+	
+	auto& leaf = node.var.leaf;
+	auto i = leaf.entries.lowerBound(key, leaf.size);
+	
+	if (i < leaf.size && !(key < leaf.entries.value(i))) return std::make_unique<T>(leaf.entries.value(i));
+	return nullptr;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+template <typename U, typename Visit>
+bool BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::scan(const U& lo, const U& hi, Visit visit) {
+	if (hi < lo) return true;
+	return scan(m_root, lo, hi, std::vector<T>(), visit);
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+const typename BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::Statistics& BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::getStatistics(bool includeFileBlockCount) const {
+	if (includeFileBlockCount)
+		m_stats.blocksInDisk = readHeader().var.blockCount;
+	
+	return m_stats;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+void BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::resetStatistics() {
+	m_stats.blocksRead = m_stats.blocksWritten = m_stats.blocksCreated = m_stats.blocksInDisk = 0;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+void BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::finishInsertions() {
+	if (m_rootChanged) {
+		writeToDisk(m_root);
+		m_rootChanged = false;
+	}
+	
+	FileHeaderBlock header = readHeader();
+	header.var.blockCount = m_stats.blocksCreated;
+	writeHeader(header);
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+typename BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::NodeBlock BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::readFromDisk(long offset) {
+	NodeBlock node;
+	bool fetched;
+	
+	m_file.read(offset, &node, sizeof(node), &fetched);
+	
+	if (fetched) ++m_stats.blocksRead;
+	return node;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+void BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::writeToDisk(NodeBlock& node) {
+	if (!node.var.header.isWritten()) {
+		node.var.header.setOffset(m_file.end());
+		++m_stats.blocksCreated;
+	}
+	
+	m_file.write(node.var.header.offset(), &node, sizeof(node));
+	++m_stats.blocksWritten;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+typename BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::FileHeaderBlock BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::readHeader() const {
+	FileHeaderBlock header;
+	bool fetched;
+	
+	m_file.read(0, &header, sizeof(header), &fetched);
+	
+	if (fetched) ++m_stats.blocksRead;
+	return header;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+void BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::writeHeader(const FileHeaderBlock& header) {
+	// The whole block is written so that nodes, appended after it, start at
+	// block boundaries
+	m_file.write(0, &header, sizeof(header));
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+typename BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::Unpacked BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::unpack(const InternalNode& node) {
+	Unpacked unpacked;
+	unpacked.keys.assign(node.keys, node.keys + node.size);
+	unpacked.children.assign(node.children, node.children + node.size + 1);
+	unpacked.buffer.assign(node.buffer, node.buffer + node.bufferSize);
+	
+	return unpacked;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+void BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::push(NodeBlock& node, const std::vector<T>& batch, std::vector<Sibling>& siblings) {
+	if (!node.var.header.isLeaf) {
+		auto unpacked = unpack(node.var.internal);
+		
+		// Values already buffered are older, so they stay before equivalent
+		// ones from the batch
+		std::vector<T> buffer;
+		buffer.reserve(unpacked.buffer.size() + batch.size());
+		std::merge(unpacked.buffer.begin(), unpacked.buffer.end(), batch.begin(), batch.end(), std::back_inserter(buffer));
+		unpacked.buffer.swap(buffer);
+		
+		if (unpacked.buffer.size() > BufferCapacity) flush(unpacked);
+		
+		writeInternal(unpacked, node, siblings);
+		return;
+	}
+	
+	auto& leaf = node.var.leaf;
+	
+	std::vector<T> current(leaf.size);
+	leaf.entries.decode(leaf.size, current.data());
+	
+	std::vector<T> values;
+	values.reserve(current.size() + batch.size());
+	std::merge(current.begin(), current.end(), batch.begin(), batch.end(), std::back_inserter(values));
+	
+	// The values are spread evenly over as few leaves as they fit in. The
+	// first leaf keeps the node's block, and the others are written from
+	// the last one back, so that each knows where the next one is.
+	std::vector<std::size_t> bounds(1, 0);
+	
+	while (bounds.back() < values.size()) {
+		auto first = bounds.back();
+		auto remaining = values.size() - first;
+		
+		std::size_t lo = 1, hi = remaining;
+		while (lo < hi) {
+			auto mid = (lo + hi + 1) / 2;
+			if (Leaf::fits(values.data() + first, mid)) lo = mid;
+			else hi = mid - 1;
+		}
+		
+		auto leaves = (remaining + lo - 1) / lo;
+		bounds.push_back(first + (remaining + leaves - 1) / leaves);
+	}
+	
+	auto next = leaf.next;
+	std::vector<Sibling> created(bounds.size() - 2);
+	
+	for (auto i = bounds.size() - 2; i > 0; --i) {
+		NodeBlock right;
+		right.var.initialize(true);
+		right.var.header.size = bounds[i + 1] - bounds[i];
+		right.var.leaf.entries.assign(values.data() + bounds[i], bounds[i + 1] - bounds[i]);
+		right.var.leaf.next = next;
+		writeToDisk(right);
+		
+		next = right.var.header.offset();
+		created[i - 1] = { KeyOf()(values[bounds[i]]), next };
+	}
+	
+	leaf.size = bounds[1];
+	leaf.entries.assign(values.data(), bounds[1]);
+	leaf.next = next;
+	writeToDisk(node);
+	
+	siblings.insert(siblings.end(), created.begin(), created.end());
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+void BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::flush(Unpacked& node) {
+	KeyOf keyOf;
+	
+	while (node.buffer.size() > BufferCapacity) {
+		// Buffered values are sorted, so the ones headed to each child are
+		// next to each other
+		std::size_t best = 0, bestBegin = 0, bestEnd = 0;
+		std::size_t begin = 0;
+		
+		for (std::size_t i = 0; i < node.children.size() && begin < node.buffer.size(); ++i) {
+			auto end = begin;
+			
+			if (i == node.keys.size()) {
+				end = node.buffer.size();
+			}
+			else {
+				while (end < node.buffer.size() && keyOf(node.buffer[end]) < node.keys[i]) ++end;
+			}
+			
+			if (end - begin > bestEnd - bestBegin) {
+				best = i;
+				bestBegin = begin;
+				bestEnd = end;
+			}
+			
+			begin = end;
+		}
+		
+		std::vector<T> batch(node.buffer.begin() + bestBegin, node.buffer.begin() + bestEnd);
+		node.buffer.erase(node.buffer.begin() + bestBegin, node.buffer.begin() + bestEnd);
+		
+		auto child = readFromDisk(node.children[best]);
+		std::vector<Sibling> siblings;
+		push(child, batch, siblings);
+		
+		for (std::size_t i = 0; i < siblings.size(); ++i) {
+			node.keys.insert(node.keys.begin() + best + i, siblings[i].separator);
+			node.children.insert(node.children.begin() + best + i + 1, siblings[i].offset);
+		}
+	}
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+void BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::writeInternal(const Unpacked& node, NodeBlock& block, std::vector<Sibling>& siblings) {
+	KeyOf keyOf;
+	
+	// Children are spread evenly over as few nodes as they fit in. The key
+	// between two of these nodes goes to the parent instead.
+	auto children = node.children.size();
+	auto nodes = (children + 2 * MI) / (2 * MI + 1);
+	
+	std::size_t firstChild = 0;
+	std::size_t firstValue = 0;
+	
+	for (std::size_t i = 0; i < nodes; ++i) {
+		auto lastChild = children * (i + 1) / nodes;
+		
+		auto lastValue = node.buffer.size();
+		if (i + 1 < nodes) {
+			lastValue = firstValue;
+			while (lastValue < node.buffer.size() && keyOf(node.buffer[lastValue]) < node.keys[lastChild - 1]) ++lastValue;
+		}
+		
+		NodeBlock piece;
+		if (i == 0) piece = block;
+		else piece.var.initialize(false);
+		
+		auto& n = piece.var.internal;
+		n.isLeaf = false;
+		n.size = lastChild - firstChild - 1;
+		n.bufferSize = lastValue - firstValue;
+		std::copy(node.children.begin() + firstChild, node.children.begin() + lastChild, n.children);
+		std::copy(node.keys.begin() + firstChild, node.keys.begin() + lastChild - 1, n.keys);
+		std::copy(node.buffer.begin() + firstValue, node.buffer.begin() + lastValue, n.buffer);
+		
+		writeToDisk(piece);
+		
+		if (i == 0) block = piece;
+		else siblings.push_back({ node.keys[firstChild - 1], piece.var.header.offset() });
+		
+		firstChild = lastChild;
+		firstValue = lastValue;
+	}
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+void BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::growRoot(std::vector<Sibling>& siblings) {
+	if (siblings.empty()) return;
+	
+	while (!siblings.empty()) {
+		Unpacked root;
+		root.children.push_back(m_root.var.header.offset());
+		
+		for (auto& sibling : siblings) {
+			root.keys.push_back(sibling.separator);
+			root.children.push_back(sibling.offset);
+		}
+		
+		siblings.clear();
+		
+		m_root.var.initialize(false);
+		writeInternal(root, m_root, siblings);
+	}
+	
+	auto header = readHeader();
+	header.var.rootAddress = m_root.var.header.offset();
+	header.var.blockCount = m_stats.blocksCreated;
+	writeHeader(header);
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, std::size_t BufferCapacity, typename Leaf, unsigned int BlockSize>
+template <typename U, typename Visit>
+bool BEpsilonTree<T, Key, KeyOf, MI, BufferCapacity, Leaf, BlockSize>::scan(const NodeBlock& node, const U& lo, const U& hi, const std::vector<T>& pending, Visit& visit) {
+	if (node.var.header.isLeaf) {
+		auto& leaf = node.var.leaf;
+		
+		std::vector<T> values(leaf.size);
+		leaf.entries.decode(leaf.size, values.data());
+		
+		auto first = std::lower_bound(values.begin(), values.end(), lo);
+		auto last = std::upper_bound(first, values.end(), hi);
+		
+		// Values in the leaf are older than the ones still buffered above it
+		std::vector<T> merged;
+		merged.reserve((last - first) + pending.size());
+		std::merge(first, last, pending.begin(), pending.end(), std::back_inserter(merged));
+		
+		for (auto& value : merged) {
+			if (!visit(value)) return false;
+		}
+		
+		return true;
+	}
+	
+	auto& n = node.var.internal;
+	
+	auto bufferFirst = std::lower_bound(n.buffer, n.buffer + n.bufferSize, lo);
+	auto bufferLast = std::upper_bound(bufferFirst, n.buffer + n.bufferSize, hi);
+	
+	std::vector<T> values;
+	values.reserve((bufferLast - bufferFirst) + pending.size());
+	std::merge(bufferFirst, bufferLast, pending.begin(), pending.end(), std::back_inserter(values));
+	
+	KeyOf keyOf;
+	auto value = values.begin();
+	
+	for (auto i = n.child(lo, true), last = n.child(hi); i <= last; ++i) {
+		auto end = value;
+		
+		if (i == n.size) {
+			end = values.end();
+		}
+		else {
+			while (end != values.end() && keyOf(*end) < n.keys[i]) ++end;
+		}
+		
+		std::vector<T> headed(value, end);
+		value = end;
+		
+		if (!scan(readFromDisk(n.children[i]), lo, hi, headed, visit)) return false;
+	}
+	
+	return true;
+}
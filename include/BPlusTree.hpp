@@ -0,0 +1,735 @@
+#ifndef _BPLUSTREE_HPP_INCLUDED_
+#define _BPLUSTREE_HPP_INCLUDED_
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "AsyncReader.hpp"
+#include "Block.hpp"
+#include "BlockCache.hpp"
+#include "BlockFile.hpp"
+#include "LeafLayout.hpp"
+#include "NodeLayout.hpp"
+
+//! B+ tree class
+/*!
+ * BPlusTree can be used to store T-type values in binary files for fast
+ * retrieval later.
+ *
+ * Use the method BPlusTree::create before inserting values and, once you've
+ * finished inserting, call BPlusTree::finishInsertions to update the file
+ * header. Use BPlusTree::load before reading values.
+ *
+ * Values are only stored in the leaves. Internal nodes only hold separator
+ * keys, which can be much smaller than the values (an id instead of a whole
+ * index record), and children offsets, so they have many more children and
+ * the tree is shorter. Leaves don't waste space on children
+ * offsets either, and each one points to the next leaf, so a range scan only
+ * descends once and then reads the leaves one after the other.
+ *
+ * Example usage:
+ * \code
+ * struct Record { int id; long offset; bool operator< (const Record& that) const; };
+ * struct RecordId { int operator() (const Record& r) const { return r.id; } };
+ *
+ * BPlusTree<Record, int, RecordId, 100, PlainLeaf<Record, 200>> tree;
+ * tree.create("filename.bin");
+ * tree.insert({ 1, 4096 });
+ * tree.finishInsertions();
+ *
+ * tree.load("filename.bin");
+ * auto x = tree.seek(1);
+ * \endcode
+ *
+ * By default the file is accessed through stdio and the kernel page cache. To
+ * bypass both, hand a BlockCache to BPlusTree::useCache before creating or
+ * loading the tree: the file will then be opened with `O_DIRECT` and nodes
+ * will be cached by the application instead, with index priority.
+ *
+ * @tparam T Type of the data to be stored. Must be a POD (Plain Old Data type)
+ * and _less-than_ comparable.
+ *
+ * @tparam Key Type of the separators in the internal nodes. Must be a POD,
+ * _less-than_ comparable, and comparable with the keys that will be sought.
+ * Values are ordered by their keys: `KeyOf()(a) < KeyOf()(b)` must be
+ * equivalent to `a < b`.
+ *
+ * @tparam KeyOf Functor type with a `Key operator() (const T&) const`
+ * returning the key of a value
+ *
+ * @tparam MI Internal node order. Each internal node will store up to 2MI
+ * keys and have up to 2MI + 1 children.
+ *
+ * @tparam Leaf Layout of the values in the leaves: PlainLeaf to store them as
+ * they are, or an encoded layout such as DeltaLeaf. Besides the values, leaves
+ * hold the one-word NodeHeader and the offset of the next leaf.
+ *
+ * @tparam BlockSize %Block size to use, in bytes. Nodes of both kinds must
+ * fit in it (see IdealBPlusTree).
+ *
+ * @tparam Counted True to make it an order-statistic tree: every internal
+ * node keeps the quantity of values under each of its children, which
+ * BPlusTree::rank, BPlusTree::select and BPlusTree::count rely on. The counts
+ * take space in the internal nodes (see maxBPlusTreeInternalOrder) and cost a
+ * node write per level on each insertion.
+ */
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize = BLOCK_SIZE, bool Counted = false>
+class BPlusTree {
+public:
+	//! Type of the stored values
+	typedef T ValueType;
+	
+	//! Type of the separators
+	typedef Key KeyType;
+	
+	//! Internal node order
+	static constexpr auto InternalOrder = MI;
+	
+	//! Maximum quantity of values in a leaf
+	static constexpr auto LeafCapacity = Leaf::Capacity;
+	
+	//! %Block size in bytes
+	static constexpr auto BlockSizeInUse = BlockSize;
+	
+	//! Default constructor
+	BPlusTree();
+	
+	//! Destructor
+	/*! Closes the file if it's open */
+	~BPlusTree();
+	
+	//! Switches the tree to direct I/O through the provided cache
+	/*!
+	 * Must be called before BPlusTree::create or BPlusTree::load, and the
+	 * cache must outlive the tree. The cache's block size must be equal to
+	 * BlockSize.
+	 *
+	 * With a cache in use, the file is opened with `O_DIRECT` and nodes are
+	 * read and written through the cache as BlockCache::IndexPage blocks.
+	 * Statistics::blocksRead then only counts blocks that weren't in the cache.
+	 *
+	 * @param cache Cache to use, or null to go back to stdio
+	 */
+	void useCache(BlockCache *cache);
+	
+	//! Initializes BPlusTree for writing
+	/*!
+	 * Opens the file in "wb+" mode. Must be called before inserting values in
+	 * the tree. Also allows reading through BPlusTree::seek.
+	 *
+	 * If there's already a file in the filepath, it'll be overwritten. The
+	 * new file begins with a header and a single empty leaf as the root.
+	 *
+	 * After you've finished inserting values, call
+	 * BPlusTree::finishInsertions to update the file header.
+	 *
+	 * @param filepath Path to the file where the tree data will be written
+	 *
+	 * @return True if the file was created successfully
+	 */
+	bool create(const char* filepath);
+	
+	//! Initializes BPlusTree for reading only
+	/*!
+	 * Opens the file in "rb" mode. Insertions won't be possible.
+	 *
+	 * The file must have been previously created by a BPlusTree which
+	 * successfully called BPlusTree::create and BPlusTree::finishInsertions,
+	 * with the same block size and internal node order: both are recorded in
+	 * the file header and checked, along with the format version (see
+	 * FORMAT_VERSION).
+	 *
+	 * @param filepath Path to the file where tree data can be found
+	 *
+	 * @return True if it was possible to open the file in filepath and it was
+	 * written in the current format, with the same block size and internal
+	 * node order
+	 */
+	bool load(const char* filepath);
+	
+	//! Reads the top levels of the tree and keeps them in memory
+	/*!
+	 * Only the root is kept in memory otherwise, so every lookup reads a node
+	 * per level below it, although the upper levels take little space. Once
+	 * pinned, nodes are never read again: a lookup in a tree with three
+	 * levels pinned reads its leaf only.
+	 *
+	 * Levels are read one after the other, with all the nodes of a level
+	 * read at once through an AsyncReader. Nodes next to each other in the
+	 * file are read together, so each level of a tree written by
+	 * BPlusTree::reorganize takes a single read. These reads don't count
+	 * towards Statistics::blocksRead.
+	 *
+	 * Pinned nodes are kept up to date by insertions. Loading or creating
+	 * a tree unpins them.
+	 *
+	 * @param levels Quantity of levels to keep in memory, counting the root.
+	 * Levels that don't fit whole in the byte budget aren't pinned.
+	 * @param byteBudget Memory the pinned nodes can take, in bytes
+	 *
+	 * @return Quantity of nodes pinned, besides the root
+	 */
+	std::size_t pin(std::size_t levels, std::size_t byteBudget = static_cast<std::size_t>(-1));
+	
+	//! Inserts a value in the tree
+	/*!
+	 * Values equivalent to ones already in the tree are inserted after them.
+	 *
+	 * Nodes along the path are read into buffers kept between insertions and
+	 * changed there, and splits are carried up the path in a loop, so nothing
+	 * is allocated unless the tree grew taller, or a leaf split holds more
+	 * values, than ever before.
+	 *
+	 * @param value Value to insert
+	 */
+	void insert(const T& value);
+	
+	//! Inserts a value, or merges it into an equivalent value already in the tree
+	/*!
+	 * Lets a tree hold a single value per key with data accumulated from many
+	 * insertions, such as a list of entries sharing the key. Only available if
+	 * the values are stored in the leaves as they are, with PlainLeaf.
+	 *
+	 * @tparam Merge Callable receiving a `T&` with the stored value
+	 *
+	 * @param value Value to insert
+	 * @param merge Called with the stored value if there's one equivalent to
+	 * value. It may change anything but the data compared by the less-than
+	 * operator, and the leaf is written back afterwards.
+	 *
+	 * @return True if the value was inserted, false if it was merged
+	 */
+	template <typename Merge>
+	bool insertOrMerge(const T& value, Merge merge);
+	
+	//! Builds the tree bottom-up from values given in sorted order
+	/*!
+	 * Must be called right after BPlusTree::create, on the empty tree. Leaves
+	 * are filled one after the other, as full as the Leaf layout allows, and
+	 * each internal node is written as soon as the level below has filled it,
+	 * so every node is written once and the file grows sequentially. Much
+	 * faster than inserting the values one by one, which reads and rewrites
+	 * a leaf per value wherever it may be in the file.
+	 *
+	 * Nodes are left full, so later insertions split them right away. The
+	 * last node of each level holds whatever is left, and may be nearly empty.
+	 *
+	 * @tparam Next Callable receiving a `T&`, setting it to the next value and
+	 * returning true, or returning false once there are no more values
+	 *
+	 * @param next Called until it returns false. The values must come in
+	 * order, as they would be in the leaves.
+	 */
+	template <typename Next>
+	void bulkLoad(Next next);
+	
+	//! Writes a copy of the tree to another file, fully packed and in level order
+	/*!
+	 * Nodes are appended to the file as the tree grows, so after many
+	 * insertions neighbouring leaves are scattered over the file, and split
+	 * nodes are only partly full. In the copy, every leaf is as full as the
+	 * Leaf layout allows, and every internal node is full except the last two
+	 * of each level, which share what's left. The root comes right after the
+	 * header, followed by each internal level in breadth-first order and then
+	 * by the leaves in key order: the top levels can be read at once, and a
+	 * scan reads the file sequentially.
+	 *
+	 * Reads every leaf twice, once to know where each leaf of the copy begins
+	 * and once to fill them. The copy is written sequentially.
+	 *
+	 * @param filepath Path to the file where the copy will be written. If
+	 * there's already a file in the filepath, it'll be overwritten.
+	 *
+	 * @return True if the file was created successfully
+	 */
+	bool reorganize(const char* filepath);
+	
+	//! Seeks a value that's equivalent to the one provided
+	/*!
+	 * Reads one node per level below the root.
+	 *
+	 * @tparam U Type of the key to seek. Must be less-than comparable with
+	 * both T and Key.
+	 *
+	 * @param key The value to seek
+	 *
+	 * @return Pointer with the value if found, null otherwise
+	 */
+	template <typename U>
+	std::unique_ptr<T> seek(const U& key);
+	
+	//! Seeks a value without allocating or copying nodes
+	/*!
+	 * Same as BPlusTree::seek, but nodes are looked at where they already
+	 * are: the root and pinned nodes in memory, the others in their cache
+	 * frames, pinned only while they're being looked at. Through stdio, every
+	 * level is read into the same buffer on the stack. Only the value found is
+	 * copied.
+	 *
+	 * @param key The value to seek
+	 * @param value Set to the value if found, left untouched otherwise
+	 *
+	 * @return True if the value was found
+	 */
+	template <typename U>
+	bool seek(const U& key, T& value);
+	
+	//! Seeks many keys at once, keeping several descents in flight
+	/*!
+	 * Every key gets its own descent from the root. Whenever a descent needs
+	 * a child node, the read is submitted to the AsyncReader instead of
+	 * blocking on it, and the descent is resumed once the read completes. Up
+	 * to AsyncReader::queueDepth descents wait on the device at the same time,
+	 * so the device queue is kept busy instead of serving one read at a time.
+	 * Pinned nodes, and nodes already in the cache, are used without a read.
+	 *
+	 * Every completed read increments Statistics::blocksRead.
+	 *
+	 * @tparam U See BPlusTree::seek
+	 *
+	 * @param keys Values to seek
+	 * @param reader Reader used to submit the node reads
+	 *
+	 * @return One pointer per key, in the same order as the keys, with the
+	 * value if found, null otherwise
+	 */
+	template <typename U>
+	std::vector<std::unique_ptr<T>> seekMany(const std::vector<U>& keys, AsyncReader& reader);
+	
+	//! Visits, in order, every value between two keys
+	/*!
+	 * Descends once to the leaf where the range begins and then follows the
+	 * leaves' links, so a scan costs the tree height plus the leaves holding
+	 * the values visited.
+	 *
+	 * @tparam U See BPlusTree::seek
+	 * @tparam Visit Callable receiving a `const T&` and returning false to
+	 * stop the scan
+	 *
+	 * @param lo Smallest key to visit
+	 * @param hi Biggest key to visit
+	 * @param visit Called with each value v such that `lo <= v <= hi`
+	 *
+	 * @return False if the scan was stopped by visit, true otherwise
+	 */
+	template <typename U, typename Visit>
+	bool scan(const U& lo, const U& hi, Visit visit);
+	
+	//! Visits every value in the tree, in order
+	/*!
+	 * Reads the leftmost path and then every leaf once.
+	 *
+	 * @tparam Visit See BPlusTree::scan
+	 *
+	 * @return False if the scan was stopped by visit, true otherwise
+	 */
+	template <typename Visit>
+	bool scan(Visit visit);
+	
+	//! Quantity of values in the tree
+	/*!
+	 * Only available if Counted is true. Reads no blocks.
+	 */
+	std::size_t size() const;
+	
+	//! Quantity of values less than a key
+	/*!
+	 * Only available if Counted is true. Reads one node per level.
+	 *
+	 * @tparam U See BPlusTree::seek
+	 *
+	 * @param key Key to rank
+	 *
+	 * @return Position the key has, or would have, in the sorted values
+	 */
+	template <typename U>
+	std::size_t rank(const U& key);
+	
+	//! Value at a position in sorted order
+	/*!
+	 * Only available if Counted is true. Reads one node per level.
+	 *
+	 * @param position Position of the value, starting at 0
+	 *
+	 * @return Pointer with the value, null if there aren't that many values
+	 */
+	std::unique_ptr<T> select(std::size_t position);
+	
+	//! Quantity of values between two keys
+	/*!
+	 * Only available if Counted is true. Reads two nodes per level at most.
+	 *
+	 * @tparam U See BPlusTree::seek
+	 *
+	 * @param lo Smallest key to count
+	 * @param hi Biggest key to count
+	 *
+	 * @return Quantity of values v such that `lo <= v <= hi`
+	 */
+	template <typename U>
+	std::size_t count(const U& lo, const U& hi);
+	
+	//! BPlusTree usage analytics
+	struct Statistics {
+		std::uint64_t blocksRead; //!< Quantity of blocks read since the tree was initialized
+		std::uint64_t blocksCreated; //!< Quantity of blocks created since the tree was initialized
+		std::uint64_t blocksInDisk; //!< Quantity of blocks stored in disk
+	};
+	
+	//! Returns the BPlusTree usage statistics so far
+	/*!
+	 * Including the quantity of blocks in the file is optional because it
+	 * requires reading the file header to update the field. The read value
+	 * will be stored in memory and can be accessed later without reading the
+	 * file header again.
+	 *
+	 * @param includeFileBlockCount True if you want to update the
+	 * Statistics::blocksInDisk value, false otherwise
+	 *
+	 * @return Statistics
+	 */
+	const Statistics& getStatistics(bool includeFileBlockCount = false) const;
+	
+	//! Reset all statistics values to 0
+	/*! Use with caution */
+	void resetStatistics();
+	
+	//! Updates the header with the total blocks in the file
+	/*!
+	 * Very important to be used once you've finished using a tree that was
+	 * initialized with BPlusTree::create
+	 */
+	void finishInsertions();
+
+private:
+	//! File header data for BPlusTree indexes
+	struct FileHeader {
+		std::uint32_t version; //!< Format version, see FORMAT_VERSION
+		std::uint32_t blockSize; //!< %Block size the tree was created with
+		std::uint32_t order; //!< Internal node order the tree was created with, see BPlusTree::InternalOrder
+		long rootAddress;
+		std::uint64_t blockCount;
+	};
+	
+	//! File header block
+	typedef Block<FileHeader, BlockSize> FileHeaderBlock;
+	
+	//! Internal node, with separators and children only
+	/*!
+	 * Child `i` holds the values between `keys[i - 1]` and `keys[i]`,
+	 * inclusive: a key equal to a separator is sought to its right, but
+	 * equivalent values inserted before the split that created the separator
+	 * may be to its left.
+	 *
+	 * Laid out so that nothing is wasted between its parts: the one-word
+	 * NodeHeader, then the counts, the children and the keys.
+	 * maxBPlusTreeInternalOrder relies on this layout to find the biggest
+	 * order that fits in a block. Nodes only
+	 * have room for 2MI keys; a full node receiving a key is split, see
+	 * BPlusTree::splitInternal.
+	 */
+	struct InternalNode : NodeHeader<BlockSize>, NodeCounts<Counted, 2 * MI + 1> {
+		long children[2 * MI + 1]; //!< Children offsets
+		Key keys[2 * MI]; //!< Separators
+		
+		//! Child whose subtree holds a key
+		/*!
+		 * @tparam U See BPlusTree::seek
+		 *
+		 * @param key Key to look for
+		 * @param leftmost True to get the leftmost child which may hold values
+		 * equivalent to the key, false to get the rightmost one
+		 *
+		 * @return Child position
+		 */
+		template <typename U>
+		std::size_t child(const U& key, bool leftmost = false) const;
+	};
+	
+	//! Leaf node, with the values and the link to the next leaf
+	/*!
+	 * The values are stored through the Leaf layout. When the layout refuses
+	 * a value, the leaf and the value are put together in a temporary array
+	 * and split.
+	 */
+	struct LeafNode : NodeHeader<BlockSize> {
+		long next; //!< Offset of the next leaf, -1 if it's the last one
+		Leaf entries; //!< Values, sorted
+		
+		//! Looks for a key within this leaf
+		/*!
+		 * @tparam U See BPlusTree::seek
+		 *
+		 * @param key Value to look for
+		 * @param found Set to true if the value at the returned position is
+		 * equivalent to the key
+		 *
+		 * @return Position of the first value that isn't less than the key
+		 */
+		template <typename U>
+		std::size_t find(const U& key, bool& found) const;
+	};
+	
+	//! Node of either kind, as read from a block
+	/*!
+	 * NodeHeader::isLeaf tells which of the two layouts is in use.
+	 */
+	union Node {
+		NodeHeader<BlockSize> header; //!< Part shared by both layouts
+		InternalNode internal; //!< Layout of internal nodes
+		LeafNode leaf; //!< Layout of leaves
+		
+		//! Initializes the node
+		/*!
+		 * The node is initialized without a place in the file (see
+		 * NodeHeader::isWritten), so that writing it gives it one. Leaves
+		 * begin without a next leaf.
+		 *
+		 * Implemented as a method rather than a constructor because nodes must
+		 * be PODs to be serialized in the binary file.
+		 *
+		 * @param isLeaf True if the node will be a leaf, false if it will be an
+		 * internal node
+		 * @param size Initial node size
+		 */
+		void initialize(bool isLeaf = true, std::size_t size = 0);
+		
+		//! Checks if the node has reached its maximum capacity
+		/*!
+		 * Only meaningful for internal nodes; leaves are full whenever their
+		 * Leaf layout refuses a value.
+		 *
+		 * @return True if the node holds 2MI keys
+		 */
+		bool isFull() const;
+		
+		//! Quantity of values in the node's subtree
+		/*!
+		 * Only exact if Counted is true, or if the node is a leaf.
+		 */
+		std::size_t subtreeSize() const;
+	};
+	
+	static_assert(sizeof(Node) <= BlockSize, "B+ tree nodes don't fit in a block, consider decreasing the orders");
+	static_assert(2 * MI <= NODE_MAX_SIZE && Leaf::Capacity <= NODE_MAX_SIZE, "B+ tree nodes too big for the node header");
+	
+	//! Node block
+	typedef Block<Node, BlockSize> NodeBlock;
+	
+	BlockFile m_file; //!< File where data will be stored
+	NodeBlock m_root; //!< Root node of the tree
+	mutable Statistics m_stats; //!< Where BPlusTree stores its read and write statistics
+	
+	std::unordered_map<long, NodeBlock*> m_pinned; //!< Nodes kept in memory by BPlusTree::pin, by offset
+	std::vector<AlignedBuffer> m_pinnedLevels; //!< Memory of the pinned nodes, one buffer per level
+	
+	std::vector<NodeBlock> m_path; //!< Nodes below the root along the path of the last insertion, reused by the next ones
+	std::vector<std::size_t> m_pathChildren; //!< Child taken at each level of that path, the root's first
+	std::vector<T> m_splitValues; //!< Values of the last leaf split, reused by the next ones
+	
+	//! Reads the node in the block at the provided offset
+	/*!
+	 * Assumes that the offset is the one of a node. Increments
+	 * Statistics::blocksRead if the block had to be fetched. Pinned nodes are
+	 * copied from memory instead, see BPlusTree::pin.
+	 */
+	NodeBlock readFromDisk(long offset);
+	
+	//! Reads the node in the block at the provided offset into a node block
+	/*!
+	 * Same as BPlusTree::readFromDisk, without copying the node once more to
+	 * return it.
+	 */
+	void readFromDisk(long offset, NodeBlock& node);
+	
+	//! Reads the node in the block at the provided offset in place
+	/*!
+	 * Same as BPlusTree::readFromDisk, without copying the node: see
+	 * BlockFile::view. Pinned nodes are handed out where they are.
+	 *
+	 * @param offset %Block offset
+	 * @param buffer Where the node is read into if there's no cache
+	 */
+	PageRef viewFromDisk(long offset, NodeBlock& buffer);
+	
+	//! Writes the node to disk
+	/*!
+	 * If the node still hasn't been written to disk (see
+	 * NodeHeader::isWritten), it's appended to the end of the file, given
+	 * that place, and Statistics::blocksCreated is incremented. Otherwise
+	 * it's simply updated. The pinned copy, if there's one, is updated as
+	 * well.
+	 */
+	void writeToDisk(NodeBlock& node);
+	
+	//! Reads the file header
+	/*!
+	 * Increments Statistics::blocksRead.
+	 */
+	FileHeaderBlock readHeader() const;
+	
+	//! Updates the file header in disk
+	void writeHeader(const FileHeaderBlock& header);
+	
+	//! Separator on its way into a parent after a split during insertion
+	struct Insertion {
+		Key separator; //!< Key that must be inserted in the parent node, to the left of Insertion::rightNode
+		long rightNode; //!< Offset of the node created by the split
+		std::size_t leftCount; //!< Quantity of values under the node that was split, if Counted
+		std::size_t rightCount; //!< Quantity of values under the node created by the split, if Counted
+	};
+	
+	//! Internal node being filled by BPlusTree::bulkLoad, one per level
+	struct BulkLevel {
+		NodeBlock node; //!< Node being filled
+		Key first; //!< Smallest key under the node, which becomes its separator in the parent
+		bool empty; //!< True if the node has no children yet
+	};
+	
+	//! Node of the copy written by BPlusTree::reorganize, before it's written
+	struct PackedNode {
+		Key first; //!< Smallest key under the node, which becomes its separator in the parent
+		std::size_t count; //!< Quantity of values under the node
+		std::size_t firstChild; //!< Position of the node's first child in the level below
+	};
+	
+	//! Adds a child to the node being filled at a level of BPlusTree::bulkLoad
+	/*!
+	 * If the node is already full, it's written and added to the level above
+	 * in turn, and a new node is begun with the child.
+	 *
+	 * @param levels Nodes being filled, from the bottom up. A level is added on
+	 * top if needed.
+	 * @param level Level of the node that gets the child
+	 * @param first Smallest key under the child
+	 * @param child Offset of the child
+	 * @param count Quantity of values under the child
+	 * @param end Offset of the next block to hand out
+	 */
+	void bulkAddChild(std::vector<BulkLevel>& levels, std::size_t level, const Key& first, long child, std::size_t count, long& end);
+	
+	//! Node at a level of the insertion path
+	/*!
+	 * @param level 0 for the root, which is used in place
+	 */
+	NodeBlock& pathNode(std::size_t level);
+
+	//! Reads the insertion path from the root down to a leaf
+	/*!
+	 * Every node of the path and the child taken in each are kept, in
+	 * BPlusTree::m_path and BPlusTree::m_pathChildren, so that splits can be
+	 * carried up without recursion.
+	 *
+	 * @param key Key whose leaf will be read
+	 *
+	 * @return Level of the leaf, see BPlusTree::pathNode
+	 */
+	std::size_t descendPath(const Key& key);
+
+	//! Inserts a value in the leaf at the end of the insertion path
+	/*!
+	 * Splits are carried up the path read by BPlusTree::descendPath.
+	 *
+	 * @param leaf Level of the leaf, as returned by BPlusTree::descendPath
+	 * @param value Value to insert
+	 */
+	void insertInPath(std::size_t leaf, const T& value);
+	
+	//! Splits a full leaf around the value being inserted in it
+	/*!
+	 * The leaf keeps its first values and gives the others to a new leaf,
+	 * whose first key is copied to the parent (see BPlusTree::splitPosition).
+	 * Both leaves are written.
+	 *
+	 * @param node Full leaf
+	 * @param position Position of the value in the leaf
+	 * @param value Value to insert
+	 *
+	 * @return Separator and new leaf to insert in the parent
+	 */
+	Insertion splitLeaf(NodeBlock& node, std::size_t position, const T& value);
+	
+	//! Inserts a separator in an internal node that isn't full
+	/*!
+	 * Keys and children after the position are moved one place to the right;
+	 * the node isn't written.
+	 *
+	 * @param node Node where the separator is inserted
+	 * @param position Child that was split
+	 * @param insertion Separator to insert, with the new child to its right
+	 */
+	static void insertAt(InternalNode& node, std::size_t position, const Insertion& insertion);
+	
+	//! Splits a full internal node around the separator being inserted in it
+	/*!
+	 * The node together with the separator would hold 2MI + 1 keys: the node
+	 * keeps the first MI keys and MI + 1 children, a new node to its right
+	 * gets the same quantity, and the middle key goes up. Both nodes are
+	 * filled straight from the full one, without gathering everything in an
+	 * intermediate buffer, and written.
+	 *
+	 * @param node Full node
+	 * @param position Child that was split
+	 * @param insertion Separator to insert; replaced by the middle key and the
+	 * new node, to be inserted in the parent
+	 */
+	void splitInternal(NodeBlock& node, std::size_t position, Insertion& insertion);
+	
+	//! Makes the root the parent of itself and the node created when it was split
+	/*!
+	 * @param insertion Separator and node that the root's split left for its
+	 * parent
+	 */
+	void growRoot(const Insertion& insertion);
+	
+	//! Reads nodes from the root down to a leaf
+	/*!
+	 * @param key Key whose leaf will be read
+	 * @param leftmost See InternalNode::child
+	 *
+	 * @return The leaf
+	 */
+	template <typename U>
+	NodeBlock descend(const U& key, bool leftmost);
+	
+	//! Looks at nodes from the root down to a leaf, in place
+	/*!
+	 * Same as BPlusTree::descend, through BPlusTree::viewFromDisk.
+	 *
+	 * @param buffer Where nodes are read into if there's no cache
+	 *
+	 * @return Handle on the leaf
+	 */
+	template <typename U>
+	PageRef descendInPlace(const U& key, bool leftmost, NodeBlock& buffer);
+	
+	//! Chooses how many values of an overflowing leaf stay in it
+	/*!
+	 * Values are split in half if the Leaf layout allows it. Encoded layouts
+	 * may not hold half of the values if they aren't alike, such as keys far
+	 * from the others, in which case the position closest to the middle where
+	 * both halves fit is chosen.
+	 *
+	 * @param values Values of the leaf and the value being inserted, sorted
+	 *
+	 * @return Quantity of values for the left leaf
+	 */
+	static std::size_t splitPosition(const std::vector<T>& values);
+	
+	//! Quantity of values less than a key, or not greater than it
+	/*!
+	 * Internal method for BPlusTree::rank and BPlusTree::count.
+	 *
+	 * @param key Key to compare the values with
+	 * @param inclusive True to also count the values equivalent to the key
+	 */
+	template <typename U>
+	std::size_t countBelow(const U& key, bool inclusive);
+};
+
+#include "BPlusTree.inl"
+
+#endif // _BPLUSTREE_HPP_INCLUDED_
@@ -0,0 +1,1056 @@
+#include <algorithm>
+
+// --- //
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+template <typename U>
+std::size_t BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::InternalNode::child(const U& key, bool leftmost) const {
+	auto last = keys + this->size;
+	auto it = leftmost? std::lower_bound(keys, last, key) : std::upper_bound(keys, last, key);
+	return it - keys;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+template <typename U>
+std::size_t BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::LeafNode::find(const U& key, bool& found) const {
+	auto i = entries.lowerBound(key, this->size);
+	
+	found = i < this->size && !(key < entries.value(i));
+	return i;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+void BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::Node::initialize(bool isLeaf, std::size_t size) {
+	header.block = 0;
+	header.isLeaf = isLeaf;
+	header.size = size;
+	
+	if (isLeaf) leaf.next = -1;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+bool BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::Node::isFull() const {
+	return header.size >= 2 * MI;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+std::size_t BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::Node::subtreeSize() const {
+	if (header.isLeaf) return header.size;
+	
+	std::size_t total = 0;
+	for (std::size_t i = 0; i <= header.size; ++i) total += internal.count(i);
+	
+	return total;
+}
+
+// --- //
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::BPlusTree()
+	: m_stats({ 0, 0, 0 })
+{	}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::~BPlusTree() {
+	m_file.close();
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+void BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::useCache(BlockCache *cache) {
+	m_file.useCache(cache);
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+bool BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::create(const char* filepath) {
+	if (m_file.create(filepath)) {
+		resetStatistics();
+		m_pinned.clear();
+		m_pinnedLevels.clear();
+		
+		FileHeaderBlock header;
+		header.var.version = FORMAT_VERSION;
+		header.var.blockSize = BlockSize;
+		header.var.order = MI;
+		writeHeader(header);
+		++m_stats.blocksCreated;
+		
+		m_root.var.initialize(true); // Root begins as a leaf
+		writeToDisk(m_root);
+		
+		header.var.rootAddress = m_root.var.header.offset();
+		header.var.blockCount = m_stats.blocksCreated;
+		writeHeader(header);
+		
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+bool BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::load(const char* filepath) {
+	if (m_file.open(filepath)) {
+		m_pinned.clear();
+		m_pinnedLevels.clear();
+		
+		FileHeaderBlock header = readHeader();
+		
+		// Nodes of another format, size or order would be read wrong
+		bool compatible = header.var.version == FORMAT_VERSION && header.var.blockSize == BlockSize && header.var.order == MI;
+		
+		if (!compatible) {
+			m_file.close();
+			return false;
+		}
+		
+		m_root = readFromDisk(header.var.rootAddress);
+		++m_stats.blocksRead;
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+std::size_t BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::pin(std::size_t levels, std::size_t byteBudget) {
+	m_pinned.clear();
+	m_pinnedLevels.clear();
+	
+	// The root is always in memory, so pinning begins with its children
+	std::vector<long> offsets;
+	
+	auto addChildren = [&offsets](const Node& node) {
+		if (node.header.isLeaf) return;
+		offsets.insert(offsets.end(), node.internal.children, node.internal.children + node.header.size + 1);
+	};
+	
+	addChildren(m_root.var);
+	
+	AsyncReader reader;
+	int fd = m_file.descriptor();
+	std::size_t pinned = 0;
+	
+	for (std::size_t level = 1; level < levels && !offsets.empty(); ++level) {
+		if ((pinned + offsets.size()) * sizeof(NodeBlock) > byteBudget) break;
+		
+		std::sort(offsets.begin(), offsets.end());
+		
+		auto buffer = allocateAligned(offsets.size() * sizeof(NodeBlock), BlockSize);
+		auto nodes = reinterpret_cast<NodeBlock*>(buffer.get());
+		
+		std::vector<AsyncReader::Request> requests;
+		
+		for (std::size_t i = 0, j; i < offsets.size(); i = j) {
+			for (j = i + 1; j < offsets.size() && offsets[j] == offsets[j - 1] + BlockSize; ++j) {
+				// Nodes next to each other are read together
+			}
+			
+			AsyncReader::Request request;
+			request.fd = fd;
+			request.offset = offsets[i];
+			request.buffer = nodes + i;
+			request.size = (j - i) * sizeof(NodeBlock);
+			request.userData = nullptr;
+			requests.push_back(request);
+		}
+		
+		std::size_t next = 0;
+		std::size_t inFlight = 0;
+		bool complete = true;
+		
+		while (next < requests.size() || inFlight) {
+			while (next < requests.size() && inFlight < reader.queueDepth()) {
+				reader.submit(requests[next++]);
+				++inFlight;
+			}
+			
+			auto& done = reader.wait();
+			--inFlight;
+			
+			complete = complete && done.result == static_cast<long>(done.size);
+		}
+		
+		if (!complete) break;
+		
+		auto parents = std::move(offsets);
+		offsets.clear();
+		
+		for (std::size_t i = 0; i < parents.size(); ++i) {
+			m_pinned[parents[i]] = nodes + i;
+			addChildren(nodes[i].var);
+		}
+		
+		pinned += parents.size();
+		m_pinnedLevels.push_back(std::move(buffer));
+	}
+	
+	return pinned;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+void BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::insert(const T& value) {
+	insertInPath(descendPath(KeyOf()(value)), value);
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+template <typename Merge>
+bool BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::insertOrMerge(const T& value, Merge merge) {
+	// The path to the leaf is kept, so that a value that isn't there yet is
+	// inserted without descending again
+	auto leaf = descendPath(KeyOf()(value));
+	auto& node = pathNode(leaf);
+	
+	bool found;
+	auto i = node.var.leaf.find(value, found);
+	
+	if (!found) {
+		insertInPath(leaf, value);
+		return true;
+	}
+	
+	merge(node.var.leaf.entries.values[i]);
+	writeToDisk(node);
+	return false;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+std::size_t BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::descendPath(const Key& key) {
+	std::size_t leaf = 0;
+	
+	while (!pathNode(leaf).var.header.isLeaf) {
+		if (m_path.size() == leaf) {
+			m_path.emplace_back();
+			m_pathChildren.emplace_back();
+		}
+		
+		auto& n = pathNode(leaf).var.internal;
+		auto i = n.child(key);
+		
+		m_pathChildren[leaf] = i;
+		readFromDisk(n.children[i], m_path[leaf]);
+		++leaf;
+	}
+	
+	return leaf;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+void BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::insertInPath(std::size_t leaf, const T& value) {
+	auto& node = pathNode(leaf);
+	auto& l = node.var.leaf;
+	auto position = l.entries.upperBound(value, l.size);
+	
+	Insertion insertion;
+	auto level = leaf;
+	
+	if (l.entries.insert(l.size, position, value)) {
+		++l.size;
+		writeToDisk(node);
+	}
+	else {
+		insertion = splitLeaf(node, position, value);
+		
+		// Separators go up until a node has room for them
+		while (true) {
+			if (level == 0) {
+				growRoot(insertion);
+				return;
+			}
+			
+			auto& parent = pathNode(--level);
+			auto child = m_pathChildren[level];
+			
+			if (!parent.var.isFull()) {
+				insertAt(parent.var.internal, child, insertion);
+				writeToDisk(parent);
+				break;
+			}
+			
+			splitInternal(parent, child, insertion);
+		}
+	}
+	
+	// The nodes above only got one more value under the child taken
+	for (auto above = level; Counted && above-- > 0;) {
+		auto& parent = pathNode(above);
+		auto child = m_pathChildren[above];
+		
+		parent.var.internal.setCount(child, parent.var.internal.count(child) + 1);
+		writeToDisk(parent);
+	}
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+template <typename Next>
+void BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::bulkLoad(Next next) {
+	// Nodes are given their block before they're written, so that a leaf
+	// knows where the next one will be. The empty root written by create
+	// becomes the first leaf.
+	long end = m_file.end();
+	
+	NodeBlock leaf = m_root;
+	Key first = Key();
+	std::vector<BulkLevel> levels;
+	T value;
+	
+	while (next(value)) {
+		auto& current = leaf.var.leaf;
+		
+		if (current.size == 0) first = KeyOf()(value);
+		
+		if (current.entries.insert(current.size, current.size, value)) {
+			++current.size;
+			continue;
+		}
+		
+		// The leaf is full, so the value begins the next one
+		NodeBlock right;
+		right.var.initialize(true, 1);
+		right.var.header.setOffset(end);
+		right.var.leaf.entries.assign(&value, 1);
+		end += BlockSize;
+		++m_stats.blocksCreated;
+		
+		current.next = right.var.header.offset();
+		writeToDisk(leaf);
+		bulkAddChild(levels, 0, first, leaf.var.header.offset(), current.size, end);
+		
+		leaf = right;
+		first = KeyOf()(value);
+	}
+	
+	writeToDisk(leaf);
+	NodeBlock root = leaf;
+	
+	if (!levels.empty()) {
+		bulkAddChild(levels, 0, first, leaf.var.header.offset(), leaf.var.header.size, end);
+		
+		// The nodes left open are written from the bottom up. A top level with
+		// a single child isn't needed: the child is the root.
+		for (std::size_t i = 0; i < levels.size(); ++i) {
+			auto& node = levels[i].node;
+			
+			if (i + 1 == levels.size() && node.var.header.size == 0) break;
+			
+			node.var.header.setOffset(end);
+			end += BlockSize;
+			++m_stats.blocksCreated;
+			writeToDisk(node);
+			
+			root = node;
+			if (i + 1 == levels.size()) break;
+			
+			auto separator = levels[i].first;
+			bulkAddChild(levels, i + 1, separator, root.var.header.offset(), root.var.subtreeSize(), end);
+		}
+	}
+	
+	m_root = root;
+	
+	auto header = readHeader();
+	header.var.rootAddress = m_root.var.header.offset();
+	header.var.blockCount = m_stats.blocksCreated;
+	writeHeader(header);
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+bool BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::reorganize(const char* filepath) {
+	// Leaves are cut where the Leaf layout refuses a value, as in bulkLoad.
+	// Levels are kept from the bottom up.
+	std::vector<std::vector<PackedNode>> levels(1);
+	Leaf scratch;
+	std::size_t n = 0;
+	Key first = Key();
+	
+	scan([&](const T& value) {
+		if (n > 0 && scratch.insert(n, n, value)) {
+			++n;
+			return true;
+		}
+		
+		if (n > 0) levels[0].push_back({ first, n, 0 });
+		
+		scratch.insert(0, 0, value);
+		first = KeyOf()(value);
+		n = 1;
+		return true;
+	});
+	
+	// An empty tree is still a single leaf
+	if (n > 0 || levels[0].empty()) levels[0].push_back({ first, n, 0 });
+	
+	const std::size_t fanout = 2 * MI + 1;
+	
+	while (levels.back().size() > 1) {
+		auto& below = levels.back();
+		auto parents = (below.size() + fanout - 1) / fanout;
+		
+		std::vector<std::size_t> bounds;
+		for (std::size_t i = 0; i < parents; ++i) bounds.push_back(i * fanout);
+		bounds.push_back(below.size());
+		
+		// The last node would be left with what doesn't fill the others, maybe
+		// a single child, so it shares them with the one before
+		if (parents > 1) bounds[parents - 1] = bounds[parents - 2] + (below.size() - bounds[parents - 2] + 1) / 2;
+		
+		std::vector<PackedNode> level;
+		
+		for (std::size_t i = 0; i < parents; ++i) {
+			std::size_t count = 0;
+			for (auto c = bounds[i]; c < bounds[i + 1]; ++c) count += below[c].count;
+			
+			level.push_back({ below[bounds[i]].first, count, bounds[i] });
+		}
+		
+		levels.push_back(level);
+	}
+	
+	// The root right after the header, then each level below it
+	std::vector<long> start(levels.size());
+	long end = BlockSize;
+	
+	for (auto l = levels.size(); l-- > 0;) {
+		start[l] = end;
+		end += levels[l].size() * BlockSize;
+	}
+	
+	BPlusTree copy;
+	if (!copy.create(filepath)) return false;
+	
+	for (auto l = levels.size() - 1; l > 0; --l) {
+		auto& below = levels[l - 1];
+		
+		for (std::size_t i = 0; i < levels[l].size(); ++i) {
+			auto begin = levels[l][i].firstChild;
+			auto last = i + 1 < levels[l].size()? levels[l][i + 1].firstChild : below.size();
+			
+			NodeBlock node;
+			node.var.initialize(false, last - begin - 1);
+			node.var.header.setOffset(start[l] + i * BlockSize);
+			
+			auto& internal = node.var.internal;
+			
+			for (auto c = begin; c < last; ++c) {
+				internal.children[c - begin] = start[l - 1] + c * BlockSize;
+				internal.setCount(c - begin, below[c].count);
+				if (c > begin) internal.keys[c - begin - 1] = below[c].first;
+			}
+			
+			copy.writeToDisk(node);
+		}
+	}
+	
+	std::vector<T> values;
+	std::size_t leaf = 0;
+	
+	auto writeLeaf = [&] {
+		NodeBlock node;
+		node.var.initialize(true, values.size());
+		node.var.header.setOffset(start[0] + leaf * BlockSize);
+		node.var.leaf.entries.assign(values.data(), values.size());
+		
+		if (leaf + 1 < levels[0].size()) node.var.leaf.next = node.var.header.offset() + BlockSize;
+		
+		copy.writeToDisk(node);
+		values.clear();
+		++leaf;
+	};
+	
+	scan([&](const T& value) {
+		values.push_back(value);
+		if (values.size() == levels[0][leaf].count) writeLeaf();
+		
+		return true;
+	});
+	
+	while (leaf < levels[0].size()) writeLeaf();
+	
+	copy.m_root = copy.readFromDisk(start.back());
+	copy.m_stats.blocksCreated = end / BlockSize;
+	
+	auto header = copy.readHeader();
+	header.var.rootAddress = start.back();
+	copy.writeHeader(header);
+	copy.finishInsertions();
+	
+	return true;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+template <typename U>
+std::unique_ptr<T> BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::seek(const U& key) {
+	T value;
+	return seek(key, value)? std::make_unique<T>(value) : nullptr;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+template <typename U>
+bool BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::seek(const U& key, T& value) {
+	NodeBlock buffer;
+	PageRef page = descendInPlace(key, false, buffer);
+	if (!page) return false;
+	
+	auto& leaf = page.as<NodeBlock>().var.leaf;
+	
+	bool found;
+	auto i = leaf.find(key, found);
+	
+	if (found) value = leaf.entries.value(i);
+	return found;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+template <typename U>
+std::vector<std::unique_ptr<T>> BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::seekMany(const std::vector<U>& keys, AsyncReader& reader) {
+	std::vector<std::unique_ptr<T>> results(keys.size());
+	
+	// Each descent in flight owns a node buffer and the request reading into it
+	struct Descent {
+		std::size_t key;
+		NodeBlock *node;
+		AsyncReader::Request request;
+	};
+	
+	std::vector<Descent> descents(std::min(keys.size(), reader.queueDepth()));
+	std::size_t nextKey = 0;
+	std::size_t inFlight = 0;
+	
+	// Node buffers are block-aligned so that they can also be used with O_DIRECT
+	auto buffers = allocateAligned(descents.size() * sizeof(NodeBlock), BlockSize);
+	for (std::size_t i = 0; i < descents.size(); ++i) {
+		descents[i].node = reinterpret_cast<NodeBlock*>(buffers.get()) + i;
+	}
+	
+	int fd = m_file.descriptor();
+	auto cache = m_file.cache();
+	
+	// Decides the descent's next step based on the node it's currently at.
+	// Returns true if a child read was submitted, false if the descent ended.
+	auto advance = [&](Descent& d, const Node *node) {
+		while (!node->header.isLeaf) {
+			auto child = node->internal.children[node->internal.child(keys[d.key])];
+			auto pinned = m_pinned.find(child);
+			
+			if (pinned != m_pinned.end()) {
+				node = &pinned->second->var;
+				continue;
+			}
+			
+			if (cache) {
+				if (auto cached = cache->lookup(fd, child)) {
+					node = &reinterpret_cast<const NodeBlock*>(cached)->var;
+					continue;
+				}
+			}
+			
+			d.request.fd = fd;
+			d.request.offset = child;
+			d.request.buffer = d.node;
+			d.request.size = sizeof(NodeBlock);
+			d.request.userData = &d;
+			reader.submit(d.request);
+			return true;
+		}
+		
+		bool found;
+		auto i = node->leaf.find(keys[d.key], found);
+		if (found) results[d.key] = std::make_unique<T>(node->leaf.entries.value(i));
+		
+		return false;
+	};
+	
+	// Hands the next keys to the descent until one of them needs the device
+	auto start = [&](Descent& d) {
+		while (nextKey < keys.size()) {
+			d.key = nextKey++;
+			
+			if (advance(d, &m_root.var)) {
+				++inFlight;
+				return;
+			}
+		}
+	};
+	
+	for (auto& d : descents) {
+		start(d);
+	}
+	
+	while (inFlight) {
+		auto& request = reader.wait();
+		auto& d = *static_cast<Descent*>(request.userData);
+		--inFlight;
+		++m_stats.blocksRead;
+		
+		bool complete = request.result == static_cast<long>(sizeof(NodeBlock));
+		if (complete && cache) cache->insert(fd, request.offset, d.node, BlockCache::IndexPage);
+		
+		if (complete && advance(d, &d.node->var)) {
+			++inFlight;
+		}
+		else {
+			start(d);
+		}
+	}
+	
+	return results;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+template <typename U, typename Visit>
+bool BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::scan(const U& lo, const U& hi, Visit visit) {
+	if (hi < lo) return true;
+	
+	auto node = descend(lo, true);
+	auto i = node.var.leaf.entries.lowerBound(lo, node.var.leaf.size);
+	
+	// Leaves are decoded whole, which is cheaper than value by value for
+	// encoded layouts
+	std::vector<T> values;
+	
+	while (true) {
+		auto& leaf = node.var.leaf;
+		values.resize(leaf.size);
+		leaf.entries.decode(leaf.size, values.data());
+		
+		for (; i < leaf.size; ++i) {
+			if (hi < values[i]) return true;
+			if (!visit(values[i])) return false;
+		}
+		
+		if (leaf.next == -1) return true;
+		
+		node = readFromDisk(leaf.next);
+		i = 0;
+	}
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+template <typename Visit>
+bool BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::scan(Visit visit) {
+	NodeBlock node = m_root;
+	
+	while (!node.var.header.isLeaf) {
+		node = readFromDisk(node.var.internal.children[0]);
+	}
+	
+	std::vector<T> values;
+	
+	while (true) {
+		auto& leaf = node.var.leaf;
+		values.resize(leaf.size);
+		leaf.entries.decode(leaf.size, values.data());
+		
+		for (auto& value : values) {
+			if (!visit(value)) return false;
+		}
+		
+		if (leaf.next == -1) return true;
+		node = readFromDisk(leaf.next);
+	}
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+std::size_t BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::size() const {
+	static_assert(Counted, "Only order-statistic trees know their size");
+	return m_root.var.subtreeSize();
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+template <typename U>
+std::size_t BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::rank(const U& key) {
+	return countBelow(key, false);
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+std::unique_ptr<T> BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::select(std::size_t position) {
+	static_assert(Counted, "Only order-statistic trees support select");
+	
+	NodeBlock node = m_root;
+	
+	while (!node.var.header.isLeaf) {
+		auto& n = node.var.internal;
+		std::size_t i = 0;
+		
+		// Skips whole children until reaching the one holding the position
+		for (; i <= n.size; ++i) {
+			if (position < n.count(i)) break;
+			position -= n.count(i);
+		}
+		
+		if (i > n.size) return nullptr;
+		node = readFromDisk(n.children[i]);
+	}
+	
+	auto& leaf = node.var.leaf;
+	return position < leaf.size? std::make_unique<T>(leaf.entries.value(position)) : nullptr;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+template <typename U>
+std::size_t BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::count(const U& lo, const U& hi) {
+	return hi < lo? 0 : countBelow(hi, true) - countBelow(lo, false);
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+const typename BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::Statistics& BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::getStatistics(bool includeFileBlockCount) const {
+	if (includeFileBlockCount)
+		m_stats.blocksInDisk = readHeader().var.blockCount;
+	
+	return m_stats;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+void BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::resetStatistics() {
+	m_stats.blocksRead = m_stats.blocksCreated = m_stats.blocksInDisk = 0;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+void BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::finishInsertions() {
+	FileHeaderBlock header = readHeader();
+	header.var.blockCount = m_stats.blocksCreated;
+	writeHeader(header);
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+typename BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::NodeBlock BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::readFromDisk(long offset) {
+	NodeBlock node;
+	readFromDisk(offset, node);
+	return node;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+void BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::readFromDisk(long offset, NodeBlock& node) {
+	if (!m_pinned.empty()) {
+		auto pinned = m_pinned.find(offset);
+		
+		if (pinned != m_pinned.end()) {
+			node = *pinned->second;
+			return;
+		}
+	}
+	
+	bool fetched;
+	
+	m_file.read(offset, &node, sizeof(node), &fetched);
+	
+	if (fetched) ++m_stats.blocksRead;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+PageRef BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::viewFromDisk(long offset, NodeBlock& buffer) {
+	if (!m_pinned.empty()) {
+		auto pinned = m_pinned.find(offset);
+		if (pinned != m_pinned.end()) return PageRef(reinterpret_cast<const char*>(pinned->second), nullptr);
+	}
+	
+	bool fetched;
+	auto page = m_file.view(offset, &buffer, sizeof(buffer), &fetched);
+	
+	if (fetched) ++m_stats.blocksRead;
+	return page;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+void BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::writeToDisk(NodeBlock& node) {
+	if (!node.var.header.isWritten()) {
+		node.var.header.setOffset(m_file.end());
+		++m_stats.blocksCreated;
+	}
+	
+	m_file.write(node.var.header.offset(), &node, sizeof(node));
+	
+	if (!m_pinned.empty()) {
+		auto pinned = m_pinned.find(node.var.header.offset());
+		if (pinned != m_pinned.end()) *pinned->second = node;
+	}
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+typename BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::FileHeaderBlock BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::readHeader() const {
+	FileHeaderBlock header;
+	bool fetched;
+	
+	m_file.read(0, &header, sizeof(header), &fetched);
+	
+	if (fetched) ++m_stats.blocksRead;
+	return header;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+void BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::writeHeader(const FileHeaderBlock& header) {
+	// The whole block is written so that nodes, appended after it, start at
+	// block boundaries
+	m_file.write(0, &header, sizeof(header));
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+typename BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::NodeBlock& BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::pathNode(std::size_t level) {
+	return level == 0? m_root : m_path[level - 1];
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+typename BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::Insertion BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::splitLeaf(NodeBlock& node, std::size_t position, const T& value) {
+	// The leaf and the new value are put together and split in two, as
+	// evenly as the layout allows. The first value of the new leaf, to the
+	// right, becomes the separator.
+	auto& leaf = node.var.leaf;
+	auto& values = m_splitValues;
+	
+	values.resize(leaf.size + 1);
+	leaf.entries.decode(leaf.size, values.data());
+	std::copy_backward(values.begin() + position, values.end() - 1, values.end());
+	values[position] = value;
+	
+	auto split = splitPosition(values);
+	
+	NodeBlock right;
+	right.var.initialize(true, values.size() - split);
+	right.var.leaf.entries.assign(values.data() + split, values.size() - split);
+	right.var.leaf.next = leaf.next;
+	
+	leaf.size = split;
+	leaf.entries.assign(values.data(), split);
+	
+	writeToDisk(right);
+	leaf.next = right.var.header.offset();
+	writeToDisk(node);
+	
+	return { KeyOf()(values[split]), right.var.header.offset(), split, values.size() - split };
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+void BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::insertAt(InternalNode& node, std::size_t position, const Insertion& insertion) {
+	for (std::size_t j = node.size; position < j; --j) {
+		node.keys[j] = node.keys[j - 1];
+		node.children[j + 1] = node.children[j];
+		node.setCount(j + 1, node.count(j));
+	}
+	
+	node.keys[position] = insertion.separator;
+	node.children[position + 1] = insertion.rightNode;
+	node.setCount(position, insertion.leftCount);
+	node.setCount(position + 1, insertion.rightCount);
+	++node.size;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+void BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::splitInternal(NodeBlock& node, std::size_t position, Insertion& insertion) {
+	auto& n = node.var.internal;
+	
+	// Keys and children the node would have with the insertion, read from
+	// where they are
+	auto key = [&](std::size_t k) -> const Key& {
+		return k < position? n.keys[k] : k == position? insertion.separator : n.keys[k - 1];
+	};
+	
+	auto child = [&](std::size_t k) {
+		return k <= position? n.children[k] : k == position + 1? insertion.rightNode : n.children[k - 1];
+	};
+	
+	auto count = [&](std::size_t k) {
+		return k < position? n.count(k) : k == position? insertion.leftCount
+			: k == position + 1? insertion.rightCount : n.count(k - 1);
+	};
+	
+	// The new node takes the last half first, before the node is changed
+	NodeBlock right;
+	right.var.initialize(false, MI);
+	auto& r = right.var.internal;
+	
+	for (std::size_t k = 0; k < MI; ++k) {
+		r.keys[k] = key(MI + 1 + k);
+	}
+	
+	for (std::size_t k = 0; k <= MI; ++k) {
+		r.children[k] = child(MI + 1 + k);
+		r.setCount(k, count(MI + 1 + k));
+	}
+	
+	Key middle = key(MI);
+	
+	// The node keeps the first half, where the insertion only lands if it's
+	// to the left of the middle
+	if (position < MI) {
+		for (std::size_t k = MI; position + 1 < k; --k) {
+			n.children[k] = n.children[k - 1];
+			n.setCount(k, n.count(k - 1));
+		}
+		
+		for (std::size_t k = MI - 1; position < k; --k) {
+			n.keys[k] = n.keys[k - 1];
+		}
+		
+		n.keys[position] = insertion.separator;
+		n.children[position + 1] = insertion.rightNode;
+		n.setCount(position + 1, insertion.rightCount);
+	}
+	
+	if (position <= MI) {
+		n.setCount(position, insertion.leftCount);
+	}
+	
+	n.size = MI;
+	
+	writeToDisk(right);
+	writeToDisk(node);
+	
+	insertion.separator = middle;
+	insertion.rightNode = right.var.header.offset();
+	insertion.leftCount = node.var.subtreeSize();
+	insertion.rightCount = right.var.subtreeSize();
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+void BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::growRoot(const Insertion& insertion) {
+	NodeBlock newRoot;
+	newRoot.var.initialize(false, 1);
+	
+	auto& root = newRoot.var.internal;
+	root.keys[0] = insertion.separator;
+	root.children[0] = m_root.var.header.offset();
+	root.children[1] = insertion.rightNode;
+	root.setCount(0, insertion.leftCount);
+	root.setCount(1, insertion.rightCount);
+	writeToDisk(newRoot);
+	
+	auto header = readHeader();
+	header.var.rootAddress = newRoot.var.header.offset();
+	header.var.blockCount = m_stats.blocksCreated;
+	writeHeader(header);
+	
+	m_root = newRoot;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+template <typename U>
+typename BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::NodeBlock BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::descend(const U& key, bool leftmost) {
+	NodeBlock node = m_root;
+	
+	while (!node.var.header.isLeaf) {
+		auto& n = node.var.internal;
+		node = readFromDisk(n.children[n.child(key, leftmost)]);
+	}
+	
+	return node;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+template <typename U>
+PageRef BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::descendInPlace(const U& key, bool leftmost, NodeBlock& buffer) {
+	PageRef page(reinterpret_cast<const char*>(&m_root), nullptr);
+	
+	// The child's offset is taken before the next node is read, which may be
+	// into the same buffer
+	while (page && !page.as<NodeBlock>().var.header.isLeaf) {
+		auto& n = page.as<NodeBlock>().var.internal;
+		page = viewFromDisk(n.children[n.child(key, leftmost)], buffer);
+	}
+	
+	return page;
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+template <typename U>
+std::size_t BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::countBelow(const U& key, bool inclusive) {
+	static_assert(Counted, "Only order-statistic trees can count values");
+	
+	NodeBlock node = m_root;
+	std::size_t below = 0;
+	
+	// Every child to the left of the one sought only holds values below the
+	// key, and every child to its right none
+	while (!node.var.header.isLeaf) {
+		auto& n = node.var.internal;
+		auto i = n.child(key, !inclusive);
+		
+		for (std::size_t j = 0; j < i; ++j) below += n.count(j);
+		
+		node = readFromDisk(n.children[i]);
+	}
+	
+	auto& leaf = node.var.leaf;
+	return below + (inclusive? leaf.entries.upperBound(key, leaf.size) : leaf.entries.lowerBound(key, leaf.size));
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+std::size_t BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::splitPosition(const std::vector<T>& values) {
+	auto n = values.size();
+	
+	// Smallest quantity of values that can go to the left leaf so that the
+	// others fit in the right one, and biggest quantity that fits in the left
+	// leaf. Both searches rely on shorter sequences always fitting when
+	// longer ones do.
+	std::size_t lo = 1;
+	std::size_t hi = n - 1;
+	
+	std::size_t first = lo, last = hi;
+	while (first < last) {
+		auto mid = (first + last) / 2;
+		if (Leaf::fits(values.data() + mid, n - mid)) last = mid;
+		else first = mid + 1;
+	}
+	
+	lo = first;
+	
+	first = lo, last = hi;
+	while (first < last) {
+		auto mid = (first + last + 1) / 2;
+		if (Leaf::fits(values.data(), mid)) first = mid;
+		else last = mid - 1;
+	}
+	
+	hi = first;
+	
+	return std::min(std::max((n + 1) / 2, lo), hi);
+}
+
+template <typename T, typename Key, typename KeyOf, std::size_t MI, typename Leaf, unsigned int BlockSize, bool Counted>
+void BPlusTree<T, Key, KeyOf, MI, Leaf, BlockSize, Counted>::bulkAddChild(std::vector<BulkLevel>& levels,
+	std::size_t level, const Key& first, long child, std::size_t count, long& end)
+{
+	auto key = first;
+	
+	while (true) {
+		if (level == levels.size()) {
+			levels.emplace_back();
+			levels.back().empty = true;
+		}
+		
+		auto& current = levels[level];
+		auto& n = current.node.var.internal;
+		
+		if (!current.empty && !current.node.var.isFull()) {
+			n.keys[n.size] = key;
+			n.children[n.size + 1] = child;
+			n.setCount(n.size + 1, count);
+			++n.size;
+			return;
+		}
+		
+		// A full node is written, and the child begins a new one. The full
+		// node must then be added to the level above.
+		auto full = current.node;
+		auto fullFirst = current.first;
+		bool wasEmpty = current.empty;
+		
+		current.node.var.initialize(false, 0);
+		current.node.var.internal.children[0] = child;
+		current.node.var.internal.setCount(0, count);
+		current.first = key;
+		current.empty = false;
+		
+		if (wasEmpty) return;
+		
+		full.var.header.setOffset(end);
+		end += BlockSize;
+		++m_stats.blocksCreated;
+		writeToDisk(full);
+		
+		key = fullFirst;
+		child = full.var.header.offset();
+		count = full.var.subtreeSize();
+		++level;
+	}
+}
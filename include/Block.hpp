@@ -1,6 +1,8 @@
 #ifndef _BLOCK_HPP_INCLUDED_
 #define _BLOCK_HPP_INCLUDED_
 
+#include <type_traits>
+
 //! Default block size in bytes
 /*!
  * The size was defined as 4096 bytes based on sector storage size of the local
@@ -8,6 +10,25 @@
  */
 #define BLOCK_SIZE 4096
 
+//! Version of the on-disk formats, recorded first in every file header
+/*!
+ * Bumped whenever the layout of a header or a block changes. Files of any
+ * other version are rejected when they're opened, and have to be uploaded
+ * again.
+ *
+ * - 1: 32-bit ids and block counts, no version in the headers
+ * - 2: 64-bit ids, block counts and statistics
+ * - 3: BTree headers with a generation and a free list, for shadow paging
+ * - 4: Hashfile headers telling whether the entries are compressed
+ * - 5: 47-bit block numbers in the node headers
+ * - 6: Skip entries in the packed posting lists
+ * - 7: BTree headers without the generation and free list of version 3,
+ *   shadow paging being dropped
+ * - 8: Bloom filter sidecars with a version, and probe strides independent
+ *   of the block
+ */
+#define FORMAT_VERSION 8
+
 //! Union for reading and writing blocks containing serialized data
 /*!
  * Wraps a T-type value within a block-sized memory space. T must be a POD
@@ -32,4 +53,38 @@ union Block {
 	T var; //!< Member used to access the wrapped value
 };
 
+//! Calls a function with a block size as a compile-time constant
+/*!
+ * %Block sizes are template parameters of the indexes, so a size only known
+ * at run time, such as one read from a file header, is dispatched to one of
+ * the sizes the indexes are instantiated for: 4, 8, 16, 32 or 64 KiB.
+ *
+ * Example usage:
+ * \code
+ * withBlockSize(header.blockSize, [&](auto blockSize) {
+ *     IdealBPlusTree<Record, int, RecordId, decltype(blockSize)::value> tree;
+ *     // ...
+ * });
+ * \endcode
+ *
+ * @tparam F Callable taking an `std::integral_constant<unsigned int, size>`
+ *
+ * @param blockSize %Block size in bytes
+ * @param f Function to call
+ *
+ * @return False if the block size isn't supported, in which case f isn't
+ * called
+ */
+template <typename F>
+bool withBlockSize(unsigned int blockSize, F f) {
+	switch (blockSize) {
+	case 4096: f(std::integral_constant<unsigned int, 4096>()); return true;
+	case 8192: f(std::integral_constant<unsigned int, 8192>()); return true;
+	case 16384: f(std::integral_constant<unsigned int, 16384>()); return true;
+	case 32768: f(std::integral_constant<unsigned int, 32768>()); return true;
+	case 65536: f(std::integral_constant<unsigned int, 65536>()); return true;
+	default: return false;
+	}
+}
+
 #endif // _BLOCK_HPP_INCLUDED_
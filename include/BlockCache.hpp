@@ -0,0 +1,316 @@
+#ifndef _BLOCKCACHE_HPP_INCLUDED_
+#define _BLOCKCACHE_HPP_INCLUDED_
+
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <vector>
+
+//! Default BlockCache capacity in blocks (64 MB with 4 KB blocks)
+#define BLOCK_CACHE_DEFAULT_BLOCKS 16384
+
+//! Quantity of blocks returned last that a BlockCache attached to a shared segment keeps pinned
+#define BLOCK_CACHE_SHARED_HELD 8
+
+//! Deleter for memory obtained through allocateAligned
+struct FreeDeleter {
+	void operator()(void *p) const { std::free(p); }
+};
+
+//! Memory block aligned for direct I/O
+typedef std::unique_ptr<char, FreeDeleter> AlignedBuffer;
+
+//! Allocates memory aligned to the provided boundary
+/*!
+ * Buffers used with files opened through openDirect must be aligned to the
+ * block size.
+ *
+ * @param size Size in bytes
+ * @param alignment Alignment in bytes, must be a power of two
+ *
+ * @return The allocated memory, or null if the allocation failed
+ */
+AlignedBuffer allocateAligned(std::size_t size, std::size_t alignment);
+
+//! Opens a file bypassing the kernel page cache
+/*!
+ * Opens the file with `O_DIRECT`. Reads and writes must then use buffers,
+ * offsets and sizes aligned to the block size.
+ *
+ * @param filepath Path to the file
+ * @param flags Flags for `open`, such as `O_RDONLY` or `O_RDWR | O_CREAT`;
+ * `O_DIRECT` is added to them
+ *
+ * @return File descriptor, or -1 on failure
+ */
+int openDirect(const char *filepath, int flags);
+
+//! Application-managed block cache for files opened with openDirect
+/*!
+ * Once the kernel page cache is out of the way, BlockCache decides which
+ * blocks stay in memory. Blocks are kept in fixed, block-aligned frames, so
+ * they can be read and written straight from the device.
+ *
+ * Each block is cached with a priority. Index pages (B-tree nodes) always win
+ * over record pages (hashfile entries):
+ *
+ * - a missing index page evicts the least recently used record page, and only
+ *   evicts other index pages once there are no record pages left;
+ * - a missing record page can only evict other record pages. If the whole
+ *   cache is taken by index pages, the record is read into a scratch frame and
+ *   isn't cached at all.
+ *
+ * So a scan over cold records can never push the indexes out of memory, and
+ * memory usage never goes above the capacity set at construction.
+ *
+ * Blocks are identified by file descriptor and offset. Call BlockCache::forget
+ * before closing a file, since its descriptor may be reused afterwards.
+ *
+ * Pointers returned by BlockCache stay valid until the next call that may
+ * fetch or write a block, unless the block is pinned with BlockCache::pin:
+ * pinned blocks are never evicted, so their pointers stay valid until they're
+ * unpinned. BlockCache isn't thread-safe.
+ *
+ * With BlockCache::attachShared, the frames are in a segment shared with other
+ * processes instead, see SharedBlockCache. The same rules apply, except that
+ * other processes may evict blocks too: the last BLOCK_CACHE_SHARED_HELD
+ * blocks returned stay pinned, so their pointers remain valid as they would
+ * in a cache of its own.
+ */
+class BlockCache {
+public:
+	//! Whether the block belongs to an index or to the record file
+	enum Priority {
+		IndexPage, //!< Index node, kept in memory as long as possible
+		RecordPage //!< Record file block, evicted first
+	};
+	
+	//! BlockCache usage analytics
+	struct Statistics {
+		unsigned long hits; //!< Blocks found in the cache
+		unsigned long misses; //!< Blocks read from the device, including the ones handed over through BlockCache::insert
+		unsigned long evictions; //!< Blocks dropped to make room for others
+		unsigned long bypasses; //!< Record blocks that couldn't be cached because index pages, or pinned blocks, took all the room
+	};
+	
+	//! Allocates all the frames at once
+	/*!
+	 * @param capacity Maximum quantity of cached blocks
+	 * @param blockSize %Block size in bytes; files using the cache must only
+	 * read and write blocks of this size
+	 */
+	BlockCache(std::size_t capacity = BLOCK_CACHE_DEFAULT_BLOCKS, std::size_t blockSize = 4096);
+	
+	//! Destructor
+	/*! Unpins the blocks it kept pinned in the shared segment, if attached to one */
+	~BlockCache();
+	
+	BlockCache(const BlockCache&) = delete;
+	BlockCache& operator=(const BlockCache&) = delete;
+	
+	//! Keeps the blocks in a segment shared with other processes
+	/*!
+	 * The segment is created with the cache's capacity if there isn't one with
+	 * that name yet. Once attached, the cache's own frames are freed; it must
+	 * be called before any block is cached.
+	 *
+	 * @param name Name of the segment, see SharedBlockCache::attach
+	 *
+	 * @return False if the segment couldn't be attached to, in which case the
+	 * cache keeps its own frames
+	 */
+	bool attachShared(const char *name);
+	
+	//! %Block size in bytes
+	std::size_t blockSize() const;
+	
+	//! Looks for a block in the cache without reading the device
+	/*!
+	 * @param fd File descriptor
+	 * @param offset %Block offset in the file
+	 *
+	 * @return The cached block, or null if it isn't cached
+	 */
+	const char* lookup(int fd, long offset);
+	
+	//! Reads a block through the cache
+	/*!
+	 * @param fd File descriptor
+	 * @param offset %Block offset in the file
+	 * @param priority Priority of the block
+	 * @param fetched Set to true if the block had to be read from the device
+	 *
+	 * @return The block, or null if it couldn't be read
+	 */
+	const char* read(int fd, long offset, Priority priority, bool& fetched);
+	
+	//! Adds a block that was read elsewhere to the cache
+	/*!
+	 * @param fd File descriptor
+	 * @param offset %Block offset in the file
+	 * @param data %Block contents, BlockCache::blockSize bytes long
+	 * @param priority Priority of the block
+	 */
+	void insert(int fd, long offset, const void *data, Priority priority);
+	
+	//! Writes a block to the device, keeping a copy in the cache
+	/*!
+	 * The write is done through the cache frame, so data doesn't need to be
+	 * aligned. If size is smaller than the block size, the rest of the block
+	 * is filled with zeros.
+	 *
+	 * @param fd File descriptor
+	 * @param offset %Block offset in the file
+	 * @param data Data to write
+	 * @param size Size of data in bytes, at most BlockCache::blockSize
+	 * @param priority Priority of the block
+	 *
+	 * @return True if the whole block was written
+	 */
+	bool write(int fd, long offset, const void *data, std::size_t size, Priority priority);
+	
+	//! Drops every cached block of a file
+	/*!
+	 * Pinned blocks are dropped as well, so handles on them must be released
+	 * before the file is closed.
+	 *
+	 * @param fd File descriptor
+	 */
+	void forget(int fd);
+	
+	//! Keeps a block from being evicted
+	/*!
+	 * Pins are counted, and every call must be matched by a call to
+	 * BlockCache::unpin. Blocks in the scratch frame can't be pinned, since
+	 * they aren't cached at all; the call is ignored for them.
+	 *
+	 * @param block Pointer returned by BlockCache::lookup or BlockCache::read
+	 */
+	void pin(const char *block);
+	
+	//! Allows a pinned block to be evicted again
+	/*!
+	 * @param block Pointer given to BlockCache::pin
+	 */
+	void unpin(const char *block);
+	
+	//! Returns the usage statistics so far
+	const Statistics& getStatistics() const;
+
+private:
+	//! Identifies a block
+	struct Key {
+		int fd; //!< File descriptor
+		long offset; //!< %Block offset
+		
+		bool operator== (const Key& that) const {
+			return fd == that.fd && offset == that.offset;
+		}
+	};
+	
+	//! Hash function for Key
+	struct KeyHash {
+		std::size_t operator() (const Key& key) const {
+			return std::hash<long>()(key.offset) * 31 + key.fd;
+		}
+	};
+	
+	//! State of a cache attached to a shared segment
+	struct Shared;
+	
+	//! Frame bookkeeping
+	struct Frame {
+		Key key; //!< Block in the frame
+		Priority priority; //!< List where the frame is
+		std::size_t previous; //!< More recently used frame in its LRU list, BlockCache::m_capacity for none
+		std::size_t next; //!< Less recently used frame in its LRU list, BlockCache::m_capacity for none
+		unsigned int pins; //!< Quantity of handles keeping the block from being evicted
+	};
+	
+	//! Frames in use with the same priority, linked through Frame::previous and Frame::next
+	struct List {
+		std::size_t first; //!< Most recently used frame, BlockCache::m_capacity for none
+		std::size_t last; //!< Least recently used frame, BlockCache::m_capacity for none
+	};
+	
+	std::size_t m_capacity; //!< Quantity of frames
+	std::size_t m_blockSize; //!< Frame size in bytes
+	AlignedBuffer m_memory; //!< All the frames, plus one scratch frame at the end
+	std::vector<Frame> m_frames; //!< Bookkeeping of each frame
+	std::vector<std::size_t> m_free; //!< Frames not in use
+	List m_lru[2]; //!< Frames in use by priority
+	
+	//! Frame holding each cached block, BlockCache::m_capacity for an empty slot
+	/*!
+	 * Open addressing with linear probing, and at least twice as many slots as
+	 * frames, so that neither the table nor the LRU lists allocate anything
+	 * once the cache is built.
+	 */
+	std::vector<std::size_t> m_table;
+	unsigned int m_tableShift; //!< Bits a Key hash is shifted right to get its home slot in BlockCache::m_table
+	Statistics m_stats; //!< Usage statistics
+	
+	std::unique_ptr<Shared> m_shared; //!< Shared segment holding the frames instead, if attached to one
+	
+	//! Address of a frame
+	char* frame(std::size_t index) const;
+	
+	//! Address of the frame used for blocks that can't be cached
+	char* scratch() const;
+	
+	//! Index of the frame holding a block, or BlockCache::m_capacity for the scratch frame
+	std::size_t frameOf(const char *block) const;
+	
+	//! Moves a frame to the front of its LRU list
+	void touch(std::size_t index);
+	
+	//! Puts a frame at the front of the LRU list of its priority
+	void link(std::size_t index);
+	
+	//! Takes a frame out of its LRU list
+	void unlink(std::size_t index);
+	
+	//! Slot of BlockCache::m_table where the search for a block starts
+	std::size_t homeOf(const Key& key) const;
+	
+	//! Frame holding a block, or BlockCache::m_capacity if it isn't cached
+	std::size_t find(const Key& key) const;
+	
+	//! Adds a frame to BlockCache::m_table, under the key of its block
+	void enter(std::size_t index);
+	
+	//! Removes a frame from BlockCache::m_table
+	/*!
+	 * The slots after it are shifted back as needed, so that no tombstones are
+	 * left behind.
+	 */
+	void remove(std::size_t index);
+	
+	//! Finds a frame for a new block
+	/*!
+	 * Evicts a block if needed, following the priority rules. Pinned blocks
+	 * are skipped.
+	 *
+	 * @return Frame index, or BlockCache::m_capacity if the block must not be
+	 * cached (the scratch frame should be used instead)
+	 */
+	std::size_t acquire(Priority priority);
+	
+	//! Registers a block in an acquired frame
+	void bind(std::size_t index, const Key& key, Priority priority);
+	
+	//! Drops the block in a frame, and returns the frame to the free list
+	void release(std::size_t index);
+	
+	//! Reads a block that isn't cached into the shared segment, see BlockCache::read
+	const char* readShared(int fd, long offset, Priority priority, bool& fetched);
+	
+	//! Puts a block in the shared segment, see BlockCache::write
+	/*!
+	 * @param toDevice False to only cache the block, as BlockCache::insert does
+	 */
+	bool writeShared(int fd, long offset, const void *data, std::size_t size, Priority priority, bool toDevice);
+};
+
+#endif // _BLOCKCACHE_HPP_INCLUDED_
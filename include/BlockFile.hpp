@@ -0,0 +1,191 @@
+#ifndef _BLOCKFILE_HPP_INCLUDED_
+#define _BLOCKFILE_HPP_INCLUDED_
+
+#include <cstddef>
+#include <cstdio>
+
+#include "BlockCache.hpp"
+
+//! Handle on a block read in place, see BlockFile::view
+/*!
+ * Points either into a BlockCache frame, which stays pinned until the handle
+ * is reset or destroyed, or into memory owned by someone else (a buffer the
+ * block was read into, a node kept in memory...), which must outlive it.
+ * Handles can be moved but not copied, so a block is unpinned exactly once.
+ */
+class PageRef {
+public:
+	//! Creates an empty handle
+	PageRef();
+	
+	//! Creates a handle on a block
+	/*!
+	 * @param data Address of the block
+	 * @param cache Cache whose frame holds the block, which is pinned; null
+	 * if the block isn't in a cache
+	 */
+	PageRef(const char *data, BlockCache *cache);
+	
+	//! Destructor
+	/*! Same as PageRef::reset */
+	~PageRef();
+	
+	PageRef(PageRef&& that);
+	PageRef& operator=(PageRef&& that);
+	
+	PageRef(const PageRef&) = delete;
+	PageRef& operator=(const PageRef&) = delete;
+	
+	//! Address of the block, null if the handle is empty
+	const char* data() const;
+	
+	//! The block seen as a B
+	/*!
+	 * @tparam B Type of the block, such as a Block instantiation
+	 */
+	template <typename B>
+	const B& as() const {
+		return *reinterpret_cast<const B*>(m_data);
+	}
+	
+	//! True if the handle isn't empty
+	explicit operator bool() const;
+	
+	//! Unpins the block, if it was pinned, and empties the handle
+	void reset();
+
+private:
+	const char *m_data; //!< Address of the block
+	BlockCache *m_cache; //!< Cache where the block is pinned, if any
+};
+
+//! File read and written one block at a time
+/*!
+ * Common I/O layer of the on-disk structures (BPlusTree, Hashfile, etc.). By
+ * default the file is accessed through stdio and the kernel page cache. If a
+ * BlockCache is handed to BlockFile::useCache before the file is opened, the
+ * file is opened with `O_DIRECT` instead and every block goes through the
+ * cache.
+ *
+ * Offsets and sizes are in bytes. With direct I/O, offsets must be multiples
+ * of the cache's block size and sizes can't be bigger than it.
+ */
+class BlockFile {
+public:
+	//! Default constructor
+	BlockFile();
+	
+	//! Destructor
+	/*! Closes the file if it's open */
+	~BlockFile();
+	
+	BlockFile(const BlockFile&) = delete;
+	BlockFile& operator=(const BlockFile&) = delete;
+	
+	//! Switches the file to direct I/O through the provided cache
+	/*!
+	 * Must be called before the file is opened, and the cache must outlive the
+	 * file.
+	 *
+	 * @param cache Cache to use, or null to go back to stdio
+	 * @param priority Priority of this file's blocks in the cache
+	 */
+	void useCache(BlockCache *cache, BlockCache::Priority priority = BlockCache::IndexPage);
+	
+	//! Sets the size of the blocks, for files whose blocks hold less than a block of data
+	/*!
+	 * Writes smaller than a block then extend the file over the whole block
+	 * through stdio as well, as the cache does, so that the last block can
+	 * later be read whole with direct I/O. The rest of the block is left
+	 * undefined, as in Block.
+	 *
+	 * @param blockSize %Block size in bytes, 0 to write only the data given
+	 */
+	void setBlockSize(std::size_t blockSize);
+	
+	//! Creates the file for reading and writing
+	/*!
+	 * If there's already a file in the filepath, it'll be overwritten.
+	 *
+	 * @param filepath Path to the file
+	 *
+	 * @return True if the file was created
+	 */
+	bool create(const char *filepath);
+	
+	//! Opens an existing file
+	/*!
+	 * @param filepath Path to the file
+	 * @param writable True to allow writes, false to open it for reading only
+	 *
+	 * @return True if the file could be opened
+	 */
+	bool open(const char *filepath, bool writable = false);
+	
+	//! Closes the file if it's open
+	void close();
+	
+	//! True if the file is open
+	bool isOpen() const;
+	
+	//! Reads a block
+	/*!
+	 * @param offset %Block offset
+	 * @param data Where the block will be read into
+	 * @param size Quantity of bytes to read
+	 * @param fetched If not null, set to true if the block had to be read from
+	 * the device, false if it was found in the cache
+	 *
+	 * @return True if the whole block was read
+	 */
+	bool read(long offset, void *data, std::size_t size, bool *fetched = nullptr) const;
+	
+	//! Reads a block in place, without copying it if possible
+	/*!
+	 * With a cache, the handle points into the cache frame, which stays
+	 * pinned while the handle lives, and the buffer isn't used. Through stdio
+	 * there's no such frame to point into, so the block is read into the
+	 * buffer and the handle points to it. Either way, nothing is allocated.
+	 *
+	 * @param offset %Block offset
+	 * @param buffer Where the block is read into if there's no cache
+	 * @param size Quantity of bytes to read
+	 * @param fetched If not null, set to true if the block had to be read from
+	 * the device, false if it was found in the cache
+	 *
+	 * @return Handle on the block, empty if it couldn't be read
+	 */
+	PageRef view(long offset, void *buffer, std::size_t size, bool *fetched = nullptr) const;
+	
+	//! Writes a block
+	/*!
+	 * See BlockFile::setBlockSize for data smaller than a block.
+	 *
+	 * @param offset %Block offset
+	 * @param data Data to write
+	 * @param size Quantity of bytes to write
+	 */
+	void write(long offset, const void *data, std::size_t size);
+	
+	//! Offset right after the last block in the file
+	long end() const;
+	
+	//! File descriptor, usable for positional reads
+	/*!
+	 * Anything still buffered by stdio is flushed first. Reads from this
+	 * descriptor must follow the cache's alignment rules if there's a cache.
+	 */
+	int descriptor() const;
+	
+	//! Cache in use, null if the file is accessed through stdio
+	BlockCache* cache() const;
+
+private:
+	std::FILE *m_file; //!< File pointer, if stdio is in use
+	BlockCache *m_cache; //!< Cache used for direct I/O, null if stdio is in use
+	BlockCache::Priority m_priority; //!< Priority of the blocks in the cache
+	std::size_t m_blockSize; //!< Size writes are padded to through stdio, 0 for no padding
+	int m_fd; //!< File descriptor opened with `O_DIRECT`, -1 if stdio is in use
+};
+
+#endif // _BLOCKFILE_HPP_INCLUDED_
@@ -0,0 +1,128 @@
+#ifndef _BLOOMFILTER_HPP_INCLUDED_
+#define _BLOOMFILTER_HPP_INCLUDED_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! Default false-positive rate for the filters built during upload
+#define DEFAULT_BLOOM_FALSE_POSITIVE_RATE 0.01
+
+//! Blocked Bloom filter for fast negative lookups
+/*!
+ * Answers whether a key may be in a set, with no false negatives and a
+ * configurable rate of false positives. It's meant to sit in front of an
+ * index: if the filter says a key is absent, the index doesn't need to be
+ * read at all.
+ *
+ * Bits are grouped in 512-bit blocks (one cache line). All the bits of a key
+ * are set within the same block, so a lookup touches a single cache line.
+ *
+ * The filter is built in memory from key hashes (see BloomFilter::hash) and can
+ * be saved to a sidecar file next to the index it belongs to.
+ *
+ * Example usage:
+ * \code
+ * BloomFilter filter(keyCount, 0.01);
+ * filter.add(BloomFilter::hash("abc", 3));
+ * filter.save("index.bloom");
+ *
+ * BloomFilter loaded;
+ * if (loaded.load("index.bloom") && !loaded.mayContain(BloomFilter::hash("abc", 3))) {
+ *     // Definitely not in the index
+ * }
+ * \endcode
+ */
+class BloomFilter {
+public:
+	//! BloomFilter usage analytics
+	struct Statistics {
+		unsigned long lookups; //!< Calls to BloomFilter::mayContain
+		unsigned long negatives; //!< Lookups answered as definitely absent
+		unsigned long falsePositives; //!< Positive lookups that the index didn't confirm, see BloomFilter::reportFalsePositive
+	};
+	
+	//! Creates an empty filter that can't be used until loaded
+	BloomFilter();
+	
+	//! Creates an empty filter sized for the provided quantity of keys
+	/*!
+	 * @param keyCount Expected quantity of keys
+	 * @param falsePositiveRate Target false-positive rate, between 0 and 1
+	 */
+	BloomFilter(std::size_t keyCount, double falsePositiveRate);
+	
+	//! Hashes a key
+	/*!
+	 * The same key must always be hashed from the same bytes, both when
+	 * building the filter and when looking it up.
+	 *
+	 * @param data Key bytes
+	 * @param size Quantity of bytes
+	 *
+	 * @return 64-bit hash of the key
+	 */
+	static std::uint64_t hash(const void *data, std::size_t size);
+	
+	//! Adds a key to the set
+	/*!
+	 * @param keyHash Hash of the key
+	 */
+	void add(std::uint64_t keyHash);
+	
+	//! Checks if a key may be in the set
+	/*!
+	 * @param keyHash Hash of the key
+	 *
+	 * @return False if the key definitely isn't in the set, true if it may be
+	 */
+	bool mayContain(std::uint64_t keyHash) const;
+	
+	//! Registers that a positive answer turned out to be wrong
+	/*!
+	 * Only used for statistics.
+	 */
+	void reportFalsePositive() const;
+	
+	//! Writes the filter to a file
+	/*!
+	 * @param filepath Path to the file, which will be overwritten
+	 *
+	 * @return True if the whole filter was written
+	 */
+	bool save(const char *filepath) const;
+	
+	//! Reads a filter previously written by BloomFilter::save
+	/*!
+	 * Filters written in another format (see FORMAT_VERSION) are rejected.
+	 *
+	 * @param filepath Path to the file
+	 *
+	 * @return True if the filter was read and written in the current format
+	 */
+	bool load(const char *filepath);
+	
+	//! Size of the filter in bytes
+	std::size_t byteSize() const;
+	
+	//! Returns the usage statistics so far
+	const Statistics& getStatistics() const;
+
+private:
+	//! Filter file header
+	struct FileHeader {
+		std::uint32_t version; //!< Format version, see FORMAT_VERSION
+		std::uint32_t hashCount; //!< Bits set per key
+		std::uint64_t blockCount; //!< Quantity of 512-bit blocks
+	};
+	
+	//! 64-bit words per block
+	static constexpr std::size_t BlockWords = 8;
+	
+	std::vector<std::uint64_t> m_bits; //!< All the blocks, one after the other
+	std::uint64_t m_blockCount; //!< Quantity of blocks
+	std::uint32_t m_hashCount; //!< Bits set per key
+	mutable Statistics m_stats; //!< Usage statistics
+};
+
+#endif // _BLOOMFILTER_HPP_INCLUDED_
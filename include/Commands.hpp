@@ -1,6 +1,110 @@
 #ifndef _COMMANDS_HPP_INCLUDED_
 #define _COMMANDS_HPP_INCLUDED_
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Block.hpp"
+#include "BloomFilter.hpp"
+#include "CoveringIndex.hpp"
+#include "ExternalSorter.hpp"
+#include "LsmTree.hpp"
+
+//! Default memory the pinned levels of an index can take, in bytes
+#define DEFAULT_PIN_MEMORY (64 * 1024 * 1024)
+
+//! I/O settings shared by all the commands
+struct IoOptions {
+	//! Bypass the kernel page cache
+	/*!
+	 * If true, every file is opened with `O_DIRECT` and blocks are cached by a
+	 * BlockCache instead, which keeps index pages in memory in favour of
+	 * hashfile pages.
+	 */
+	bool directIO;
+	
+	std::size_t cacheBlocks; //!< BlockCache capacity in blocks, if directIO is set
+	
+	//! Levels of each B-tree index kept in memory, counting the root
+	/*!
+	 * Read right after the index is loaded, see BPlusTree::pin. 0 or 1 only
+	 * keep the root.
+	 */
+	std::size_t pinnedLevels = 0;
+	
+	std::size_t pinMemory = DEFAULT_PIN_MEMORY; //!< Bytes the pinned levels of each index can take
+	
+	//! Name of a segment the BlockCache frames are shared in with other processes, if directIO is set
+	/*!
+	 * See BlockCache::attachShared. Null for a cache of the command's own.
+	 */
+	const char *sharedCache = nullptr;
+};
+
+//! Changes the I/O settings of the commands called afterwards
+/*!
+ * By default, files are accessed through stdio and the kernel page cache.
+ *
+ * @param options New settings
+ */
+void setIoOptions(const IoOptions& options);
+
+//! Structures the secondary index can be built with
+enum TitleIndexType {
+	BTreeTitleIndex, //!< B-tree, `bd-titletree.bin`
+	HashTitleIndex //!< Extendible hash, `bd-titlehash.bin`; only exact lookups, but in fewer block reads
+};
+
+//! Settings for upload
+struct UploadOptions {
+	//! Target false-positive rate of the indexes' Bloom filters
+	/*!
+	 * Between 0 and 1; 0 means no filters will be built.
+	 */
+	double bloomFalsePositiveRate = DEFAULT_BLOOM_FALSE_POSITIVE_RATE;
+	
+	TitleIndexType titleIndex = BTreeTitleIndex; //!< Structure of the secondary index
+	
+	//! Memory, in bytes, for sorting the titles before building the secondary index B+ tree
+	/*!
+	 * Titles that don't fit are sorted in runs written to temporary files,
+	 * see ExternalSorter. The authors are sorted within the same budget, to
+	 * build the author index.
+	 */
+	std::size_t sortMemory = DEFAULT_SORT_MEMORY;
+	
+	//! %Block size in bytes of every file of the database
+	/*!
+	 * Must be one of the sizes withBlockSize supports. It's recorded in the
+	 * file headers, and the other commands use the size found in the
+	 * hashfile's.
+	 */
+	unsigned int blockSize = BLOCK_SIZE;
+	
+	//! Quantity of partitions the database is split in, see PartitionMap
+	/*!
+	 * With more than one, each partition is built on its own thread, into its
+	 * own files. Covering indexes and the extendible hash secondary index
+	 * aren't available then.
+	 */
+	std::size_t partitions = 1;
+	
+	std::vector<std::string> partitionDirectories; //!< Directories given to the partitions in turn; the database's own if empty
+	
+	std::vector<IndexDefinition> indexes; //!< Covering indexes to build besides the primary and secondary ones
+	
+	//! Compress the entries once the hashfile is written
+	/*!
+	 * See Hashfile::compress. The hashfile can't be appended to afterwards.
+	 */
+	bool compress = false;
+	
+	//! Build the full-text index over the titles and snippets, see search
+	bool textIndex = false;
+};
+
 //! Receives a CSV file and creates a database based on its contents
 /*!
  * Will load the data in the provided CSV file and, one by one, upload them
@@ -25,13 +129,82 @@
  *
  * - `db-hashfile.bin`: where the entries will be stored;
  * - `db-idindex.bin`: primary index by id;
- * - `db-titleindex.bin`: secondary index by title.
+ * - `db-titleindex.bin`: secondary index by title;
+ * - `bd-titlepostings.bin`: posting lists of the secondary index, for titles
+ *   shared by many entries;
+ * - `bd-authortree.bin`: author index, see seekauthor;
+ * - `bd-authorpostings.bin`: posting lists of the author index;
+ * - `bd-termtree.bin` and `bd-termpostings.bin`: full-text index, if the
+ *   options ask for it, see search.
+ *
+ * The secondary index B+ tree isn't built entry by entry: the titles are
+ * sorted first, within the memory set in the options, and the tree is then
+ * built bottom-up (see BPlusTree::bulkLoad).
+ *
+ * If the options ask for the secondary index to be an extendible hash, it's
+ * written to `bd-titlehash.bin` instead, and the B-tree file is removed.
+ *
+ * Unless disabled through the options, a Bloom filter sidecar file is also
+ * created for each index, so that seeking keys that aren't in the database
+ * doesn't require reading the index:
+ *
+ * - `bd-idtree.bloom`: filter for the primary index;
+ * - `bd-titletree.bloom`: filter for the secondary index.
+ *
+ * Each covering index declared in the options is written to
+ * `bd-index-<name>.bin`, and the declarations to `bd-catalog.bin`, so that
+ * they can be queried by scan. Covering indexes from a previous upload are
+ * removed.
+ *
+ * Every file uses the block size set in the options, and so does the cache
+ * if direct I/O is on: bigger blocks make for shallower trees, at the price
+ * of reading more bytes per block.
+ *
+ * If the options ask for several partitions, the input is read once to
+ * sample ids and titles, and the split points are saved to
+ * `bd-partitions.bin` (see PartitionMap). Each partition then gets its own
+ * hashfile segment, primary index, secondary index B+ tree, author index,
+ * posting lists and filters, named `part<n>-<file>` in its directory, built on its own thread.
+ * The other commands find the partition map and route each key to its
+ * partition, or fan out to all of them.
  *
  * The files will be overwritten if they already exist.
  *
  * @param filePath Path to the CSV file with entries
+ * @param options Upload settings
  */
-void upload(const char* filePath);
+void upload(const char* filePath, const UploadOptions& options);
+
+//! Settings for append
+struct AppendOptions {
+	//! Quantity of ids kept in memory before they're written as a primary index run
+	std::size_t memtableCapacity = LSM_MEMTABLE_CAPACITY;
+};
+
+//! Adds the entries in a CSV file to a database that's already uploaded
+/*!
+ * Takes the same CSV format as upload. Each entry is written to the hashfile
+ * at the place given by its id, so findrec finds it right away. Entries whose
+ * id is already in the database are skipped.
+ *
+ * Rebuilding the primary index for every batch of entries would take as long
+ * as uploading again, so the ids are indexed in an LsmTree instead: they're
+ * gathered in memory and written as small, immutable B+ trees (runs) beside
+ * the primary index, `bd-idruns-<number>.bin`, each with its own Bloom
+ * filter. Runs are merged in the background once there are too many. seek1
+ * looks ids up in the runs when they aren't in the primary index.
+ *
+ * Only the primary index and the hashfile are updated, so appended entries
+ * can only be found by id, with seek1 and findrec, and append says so. The
+ * secondary, author, full-text and covering indexes, their Bloom filters,
+ * and so seek2, seekauthor, search, count1, select2 and scan, pick the
+ * appended entries up at the next upload, which also removes the runs. A
+ * database uploaded in partitions can't be appended to.
+ *
+ * @param filePath Path to the CSV file with entries
+ * @param options Append settings
+ */
+void append(const char* filePath, const AppendOptions& options);
 
 //! Finds an entry in the hashfile based on the entry's id
 /*!
@@ -49,15 +222,26 @@ void findrec(long id);
  * Uses a B-tree to seek the entry by id within the primary index. In case no
  * entry with the id is found, the procedure will inform.
  *
+ * If the index has a Bloom filter, it's checked first, and the index isn't
+ * read at all if the filter rules the id out.
+ *
+ * Ids that aren't in the index are then sought in the runs written by
+ * append, if any, newest first.
+ *
  * @param id Id of the entry to find
  */
 void seek1(long id);
 
 //! Seeks an entry by its title using the secondary index
 /*!
- * Uses a B-tree to seek the entry by title within the secondary index.
+ * Uses a B-tree to seek the entry by title within the secondary index, or the
+ * extendible hash if the index was uploaded as one.
+ *
+ * Prints every entry with the title, in id order. Entries sharing a title are
+ * grouped under a single key in the index, so they're all found in the same
+ * lookup.
  *
- * Will return the first entry found with the title.
+ * The index's Bloom filter is checked first, as in seek1.
  *
  * In case no entry with the provided title is found, the procedure will
  * inform.
@@ -66,4 +250,128 @@ void seek1(long id);
  */
 void seek2(const char* title);
 
+//! Seeks several entries by id at once using the primary index
+/*!
+ * Works like seek1, but instead of looking for the entries one after the
+ * other, all the descents through the primary index and all the hashfile
+ * reads are kept in flight at the same time. See BPlusTree::seekMany.
+ *
+ * Entries are printed in the same order as the ids.
+ *
+ * @param ids Ids of the entries to find
+ * @param count Quantity of ids
+ */
+void seek1(const long* ids, std::size_t count);
+
+//! Seeks several entries by title at once using the secondary index
+/*!
+ * Works like seek2, but with all the lookups in flight at the same time. See
+ * seek1(const long*, std::size_t).
+ *
+ * @param titles Titles of the entries to find
+ * @param count Quantity of titles
+ */
+void seek2(const char* const* titles, std::size_t count);
+
+//! Seeks the entries by an author using the author index
+/*!
+ * upload splits Entry::authors at each `|` and indexes every author in a
+ * B+ tree, `bd-authortree.bin`, whose values point to posting lists in
+ * `bd-authorpostings.bin` with the offsets of all the author's entries. The
+ * offsets are delta-compressed (see PackedPostingFile), so an author's list
+ * usually takes a single block. Finding the entries then reads one node per
+ * level of the tree, the list, and the entries themselves, instead of the
+ * whole hashfile.
+ *
+ * Prints every entry by the author, in id order. The name must be an exact
+ * match, spaces around it aside. In a database uploaded in partitions, each
+ * partition indexes the authors of its own entries, and the author is
+ * sought in all of them.
+ *
+ * @param author Name of the author
+ */
+void seekauthor(const char* author);
+
+//! Finds the entries with all the provided words in their title or snippet
+/*!
+ * Uses the full-text index, built by upload if its options ask for it. Each
+ * title and snippet is split in terms, the runs of letters and digits,
+ * lowercased. The index is a B+ tree with each term once,
+ * `bd-termtree.bin`, with the quantity of entries holding it and their
+ * posting list, delta-compressed in `bd-termpostings.bin` (see
+ * PackedPostingFile).
+ *
+ * The words are split in terms the same way, and each term is sought in the
+ * tree. If they're all there, their posting lists are read and intersected,
+ * shortest first, by galloping through the longer ones (see
+ * intersectPostings), and only the entries with every term are read from
+ * the hashfile. Entries are printed in id order.
+ *
+ * In a database uploaded in partitions, each partition indexes its own
+ * entries, and the terms are sought in all of them.
+ *
+ * @param words Words to search, each of which may hold several terms
+ * @param count Quantity of words
+ * @param limit Maximum quantity of entries to print, 0 for no limit
+ */
+void search(const char* const* words, std::size_t count, std::size_t limit);
+
+/*!
+ * The primary index keeps, in each node, the quantity of ids under each of
+ * its children, so the count costs the height of the tree in block reads,
+ * however many ids are in the range. See BPlusTree::count.
+ *
+ * In a database uploaded in partitions, every partition's index is counted
+ * on its own thread at the same time.
+ *
+ * @param lo Smallest id to count
+ * @param hi Biggest id to count
+ */
+void count1(long lo, long hi);
+
+//! Finds the entries with the title at a position in alphabetical order
+/*!
+ * Uses the subtree counts of the secondary index, so only one node per level
+ * is read to get to the title (see BPlusTree::select). Titles shared by many
+ * entries count once, and all their entries are printed, as in seek2.
+ *
+ * Only available if the secondary index is a B-tree.
+ *
+ * @param position Position of the title, starting at 1
+ */
+void select2(std::size_t position);
+
+//! Lists the entries in a covering index whose first key columns have the provided values
+/*!
+ * Entries are listed in the index order and only the columns stored in the
+ * index are printed, so the hashfile isn't read at all. For example, with an
+ * index declared as `topcited:year,-citations,id+title`, scanning it with the
+ * prefix `2015` and a limit of 10 lists the 10 most cited articles of 2015.
+ *
+ * @param name Name of the index, as declared on upload
+ * @param prefix Values of the first key columns; may be empty to list the
+ * whole index
+ * @param prefixSize Quantity of values in the prefix
+ * @param limit Maximum quantity of entries to list, 0 for no limit
+ */
+void scan(const char* name, const std::int64_t* prefix, std::size_t prefixSize, std::size_t limit);
+
+//! Rewrites an index fully packed, with its nodes in level order
+/*!
+ * The primary index is built one id at a time, so its nodes are scattered
+ * over the file in the order they were split, about two thirds full. The
+ * index is copied by BPlusTree::reorganize to a temporary file beside it,
+ * with every node full, the internal levels one after the other from the
+ * root down and the leaves in key order, and the copy then replaces it.
+ * Lookups give the same results, in fewer block reads if the tree got
+ * shorter, and scans read the leaves sequentially.
+ *
+ * Only the B-tree indexes can be reorganized: `id` for the primary index and
+ * `title` for the secondary index, if it was uploaded as a B-tree. In a
+ * database uploaded in partitions, the index of every partition is.
+ *
+ * @param index Name of the index
+ */
+void reorg(const char* index);
+
 #endif
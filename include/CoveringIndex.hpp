@@ -0,0 +1,205 @@
+#ifndef _COVERINGINDEX_HPP_INCLUDED_
+#define _COVERINGINDEX_HPP_INCLUDED_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Entry.hpp"
+
+//! Maximum quantity of key columns in a covering index
+#define COVERING_MAX_KEYS 3
+
+//! Maximum quantity of numeric columns included in a covering index
+#define COVERING_MAX_INCLUDED 3
+
+//! Maximum size of a covering index name, including the '\0' end character
+#define COVERING_NAME_MAX 32
+
+//! Entry columns that can be stored in a covering index
+enum Column {
+	IdColumn,
+	TitleColumn,
+	YearColumn,
+	CitationsColumn
+};
+
+//! Key column of a covering index
+struct KeyColumn {
+	Column column; //!< Column, which must be numeric
+	bool descending; //!< True if the column is sorted from the biggest value to the smallest
+};
+
+//! Value stored in a covering index
+/*!
+ * Only the key columns are compared, lexicographically, so that values are
+ * sorted by the first key column, then the second and so on. Descending key
+ * columns are stored complemented, which reverses their order while keeping
+ * every value representable.
+ *
+ * @tparam TitleSize Space for the title, if it's an included column; 1
+ * otherwise
+ */
+template <std::size_t TitleSize>
+struct CoveringValue {
+	std::int64_t keys[COVERING_MAX_KEYS]; //!< Key columns, complemented if descending; unused ones are 0
+	std::int64_t included[COVERING_MAX_INCLUDED]; //!< Included numeric columns
+	long offset; //!< Entry offset in the hashfile
+	char title[TitleSize]; //!< Entry title, if it's an included column
+	
+	//! Less-than comparator so that CoveringValue can be used in BEpsilonTree
+	bool operator< (const CoveringValue& that) const {
+		return std::lexicographical_compare(keys, keys + COVERING_MAX_KEYS, that.keys, that.keys + COVERING_MAX_KEYS);
+	}
+};
+
+//! Key columns of a CoveringValue
+/*!
+ * Separator of the covering index B+ trees: internal nodes only keep the key
+ * columns, which are the only ones compared.
+ */
+struct CoveringKey {
+	std::int64_t keys[COVERING_MAX_KEYS]; //!< Key columns, as in CoveringValue::keys
+	
+	//! Less-than comparator so that CoveringKey can be used in BPlusTree
+	bool operator< (const CoveringKey& that) const {
+		return std::lexicographical_compare(keys, keys + COVERING_MAX_KEYS, that.keys, that.keys + COVERING_MAX_KEYS);
+	}
+};
+
+//! Less-than comparator between CoveringKey and CoveringValue
+template <std::size_t TitleSize>
+bool operator< (const CoveringKey& key, const CoveringValue<TitleSize>& value) {
+	return std::lexicographical_compare(key.keys, key.keys + COVERING_MAX_KEYS, value.keys, value.keys + COVERING_MAX_KEYS);
+}
+
+//! Less-than comparator between CoveringValue and CoveringKey
+template <std::size_t TitleSize>
+bool operator< (const CoveringValue<TitleSize>& value, const CoveringKey& key) {
+	return std::lexicographical_compare(value.keys, value.keys + COVERING_MAX_KEYS, key.keys, key.keys + COVERING_MAX_KEYS);
+}
+
+//! Functor returning the CoveringKey of a CoveringValue, for BPlusTree
+struct CoveringKeyOf {
+	template <std::size_t TitleSize>
+	CoveringKey operator() (const CoveringValue<TitleSize>& value) const {
+		CoveringKey key;
+		std::copy(value.keys, value.keys + COVERING_MAX_KEYS, key.keys);
+		return key;
+	}
+};
+
+//! Covering index value without the title
+typedef CoveringValue<1> NarrowCoveringValue;
+
+//! Covering index value with the title as an included column
+typedef CoveringValue<TITLE_CHAR_MAX> TitledCoveringValue;
+
+//! Declaration of an extra index built during upload
+/*!
+ * A covering index is a BPlusTree sorted by up to COVERING_MAX_KEYS numeric
+ * columns, such as `(year, citations DESC, id)`, which may also store other
+ * columns beside the keys. Queries whose columns are all in the index are
+ * answered from the index alone, without reading the entries.
+ *
+ * Declarations are written as `<name>:<keys>[+<included>]`, where both
+ * column lists are comma-separated and a key column is sorted in descending
+ * order if prefixed by `-`:
+ *
+ * \code
+ * IndexDefinition definition;
+ * IndexDefinition::parse("topcited:year,-citations,id+title", definition);
+ * \endcode
+ */
+struct IndexDefinition {
+	char name[COVERING_NAME_MAX]; //!< Index name, used in its filename and to query it
+	unsigned int keyCount; //!< Quantity of key columns
+	KeyColumn keys[COVERING_MAX_KEYS]; //!< Key columns, in sort priority order
+	unsigned int includedCount; //!< Quantity of included numeric columns
+	Column included[COVERING_MAX_INCLUDED]; //!< Included numeric columns
+	bool includesTitle; //!< True if the title is an included column
+	
+	//! Reads a declaration
+	/*!
+	 * Names may only have letters, digits, `_` and `-`. Column names are `id`,
+	 * `title`, `year` and `citations`; the title can only be included.
+	 *
+	 * @param declaration Declaration text
+	 * @param definition Where the declaration will be read into
+	 *
+	 * @return True if the declaration is valid
+	 */
+	static bool parse(const char *declaration, IndexDefinition& definition);
+	
+	//! Fills a value with the columns of an entry
+	/*!
+	 * @param e Entry to index
+	 * @param offset Entry offset in the hashfile
+	 * @param value Value to fill
+	 */
+	template <std::size_t TitleSize>
+	void fill(const Entry& e, long offset, CoveringValue<TitleSize>& value) const;
+	
+	//! Builds the smallest and biggest values with the provided key prefix
+	/*!
+	 * Every value whose first key columns are equal to the prefix is between
+	 * the two.
+	 *
+	 * @param prefix Values of the first key columns
+	 * @param prefixSize Quantity of values in the prefix, at most keyCount
+	 * @param lo Smallest value with the prefix
+	 * @param hi Biggest value with the prefix
+	 */
+	template <std::size_t TitleSize>
+	void range(const std::int64_t *prefix, std::size_t prefixSize, CoveringValue<TitleSize>& lo, CoveringValue<TitleSize>& hi) const;
+	
+	//! Prints a value, one column after the other in a single line
+	/*!
+	 * @param value Value to print
+	 */
+	template <std::size_t TitleSize>
+	void print(const CoveringValue<TitleSize>& value) const;
+	
+	//! Prints the declaration, in the same format IndexDefinition::parse reads
+	void printDeclaration() const;
+};
+
+//! Name of a column, as used in declarations
+/*!
+ * @param column Column
+ *
+ * @return Column name
+ */
+const char* columnName(Column column);
+
+//! Value of a numeric column of an entry
+/*!
+ * @param e Entry
+ * @param column Numeric column
+ *
+ * @return Column value
+ */
+std::int64_t columnValue(const Entry& e, Column column);
+
+//! Writes the declarations of the indexes built during upload
+/*!
+ * @param filepath Path to the catalog file, which will be overwritten
+ * @param definitions Declarations
+ *
+ * @return True if the whole catalog was written
+ */
+bool saveCatalog(const char *filepath, const std::vector<IndexDefinition>& definitions);
+
+//! Reads the declarations written by saveCatalog
+/*!
+ * @param filepath Path to the catalog file
+ * @param definitions Vector where the declarations will be appended
+ *
+ * @return True if the catalog was read
+ */
+bool loadCatalog(const char *filepath, std::vector<IndexDefinition>& definitions);
+
+#include "CoveringIndex.inl"
+
+#endif // _COVERINGINDEX_HPP_INCLUDED_
@@ -0,0 +1,58 @@
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+// --- //
+
+template <std::size_t TitleSize>
+void IndexDefinition::fill(const Entry& e, long offset, CoveringValue<TitleSize>& value) const {
+	std::fill(value.keys, value.keys + COVERING_MAX_KEYS, 0);
+	std::fill(value.included, value.included + COVERING_MAX_INCLUDED, 0);
+	
+	for (unsigned int i = 0; i < keyCount; ++i) {
+		auto v = columnValue(e, keys[i].column);
+		value.keys[i] = keys[i].descending? ~v : v;
+	}
+	
+	for (unsigned int i = 0; i < includedCount; ++i) {
+		value.included[i] = columnValue(e, included[i]);
+	}
+	
+	value.offset = offset;
+	
+	// Copied by hand, since the title may not be included at all (TitleSize 1)
+	auto size = std::min<std::size_t>(std::strlen(e.title), TitleSize - 1);
+	std::memset(value.title, 0, TitleSize);
+	std::memcpy(value.title, e.title, size);
+}
+
+template <std::size_t TitleSize>
+void IndexDefinition::range(const std::int64_t *prefix, std::size_t prefixSize, CoveringValue<TitleSize>& lo, CoveringValue<TitleSize>& hi) const {
+	std::fill(lo.keys, lo.keys + COVERING_MAX_KEYS, 0);
+	std::fill(hi.keys, hi.keys + COVERING_MAX_KEYS, 0);
+	
+	for (unsigned int i = 0; i < keyCount; ++i) {
+		if (i < prefixSize) {
+			lo.keys[i] = hi.keys[i] = keys[i].descending? ~prefix[i] : prefix[i];
+		}
+		else {
+			lo.keys[i] = INT64_MIN;
+			hi.keys[i] = INT64_MAX;
+		}
+	}
+}
+
+template <std::size_t TitleSize>
+void IndexDefinition::print(const CoveringValue<TitleSize>& value) const {
+	for (unsigned int i = 0; i < keyCount; ++i) {
+		std::cout << columnName(keys[i].column) << ": "
+			<< (keys[i].descending? ~value.keys[i] : value.keys[i]) << "  ";
+	}
+	
+	for (unsigned int i = 0; i < includedCount; ++i) {
+		std::cout << columnName(included[i]) << ": " << value.included[i] << "  ";
+	}
+	
+	if (includesTitle) std::cout << "title: " << value.title;
+	std::cout << '\n';
+}
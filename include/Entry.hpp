@@ -1,6 +1,8 @@
 #ifndef _ENTRY_HPP_INCLUDED_
 #define _ENTRY_HPP_INCLUDED_
 
+#include <cstdint>
+
 //! Max title size in characters
 #define TITLE_CHAR_MAX 300
 
@@ -19,7 +21,7 @@
  */
 struct Entry {
 	bool valid; //!< True if the data is legit, false if the entry is being used only for padding within the file
-	int id; //!< Article identifier
+	std::int64_t id; //!< Article identifier
 	char title[TITLE_CHAR_MAX]; //!< Article title
 	int year; //!< Publication year of the article
 	char authors[AUTHORS_CHAR_MAX]; //!< Article authors
@@ -0,0 +1,328 @@
+#ifndef _EXTENDIBLEHASH_HPP_INCLUDED_
+#define _EXTENDIBLEHASH_HPP_INCLUDED_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "AsyncReader.hpp"
+#include "Block.hpp"
+#include "BlockCache.hpp"
+#include "BlockFile.hpp"
+
+//! Maximum global depth of an ExtendibleHash
+/*!
+ * Buckets that would need a deeper directory to be split get overflow buckets
+ * instead. 2^24 directory entries take 128 MB while inserting.
+ */
+#define EXTENDIBLE_HASH_MAX_DEPTH 24
+
+//! Auxiliary function to calculate how many T-type values fit in an ExtendibleHash bucket
+/*!
+ * The calculation is done based on BlockSize, taking into account the other
+ * members of an ExtendibleHash::Bucket:
+ *
+ * `BlockSize = 2 * sizeof(long) + sizeof(unsigned int) + sizeof(std::size_t) + capacity * sizeof(T)`
+ *
+ * @tparam T Type that will be stored in ExtendibleHash
+ * @tparam BlockSize Size in bytes
+ *
+ * @return Calculation result
+ */
+template <typename T, unsigned int BlockSize>
+constexpr auto maxBucketCapacity() {
+	constexpr auto c = 3 * sizeof(long) + sizeof(std::size_t);
+	static_assert(c + sizeof(T) <= BlockSize, "Type T too big, consider increasing blockSize");
+	
+	return (BlockSize - c) / sizeof(T);
+}
+
+//! Disk-based extendible hash index
+/*!
+ * ExtendibleHash stores T-type values in a binary file for exact-match
+ * lookups, like BPlusTree, but a lookup costs the same no matter how many values
+ * there are: one block read for the directory page and one for the bucket.
+ *
+ * Values are spread among buckets, one bucket per block, according to the low
+ * bits of their hash. The directory maps each combination of the lowest
+ * `globalDepth` bits to a bucket, and several entries may share a bucket. When
+ * a bucket overflows it's split in two, looking at one more bit, and the
+ * directory doubles only if the bucket was already using all its bits. So the
+ * index grows one bucket at a time as values are inserted.
+ *
+ * Values with the exact same hash can't be told apart by any bit, so once a
+ * bucket only holds such values it gets a chain of overflow buckets instead of
+ * being split.
+ *
+ * The directory is kept in memory while inserting, and written after the
+ * buckets by ExtendibleHash::finishInsertions. Readers only load the header and
+ * read the directory page they need for each lookup.
+ *
+ * Usage is the same as BPlusTree:
+ * \code
+ * ExtendibleHash<int, IntHash> index;
+ *
+ * // Insert data
+ * index.create("filename.bin");
+ * index.insert(1);
+ * index.finishInsertions();
+ *
+ * // Read data
+ * index.load("filename.bin");
+ * auto x = index.seek(1);
+ * if (x) f(*x); // If found, do something to x
+ * \endcode
+ *
+ * @tparam T Type of the data to be stored. Must be a POD (Plain Old Data type)
+ * and _less-than_ comparable. Two values are the same key if neither is less
+ * than the other.
+ *
+ * @tparam Hash Function object returning a `std::uint64_t` hash for T-type
+ * values, and for every key type that will be sought. Equivalent keys must have
+ * the same hash.
+ *
+ * @tparam BlockSize %Block size to use, in bytes
+ */
+template <typename T, typename Hash, unsigned int BlockSize = BLOCK_SIZE>
+class ExtendibleHash {
+public:
+	//! Type of the stored values
+	typedef T ValueType;
+	
+	//! Quantity of values per bucket
+	static constexpr auto Capacity = maxBucketCapacity<T, BlockSize>();
+	
+	//! %Block size in bytes
+	static constexpr auto BlockSizeInUse = BlockSize;
+	
+	//! Default constructor
+	ExtendibleHash();
+	
+	//! Switches the index to direct I/O through the provided cache
+	/*!
+	 * See BPlusTree::useCache.
+	 *
+	 * @param cache Cache to use, or null to go back to stdio
+	 */
+	void useCache(BlockCache *cache);
+	
+	//! Initializes the index for writing
+	/*!
+	 * If there's already a file in the filepath, it'll be overwritten. The new
+	 * file starts with a header and a single empty bucket.
+	 *
+	 * After you've finished inserting values, call
+	 * ExtendibleHash::finishInsertions to write the directory.
+	 *
+	 * @param filepath Path to the file where the index will be written
+	 *
+	 * @return True if the file was created successfully
+	 */
+	bool create(const char* filepath);
+	
+	//! Initializes the index for reading only
+	/*!
+	 * The file must have been created by an ExtendibleHash which called
+	 * ExtendibleHash::finishInsertions, with the same block size and bucket
+	 * capacity.
+	 *
+	 * @param filepath Path to the file where index data can be found
+	 *
+	 * @return True if it was possible to open the file and it holds a directory
+	 * written in the current format, with the same block size and bucket
+	 * capacity
+	 */
+	bool load(const char* filepath);
+	
+	//! Inserts a value in the index
+	/*!
+	 * @param value Value to insert
+	 */
+	void insert(const T& value);
+	
+	//! Inserts a value, or merges it into an equivalent value already in the index
+	/*!
+	 * Same as BPlusTree::insertOrMerge. The merge must not change the value's
+	 * hash either.
+	 *
+	 * @tparam Merge Callable receiving a `T&` with the stored value
+	 *
+	 * @param value Value to insert
+	 * @param merge Called with the stored value if there's one equivalent to
+	 * value
+	 *
+	 * @return True if the value was inserted, false if it was merged
+	 */
+	template <typename Merge>
+	bool insertOrMerge(const T& value, Merge merge);
+	
+	//! Seeks a value that's equivalent to the one provided
+	/*!
+	 * @tparam U Type of the key to seek. T and U must be less-than comparable
+	 * and Hash must accept U.
+	 *
+	 * @param key The value to seek
+	 *
+	 * @return Pointer with the value if found, null otherwise
+	 */
+	template <typename U>
+	std::unique_ptr<T> seek(const U& key);
+	
+	//! Seeks a value without allocating or copying blocks
+	/*!
+	 * Same as BPlusTree::seek with a value: directory pages and buckets are
+	 * looked at in place, see BlockFile::view.
+	 *
+	 * @param key The value to seek
+	 * @param value Set to the value if found, left untouched otherwise
+	 *
+	 * @return True if the value was found
+	 */
+	template <typename U>
+	bool seek(const U& key, T& value);
+	
+	//! Seeks many keys at once, keeping several lookups in flight
+	/*!
+	 * Same as BPlusTree::seekMany.
+	 *
+	 * @tparam U See ExtendibleHash::seek
+	 *
+	 * @param keys Values to seek
+	 * @param reader Reader used to submit the block reads
+	 *
+	 * @return One pointer per key, in the same order as the keys, with the
+	 * value if found, null otherwise
+	 */
+	template <typename U>
+	std::vector<std::unique_ptr<T>> seekMany(const std::vector<U>& keys, AsyncReader& reader);
+	
+	//! ExtendibleHash usage analytics
+	struct Statistics {
+		std::uint64_t blocksRead; //!< Quantity of blocks read since the index was initialized
+		std::uint64_t blocksCreated; //!< Quantity of blocks created since the index was initialized
+		std::uint64_t blocksInDisk; //!< Quantity of blocks stored in disk
+	};
+	
+	//! Returns the usage statistics so far
+	/*!
+	 * See BPlusTree::getStatistics.
+	 *
+	 * @param includeFileBlockCount True if you want to update the
+	 * Statistics::blocksInDisk value, false otherwise
+	 *
+	 * @return Statistics
+	 */
+	const Statistics& getStatistics(bool includeFileBlockCount = false) const;
+	
+	//! Reset all statistics values to 0
+	void resetStatistics();
+	
+	//! Writes the directory and updates the header
+	/*!
+	 * Must be called once you've finished inserting values. Calling it again
+	 * after more insertions writes a new copy of the directory.
+	 */
+	void finishInsertions();
+	
+	//! Quantity of hash bits used by the directory
+	unsigned int globalDepth() const;
+
+private:
+	//! File header data for ExtendibleHash indexes
+	struct FileHeader {
+		std::uint32_t version; //!< Format version, see FORMAT_VERSION
+		std::uint32_t blockSize; //!< %Block size the hash was created with
+		std::uint32_t bucketCapacity; //!< Values per bucket the hash was created with, see ExtendibleHash::Capacity
+		std::uint32_t globalDepth; //!< Quantity of hash bits used by the directory
+		long directoryAddress; //!< Offset of the first directory page, -1 if not written yet
+		std::uint64_t blockCount; //!< Quantity of blocks in the file
+	};
+	
+	//! File header block
+	typedef Block<FileHeader, BlockSize> FileHeaderBlock;
+	
+	//! Bucket of values sharing the lowest ExtendibleHash::Bucket::localDepth hash bits
+	struct Bucket {
+		long offset; //!< Disk address, -1 if the bucket hasn't been written yet
+		long next; //!< Overflow bucket address, -1 if there's none
+		unsigned int localDepth; //!< Quantity of hash bits shared by all the values
+		std::size_t size; //!< Quantity of values currently stored in the bucket
+		T values[Capacity]; //!< Bucket values
+		
+		//! Initializes an empty bucket
+		/*!
+		 * @param localDepth Quantity of hash bits shared by the bucket values
+		 */
+		void initialize(unsigned int localDepth);
+	};
+	
+	//! Bucket block
+	typedef Block<Bucket, BlockSize> BucketBlock;
+	
+	//! Directory entries per block
+	static constexpr std::size_t EntriesPerPage = BlockSize / sizeof(long);
+	
+	//! Part of the directory stored in a single block
+	struct DirectoryPage {
+		long buckets[EntriesPerPage]; //!< Bucket address for each directory entry
+	};
+	
+	//! Directory page block
+	typedef Block<DirectoryPage, BlockSize> DirectoryPageBlock;
+	
+	BlockFile m_file; //!< File where data will be stored
+	FileHeader m_header; //!< Header of the loaded file
+	std::vector<long> m_directory; //!< Whole directory, only kept while inserting
+	std::vector<long> m_free; //!< Overflow buckets released by splits, reused before growing the file
+	mutable Statistics m_stats; //!< Where ExtendibleHash stores its read and write statistics
+	
+	//! Reads a block, updating the statistics
+	template <typename B>
+	void readFromDisk(long offset, B& block) const;
+	
+	//! Reads a block in place, updating the statistics
+	/*!
+	 * See BlockFile::view.
+	 *
+	 * @param buffer Where the block is read into if there's no cache
+	 */
+	template <typename B>
+	PageRef viewFromDisk(long offset, B& buffer) const;
+	
+	//! Writes a bucket, allocating a block for it if it has none yet
+	void writeBucket(BucketBlock& bucket);
+	
+	//! Address of the bucket holding a hash
+	/*!
+	 * Uses the in-memory directory while inserting, and reads the directory
+	 * page otherwise.
+	 */
+	long bucketAddress(std::uint64_t hash);
+	
+	//! Splits a full bucket in two, looking at one more hash bit
+	/*!
+	 * Doubles the directory if needed. Values from the bucket's overflow chain
+	 * are also redistributed.
+	 *
+	 * @param head First bucket of the chain
+	 */
+	void split(BucketBlock& head);
+	
+	//! Writes values into a bucket and as many overflow buckets as needed
+	/*!
+	 * @param head Bucket where the values will be written first
+	 * @param values Values to write
+	 */
+	void writeChain(BucketBlock& head, const std::vector<T>& values);
+	
+	//! Looks for a key in a bucket
+	/*!
+	 * @return Position of the value, or Bucket::size if not found
+	 */
+	template <typename U>
+	static std::size_t find(const Bucket& bucket, const U& key);
+};
+
+#include "ExtendibleHash.inl"
+
+#endif // _EXTENDIBLEHASH_HPP_INCLUDED_
@@ -0,0 +1,459 @@
+#include <algorithm>
+
+// --- //
+
+template <typename T, typename Hash, unsigned int BlockSize>
+void ExtendibleHash<T, Hash, BlockSize>::Bucket::initialize(unsigned int localDepth) {
+	this->offset = -1;
+	this->next = -1;
+	this->localDepth = localDepth;
+	this->size = 0;
+}
+
+// --- //
+
+template <typename T, typename Hash, unsigned int BlockSize>
+ExtendibleHash<T, Hash, BlockSize>::ExtendibleHash()
+	: m_header({ 0, 0, 0, 0, -1, 0 })
+	, m_stats({ 0, 0, 0 })
+{	}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+void ExtendibleHash<T, Hash, BlockSize>::useCache(BlockCache *cache) {
+	m_file.useCache(cache);
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+bool ExtendibleHash<T, Hash, BlockSize>::create(const char* filepath) {
+	if (m_file.create(filepath)) {
+		resetStatistics();
+		m_free.clear();
+		
+		FileHeaderBlock header;
+		header.var = m_header = { FORMAT_VERSION, BlockSize, Capacity, 0, -1, 0 };
+		m_file.write(0, &header, sizeof(header));
+		++m_stats.blocksCreated;
+		
+		// Global depth 0: a single directory entry for a single bucket
+		BucketBlock bucket;
+		bucket.var.initialize(0);
+		writeBucket(bucket);
+		m_directory.assign(1, bucket.var.offset);
+		
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+bool ExtendibleHash<T, Hash, BlockSize>::load(const char* filepath) {
+	m_directory.clear();
+	
+	if (m_file.open(filepath)) {
+		FileHeaderBlock header;
+		readFromDisk(0, header);
+		m_header = header.var;
+		
+		// Buckets of another format or size would be read wrong
+		bool compatible = m_header.version == FORMAT_VERSION && m_header.blockSize == BlockSize && m_header.bucketCapacity == Capacity;
+		return compatible && m_header.directoryAddress >= 0;
+	}
+	else {
+		return false;
+	}
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+void ExtendibleHash<T, Hash, BlockSize>::insert(const T& value) {
+	auto hash = Hash()(value);
+	
+	while (true) {
+		BucketBlock head;
+		readFromDisk(bucketAddress(hash), head);
+		
+		// Looks for room along the overflow chain, checking along the way if
+		// all values share the new value's hash, in which case splitting
+		// wouldn't separate them
+		BucketBlock bucket = head;
+		bool sameHash = true;
+		
+		while (true) {
+			if (bucket.var.size < Capacity) {
+				bucket.var.values[bucket.var.size++] = value;
+				writeBucket(bucket);
+				return;
+			}
+			
+			for (std::size_t i = 0; i < bucket.var.size && sameHash; ++i) {
+				sameHash = Hash()(bucket.var.values[i]) == hash;
+			}
+			
+			if (bucket.var.next == -1) break;
+			readFromDisk(bucket.var.next, bucket);
+		}
+		
+		if (sameHash || head.var.localDepth >= EXTENDIBLE_HASH_MAX_DEPTH) {
+			BucketBlock overflow;
+			overflow.var.initialize(head.var.localDepth);
+			overflow.var.values[0] = value;
+			overflow.var.size = 1;
+			writeBucket(overflow);
+			
+			bucket.var.next = overflow.var.offset;
+			writeBucket(bucket);
+			return;
+		}
+		
+		split(head);
+	}
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+template <typename Merge>
+bool ExtendibleHash<T, Hash, BlockSize>::insertOrMerge(const T& value, Merge merge) {
+	BucketBlock bucket;
+	auto offset = bucketAddress(Hash()(value));
+	
+	while (offset != -1) {
+		readFromDisk(offset, bucket);
+		
+		auto i = find(bucket.var, value);
+		if (i < bucket.var.size) {
+			merge(bucket.var.values[i]);
+			writeBucket(bucket);
+			return false;
+		}
+		
+		offset = bucket.var.next;
+	}
+	
+	insert(value);
+	return true;
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+template <typename U>
+std::unique_ptr<T> ExtendibleHash<T, Hash, BlockSize>::seek(const U& key) {
+	T value;
+	return seek(key, value)? std::make_unique<T>(value) : nullptr;
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+template <typename U>
+bool ExtendibleHash<T, Hash, BlockSize>::seek(const U& key, T& value) {
+	BucketBlock buffer;
+	auto offset = bucketAddress(Hash()(key));
+	
+	while (offset != -1) {
+		PageRef page = viewFromDisk(offset, buffer);
+		if (!page) return false;
+		
+		auto& bucket = page.as<BucketBlock>().var;
+		auto i = find(bucket, key);
+		
+		if (i < bucket.size) {
+			value = bucket.values[i];
+			return true;
+		}
+		
+		offset = bucket.next;
+	}
+	
+	return false;
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+template <typename U>
+std::vector<std::unique_ptr<T>> ExtendibleHash<T, Hash, BlockSize>::seekMany(const std::vector<U>& keys, AsyncReader& reader) {
+	std::vector<std::unique_ptr<T>> results(keys.size());
+	
+	// Each lookup in flight owns a block buffer, holding either its directory
+	// page or its current bucket, and the request reading into it
+	struct Lookup {
+		std::size_t key;
+		std::uint64_t hash;
+		bool directory;
+		char *block;
+		AsyncReader::Request request;
+	};
+	
+	std::vector<Lookup> lookups(std::min(keys.size(), reader.queueDepth()));
+	std::size_t nextKey = 0;
+	std::size_t inFlight = 0;
+	
+	// Block buffers are aligned so that they can also be used with O_DIRECT
+	auto buffers = allocateAligned(lookups.size() * BlockSize, BlockSize);
+	for (std::size_t i = 0; i < lookups.size(); ++i) {
+		lookups[i].block = buffers.get() + i * BlockSize;
+	}
+	
+	int fd = m_file.descriptor();
+	auto cache = m_file.cache();
+	
+	// Submits a read for the lookup's next block, or takes it from the cache.
+	// Returns null if a read was submitted.
+	auto fetch = [&](Lookup& l, long offset, bool directory) -> const char* {
+		l.directory = directory;
+		
+		if (cache) {
+			if (auto cached = cache->lookup(fd, offset)) return cached;
+		}
+		
+		l.request.fd = fd;
+		l.request.offset = offset;
+		l.request.buffer = l.block;
+		l.request.size = BlockSize;
+		l.request.userData = &l;
+		reader.submit(l.request);
+		return nullptr;
+	};
+	
+	// Decides the lookup's next step based on the block it has just got.
+	// Returns true if a read was submitted, false if the lookup ended.
+	auto advance = [&](Lookup& l, const char *block) {
+		while (block) {
+			long next;
+			
+			if (l.directory) {
+				auto entry = l.hash & ((std::uint64_t(1) << m_header.globalDepth) - 1);
+				next = reinterpret_cast<const DirectoryPageBlock*>(block)->var.buckets[entry % EntriesPerPage];
+			}
+			else {
+				auto& bucket = reinterpret_cast<const BucketBlock*>(block)->var;
+				auto i = find(bucket, keys[l.key]);
+				
+				if (i < bucket.size) {
+					results[l.key] = std::make_unique<T>(bucket.values[i]);
+					return false;
+				}
+				
+				next = bucket.next;
+			}
+			
+			if (next == -1) return false;
+			block = fetch(l, next, false);
+		}
+		
+		return true;
+	};
+	
+	// Hands the next keys to the lookup until one of them needs the device
+	auto start = [&](Lookup& l) {
+		while (nextKey < keys.size()) {
+			l.key = nextKey++;
+			l.hash = Hash()(keys[l.key]);
+			
+			const char *block;
+			if (m_directory.empty()) {
+				auto entry = l.hash & ((std::uint64_t(1) << m_header.globalDepth) - 1);
+				block = fetch(l, m_header.directoryAddress + entry / EntriesPerPage * BlockSize, true);
+			}
+			else {
+				block = fetch(l, bucketAddress(l.hash), false);
+			}
+			
+			if (advance(l, block)) {
+				++inFlight;
+				return;
+			}
+		}
+	};
+	
+	for (auto& l : lookups) {
+		start(l);
+	}
+	
+	while (inFlight) {
+		auto& request = reader.wait();
+		auto& l = *static_cast<Lookup*>(request.userData);
+		--inFlight;
+		++m_stats.blocksRead;
+		
+		bool complete = request.result == static_cast<long>(BlockSize);
+		if (complete && cache) cache->insert(fd, request.offset, l.block, BlockCache::IndexPage);
+		
+		if (complete && advance(l, l.block)) {
+			++inFlight;
+		}
+		else {
+			start(l);
+		}
+	}
+	
+	return results;
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+const typename ExtendibleHash<T, Hash, BlockSize>::Statistics& ExtendibleHash<T, Hash, BlockSize>::getStatistics(bool includeFileBlockCount) const {
+	if (includeFileBlockCount) {
+		FileHeaderBlock header;
+		readFromDisk(0, header);
+		m_stats.blocksInDisk = header.var.blockCount;
+	}
+	
+	return m_stats;
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+void ExtendibleHash<T, Hash, BlockSize>::resetStatistics() {
+	m_stats.blocksRead = m_stats.blocksCreated = m_stats.blocksInDisk = 0;
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+void ExtendibleHash<T, Hash, BlockSize>::finishInsertions() {
+	DirectoryPageBlock page;
+	m_header.directoryAddress = m_file.end();
+	
+	for (std::size_t first = 0; first < m_directory.size(); first += EntriesPerPage) {
+		auto last = std::min(first + EntriesPerPage, m_directory.size());
+		std::copy(m_directory.begin() + first, m_directory.begin() + last, page.var.buckets);
+		
+		m_file.write(m_header.directoryAddress + first / EntriesPerPage * BlockSize, &page, sizeof(page));
+		++m_stats.blocksCreated;
+	}
+	
+	m_header.blockCount = m_stats.blocksCreated;
+	
+	FileHeaderBlock header;
+	header.var = m_header;
+	m_file.write(0, &header, sizeof(header));
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+unsigned int ExtendibleHash<T, Hash, BlockSize>::globalDepth() const {
+	return m_header.globalDepth;
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+template <typename B>
+void ExtendibleHash<T, Hash, BlockSize>::readFromDisk(long offset, B& block) const {
+	bool fetched;
+	
+	m_file.read(offset, &block, sizeof(block), &fetched);
+	
+	if (fetched) ++m_stats.blocksRead;
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+template <typename B>
+PageRef ExtendibleHash<T, Hash, BlockSize>::viewFromDisk(long offset, B& buffer) const {
+	bool fetched;
+	auto page = m_file.view(offset, &buffer, sizeof(buffer), &fetched);
+	
+	if (fetched) ++m_stats.blocksRead;
+	return page;
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+void ExtendibleHash<T, Hash, BlockSize>::writeBucket(BucketBlock& bucket) {
+	if (bucket.var.offset == -1) {
+		if (!m_free.empty()) {
+			bucket.var.offset = m_free.back();
+			m_free.pop_back();
+		}
+		else {
+			bucket.var.offset = m_file.end();
+			++m_stats.blocksCreated;
+		}
+	}
+	
+	m_file.write(bucket.var.offset, &bucket, sizeof(bucket));
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+long ExtendibleHash<T, Hash, BlockSize>::bucketAddress(std::uint64_t hash) {
+	auto entry = hash & ((std::uint64_t(1) << m_header.globalDepth) - 1);
+	
+	if (!m_directory.empty()) {
+		return m_directory[entry];
+	}
+	
+	DirectoryPageBlock buffer;
+	PageRef page = viewFromDisk(m_header.directoryAddress + entry / EntriesPerPage * BlockSize, buffer);
+	return page? page.as<DirectoryPageBlock>().var.buckets[entry % EntriesPerPage] : -1;
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+void ExtendibleHash<T, Hash, BlockSize>::split(BucketBlock& head) {
+	auto depth = head.var.localDepth;
+	
+	if (depth == m_header.globalDepth) {
+		// Every entry gets a twin which differs in the new highest bit, and
+		// points to the same bucket until it's split
+		m_directory.insert(m_directory.end(), m_directory.begin(), m_directory.end());
+		++m_header.globalDepth;
+	}
+	
+	// Gathers the values of the whole chain, releasing the overflow buckets
+	std::vector<T> values(head.var.values, head.var.values + head.var.size);
+	
+	for (long next = head.var.next; next != -1; ) {
+		BucketBlock overflow;
+		readFromDisk(next, overflow);
+		values.insert(values.end(), overflow.var.values, overflow.var.values + overflow.var.size);
+		
+		m_free.push_back(next);
+		next = overflow.var.next;
+	}
+	
+	std::vector<T> left, right;
+	for (auto& value : values) {
+		(Hash()(value) >> depth & 1? right : left).push_back(value);
+	}
+	
+	auto offset = head.var.offset;
+	head.var.initialize(depth + 1);
+	head.var.offset = offset;
+	writeChain(head, left);
+	
+	BucketBlock sibling;
+	sibling.var.initialize(depth + 1);
+	writeChain(sibling, right);
+	
+	// Entries pointing to the old bucket which have the new bit set now point
+	// to the sibling
+	for (auto& entry : m_directory) {
+		if (entry == offset && (&entry - m_directory.data()) >> depth & 1) {
+			entry = sibling.var.offset;
+		}
+	}
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+void ExtendibleHash<T, Hash, BlockSize>::writeChain(BucketBlock& head, const std::vector<T>& values) {
+	auto copy = [&](BucketBlock& bucket, std::size_t first) {
+		bucket.var.size = std::min(values.size() - first, std::size_t(Capacity));
+		std::copy(values.begin() + first, values.begin() + first + bucket.var.size, bucket.var.values);
+	};
+	
+	copy(head, 0);
+	
+	// Overflow buckets are written before the bucket pointing to them, so that
+	// the pointer can be set
+	std::vector<BucketBlock> chain;
+	for (std::size_t first = Capacity; first < values.size(); first += Capacity) {
+		chain.emplace_back();
+		chain.back().var.initialize(head.var.localDepth);
+		copy(chain.back(), first);
+	}
+	
+	for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+		it->var.next = it == chain.rbegin()? -1 : (it - 1)->var.offset;
+		writeBucket(*it);
+	}
+	
+	head.var.next = chain.empty()? -1 : chain.front().var.offset;
+	writeBucket(head);
+}
+
+template <typename T, typename Hash, unsigned int BlockSize>
+template <typename U>
+std::size_t ExtendibleHash<T, Hash, BlockSize>::find(const Bucket& bucket, const U& key) {
+	for (std::size_t i = 0; i < bucket.size; ++i) {
+		if (!(key < bucket.values[i]) && !(bucket.values[i] < key)) return i;
+	}
+	
+	return bucket.size;
+}
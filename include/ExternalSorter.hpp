@@ -0,0 +1,137 @@
+#ifndef _EXTERNALSORTER_HPP_INCLUDED_
+#define _EXTERNALSORTER_HPP_INCLUDED_
+
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+//! Default memory budget of an ExternalSorter, in bytes
+#define DEFAULT_SORT_MEMORY (64 * 1024 * 1024)
+
+//! Sorts more values than fit in memory
+/*!
+ * Values are gathered in a buffer as big as the memory budget allows. Each
+ * time it fills up, it's sorted and written to a temporary file as a sorted
+ * run. Once every value has been added, the runs are merged, all at once,
+ * as the values are taken out with ExternalSorter::next.
+ *
+ * Both the runs and the merge are read and written sequentially, so sorting
+ * costs about two sequential passes over the values, no matter the order in
+ * which they're added. If every value fits in the buffer, nothing is written
+ * at all.
+ *
+ * The buffer is sorted on several threads: each sorts a slice of it, and the
+ * slices are then merged pairwise, also in parallel.
+ *
+ * Example usage:
+ * \code
+ * ExternalSorter<int> sorter(1024 * 1024);
+ * sorter.add(3);
+ * sorter.add(1);
+ * sorter.sort();
+ *
+ * int x;
+ * while (sorter.next(x)) {
+ *     // 1, then 3
+ * }
+ * \endcode
+ *
+ * @tparam T Type of the values. Must be a POD (Plain Old Data type), since
+ * it's written to the runs as it is in memory.
+ *
+ * @tparam Compare Less-than comparator of T
+ */
+template <typename T, typename Compare = std::less<T>>
+class ExternalSorter {
+public:
+	//! Creates a sorter with nothing added
+	/*!
+	 * @param memoryBudget Bytes the buffer of values can take. Merging takes
+	 * about as much, split between the runs.
+	 * @param threads Threads sorting the buffer, 0 to use one per core
+	 * @param compare Comparator of the values
+	 */
+	explicit ExternalSorter(std::size_t memoryBudget = DEFAULT_SORT_MEMORY, unsigned int threads = 0,
+		Compare compare = Compare());
+	
+	//! Destructor
+	/*! Closes the runs, which removes them */
+	~ExternalSorter();
+	
+	ExternalSorter(const ExternalSorter&) = delete;
+	ExternalSorter& operator= (const ExternalSorter&) = delete;
+	
+	//! Adds a value to be sorted
+	/*!
+	 * May write a run, if the buffer is full.
+	 *
+	 * @param value Value to add
+	 *
+	 * @return False if a run couldn't be written
+	 */
+	bool add(const T& value);
+	
+	//! Ends the addition of values and prepares to take them out in order
+	/*!
+	 * @return False if a run couldn't be written
+	 */
+	bool sort();
+	
+	//! Takes out the next value in order
+	/*!
+	 * Only valid after ExternalSorter::sort.
+	 *
+	 * @param value Set to the next value
+	 *
+	 * @return False if every value has been taken out already
+	 */
+	bool next(T& value);
+	
+	//! Quantity of values added
+	std::size_t size() const;
+	
+	//! Quantity of runs written to temporary files
+	std::size_t runCount() const;
+
+private:
+	//! Sorted run in a temporary file
+	struct Run {
+		std::FILE *file; //!< Temporary file, removed when closed
+		std::vector<T> values; //!< Values read from the file while merging, not yet taken out
+		std::size_t position; //!< Position in Run::values of the smallest value not yet taken out
+	};
+	
+	std::size_t m_memoryBudget; //!< Bytes the buffer can take
+	unsigned int m_threads; //!< Threads sorting the buffer
+	Compare m_compare; //!< Comparator of the values
+	
+	std::vector<T> m_buffer; //!< Values not yet written to a run
+	std::size_t m_bufferPosition; //!< Next value of the buffer to take out, if there are no runs
+	std::vector<Run> m_runs; //!< Runs written so far
+	std::vector<std::size_t> m_heap; //!< Runs that still have values, as a heap on their smallest values
+	std::size_t m_runBufferSize; //!< Quantity of values read at once from each run while merging
+	std::size_t m_size; //!< Quantity of values added
+	
+	//! Sorts the buffer on ExternalSorter::m_threads threads
+	void sortBuffer();
+	
+	//! Sorts the buffer and writes it as a new run
+	/*!
+	 * @return False if the run couldn't be written
+	 */
+	bool spill();
+	
+	//! Reads the next values of a run to its buffer
+	/*!
+	 * @return False if the run has no more values
+	 */
+	bool fill(Run& run);
+	
+	//! Comparator of runs by their smallest values, making ExternalSorter::m_heap a min-heap
+	bool runGreater(std::size_t a, std::size_t b) const;
+};
+
+#include "ExternalSorter.inl"
+
+#endif // _EXTERNALSORTER_HPP_INCLUDED_
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <thread>
+
+template <typename T, typename Compare>
+ExternalSorter<T, Compare>::ExternalSorter(std::size_t memoryBudget, unsigned int threads, Compare compare)
+	: m_memoryBudget(memoryBudget), m_threads(threads), m_compare(compare), m_bufferPosition(0), m_runBufferSize(0), m_size(0)
+{
+	if (m_threads == 0) m_threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+template <typename T, typename Compare>
+ExternalSorter<T, Compare>::~ExternalSorter() {
+	for (auto& run : m_runs) {
+		std::fclose(run.file);
+	}
+}
+
+template <typename T, typename Compare>
+bool ExternalSorter<T, Compare>::add(const T& value) {
+	m_buffer.push_back(value);
+	++m_size;
+	
+	if (m_buffer.size() * sizeof(T) >= m_memoryBudget) return spill();
+	return true;
+}
+
+template <typename T, typename Compare>
+bool ExternalSorter<T, Compare>::sort() {
+	// Everything fits in memory, so the buffer is handed out as it is
+	if (m_runs.empty()) {
+		sortBuffer();
+		return true;
+	}
+	
+	if (!m_buffer.empty() && !spill()) return false;
+	
+	std::vector<T>().swap(m_buffer);
+	
+	// The merge gets the whole budget, split between the runs' buffers
+	m_runBufferSize = std::max<std::size_t>(m_memoryBudget / m_runs.size() / sizeof(T), 1);
+	
+	for (std::size_t i = 0; i < m_runs.size(); ++i) {
+		std::rewind(m_runs[i].file);
+		if (fill(m_runs[i])) m_heap.push_back(i);
+	}
+	
+	auto greater = [this](std::size_t a, std::size_t b) { return runGreater(a, b); };
+	std::make_heap(m_heap.begin(), m_heap.end(), greater);
+	
+	return true;
+}
+
+template <typename T, typename Compare>
+bool ExternalSorter<T, Compare>::next(T& value) {
+	if (m_runs.empty()) {
+		if (m_bufferPosition == m_buffer.size()) return false;
+		
+		value = m_buffer[m_bufferPosition++];
+		return true;
+	}
+	
+	if (m_heap.empty()) return false;
+	
+	auto greater = [this](std::size_t a, std::size_t b) { return runGreater(a, b); };
+	
+	std::pop_heap(m_heap.begin(), m_heap.end(), greater);
+	auto& run = m_runs[m_heap.back()];
+	value = run.values[run.position];
+	
+	if (++run.position < run.values.size() || fill(run)) std::push_heap(m_heap.begin(), m_heap.end(), greater);
+	else m_heap.pop_back();
+	
+	return true;
+}
+
+template <typename T, typename Compare>
+std::size_t ExternalSorter<T, Compare>::size() const {
+	return m_size;
+}
+
+template <typename T, typename Compare>
+std::size_t ExternalSorter<T, Compare>::runCount() const {
+	return m_runs.size();
+}
+
+template <typename T, typename Compare>
+void ExternalSorter<T, Compare>::sortBuffer() {
+	// Slices small enough aren't worth a thread
+	auto slices = std::min<std::size_t>(m_threads, std::max<std::size_t>(m_buffer.size() / 4096, 1));
+	
+	std::vector<std::size_t> bounds;
+	for (std::size_t i = 0; i <= slices; ++i) {
+		bounds.push_back(m_buffer.size() * i / slices);
+	}
+	
+	auto begin = m_buffer.begin();
+	std::vector<std::thread> workers;
+	
+	for (std::size_t i = 0; i < slices; ++i) {
+		workers.emplace_back([&, i] {
+			std::sort(begin + bounds[i], begin + bounds[i + 1], m_compare);
+		});
+	}
+	
+	for (auto& worker : workers) worker.join();
+	
+	// Neighbouring slices are merged pairwise, halving the slices each round
+	while (bounds.size() > 2) {
+		std::vector<std::size_t> merged;
+		workers.clear();
+		
+		for (std::size_t i = 0; i + 1 < bounds.size(); i += 2) {
+			merged.push_back(bounds[i]);
+			if (i + 2 >= bounds.size()) continue;
+			
+			workers.emplace_back([&, i] {
+				std::inplace_merge(begin + bounds[i], begin + bounds[i + 1], begin + bounds[i + 2], m_compare);
+			});
+		}
+		
+		merged.push_back(bounds.back());
+		
+		for (auto& worker : workers) worker.join();
+		bounds.swap(merged);
+	}
+}
+
+template <typename T, typename Compare>
+bool ExternalSorter<T, Compare>::spill() {
+	sortBuffer();
+	
+	Run run;
+	run.position = 0;
+	run.file = std::tmpfile();
+	if (!run.file) return false;
+	
+	m_runs.push_back(run);
+	
+	auto written = std::fwrite(m_buffer.data(), sizeof(T), m_buffer.size(), m_runs.back().file);
+	if (written != m_buffer.size()) return false;
+	
+	m_buffer.clear();
+	return true;
+}
+
+template <typename T, typename Compare>
+bool ExternalSorter<T, Compare>::fill(Run& run) {
+	run.values.resize(m_runBufferSize);
+	run.values.resize(std::fread(run.values.data(), sizeof(T), m_runBufferSize, run.file));
+	run.position = 0;
+	
+	return !run.values.empty();
+}
+
+template <typename T, typename Compare>
+bool ExternalSorter<T, Compare>::runGreater(std::size_t a, std::size_t b) const {
+	auto& x = m_runs[a];
+	auto& y = m_runs[b];
+	return m_compare(y.values[y.position], x.values[x.position]);
+}
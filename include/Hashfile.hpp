@@ -0,0 +1,271 @@
+#ifndef _HASHFILE_HPP_INCLUDED_
+#define _HASHFILE_HPP_INCLUDED_
+
+#include <cstdint>
+#include <vector>
+
+#include "Block.hpp"
+#include "BlockCache.hpp"
+#include "BlockFile.hpp"
+#include "Entry.hpp"
+#include "LzCodec.hpp"
+
+//! Default block size in bytes of the hashing file, and the space an entry takes in its block
+#define HASHFILE_BLOCK_SIZE BLOCK_SIZE
+
+//! Size in bytes of the dictionary a hashfile's entries are compressed with
+#define HASHFILE_DICTIONARY_SIZE 32768
+
+//! Quantity of entries sampled to train the dictionary of a compressed hashfile
+#define HASHFILE_DICTIONARY_SAMPLES 1024
+
+//! Place in the block directory of a compressed hashfile for ids without an entry
+#define HASHFILE_NO_ENTRY UINT64_MAX
+
+//! Header data for the hashfile
+struct HashfileHeader {
+	std::uint32_t version; //!< Format version, see FORMAT_VERSION
+	std::uint32_t blockSize; //!< Size of every block in the file, header included
+	std::int64_t blockCount;
+	std::int64_t firstId; //!< Id of the entry in the first block after the header, 0 unless the file is a segment (see PartitionedHashfile)
+	std::uint32_t compressed; //!< 1 if the entries are compressed, see Hashfile::compress
+	std::uint32_t dictionarySize; //!< Size in bytes of the dictionary the entries are compressed with, in the blocks right after the header
+	std::int64_t dataOffset; //!< Position of the first block of compressed entries
+	std::int64_t directoryOffset; //!< Position of the block directory, before the compressed entries
+	std::int64_t storedBlocks; //!< Quantity of blocks the file actually takes, when the entries are compressed
+};
+
+//! HashfileHeader block
+typedef Block<HashfileHeader, HASHFILE_BLOCK_SIZE> HashfileHeaderBlock;
+
+//! Entry block
+typedef Block<Entry, HASHFILE_BLOCK_SIZE> EntryBlock;
+
+//! File where the entries are stored
+/*!
+ * The first block holds a HashfileHeader. Every block after it holds a single
+ * Entry, and entries are appended in id order, so an entry's position is given
+ * by its id (perfect hashing). Ids that are skipped in the input are filled
+ * with invalid entries.
+ *
+ * The block size is chosen when the file is created and recorded in the
+ * header. Blocks bigger than an EntryBlock keep the entry at their start.
+ *
+ * A file may also be a segment, holding only the entries from some id on (see
+ * PartitionedHashfile). Offsets are still given as in a whole hashfile, so
+ * that they're the same in every segment, and the blocks of the ids before
+ * the segment's first one are just left out of the file.
+ *
+ * Once written, the file can be compressed with Hashfile::compress. Entries
+ * are then compressed one by one with an LzCodec, using a dictionary trained
+ * on samples of them, and packed one after the other into as few blocks as
+ * they fit in. A block directory, with the block and the place in it of each
+ * id's entry, precedes them, so offsets stay the same. Only the directory block
+ * of the id sought is read, and it's kept for the ids next to it, so reading
+ * an entry takes a block read, plus one of the directory unless a neighbour's
+ * entry was read last or the directory block is cached. A compressed file
+ * can't be written anymore.
+ *
+ * Like BPlusTree, the file is accessed through stdio by default. Hand a BlockCache
+ * to Hashfile::useCache before opening the file to use direct I/O instead, in
+ * which case blocks are cached as BlockCache::RecordPage.
+ */
+class Hashfile {
+public:
+	//! Default constructor
+	Hashfile();
+	
+	//! Destructor
+	/*! Closes the file if it's open */
+	~Hashfile();
+	
+	Hashfile(const Hashfile&) = delete;
+	Hashfile& operator=(const Hashfile&) = delete;
+	
+	//! Switches the hashfile to direct I/O through the provided cache
+	/*!
+	 * Same as BPlusTree::useCache.
+	 *
+	 * @param cache Cache to use, or null to go back to stdio
+	 */
+	void useCache(BlockCache *cache);
+	
+	//! Creates the file for appending entries
+	/*!
+	 * If there's already a file in the filepath, it'll be overwritten. The
+	 * header block is written right away with a block count of 1.
+	 *
+	 * @param filepath Path to the file
+	 * @param blockSize %Block size in bytes, at least as big as an EntryBlock;
+	 * must be the cache's block size if there's a cache
+	 * @param firstId Id of the first entry to be appended, for a segment
+	 *
+	 * @return True if the file was created successfully
+	 */
+	bool create(const char *filepath, unsigned int blockSize = HASHFILE_BLOCK_SIZE, std::int64_t firstId = 0);
+	
+	//! Opens an existing file
+	/*!
+	 * @param filepath Path to the file
+	 * @param writable True to also write entries, appending them after the
+	 * blocks counted in the header
+	 *
+	 * @return True if the file could be opened, it was written in the current
+	 * format (see FORMAT_VERSION) and its block size can be used, which with a
+	 * cache means it must be the cache's block size; a compressed file can't be
+	 * opened for writing
+	 */
+	bool open(const char *filepath, bool writable = false);
+	
+	//! Closes the file if it's open
+	void close();
+	
+	//! Rewrites a hashfile with its entries compressed
+	/*!
+	 * Entries are sampled first, to train the dictionary. The compressed file
+	 * is written to a temporary file, which then replaces the hashfile. Entries
+	 * are read in id order, and each block of the directory is written once
+	 * its ids are done, so only a block of it is kept in memory.
+	 *
+	 * @param filepath Path to a hashfile that isn't compressed, and isn't open
+	 *
+	 * @return True if the hashfile was replaced
+	 */
+	static bool compress(const char *filepath);
+	
+	//! True if the entries are compressed
+	bool compressed() const;
+	
+	//! Reads the file header
+	HashfileHeaderBlock readHeader();
+	
+	//! Updates the file header
+	/*!
+	 * @param header %Block with the header to write
+	 */
+	void writeHeader(const HashfileHeaderBlock& header);
+	
+	//! Appends an entry block to the end of the file
+	/*!
+	 * @param entry %Block to append
+	 *
+	 * @return Offset where the block was written
+	 */
+	long append(const EntryBlock& entry);
+	
+	//! Overwrites the entry block at the provided offset
+	/*!
+	 * Meant for filling the place of an invalid entry, see Hashfile::append
+	 * for adding blocks at the end.
+	 *
+	 * @param offset %Block offset
+	 * @param entry %Block to write
+	 */
+	void write(long offset, const EntryBlock& entry);
+	
+	//! Offset of the next appended block
+	long end() const;
+	
+	//! %Block size in bytes, as recorded in the header
+	unsigned int blockSize() const;
+	
+	//! Offset of the block of the entry with the provided id
+	/*!
+	 * Entries are placed by id, right after the header block.
+	 *
+	 * @param id Entry id
+	 */
+	long entryOffset(long id) const;
+	
+	//! Reads the entry block at the provided offset
+	/*!
+	 * @param offset %Block offset
+	 * @param entry Where the block will be read into
+	 *
+	 * @return True if a whole block could be read
+	 */
+	bool read(long offset, EntryBlock& entry);
+	
+	//! Reads the entry block at the provided offset in place
+	/*!
+	 * Same as BlockFile::view: with a cache, the handle points into the
+	 * cache frame and the entry isn't copied.
+	 *
+	 * @param offset %Block offset
+	 * @param buffer Where the block is read into if there's no cache
+	 *
+	 * @return Handle on the block, empty if a whole block couldn't be read
+	 */
+	PageRef view(long offset, EntryBlock& buffer);
+	
+	//! File descriptor, usable for positional reads
+	/*!
+	 * Reads from this descriptor must follow the same alignment rules as the
+	 * cache when direct I/O is in use, and use Hashfile::fileOffset.
+	 */
+	int descriptor() const;
+	
+	//! Position in the file of the block holding the entry at the provided offset
+	/*!
+	 * They're only different in a segment, which leaves out the blocks before
+	 * its first entry, and in a compressed file, where the block must go
+	 * through Hashfile::unpack to get the entry.
+	 *
+	 * @param offset %Block offset, as in a whole hashfile
+	 *
+	 * @return The position, or -1 if the file is compressed and there's no
+	 * entry at the offset
+	 */
+	long fileOffset(long offset) const;
+	
+	//! Gets an entry out of the block holding it
+	/*!
+	 * Only a compressed file's blocks need it; otherwise, the block is the
+	 * entry's and is just copied.
+	 *
+	 * @param offset Entry offset
+	 * @param block %Block read from Hashfile::fileOffset, which may be the
+	 * same memory as entry
+	 * @param entry Where the entry is written; marked as invalid if it
+	 * couldn't be decompressed
+	 *
+	 * @return True if the entry was there
+	 */
+	bool unpack(long offset, const char *block, EntryBlock& entry) const;
+	
+	//! Cache in use, null if the file is accessed through stdio
+	BlockCache* cache() const;
+
+private:
+	BlockFile m_file; //!< File where the entries are stored
+	long m_end; //!< Offset of the next appended block
+	long m_skipped; //!< Bytes of the blocks left out before a segment's first entry
+	unsigned int m_blockSize; //!< %Block size in bytes
+	
+	bool m_compressed; //!< True if the entries are compressed
+	long m_dataOffset; //!< Position of the first block of compressed entries
+	long m_directoryOffset; //!< Position of the block directory of a compressed file
+	std::int64_t m_slots; //!< Quantity of ids in the block directory
+	LzCodec m_codec; //!< Codec with the entries' dictionary
+	std::vector<char> m_packed; //!< Where blocks of compressed entries are read into
+	mutable std::vector<char> m_directoryBlock; //!< Directory block read last
+	mutable long m_directoryPosition; //!< Position of Hashfile::m_directoryBlock, -1 if none was read
+	
+	//! Position of an offset's entry among the file's, -1 if it's out of the file
+	std::int64_t slotOf(long offset) const;
+	
+	//! Entry of the block directory for an offset
+	/*!
+	 * Each id's entry has the block index of its compressed entry in the
+	 * upper 48 bits, and its place in the block in the lower 16.
+	 *
+	 * @return The directory entry, HASHFILE_NO_ENTRY if there's no entry at
+	 * the offset or the directory couldn't be read
+	 */
+	std::uint64_t directoryEntry(long offset) const;
+	
+	//! Reads the dictionary of a compressed file and locates its block directory
+	bool loadCompressed(const HashfileHeader& header);
+};
+
+#endif // _HASHFILE_HPP_INCLUDED_
@@ -1,44 +1,143 @@
 #ifndef _IDEALBTREE_HPP_INCLUDED_
 #define _IDEALBTREE_HPP_INCLUDED_
 
-#include "BTree.hpp"
+#include "BEpsilonTree.hpp"
+#include "BPlusTree.hpp"
 
-//! Auxiliary function to calculate the max order of a BTree to store T-type values
+//! Auxiliary function to calculate the max order of the internal nodes of a BPlusTree
 /*!
  * The calculation is done based on BlockSize, the result being the max order
  * you can have for your tree without having your node exceed BlockSize in
- * bytes.
+ * bytes. Internal nodes are laid out without padding between their members,
+ * and only store keys and children:
  *
- * We arrived at it through the following initial formula:
+ * `BlockSize = sizeof(NodeHeader) + (2 * MI + 1) * sizeof(long) + 2 * MI * sizeof(Key)`
  *
- * `BlockSize = sizeof(long) + sizeof(bool) + sizeof(std::size_t) + (2 * M + 1) * sizeof(T) + (2 * M + 2) * sizeof(long)`
+ * Order-statistic trees also keep a `std::size_t` count per child. The order
+ * is also limited by what NodeHeader::size can count.
  *
- * This formula takes into account the size of members of a BTree::BNode.
+ * @tparam Key Type of the separators
+ * @tparam BlockSize Size in bytes
+ * @tparam Counted True if the tree keeps subtree counts
+ *
+ * @return Calculation result
+ */
+template <typename Key, unsigned int BlockSize, bool Counted = false>
+constexpr auto maxBPlusTreeInternalOrder() {
+	constexpr auto child = sizeof(long) + (Counted? sizeof(std::size_t) : 0);
+	constexpr auto c = sizeof(NodeHeader<BlockSize>) + child;
+	static_assert(c < BlockSize, "B+ tree internal order will be negative, consider increasing blockSize");
+	
+	constexpr auto M = (BlockSize - c) / (2 * (sizeof(Key) + child));
+	static_assert(M >= 1, "Type Key too big, consider increasing blockSize");
+	
+	return M < NODE_MAX_SIZE / 2? M : NODE_MAX_SIZE / 2;
+}
+
+//! Space left for the values in a leaf of a BPlusTree
+/*!
+ * Leaves store values and the offset of the next leaf, but no children:
+ *
+ * `BlockSize = sizeof(NodeHeader) + sizeof(long) + leafBytes`
+ *
+ * Encoded leaf layouts such as DeltaLeaf take exactly this many bytes.
  *
- * @tparam T Type that will be stored in BTree
+ * @tparam BlockSize Size in bytes
+ *
+ * @return Calculation result
+ */
+template <unsigned int BlockSize>
+constexpr std::size_t maxBPlusTreeLeafBytes() {
+	constexpr auto c = sizeof(NodeHeader<BlockSize>) + sizeof(long);
+	static_assert(c < BlockSize, "B+ tree leaves will have no room, consider increasing blockSize");
+	
+	return BlockSize - c;
+}
+
+//! Auxiliary function to calculate the max quantity of T-type values in a PlainLeaf
+/*!
+ * @tparam T Type that will be stored in BPlusTree
  * @tparam BlockSize Size in bytes
  *
  * @return Calculation result
  */
 template <typename T, unsigned int BlockSize>
-constexpr auto maxBTreeOrder() {
-	constexpr auto c = 3 * sizeof(long) + sizeof(bool) + sizeof(std::size_t) + sizeof(T);
-	static_assert(c < BlockSize, "B-tree order will be negative, consider increasing blockSize");
+constexpr auto maxPlainLeafCapacity() {
+	constexpr auto capacity = maxBPlusTreeLeafBytes<BlockSize>() / sizeof(T);
+	static_assert(capacity >= 2, "Type T too big, consider increasing blockSize");
+	
+	return capacity < NODE_MAX_SIZE? capacity : NODE_MAX_SIZE;
+}
+
+//! BPlusTree with ideal pre-calculated orders for both kinds of node
+/*!
+ * @tparam T Type to be stored
+ * @tparam Key Type of the separators, see BPlusTree
+ * @tparam KeyOf Functor returning the key of a value, see BPlusTree
+ * @tparam BlockSize %Block size in bytes
+ * @tparam Counted True for an order-statistic tree, see BPlusTree
+ * @tparam Leaf Leaf layout, see BPlusTree. By default, values are stored as
+ * they are, as many as fit in a block.
+ */
+template <typename T, typename Key, typename KeyOf, unsigned int BlockSize = BLOCK_SIZE, bool Counted = false,
+	typename Leaf = PlainLeaf<T, maxPlainLeafCapacity<T, BlockSize>()>>
+using IdealBPlusTree = BPlusTree<T, Key, KeyOf,
+	maxBPlusTreeInternalOrder<Key, BlockSize, Counted>(), Leaf, BlockSize, Counted>;
 
-	constexpr auto M = (BlockSize - c) / (2 * (sizeof(T) + sizeof(long)));
-	static_assert(M >= 1, "Type T too big, consider increasing blockSize");
+//! Auxiliary function to calculate the internal node order of a BEpsilonTree
+/*!
+ * Internal nodes give about the square root of their room to separators and
+ * children (epsilon = 1/2), and the rest to the buffer. With half as many
+ * levels' worth of fanout, the tree is about twice as tall as a BPlusTree,
+ * but each value moved down a level takes a fraction of a block write.
+ *
+ * @tparam Key Type of the separators
+ * @tparam BlockSize Size in bytes
+ *
+ * @return Calculation result
+ */
+template <typename Key, unsigned int BlockSize>
+constexpr std::size_t bEpsilonTreeOrder() {
+	constexpr auto children = 2 * maxBPlusTreeInternalOrder<Key, BlockSize>() + 1;
+	
+	std::size_t root = 1;
+	while ((root + 1) * (root + 1) <= children) ++root;
+	
+	return root / 2 > 1? root / 2 : 1;
+}
 
-	return M;
+//! Auxiliary function to calculate the buffer size of a BEpsilonTree's internal nodes
+/*!
+ * The buffer takes whatever the separators and children leave of the block:
+ *
+ * `BlockSize = sizeof(NodeHeader) + sizeof(std::uint64_t) + (2 * MI + 1) * sizeof(long) + 2 * MI * sizeof(Key) + BufferCapacity * sizeof(T)`
+ *
+ * @tparam T Type that will be stored in BEpsilonTree
+ * @tparam Key Type of the separators
+ * @tparam MI Internal node order
+ * @tparam BlockSize Size in bytes
+ *
+ * @return Calculation result
+ */
+template <typename T, typename Key, std::size_t MI, unsigned int BlockSize>
+constexpr std::size_t bEpsilonTreeBufferCapacity() {
+	constexpr auto c = sizeof(NodeHeader<BlockSize>) + sizeof(std::uint64_t) + (2 * MI + 1) * sizeof(long) + 2 * MI * sizeof(Key);
+	static_assert(c + sizeof(T) <= BlockSize, "B-epsilon tree buffer would be empty, consider increasing blockSize");
+	
+	return (BlockSize - c) / sizeof(T);
 }
 
-//! BTree with ideal pre-calculated M order based on `sizeof(T)`
+//! BEpsilonTree with pre-calculated order and buffer size
 /*!
- * The nodes of such a BTree will be making the most out of their block space
- * 
  * @tparam T Type to be stored
+ * @tparam Key Type of the separators, see BPlusTree
+ * @tparam KeyOf Functor returning the key of a value, see BPlusTree
  * @tparam BlockSize %Block size in bytes
  */
-template <typename T, unsigned int BlockSize = BLOCK_SIZE>
-using IdealBTree = BTree<T, maxBTreeOrder<T, BlockSize>(), BlockSize>;
+template <typename T, typename Key, typename KeyOf, unsigned int BlockSize = BLOCK_SIZE>
+using IdealBEpsilonTree = BEpsilonTree<T, Key, KeyOf,
+	bEpsilonTreeOrder<Key, BlockSize>(),
+	bEpsilonTreeBufferCapacity<T, Key, bEpsilonTreeOrder<Key, BlockSize>(), BlockSize>(),
+	PlainLeaf<T, maxPlainLeafCapacity<T, BlockSize>()>, BlockSize>;
 
 #endif //_IDEALBTREE_HPP_INCLUDED_
@@ -0,0 +1,184 @@
+#ifndef _LEAFLAYOUT_HPP_INCLUDED_
+#define _LEAFLAYOUT_HPP_INCLUDED_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "NodeLayout.hpp"
+
+//! Leaf layout of a BPlusTree which stores the values as they are
+/*!
+ * BPlusTree stores the values of a leaf through a layout type, so that leaves
+ * can be encoded differently from the values themselves (see DeltaLeaf).
+ * Every layout has the same members as this one. The quantity of values in
+ * the leaf is kept in its NodeHeader, so it's passed to most of them as `n`.
+ *
+ * @tparam T Type of the values
+ * @tparam LeafCapacity Quantity of values that fit in a leaf
+ */
+template <typename T, std::size_t LeafCapacity>
+struct PlainLeaf {
+	//! Maximum quantity of values in a leaf
+	static constexpr std::size_t Capacity = LeafCapacity;
+	
+	T values[LeafCapacity]; //!< Values, sorted
+	
+	//! Value at a position
+	const T& value(std::size_t i) const { return values[i]; }
+	
+	//! Position of the first value that isn't less than a key
+	template <typename U>
+	std::size_t lowerBound(const U& key, std::size_t n) const;
+	
+	//! Position of the first value that's greater than a key
+	template <typename U>
+	std::size_t upperBound(const U& key, std::size_t n) const;
+	
+	//! Copies all the values to an array
+	/*!
+	 * @param n Quantity of values in the leaf
+	 * @param out Array with room for n values
+	 */
+	void decode(std::size_t n, T *out) const;
+	
+	//! Checks if a sorted sequence of values fits in a leaf
+	static bool fits(const T *values, std::size_t n);
+	
+	//! Replaces the contents of the leaf with a sorted sequence of values
+	/*!
+	 * @return False if they don't fit, in which case the leaf is unchanged
+	 */
+	bool assign(const T *values, std::size_t n);
+	
+	//! Inserts a value at a position
+	/*!
+	 * @param n Quantity of values in the leaf
+	 * @param i Position of the new value, which must keep the leaf sorted
+	 * @param value Value to insert
+	 *
+	 * @return False if the value doesn't fit, in which case the leaf is
+	 * unchanged and must be split
+	 */
+	bool insert(std::size_t n, std::size_t i, const T& value);
+};
+
+//! Leaf layout of a BPlusTree with integer keys, frame-of-reference encoded
+/*!
+ * Keys are stored as their difference to the smallest key in the leaf (the
+ * frame of reference), bit-packed with as many bits as the biggest difference
+ * needs. Leaves of nearly consecutive keys take a dozen bits per value
+ * instead of a whole value.
+ *
+ * Each value also has a payload, such as the offset of an entry. Payloads
+ * which can be derived from the key aren't stored at all; only the others are
+ * kept, as exceptions at the end of the leaf.
+ *
+ * Unlike PlainLeaf, the quantity of values that fit in a leaf depends on the
+ * values, so leaves are split when the next value doesn't fit rather than at
+ * a fixed size. Values can't be changed in place, so BPlusTree::insertOrMerge
+ * isn't available with this layout.
+ *
+ * @tparam T Type of the values
+ *
+ * @tparam Codec Type with static members describing the values:
+ * `std::int64_t key(const T&)`, `long payload(const T&)`,
+ * `long derivedPayload(std::int64_t key)` and
+ * `T make(std::int64_t key, long payload)`. Differences between the keys in a
+ * leaf must fit in 32 bits.
+ *
+ * @tparam Bytes Space taken by the leaf, in bytes
+ */
+template <typename T, typename Codec, std::size_t Bytes>
+struct DeltaLeaf {
+	//! Space for the packed differences and the exceptions
+	static constexpr std::size_t DataSize = Bytes - sizeof(std::int64_t) - 2 * sizeof(std::uint16_t);
+	
+	//! Space taken by an exception: the position of the value and its payload
+	static constexpr std::size_t ExceptionSize = sizeof(std::uint16_t) + sizeof(long);
+	
+	//! Maximum quantity of values in a leaf, when all of them have the same key
+	static constexpr std::size_t Capacity = NODE_MAX_SIZE;
+	
+	std::int64_t base; //!< Smallest key in the leaf
+	std::uint16_t width; //!< Bits taken by each difference
+	std::uint16_t exceptionCount; //!< Quantity of payloads that aren't derived from the key
+	
+	//! Packed differences from the beginning, exceptions from the end backwards
+	/*!
+	 * The last 8 bytes before the exceptions are always left unused, so that a
+	 * difference can be read with a single unaligned 64-bit load.
+	 */
+	unsigned char data[DataSize];
+	
+	//! Value at a position
+	T value(std::size_t i) const;
+	
+	//! Position of the first value that isn't less than a key
+	template <typename U>
+	std::size_t lowerBound(const U& key, std::size_t n) const;
+	
+	//! Position of the first value that's greater than a key
+	template <typename U>
+	std::size_t upperBound(const U& key, std::size_t n) const;
+	
+	//! Decodes all the values to an array
+	/*!
+	 * The differences are unpacked in a single pass, and the exceptions
+	 * patched in afterwards.
+	 *
+	 * @param n Quantity of values in the leaf
+	 * @param out Array with room for n values
+	 */
+	void decode(std::size_t n, T *out) const;
+	
+	//! Checks if a sorted sequence of values fits in a leaf
+	static bool fits(const T *values, std::size_t n);
+	
+	//! Replaces the contents of the leaf with a sorted sequence of values
+	/*!
+	 * @return False if they don't fit, in which case the leaf is unchanged
+	 */
+	bool assign(const T *values, std::size_t n);
+	
+	//! Inserts a value at a position
+	/*!
+	 * Appending a value whose difference fits in the current width only
+	 * writes its bits; any other insertion encodes the whole leaf again.
+	 *
+	 * @return False if the value doesn't fit, in which case the leaf is
+	 * unchanged and must be split
+	 */
+	bool insert(std::size_t n, std::size_t i, const T& value);
+
+private:
+	//! Bits needed to represent a difference
+	static unsigned int bitsFor(std::uint64_t difference);
+	
+	//! Checks if the given quantities of values and exceptions fit in a leaf
+	static bool fits(std::size_t n, unsigned int width, std::size_t exceptions);
+	
+	//! Difference of the key at a position to the base
+	std::uint64_t difference(std::size_t i) const;
+	
+	//! Writes the difference of the key at a position
+	void setDifference(std::size_t i, std::uint64_t difference);
+	
+	//! Offset in DeltaLeaf::data of an exception
+	static std::size_t exceptionOffset(std::size_t k);
+	
+	//! Position of the value an exception belongs to
+	std::size_t exceptionPosition(std::size_t k) const;
+	
+	//! Payload of an exception
+	long exceptionPayload(std::size_t k) const;
+	
+	//! Writes an exception
+	void setException(std::size_t k, std::size_t position, long payload);
+	
+	//! Payload of the value at a position
+	long payload(std::size_t i, std::int64_t key) const;
+};
+
+#include "LeafLayout.inl"
+
+#endif // _LEAFLAYOUT_HPP_INCLUDED_
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// --- //
+
+template <typename T, std::size_t LeafCapacity>
+template <typename U>
+std::size_t PlainLeaf<T, LeafCapacity>::lowerBound(const U& key, std::size_t n) const {
+	return std::lower_bound(values, values + n, key) - values;
+}
+
+template <typename T, std::size_t LeafCapacity>
+template <typename U>
+std::size_t PlainLeaf<T, LeafCapacity>::upperBound(const U& key, std::size_t n) const {
+	return std::upper_bound(values, values + n, key) - values;
+}
+
+template <typename T, std::size_t LeafCapacity>
+void PlainLeaf<T, LeafCapacity>::decode(std::size_t n, T *out) const {
+	std::copy(values, values + n, out);
+}
+
+template <typename T, std::size_t LeafCapacity>
+bool PlainLeaf<T, LeafCapacity>::fits(const T*, std::size_t n) {
+	return n <= LeafCapacity;
+}
+
+template <typename T, std::size_t LeafCapacity>
+bool PlainLeaf<T, LeafCapacity>::assign(const T *values, std::size_t n) {
+	if (n > LeafCapacity) return false;
+	
+	std::copy(values, values + n, this->values);
+	return true;
+}
+
+template <typename T, std::size_t LeafCapacity>
+bool PlainLeaf<T, LeafCapacity>::insert(std::size_t n, std::size_t i, const T& value) {
+	if (n >= LeafCapacity) return false;
+	
+	for (auto j = n; i < j; --j) {
+		values[j] = values[j - 1];
+	}
+	
+	values[i] = value;
+	return true;
+}
+
+// --- //
+
+template <typename T, typename Codec, std::size_t Bytes>
+T DeltaLeaf<T, Codec, Bytes>::value(std::size_t i) const {
+	auto key = base + static_cast<std::int64_t>(difference(i));
+	return Codec::make(key, payload(i, key));
+}
+
+template <typename T, typename Codec, std::size_t Bytes>
+template <typename U>
+std::size_t DeltaLeaf<T, Codec, Bytes>::lowerBound(const U& key, std::size_t n) const {
+	std::size_t lo = 0;
+	
+	while (n > 0) {
+		auto half = n / 2;
+		
+		if (value(lo + half) < key) {
+			lo += half + 1;
+			n -= half + 1;
+		}
+		else {
+			n = half;
+		}
+	}
+	
+	return lo;
+}
+
+template <typename T, typename Codec, std::size_t Bytes>
+template <typename U>
+std::size_t DeltaLeaf<T, Codec, Bytes>::upperBound(const U& key, std::size_t n) const {
+	std::size_t lo = 0;
+	
+	while (n > 0) {
+		auto half = n / 2;
+		
+		if (!(key < value(lo + half))) {
+			lo += half + 1;
+			n -= half + 1;
+		}
+		else {
+			n = half;
+		}
+	}
+	
+	return lo;
+}
+
+template <typename T, typename Codec, std::size_t Bytes>
+void DeltaLeaf<T, Codec, Bytes>::decode(std::size_t n, T *out) const {
+	for (std::size_t i = 0; i < n; ++i) {
+		auto key = base + static_cast<std::int64_t>(difference(i));
+		out[i] = Codec::make(key, Codec::derivedPayload(key));
+	}
+	
+	for (std::size_t k = 0; k < exceptionCount; ++k) {
+		auto i = exceptionPosition(k);
+		out[i] = Codec::make(Codec::key(out[i]), exceptionPayload(k));
+	}
+}
+
+template <typename T, typename Codec, std::size_t Bytes>
+bool DeltaLeaf<T, Codec, Bytes>::fits(const T *values, std::size_t n) {
+	if (n == 0) return true;
+	
+	auto first = Codec::key(values[0]);
+	std::size_t exceptions = 0;
+	
+	for (std::size_t i = 0; i < n; ++i) {
+		if (Codec::payload(values[i]) != Codec::derivedPayload(Codec::key(values[i]))) ++exceptions;
+	}
+	
+	return fits(n, bitsFor(Codec::key(values[n - 1]) - first), exceptions);
+}
+
+template <typename T, typename Codec, std::size_t Bytes>
+bool DeltaLeaf<T, Codec, Bytes>::assign(const T *values, std::size_t n) {
+	if (!fits(values, n)) return false;
+	
+	base = n? Codec::key(values[0]) : 0;
+	width = n? bitsFor(Codec::key(values[n - 1]) - base) : 0;
+	exceptionCount = 0;
+	
+	for (std::size_t i = 0; i < n; ++i) {
+		auto key = Codec::key(values[i]);
+		auto payload = Codec::payload(values[i]);
+		
+		setDifference(i, key - base);
+		if (payload != Codec::derivedPayload(key)) setException(exceptionCount++, i, payload);
+	}
+	
+	return true;
+}
+
+template <typename T, typename Codec, std::size_t Bytes>
+bool DeltaLeaf<T, Codec, Bytes>::insert(std::size_t n, std::size_t i, const T& value) {
+	auto key = Codec::key(value);
+	auto payload = Codec::payload(value);
+	
+	// Values are mostly appended in key order, which doesn't change the
+	// base, and changes neither the width nor the other exceptions as long as
+	// the difference fits
+	if (n > 0 && i == n && bitsFor(key - base) <= width) {
+		bool exception = payload != Codec::derivedPayload(key);
+		if (!fits(n + 1, width, exceptionCount + exception)) return false;
+		
+		setDifference(n, key - base);
+		if (exception) setException(exceptionCount++, n, payload);
+		return true;
+	}
+	
+	// An empty leaf's header may be left over from whatever the block held
+	if (n == 0) return assign(&value, 1);
+	
+	std::vector<T> values(n + 1);
+	decode(n, values.data());
+	
+	std::copy_backward(values.begin() + i, values.begin() + n, values.end());
+	values[i] = value;
+	
+	return assign(values.data(), n + 1);
+}
+
+template <typename T, typename Codec, std::size_t Bytes>
+unsigned int DeltaLeaf<T, Codec, Bytes>::bitsFor(std::uint64_t difference) {
+	unsigned int bits = 0;
+	
+	while (difference) {
+		++bits;
+		difference >>= 1;
+	}
+	
+	return bits;
+}
+
+template <typename T, typename Codec, std::size_t Bytes>
+bool DeltaLeaf<T, Codec, Bytes>::fits(std::size_t n, unsigned int width, std::size_t exceptions) {
+	return n <= NODE_MAX_SIZE && width <= 32
+		&& (n * width + 7) / 8 + sizeof(std::uint64_t) + exceptions * ExceptionSize <= DataSize;
+}
+
+template <typename T, typename Codec, std::size_t Bytes>
+std::uint64_t DeltaLeaf<T, Codec, Bytes>::difference(std::size_t i) const {
+	auto bit = i * width;
+	std::uint64_t word;
+	std::memcpy(&word, data + bit / 8, sizeof(word));
+	
+	return (word >> (bit % 8)) & ((std::uint64_t(1) << width) - 1);
+}
+
+template <typename T, typename Codec, std::size_t Bytes>
+void DeltaLeaf<T, Codec, Bytes>::setDifference(std::size_t i, std::uint64_t difference) {
+	auto bit = i * width;
+	auto mask = ((std::uint64_t(1) << width) - 1) << (bit % 8);
+	
+	std::uint64_t word;
+	std::memcpy(&word, data + bit / 8, sizeof(word));
+	word = (word & ~mask) | (difference << (bit % 8) & mask);
+	std::memcpy(data + bit / 8, &word, sizeof(word));
+}
+
+template <typename T, typename Codec, std::size_t Bytes>
+std::size_t DeltaLeaf<T, Codec, Bytes>::exceptionOffset(std::size_t k) {
+	return DataSize - (k + 1) * ExceptionSize;
+}
+
+template <typename T, typename Codec, std::size_t Bytes>
+std::size_t DeltaLeaf<T, Codec, Bytes>::exceptionPosition(std::size_t k) const {
+	std::uint16_t position;
+	std::memcpy(&position, data + exceptionOffset(k), sizeof(position));
+	return position;
+}
+
+template <typename T, typename Codec, std::size_t Bytes>
+long DeltaLeaf<T, Codec, Bytes>::exceptionPayload(std::size_t k) const {
+	long payload;
+	std::memcpy(&payload, data + exceptionOffset(k) + sizeof(std::uint16_t), sizeof(payload));
+	return payload;
+}
+
+template <typename T, typename Codec, std::size_t Bytes>
+void DeltaLeaf<T, Codec, Bytes>::setException(std::size_t k, std::size_t position, long payload) {
+	auto p = static_cast<std::uint16_t>(position);
+	std::memcpy(data + exceptionOffset(k), &p, sizeof(p));
+	std::memcpy(data + exceptionOffset(k) + sizeof(p), &payload, sizeof(payload));
+}
+
+template <typename T, typename Codec, std::size_t Bytes>
+long DeltaLeaf<T, Codec, Bytes>::payload(std::size_t i, std::int64_t key) const {
+	// Exceptions are sorted by position
+	std::size_t lo = 0;
+	std::size_t hi = exceptionCount;
+	
+	while (lo < hi) {
+		auto mid = (lo + hi) / 2;
+		auto position = exceptionPosition(mid);
+		
+		if (position == i) return exceptionPayload(mid);
+		else if (position < i) lo = mid + 1;
+		else hi = mid;
+	}
+	
+	return Codec::derivedPayload(key);
+}
@@ -0,0 +1,254 @@
+#ifndef _LSMTREE_HPP_INCLUDED_
+#define _LSMTREE_HPP_INCLUDED_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BlockCache.hpp"
+#include "BloomFilter.hpp"
+#include "ExternalSorter.hpp"
+
+//! Default quantity of values kept in memory by an LsmTree before they're written as a run
+#define LSM_MEMTABLE_CAPACITY 65536
+
+//! Default quantity of runs an LsmTree can have before they're compacted
+#define LSM_MAX_RUNS 4
+
+//! False-positive rate of the filter of each run of an LsmTree
+#define LSM_RUN_FALSE_POSITIVE_RATE 0.01
+
+//! Log-structured merge tree over immutable BPlusTree runs
+/*!
+ * Meant for indexes that keep receiving values after being built. Inserted
+ * values go to a sorted table in memory (the memtable). Once it's full, it's
+ * written as a new run: a BPlusTree built bottom-up with BPlusTree::bulkLoad,
+ * fully packed and never changed afterwards. Inserting costs no block reads at
+ * all, and writing a run is sequential.
+ *
+ * Lookups check the memtable and then the runs from the newest to the oldest,
+ * so a value inserted again replaces the previous one. Each run has a
+ * BloomFilter, so runs that don't hold the key are usually skipped without
+ * reading them.
+ *
+ * When there are too many runs, they're compacted into a single one on a
+ * background thread: every run is merged, keeping only the newest value for
+ * each key, while lookups and insertions carry on with the runs as they were.
+ *
+ * The runs in use are listed in a manifest file, `<prefix>.manifest`, which
+ * is replaced as a whole each time it changes. Runs are written to
+ * `<prefix>-<number>.bin`, with their filters in `<prefix>-<number>.bloom`.
+ *
+ * Example usage:
+ * \code
+ * LsmTree<IdealBPlusTree<Record, int, RecordId>, RecordIdHash> lsm;
+ * lsm.open("records");
+ * lsm.insert({ 1, 4096 });
+ * auto x = lsm.seek(1);
+ * lsm.close();
+ * \endcode
+ *
+ * @tparam Tree Type of the runs. Must be a BPlusTree; its values must have
+ * unique keys.
+ *
+ * @tparam Hash Functor type returning an `std::uint64_t` hash of a key, used
+ * for the runs' filters. Must accept the values as well as the keys that will
+ * be sought, and hash a value the same as its key.
+ */
+template <typename Tree, typename Hash>
+class LsmTree {
+public:
+	//! Type of the stored values
+	typedef typename Tree::ValueType ValueType;
+	
+	//! LsmTree usage analytics
+	struct Statistics {
+		std::uint64_t runsSearched; //!< Quantity of runs read by lookups
+		std::uint64_t runsSkipped; //!< Quantity of runs skipped by lookups thanks to their filters
+		std::uint64_t blocksRead; //!< Quantity of blocks read from the runs by lookups
+		std::uint64_t flushes; //!< Quantity of runs written from the memtable
+		std::uint64_t compactions; //!< Quantity of compactions finished
+	};
+	
+	//! Creates an LsmTree without opening any file
+	/*!
+	 * @param memtableCapacity Quantity of values kept in memory before they're
+	 * written as a run
+	 * @param maxRuns Quantity of runs that triggers a compaction when exceeded
+	 */
+	explicit LsmTree(std::size_t memtableCapacity = LSM_MEMTABLE_CAPACITY, std::size_t maxRuns = LSM_MAX_RUNS);
+	
+	//! Destructor
+	/*! Same as LsmTree::close */
+	~LsmTree();
+	
+	LsmTree(const LsmTree&) = delete;
+	LsmTree& operator= (const LsmTree&) = delete;
+	
+	//! Makes the runs read by lookups use the provided cache
+	/*!
+	 * Compactions don't use it, since the cache can't be shared between
+	 * threads. The run a compaction writes is opened without it too, and
+	 * opened again with it by the next lookup, flush or
+	 * LsmTree::waitForCompaction, on the thread using the LsmTree.
+	 *
+	 * @param cache Cache to use, or null to go through stdio
+	 */
+	void useCache(BlockCache *cache);
+	
+	//! Opens the runs listed in a manifest, or starts an empty one
+	/*!
+	 * @param prefix Path of the files without their extension
+	 *
+	 * @return False if a run listed in the manifest couldn't be opened
+	 */
+	bool open(const std::string& prefix);
+	
+	//! Writes the memtable as a run and waits for compaction to finish
+	/*!
+	 * @return False if the memtable couldn't be written
+	 */
+	bool close();
+	
+	//! Inserts a value, replacing the value with the same key if there's one
+	/*!
+	 * Writes the memtable as a run if it's full.
+	 *
+	 * @param value Value to insert
+	 *
+	 * @return False if the memtable had to be written and couldn't be
+	 */
+	bool insert(const ValueType& value);
+	
+	//! Seeks the newest value with the provided key
+	/*!
+	 * @tparam U Type of the key to seek, see BPlusTree::seek
+	 *
+	 * @param key Key to seek
+	 *
+	 * @return Pointer with the value if found, null otherwise
+	 */
+	template <typename U>
+	std::unique_ptr<ValueType> seek(const U& key);
+	
+	//! Writes the memtable as a new run, even if it isn't full
+	/*!
+	 * Starts a compaction if there are too many runs afterwards.
+	 *
+	 * @return False if the run couldn't be written
+	 */
+	bool flush();
+	
+	//! Waits for the compaction in progress, if there's one
+	void waitForCompaction();
+	
+	//! Quantity of runs in use
+	std::size_t runCount() const;
+	
+	//! Quantity of values in the memtable
+	std::size_t memtableSize() const;
+	
+	//! Returns the LsmTree usage statistics so far
+	Statistics getStatistics() const;
+	
+	//! Removes the manifest and the runs it lists
+	/*!
+	 * @param prefix Path of the files without their extension, as given to
+	 * LsmTree::open
+	 */
+	static void remove(const std::string& prefix);
+
+private:
+	//! Value of a run being compacted, with the age of its run
+	struct Versioned {
+		ValueType value; //!< Value
+		unsigned int age; //!< 0 for the newest run, bigger for older ones
+	};
+	
+	//! Order of the values being compacted: by key, then newest first
+	struct VersionOrder {
+		bool operator() (const Versioned& a, const Versioned& b) const {
+			return a.value < b.value || (!(b.value < a.value) && a.age < b.age);
+		}
+	};
+	
+	//! Immutable run
+	struct Run {
+		unsigned int number; //!< Number in the run's filenames
+		Tree tree; //!< Run's tree, open for reading
+		BloomFilter filter; //!< Filter of the run's keys
+	};
+	
+	std::string m_prefix; //!< Path of the files without their extension
+	std::size_t m_memtableCapacity; //!< Quantity of values that fill the memtable
+	std::size_t m_maxRuns; //!< Quantity of runs that triggers a compaction when exceeded
+	BlockCache *m_cache; //!< Cache used by lookups, if any
+	
+	std::set<ValueType, std::less<>> m_memtable; //!< Values not yet written to a run, searchable by key
+	
+	mutable std::mutex m_mutex; //!< Guards the members below, shared with the compaction thread
+	std::vector<std::shared_ptr<Run>> m_runs; //!< Runs in use, oldest first
+	std::vector<std::shared_ptr<Run>> m_retired; //!< Runs replaced by a compaction, to be closed by the thread using the cache
+	std::shared_ptr<Run> m_merged; //!< Run written by the last compaction, to be opened with the cache by the thread using it
+	unsigned int m_nextRun; //!< Number of the next run to be written
+	Statistics m_stats; //!< Where LsmTree stores its statistics
+	
+	std::thread m_compaction; //!< Thread of the last compaction started
+	std::atomic<bool> m_compacting; //!< True while a compaction is in progress
+	
+	//! Filepath of a run's tree
+	static std::string runFilepath(const std::string& prefix, unsigned int number);
+	
+	//! Filepath of a run's filter
+	static std::string filterFilepath(const std::string& prefix, unsigned int number);
+	
+	//! Writes the manifest with the runs currently in use
+	/*!
+	 * Must be called with LsmTree::m_mutex held.
+	 *
+	 * @return False if it couldn't be written
+	 */
+	bool writeManifest() const;
+	
+	//! Opens a run that's already written
+	/*!
+	 * @return Null if the run couldn't be opened
+	 */
+	std::shared_ptr<Run> openRun(unsigned int number, BlockCache *cache) const;
+	
+	//! Writes a run and its filter from values in order
+	/*!
+	 * @tparam Next See BPlusTree::bulkLoad
+	 *
+	 * @return False if the files couldn't be written
+	 */
+	template <typename Next>
+	bool writeRun(unsigned int number, Next next) const;
+	
+	//! Takes over, on the thread using the cache, what the last compaction left
+	/*!
+	 * Closes the runs it replaced, and opens the run it wrote again with the
+	 * cache, in place of the one it opened without.
+	 */
+	void settleCompaction();
+	
+	//! Merges every run in a snapshot into a single one
+	/*!
+	 * Runs on the compaction thread. Runs written meanwhile are kept after the
+	 * merged run, since they're newer.
+	 *
+	 * @param snapshot Runs to merge, oldest first
+	 */
+	void compact(std::vector<std::shared_ptr<Run>> snapshot);
+};
+
+#include "LsmTree.inl"
+
+#endif // _LSMTREE_HPP_INCLUDED_
@@ -0,0 +1,361 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+template <typename Tree, typename Hash>
+LsmTree<Tree, Hash>::LsmTree(std::size_t memtableCapacity, std::size_t maxRuns)
+	: m_memtableCapacity(memtableCapacity), m_maxRuns(maxRuns), m_cache(nullptr), m_nextRun(0),
+	m_stats({ 0, 0, 0, 0, 0 }), m_compacting(false)
+{	}
+
+template <typename Tree, typename Hash>
+LsmTree<Tree, Hash>::~LsmTree() {
+	close();
+}
+
+template <typename Tree, typename Hash>
+void LsmTree<Tree, Hash>::useCache(BlockCache *cache) {
+	m_cache = cache;
+}
+
+template <typename Tree, typename Hash>
+bool LsmTree<Tree, Hash>::open(const std::string& prefix) {
+	close();
+	
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_prefix = prefix;
+	m_runs.clear();
+	m_nextRun = 0;
+	
+	// Without a manifest, there are no runs yet
+	std::FILE *manifest = std::fopen((prefix + ".manifest").c_str(), "rb");
+	if (!manifest) return true;
+	
+	std::uint32_t nextRun, number;
+	bool valid = std::fread(&nextRun, sizeof(nextRun), 1, manifest) == 1;
+	
+	while (valid && std::fread(&number, sizeof(number), 1, manifest) == 1) {
+		auto run = openRun(number, m_cache);
+		
+		if (run) m_runs.push_back(run);
+		else valid = false;
+	}
+	
+	std::fclose(manifest);
+	
+	m_nextRun = nextRun;
+	return valid;
+}
+
+template <typename Tree, typename Hash>
+bool LsmTree<Tree, Hash>::close() {
+	if (m_prefix.empty()) return true;
+	
+	bool flushed = flush();
+	waitForCompaction();
+	
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_runs.clear();
+	m_prefix.clear();
+	
+	return flushed;
+}
+
+template <typename Tree, typename Hash>
+bool LsmTree<Tree, Hash>::insert(const ValueType& value) {
+	auto it = m_memtable.find(value);
+	if (it != m_memtable.end()) m_memtable.erase(it);
+	
+	m_memtable.insert(value);
+	
+	if (m_memtable.size() >= m_memtableCapacity) return flush();
+	return true;
+}
+
+template <typename Tree, typename Hash>
+template <typename U>
+std::unique_ptr<typename LsmTree<Tree, Hash>::ValueType> LsmTree<Tree, Hash>::seek(const U& key) {
+	auto it = m_memtable.find(key);
+	if (it != m_memtable.end()) return std::make_unique<ValueType>(*it);
+	
+	settleCompaction();
+	
+	std::vector<std::shared_ptr<Run>> runs;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		runs = m_runs;
+	}
+	
+	auto hash = Hash()(key);
+	unsigned int searched = 0, skipped = 0, blocksRead = 0;
+	std::unique_ptr<ValueType> found;
+	
+	for (auto run = runs.rbegin(); run != runs.rend() && !found; ++run) {
+		if (!(*run)->filter.mayContain(hash)) {
+			++skipped;
+			continue;
+		}
+		
+		++searched;
+		auto before = (*run)->tree.getStatistics().blocksRead;
+		
+		found = (*run)->tree.seek(key);
+		if (!found) (*run)->filter.reportFalsePositive();
+		
+		blocksRead += (*run)->tree.getStatistics().blocksRead - before;
+	}
+	
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.runsSearched += searched;
+	m_stats.runsSkipped += skipped;
+	m_stats.blocksRead += blocksRead;
+	
+	return found;
+}
+
+template <typename Tree, typename Hash>
+bool LsmTree<Tree, Hash>::flush() {
+	if (m_memtable.empty()) return true;
+	
+	unsigned int number;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		number = m_nextRun++;
+	}
+	
+	auto value = m_memtable.begin();
+	bool written = writeRun(number, [&](ValueType& next) {
+		if (value == m_memtable.end()) return false;
+		
+		next = *value++;
+		return true;
+	});
+	
+	auto run = written? openRun(number, m_cache) : nullptr;
+	if (!run) return false;
+	
+	m_memtable.clear();
+	settleCompaction();
+	
+	std::vector<std::shared_ptr<Run>> snapshot;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_runs.push_back(run);
+		++m_stats.flushes;
+		
+		if (!writeManifest()) return false;
+		if (m_runs.size() > m_maxRuns && !m_compacting) snapshot = m_runs;
+	}
+	
+	if (!snapshot.empty()) {
+		if (m_compaction.joinable()) m_compaction.join();
+		
+		m_compacting = true;
+		m_compaction = std::thread(&LsmTree::compact, this, snapshot);
+	}
+	
+	return true;
+}
+
+template <typename Tree, typename Hash>
+void LsmTree<Tree, Hash>::waitForCompaction() {
+	if (m_compaction.joinable()) m_compaction.join();
+	settleCompaction();
+}
+
+template <typename Tree, typename Hash>
+std::size_t LsmTree<Tree, Hash>::runCount() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_runs.size();
+}
+
+template <typename Tree, typename Hash>
+std::size_t LsmTree<Tree, Hash>::memtableSize() const {
+	return m_memtable.size();
+}
+
+template <typename Tree, typename Hash>
+typename LsmTree<Tree, Hash>::Statistics LsmTree<Tree, Hash>::getStatistics() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+template <typename Tree, typename Hash>
+void LsmTree<Tree, Hash>::remove(const std::string& prefix) {
+	auto manifestPath = prefix + ".manifest";
+	
+	std::FILE *manifest = std::fopen(manifestPath.c_str(), "rb");
+	if (!manifest) return;
+	
+	std::uint32_t nextRun, number;
+	
+	if (std::fread(&nextRun, sizeof(nextRun), 1, manifest) == 1) {
+		while (std::fread(&number, sizeof(number), 1, manifest) == 1) {
+			std::remove(runFilepath(prefix, number).c_str());
+			std::remove(filterFilepath(prefix, number).c_str());
+		}
+	}
+	
+	std::fclose(manifest);
+	std::remove(manifestPath.c_str());
+}
+
+template <typename Tree, typename Hash>
+void LsmTree<Tree, Hash>::settleCompaction() {
+	std::vector<std::shared_ptr<Run>> retired;
+	std::shared_ptr<Run> merged;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		retired.swap(m_retired);
+		merged.swap(m_merged);
+	}
+	
+	if (!merged || !m_cache) return;
+	
+	// If the run can't be opened again, the one opened without the cache is
+	// kept. It may also have been compacted away meanwhile.
+	auto cached = openRun(merged->number, m_cache);
+	if (!cached) return;
+	
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::replace(m_runs.begin(), m_runs.end(), merged, cached);
+}
+
+template <typename Tree, typename Hash>
+std::string LsmTree<Tree, Hash>::runFilepath(const std::string& prefix, unsigned int number) {
+	return prefix + "-" + std::to_string(number) + ".bin";
+}
+
+template <typename Tree, typename Hash>
+std::string LsmTree<Tree, Hash>::filterFilepath(const std::string& prefix, unsigned int number) {
+	return prefix + "-" + std::to_string(number) + ".bloom";
+}
+
+template <typename Tree, typename Hash>
+bool LsmTree<Tree, Hash>::writeManifest() const {
+	// The new manifest replaces the old one only once it's complete, so that
+	// a crash leaves either of them
+	auto manifestPath = m_prefix + ".manifest";
+	auto temporaryPath = manifestPath + ".tmp";
+	
+	std::FILE *manifest = std::fopen(temporaryPath.c_str(), "wb");
+	if (!manifest) return false;
+	
+	std::uint32_t nextRun = m_nextRun;
+	bool written = std::fwrite(&nextRun, sizeof(nextRun), 1, manifest) == 1;
+	
+	for (auto& run : m_runs) {
+		std::uint32_t number = run->number;
+		written = written && std::fwrite(&number, sizeof(number), 1, manifest) == 1;
+	}
+	
+	written = std::fclose(manifest) == 0 && written;
+	return written && std::rename(temporaryPath.c_str(), manifestPath.c_str()) == 0;
+}
+
+template <typename Tree, typename Hash>
+std::shared_ptr<typename LsmTree<Tree, Hash>::Run> LsmTree<Tree, Hash>::openRun(unsigned int number, BlockCache *cache) const {
+	auto run = std::make_shared<Run>();
+	run->number = number;
+	run->tree.useCache(cache);
+	
+	if (!run->tree.load(runFilepath(m_prefix, number).c_str())) return nullptr;
+	if (!run->filter.load(filterFilepath(m_prefix, number).c_str())) return nullptr;
+	
+	return run;
+}
+
+template <typename Tree, typename Hash>
+template <typename Next>
+bool LsmTree<Tree, Hash>::writeRun(unsigned int number, Next next) const {
+	Tree tree;
+	if (!tree.create(runFilepath(m_prefix, number).c_str())) return false;
+	
+	// Key hashes are kept until the end, once we know how big the filter must be
+	std::vector<std::uint64_t> hashes;
+	
+	tree.bulkLoad([&](ValueType& value) {
+		if (!next(value)) return false;
+		
+		hashes.push_back(Hash()(value));
+		return true;
+	});
+	
+	tree.finishInsertions();
+	
+	BloomFilter filter(hashes.size(), LSM_RUN_FALSE_POSITIVE_RATE);
+	for (auto h : hashes) filter.add(h);
+	
+	return filter.save(filterFilepath(m_prefix, number).c_str());
+}
+
+template <typename Tree, typename Hash>
+void LsmTree<Tree, Hash>::compact(std::vector<std::shared_ptr<Run>> snapshot) {
+	// Runs are opened again without the cache, which belongs to the other
+	// thread. Their values go through an external sort by key and age, so
+	// that the newest value of each key comes first and the others are
+	// dropped.
+	ExternalSorter<Versioned, VersionOrder> sorter(DEFAULT_SORT_MEMORY, 1);
+	bool valid = true;
+	
+	for (std::size_t i = 0; i < snapshot.size() && valid; ++i) {
+		Tree tree;
+		valid = tree.load(runFilepath(m_prefix, snapshot[i]->number).c_str());
+		
+		unsigned int age = snapshot.size() - 1 - i;
+		tree.scan([&](const ValueType& value) {
+			valid = sorter.add({ value, age }) && valid;
+			return valid;
+		});
+	}
+	
+	unsigned int number;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		number = m_nextRun++;
+	}
+	
+	Versioned pending;
+	bool hasPending = valid && sorter.sort() && sorter.next(pending);
+	
+	valid = valid && writeRun(number, [&](ValueType& value) {
+		if (!hasPending) return false;
+		value = pending.value;
+		
+		while ((hasPending = sorter.next(pending)) && !(value < pending.value)) {
+			// Older value of the same key
+		}
+		
+		return true;
+	});
+	
+	auto merged = valid? openRun(number, nullptr) : nullptr;
+	
+	if (merged) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		
+		// Runs flushed during the compaction are newer than the merged one
+		std::vector<std::shared_ptr<Run>> runs(1, merged);
+		runs.insert(runs.end(), m_runs.begin() + snapshot.size(), m_runs.end());
+		m_runs.swap(runs);
+		++m_stats.compactions;
+		
+		// Closing a run's tree touches the cache, which only the other thread
+		// can do, and so does opening the merged run with it
+		m_retired.insert(m_retired.end(), snapshot.begin(), snapshot.end());
+		m_merged = merged;
+		
+		if (writeManifest()) {
+			for (auto& run : snapshot) {
+				std::remove(runFilepath(m_prefix, run->number).c_str());
+				std::remove(filterFilepath(m_prefix, run->number).c_str());
+			}
+		}
+	}
+	else {
+		std::remove(runFilepath(m_prefix, number).c_str());
+		std::remove(filterFilepath(m_prefix, number).c_str());
+	}
+	
+	m_compacting = false;
+}
@@ -0,0 +1,114 @@
+#ifndef _LZCODEC_HPP_INCLUDED_
+#define _LZCODEC_HPP_INCLUDED_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//! Bits of the hash of the 4 bytes starting each position, which index LzCodec's match table
+#define LZ_HASH_BITS 14
+
+//! Largest distance back a match can start at, and so the largest dictionary an LzCodec can use in full
+#define LZ_MAX_DISTANCE 65535
+
+//! Length of the pieces of samples a dictionary is made of, see LzCodec::train
+#define LZ_TRAIN_SEGMENT 64
+
+//! Length of the substrings counted in the samples, see LzCodec::train
+#define LZ_TRAIN_KMER 8
+
+//! Fast LZ77 compressor for small buffers, with an optional shared dictionary
+/*!
+ * Meant for compressing many small records one at a time, such as entries,
+ * while keeping each of them readable on its own. Compressed data is a
+ * sequence of literal runs, each followed by a match: a copy of earlier data,
+ * given as a length and a distance back of up to LZ_MAX_DISTANCE bytes. Runs
+ * and match lengths take a token byte, with more bytes only for long ones, as
+ * in LZ4. Matches are found greedily through a table of the last position of
+ * each 4-byte hash, so compressing is a single pass.
+ *
+ * Small records don't repeat much within themselves, but they repeat one
+ * another. A dictionary, trained on samples of the records with
+ * LzCodec::train, is seen by the compressor as data right before each record,
+ * so matches can refer to it. The same dictionary must be given to decompress.
+ *
+ * Example usage:
+ * \code
+ * LzCodec codec(LzCodec::train(samples, 16384));
+ *
+ * std::vector<char> packed(LzCodec::bound(size));
+ * packed.resize(codec.compress(data, size, packed.data(), packed.size()));
+ *
+ * codec.decompress(packed.data(), packed.size(), data, size);
+ * \endcode
+ */
+class LzCodec {
+public:
+	//! Creates a codec without a dictionary
+	LzCodec();
+	
+	//! Creates a codec with a dictionary
+	/*!
+	 * @param dictionary Dictionary; only its last LZ_MAX_DISTANCE bytes are
+	 * kept
+	 */
+	explicit LzCodec(std::string dictionary);
+	
+	//! Dictionary in use, empty if there's none
+	const std::string& dictionary() const;
+	
+	//! Largest size data of the provided size can take once compressed
+	static std::size_t bound(std::size_t size);
+	
+	//! Compresses data
+	/*!
+	 * @param data Data to compress
+	 * @param size Size of the data in bytes
+	 * @param output Where the compressed data is written
+	 * @param capacity Size of output in bytes; LzCodec::bound is always enough
+	 *
+	 * @return Size of the compressed data in bytes, or 0 if it doesn't fit in
+	 * the output
+	 */
+	std::size_t compress(const char *data, std::size_t size, char *output, std::size_t capacity) const;
+	
+	//! Decompresses data compressed with the same dictionary
+	/*!
+	 * @param data Compressed data
+	 * @param size Size of the compressed data in bytes
+	 * @param output Where the data is written
+	 * @param outputSize Size of the data once decompressed, in bytes
+	 *
+	 * @return True if the compressed data was valid and held exactly
+	 * outputSize bytes
+	 */
+	bool decompress(const char *data, std::size_t size, char *output, std::size_t outputSize) const;
+	
+	//! Builds a dictionary out of samples of the data to compress
+	/*!
+	 * Every substring of LZ_TRAIN_KMER bytes is counted in the samples, once
+	 * per sample. The dictionary is then made of the LZ_TRAIN_SEGMENT-byte
+	 * pieces of the samples holding the most frequent substrings, a substring
+	 * only counting for the first piece taken that holds it. The best pieces
+	 * go last, closest to the data, where matches take the fewest bytes to
+	 * reach them. Runs of a single byte aren't counted, since a record matches
+	 * them within itself anyway.
+	 *
+	 * @param samples Samples, such as a few hundred records
+	 * @param size Dictionary size in bytes, at most LZ_MAX_DISTANCE
+	 *
+	 * @return The dictionary, shorter than size if the samples have too few
+	 * useful pieces
+	 */
+	static std::string train(const std::vector<std::string>& samples, std::size_t size);
+
+private:
+	std::string m_dictionary; //!< Data seen as if it came right before what's compressed
+	std::vector<std::int32_t> m_table; //!< Last position in the dictionary of each hash, -1 for none
+	
+	//! Hash of the 4 bytes at a position, see LZ_HASH_BITS
+	static std::uint32_t hash(const char *p);
+};
+
+#endif // _LZCODEC_HPP_INCLUDED_
@@ -0,0 +1,78 @@
+#ifndef _NODELAYOUT_HPP_INCLUDED_
+#define _NODELAYOUT_HPP_INCLUDED_
+
+#include <cstddef>
+#include <cstdint>
+
+//! Bits of the block number of a node in NodeHeader
+/*!
+ * 2^47 blocks of 4 KiB are 512 PiB, past the largest file Linux file systems
+ * allow, so a node's place can't wrap around.
+ */
+#define NODE_BLOCK_BITS 47
+
+//! Header at the beginning of every BPlusTree and BEpsilonTree node
+/*!
+ * Packed into a single word, so that nearly the whole block is left for keys
+ * and children. Arrays of words (children offsets, subtree counts) can start
+ * right after it without any padding.
+ *
+ * The node's place in the file is kept as a block number rather than a byte
+ * offset, in NODE_BLOCK_BITS bits, which is far more blocks than a file can
+ * hold. Block 0 always holds the file header, so it's used to tell nodes
+ * which haven't been written yet.
+ *
+ * @tparam BlockSize %Block size of the tree, in bytes
+ */
+template <unsigned int BlockSize>
+struct NodeHeader {
+	std::uint64_t block : NODE_BLOCK_BITS; //!< Block number in the file, 0 until the node is first written
+	std::uint64_t size : 16; //!< Quantity of values or keys currently stored in the node
+	std::uint64_t isLeaf : 1; //!< True if the node is a leaf, false if it's an internal node
+	
+	//! Offset of the node in the file
+	long offset() const { return static_cast<long>(block) * BlockSize; }
+	
+	//! Updates the node's place in the file
+	void setOffset(long offset) { block = static_cast<std::uint64_t>(offset / BlockSize); }
+	
+	//! True if the node already has a place in the file
+	bool isWritten() const { return block != 0; }
+};
+
+static_assert(sizeof(NodeHeader<4096>) == sizeof(long), "Node header must take a single word");
+
+//! Largest quantity of values or keys a NodeHeader can count
+#define NODE_MAX_SIZE UINT16_MAX
+
+//! Per-child subtree counts of an internal node
+/*!
+ * Only kept by order-statistic trees (see the Counted parameter of
+ * BPlusTree). For other trees this specialization is empty and takes no space
+ * in the node.
+ *
+ * @tparam Counted True if the counts are kept
+ * @tparam Size Quantity of children
+ */
+template <bool Counted, std::size_t Size>
+struct NodeCounts {
+	std::size_t counts[Size]; //!< Quantity of values in each child's subtree
+	
+	//! Quantity of values in a child's subtree
+	std::size_t count(std::size_t child) const { return counts[child]; }
+	
+	//! Updates the quantity of values in a child's subtree
+	void setCount(std::size_t child, std::size_t count) { counts[child] = count; }
+};
+
+//! Counts of a tree which doesn't keep them
+template <std::size_t Size>
+struct NodeCounts<false, Size> {
+	//! Always 0
+	std::size_t count(std::size_t) const { return 0; }
+	
+	//! Does nothing
+	void setCount(std::size_t, std::size_t) {}
+};
+
+#endif // _NODELAYOUT_HPP_INCLUDED_
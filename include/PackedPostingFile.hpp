@@ -0,0 +1,224 @@
+#ifndef _PACKEDPOSTINGFILE_HPP_INCLUDED_
+#define _PACKEDPOSTINGFILE_HPP_INCLUDED_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Block.hpp"
+#include "BlockCache.hpp"
+#include "BlockFile.hpp"
+
+//! Quantity of offsets in each posting block of a PackedPostingFile list
+/*!
+ * Each posting block has a skip entry, so a list can be skipped through a
+ * posting block at a time. Smaller posting blocks skip more precisely, but
+ * take more skip entries, which are read whole when a list is opened.
+ */
+#define POSTING_SKIP_INTERVAL 128
+
+//! File of posting lists written once, with their offsets delta-compressed
+/*!
+ * Where PostingFile gives each list blocks of its own, so that offsets can be
+ * added to it later on, the lists of a PackedPostingFile are written whole,
+ * one right after the other, and never change. An index key that's in many
+ * entries, such as an author's name, then costs a few bytes per entry, and
+ * keys with only a few entries share blocks with many others.
+ *
+ * A list is identified by the position of its first byte in the file.
+ * Offsets are sorted, and they must be multiples of the block size, as
+ * hashfile offsets are, so they're stored in blocks; every number is a
+ * variable-length integer, 7 bits per byte. The offsets are grouped in
+ * posting blocks of POSTING_SKIP_INTERVAL. A list holds the quantity of
+ * offsets, then a skip entry per posting block, with the block's first offset
+ * and how many bytes the previous block took (both as differences to the
+ * previous skip entry's), then the posting blocks, with the difference between
+ * each of their other offsets and the one before it. Entries with nearby ids
+ * then take a byte each, and a PackedPostingFile::Cursor can skip to an
+ * offset by reading only the skip entries and the posting block it's in.
+ *
+ * Example usage:
+ * \code
+ * PackedPostingFile postings;
+ * postings.create("postings.bin");
+ *
+ * long list = postings.write({ 4096, 8192, 40960 });
+ * postings.close();
+ *
+ * postings.open("postings.bin");
+ *
+ * std::vector<long> offsets;
+ * postings.read(list, offsets);
+ * \endcode
+ *
+ * Like PostingFile, hand a BlockCache to PackedPostingFile::useCache before
+ * opening the file to use direct I/O instead of stdio.
+ */
+class PackedPostingFile {
+public:
+	//! Reads a posting list in order, skipping ahead without decoding what's skipped
+	/*!
+	 * The skip entries are read when the list is opened. After that, only the
+	 * posting blocks the cursor lands in are decoded, and only the file
+	 * blocks holding them are read.
+	 */
+	class Cursor {
+	public:
+		//! Default constructor
+		Cursor();
+		
+		//! Opens a posting list, standing on its first offset
+		/*!
+		 * @param file File holding the list, which must stay open while the
+		 * cursor is used
+		 * @param list Position of the list, as returned by
+		 * PackedPostingFile::write
+		 *
+		 * @return Same as Cursor::valid
+		 */
+		bool open(const PackedPostingFile& file, long list);
+		
+		//! True while the cursor stands on an offset, false once past the end or if the list couldn't be read
+		bool valid() const;
+		
+		//! Offset the cursor stands on, if it's valid
+		long offset() const;
+		
+		//! Moves to the next offset
+		/*!
+		 * @return Same as Cursor::valid
+		 */
+		bool next();
+		
+		//! Moves to the first offset at or after the provided one
+		/*!
+		 * Gallops over the skip entries from the posting block the cursor is
+		 * in, skipping ranges of posting blocks that double in size until one
+		 * starts past the offset, and then narrows the range down by halves.
+		 * Only the posting block found is decoded, and the offset is found in
+		 * it with postingsBelow. The cursor never moves back.
+		 *
+		 * @param offset Offset sought
+		 *
+		 * @return Same as Cursor::valid
+		 */
+		bool seek(long offset);
+		
+		//! Quantity of offsets in the list
+		std::uint64_t size() const;
+		
+		//! Quantity of file blocks read so far
+		std::size_t blocksRead() const;
+	
+	private:
+		//! Skip entry of a posting block
+		struct Skip {
+			long first; //!< First offset in the posting block
+			long position; //!< Position in the file of the block's other offsets
+		};
+		
+		const PackedPostingFile *m_file; //!< File holding the list
+		std::uint64_t m_size; //!< Quantity of offsets in the list
+		std::vector<Skip> m_skips; //!< Skip entry of each posting block
+		std::size_t m_block; //!< Posting block the cursor is in
+		std::vector<long> m_offsets; //!< Offsets of that posting block, empty once past the end
+		std::size_t m_position; //!< Position of the cursor in Cursor::m_offsets
+		
+		std::vector<char> m_buffer; //!< Where file blocks are read into if there's no cache
+		PageRef m_page; //!< File block being decoded
+		long m_pageOffset; //!< Position in the file of Cursor::m_page
+		std::size_t m_byte; //!< Position in Cursor::m_page of the next byte to decode
+		std::size_t m_blocksRead; //!< Quantity of file blocks read
+		
+		//! Gets ready to decode from a position in the file
+		void moveTo(long position);
+		
+		//! Decodes the next number, going on to the next file block when this one is over
+		bool nextNumber(std::uint64_t& number);
+		
+		//! Decodes a posting block, standing on its first offset
+		/*!
+		 * @param block Posting block, past the last to leave the list
+		 *
+		 * @return True if the block could be read
+		 */
+		bool load(std::size_t block);
+	};
+	
+	//! Default constructor
+	PackedPostingFile();
+	
+	//! Destructor
+	/*! Same as PackedPostingFile::close */
+	~PackedPostingFile();
+	
+	PackedPostingFile(const PackedPostingFile&) = delete;
+	PackedPostingFile& operator=(const PackedPostingFile&) = delete;
+	
+	//! Switches the file to direct I/O through the provided cache
+	/*!
+	 * Same as BPlusTree::useCache. Posting blocks are cached as index pages.
+	 *
+	 * @param cache Cache to use, or null to go back to stdio
+	 */
+	void useCache(BlockCache *cache);
+	
+	//! Creates an empty file for writing posting lists
+	/*!
+	 * If there's already a file in the filepath, it'll be overwritten.
+	 *
+	 * @param filepath Path to the file
+	 * @param blockSize %Block size in bytes; must be the cache's block size if
+	 * there's a cache
+	 *
+	 * @return True if the file was created successfully
+	 */
+	bool create(const char *filepath, unsigned int blockSize = BLOCK_SIZE);
+	
+	//! Opens an existing file for reading
+	/*!
+	 * @param filepath Path to the file
+	 * @param blockSize %Block size the file was created with
+	 *
+	 * @return True if the file could be opened
+	 */
+	bool open(const char *filepath, unsigned int blockSize = BLOCK_SIZE);
+	
+	//! Closes the file if it's open
+	/*!
+	 * If the file was created, the block being filled is written first.
+	 */
+	void close();
+	
+	//! Writes a posting list after the ones written so far
+	/*!
+	 * @param offsets Hashfile offsets, sorted, each a multiple of the block
+	 * size
+	 *
+	 * @return Position of the list in the file
+	 */
+	long write(const std::vector<long>& offsets);
+	
+	//! Reads all the offsets of a posting list
+	/*!
+	 * To only read the offsets that matter, use a PackedPostingFile::Cursor.
+	 *
+	 * @param list Position of the list, as returned by
+	 * PackedPostingFile::write
+	 * @param offsets Vector where the offsets will be appended, in order
+	 *
+	 * @return Quantity of blocks read
+	 */
+	std::size_t read(long list, std::vector<long>& offsets) const;
+	
+	//! Quantity of blocks in the file
+	std::size_t blockCount() const;
+
+private:
+	BlockFile m_file; //!< File where the lists are stored
+	long m_end; //!< Size of the lists written so far, in bytes
+	unsigned int m_blockSize; //!< %Block size in bytes
+	std::vector<char> m_tail; //!< Last block of the file, being filled; empty unless the file was created
+};
+
+#endif // _PACKEDPOSTINGFILE_HPP_INCLUDED_
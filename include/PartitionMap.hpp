@@ -0,0 +1,118 @@
+#ifndef _PARTITIONMAP_HPP_INCLUDED_
+#define _PARTITIONMAP_HPP_INCLUDED_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Entry.hpp"
+
+//! Max directory path size in characters, for each partition
+#define PARTITION_DIRECTORY_MAX 256
+
+//! Quantity of ids and of titles sampled from the input to choose the split points
+#define PARTITION_SAMPLE_SIZE 4096
+
+//! Part of a database split by ranges of ids and of titles
+/*!
+ * A partition holds two unrelated ranges: the entries with ids from
+ * Partition::firstId up to the next partition's, in its hashfile segment and
+ * primary index; and the titles from Partition::firstTitle up to the next
+ * partition's, in its secondary index. A title's entries may be in any
+ * hashfile segment.
+ */
+struct Partition {
+	std::int64_t firstId; //!< Smallest id in the partition, 0 for the first one
+	char firstTitle[TITLE_CHAR_MAX]; //!< Smallest title in the partition, empty for the first one
+	char directory[PARTITION_DIRECTORY_MAX]; //!< Directory where the partition's files are
+};
+
+//! Split of a database in partitions, routing ids and titles to them
+/*!
+ * Split points are chosen from samples of the ids and the titles, so that
+ * each partition gets about the same share of both. Partitions are sorted by
+ * their ranges, so an id or a title is found in the last partition whose range
+ * starts at or before it.
+ *
+ * Each partition keeps its files in its own directory, which may be on its own
+ * device, under names given by PartitionMap::filepath. The map itself is
+ * small and saved as a whole.
+ *
+ * Example usage:
+ * \code
+ * auto map = PartitionMap::split(ids, titles, 4, { "/disk1", "/disk2" });
+ * map.save("partitions.bin");
+ *
+ * auto k = map.ofId(42);
+ * auto path = map.filepath(k, "idtree.bin"); // "/disk2/part1-idtree.bin", say
+ * \endcode
+ */
+class PartitionMap {
+public:
+	//! Creates an empty map, with no partitions
+	PartitionMap();
+	
+	//! Chooses the split points of a database from samples of its input
+	/*!
+	 * Partitions are given the directories in turn, so there may be fewer
+	 * directories than partitions.
+	 *
+	 * @param ids Sampled ids, in any order
+	 * @param titles Sampled titles, in any order
+	 * @param count Quantity of partitions
+	 * @param directories Directories of the partitions, at least one; each
+	 * must be shorter than PARTITION_DIRECTORY_MAX
+	 *
+	 * @return The map
+	 */
+	static PartitionMap split(std::vector<std::int64_t> ids, std::vector<std::string> titles, std::size_t count, const std::vector<std::string>& directories);
+	
+	//! Reads a map saved with PartitionMap::save
+	/*!
+	 * @param filepath Path to the file
+	 *
+	 * @return True if the file could be read and it was written in the current
+	 * format, see FORMAT_VERSION
+	 */
+	bool load(const char *filepath);
+	
+	//! Writes the map to a file
+	/*!
+	 * @param filepath Path to the file; if there's already a file, it'll be
+	 * overwritten
+	 *
+	 * @return True if the file was written successfully
+	 */
+	bool save(const char *filepath) const;
+	
+	//! Quantity of partitions
+	std::size_t size() const;
+	
+	//! Partition at the provided position
+	const Partition& operator[] (std::size_t i) const;
+	
+	//! Partition holding an id
+	std::size_t ofId(std::int64_t id) const;
+	
+	//! Partition holding a title
+	std::size_t ofTitle(const char *title) const;
+	
+	//! Path to one of a partition's files
+	/*!
+	 * @param i Partition
+	 * @param filename Name of the file, as in a database that isn't partitioned
+	 */
+	std::string filepath(std::size_t i, const char *filename) const;
+
+private:
+	//! Header of a saved map, followed by the partitions
+	struct FileHeader {
+		std::uint32_t version; //!< Format version, see FORMAT_VERSION
+		std::uint32_t count; //!< Quantity of partitions
+	};
+	
+	std::vector<Partition> m_partitions; //!< Partitions, sorted by their ranges
+};
+
+#endif // _PARTITIONMAP_HPP_INCLUDED_
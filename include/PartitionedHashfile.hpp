@@ -0,0 +1,72 @@
+#ifndef _PARTITIONEDHASHFILE_HPP_INCLUDED_
+#define _PARTITIONEDHASHFILE_HPP_INCLUDED_
+
+#include <memory>
+#include <vector>
+
+#include "BlockCache.hpp"
+#include "BlockFile.hpp"
+#include "Hashfile.hpp"
+#include "PartitionMap.hpp"
+
+//! Hashfile split in one segment per partition, read as if it were a single one
+/*!
+ * Each segment is a Hashfile holding the entries of its partition's ids, from
+ * Partition::firstId on. Segments take offsets as in a single hashfile, which
+ * is what the indexes store, so an offset only has to be sent to the segment
+ * of the id it belongs to.
+ *
+ * Example usage:
+ * \code
+ * PartitionMap map;
+ * map.load("partitions.bin");
+ *
+ * PartitionedHashfile hashfile;
+ * hashfile.open(map, "hashfile.bin");
+ *
+ * EntryBlock buffer;
+ * auto page = hashfile.view(4096 * (42 + 1), buffer); // Entry of id 42, with 4 KiB blocks
+ * \endcode
+ */
+class PartitionedHashfile {
+public:
+	//! Default constructor
+	PartitionedHashfile();
+	
+	//! Makes the segments opened afterwards use the provided cache
+	/*!
+	 * @param cache Cache to use, or null to go through stdio
+	 */
+	void useCache(BlockCache *cache);
+	
+	//! Opens every segment of a partitioned database for reading
+	/*!
+	 * @param map Partitions of the database, which must outlive the hashfile
+	 * @param filename Name of the segment files, see PartitionMap::filepath
+	 *
+	 * @return True if every segment could be opened, see Hashfile::open
+	 */
+	bool open(const PartitionMap& map, const char *filename);
+	
+	//! Segment with the entry at an offset
+	/*!
+	 * @param offset Entry offset
+	 */
+	Hashfile& segment(long offset);
+	
+	//! Reads the entry block at the provided offset in place
+	/*!
+	 * Same as Hashfile::view, in the entry's segment.
+	 */
+	PageRef view(long offset, EntryBlock& buffer);
+	
+	//! %Block size in bytes, the same in every segment
+	unsigned int blockSize() const;
+
+private:
+	const PartitionMap *m_map; //!< Partitions of the database
+	std::vector<std::unique_ptr<Hashfile>> m_segments; //!< Segment of each partition
+	BlockCache *m_cache; //!< Cache for the segments, if any
+};
+
+#endif // _PARTITIONEDHASHFILE_HPP_INCLUDED_
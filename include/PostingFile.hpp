@@ -0,0 +1,117 @@
+#ifndef _POSTINGFILE_HPP_INCLUDED_
+#define _POSTINGFILE_HPP_INCLUDED_
+
+#include <cstddef>
+#include <vector>
+
+#include "Block.hpp"
+#include "BlockCache.hpp"
+#include "BlockFile.hpp"
+
+//! Quantity of hashfile offsets per posting block
+#define POSTINGS_PER_BLOCK ((BLOCK_SIZE - sizeof(long) - sizeof(std::size_t)) / sizeof(long))
+
+//! Part of a posting list stored in a single block
+struct PostingBlock {
+	long next; //!< Offset of the next block of the list, -1 if it's the last one
+	std::size_t size; //!< Quantity of offsets in use
+	long offsets[POSTINGS_PER_BLOCK]; //!< Hashfile offsets
+};
+
+//! Block of a PostingFile
+typedef Block<PostingBlock, BLOCK_SIZE> PostingBlockBlock;
+
+//! File of posting lists, each a chain of blocks of hashfile offsets
+/*!
+ * An index key shared by many entries keeps a single copy of the key in the
+ * index, and the offsets of the entries that don't fit beside it go to a
+ * posting list in this file.
+ *
+ * A list is identified by the offset of its head block. Offsets are added to
+ * the head block until it's full, and then a new head is chained in front of
+ * it, so adding an offset takes one block read at most. Offsets come out of
+ * PostingFile::read newest block first.
+ *
+ * Example usage:
+ * \code
+ * PostingFile postings;
+ * postings.create("postings.bin");
+ *
+ * long list = -1; // Empty list
+ * list = postings.append(list, 4096);
+ * list = postings.append(list, 8192);
+ *
+ * std::vector<long> offsets;
+ * postings.read(list, offsets);
+ * \endcode
+ *
+ * Like Hashfile, hand a BlockCache to PostingFile::useCache before opening the
+ * file to use direct I/O instead of stdio. Blocks bigger than a
+ * PostingBlockBlock keep the posting block at their start.
+ */
+class PostingFile {
+public:
+	//! Default constructor
+	PostingFile();
+	
+	//! Switches the file to direct I/O through the provided cache
+	/*!
+	 * Same as BPlusTree::useCache. Posting blocks are cached as index pages.
+	 *
+	 * @param cache Cache to use, or null to go back to stdio
+	 */
+	void useCache(BlockCache *cache);
+	
+	//! Creates an empty file for appending to posting lists
+	/*!
+	 * If there's already a file in the filepath, it'll be overwritten.
+	 *
+	 * @param filepath Path to the file
+	 * @param blockSize %Block size in bytes, at least as big as a
+	 * PostingBlockBlock; must be the cache's block size if there's a cache
+	 *
+	 * @return True if the file was created successfully
+	 */
+	bool create(const char *filepath, unsigned int blockSize = BLOCK_SIZE);
+	
+	//! Opens an existing file for reading
+	/*!
+	 * @param filepath Path to the file
+	 * @param blockSize %Block size the file was created with
+	 *
+	 * @return True if the file could be opened
+	 */
+	bool open(const char *filepath, unsigned int blockSize = BLOCK_SIZE);
+	
+	//! Closes the file if it's open
+	void close();
+	
+	//! Adds an offset to a posting list
+	/*!
+	 * @param list Offset of the list's head block, -1 for a new list
+	 * @param offset Hashfile offset to add
+	 *
+	 * @return Offset of the list's head block, which changes whenever the
+	 * head is full
+	 */
+	long append(long list, long offset);
+	
+	//! Reads all the offsets of a posting list
+	/*!
+	 * @param list Offset of the list's head block, -1 for an empty list
+	 * @param offsets Vector where the offsets will be appended
+	 *
+	 * @return Quantity of blocks read
+	 */
+	std::size_t read(long list, std::vector<long>& offsets) const;
+	
+	//! Quantity of blocks in the file
+	std::size_t blockCount() const;
+
+private:
+	BlockFile m_file; //!< File where the lists are stored
+	long m_end; //!< Offset of the next block to be created
+	unsigned int m_blockSize; //!< %Block size in bytes
+};
+
+#endif // _POSTINGFILE_HPP_INCLUDED_
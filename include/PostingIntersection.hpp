@@ -0,0 +1,53 @@
+#ifndef _POSTINGINTERSECTION_HPP_INCLUDED_
+#define _POSTINGINTERSECTION_HPP_INCLUDED_
+
+#include <cstddef>
+#include <vector>
+
+#include "PackedPostingFile.hpp"
+
+//! Size of the ranges of a posting block searched by comparing every offset, see postingsBelow
+/*!
+ * A binary search narrows the range where an offset may be down to this many
+ * offsets, which are then compared with it all at once, with SSE2 where
+ * available.
+ */
+#define POSTING_SCAN_WINDOW 32
+
+//! Quantity of offsets less than a value in a sorted range, which is where the value would go
+/*!
+ * Used by PackedPostingFile::Cursor::seek within the posting block it lands
+ * in. The range is halved until it's POSTING_SCAN_WINDOW offsets long, and
+ * those are compared with the value without branching on each: with SSE2,
+ * two at a time.
+ *
+ * Offsets must not be negative, as hashfile offsets aren't.
+ *
+ * @param offsets Sorted offsets
+ * @param size Quantity of offsets
+ * @param value Offset sought
+ *
+ * @return Position of the first offset that isn't less than the value
+ */
+std::size_t postingsBelow(const long *offsets, std::size_t size, long value);
+
+//! Keeps, in a posting list, only the offsets that are in another one
+/*!
+ * Each offset of the first list is sought in the second one with
+ * PackedPostingFile::Cursor::seek, which gallops over the skip entries from
+ * where the previous offset was found, and finds the offset within the
+ * posting block it lands in with postingsBelow. Only those posting blocks are
+ * decoded, so the cost grows with the size of the first list
+ * and only with the logarithm of the gaps in the second. The first list
+ * should be the shorter one: intersecting a rare term's list with a common
+ * term's decodes a posting block of the common term's per match at most,
+ * and reads none of the others.
+ *
+ * @param result First list, sorted, where the offsets found in the other one
+ * are kept, in order
+ * @param list Cursor on the second list, which is left past the last offset
+ * sought
+ */
+void intersectPostings(std::vector<long>& result, PackedPostingFile::Cursor& list);
+
+#endif // _POSTINGINTERSECTION_HPP_INCLUDED_
@@ -0,0 +1,235 @@
+#ifndef _SHAREDBLOCKCACHE_HPP_INCLUDED_
+#define _SHAREDBLOCKCACHE_HPP_INCLUDED_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "BlockCache.hpp"
+
+//! Quantity of latches guarding the lookup table of a SharedBlockCache
+#define SHARED_CACHE_STRIPES 64
+
+//! Quantity of handles that can be attached to a SharedBlockCache segment at once, in every process
+/*!
+ * Each frame keeps a pin count for each of them, 2 bytes each.
+ */
+#define SHARED_CACHE_HANDLES 64
+
+//! Block cache frames in a POSIX shared memory segment, used by many processes at once
+/*!
+ * Processes reading the same files each keep their own copy of the blocks
+ * they use in their BlockCache. A BlockCache attached to a shared segment
+ * (see BlockCache::attachShared) keeps them here instead, so each block is in
+ * memory once per host, and a block one process read is a hit for the others.
+ * The segment outlives the processes, until it's removed with
+ * SharedBlockCache::remove or the host restarts.
+ *
+ * Blocks are identified by file and offset. Files are told apart by their
+ * device and inode, along with the time they were last changed, so blocks
+ * cached before a file was rewritten are never mistaken for its current ones:
+ * they're just no longer looked up, and get evicted.
+ *
+ * The lookup table is a chained hash table whose buckets are split between
+ * SHARED_CACHE_STRIPES latches (process-shared mutexes), so lookups of
+ * different blocks seldom wait on each other. Frames are pinned with a
+ * reference count, changed atomically, and only evicted once it's back to 0.
+ * Eviction goes around the frames like a clock, giving recently used ones a
+ * second chance. As in BlockCache, index pages are only evicted to make room
+ * for other index pages, and only once record pages had their chance.
+ *
+ * A published frame is never written again, since other processes may be
+ * reading it. A block that changes is written to a frame of its own, which
+ * replaces the old one in the bucket (see SharedBlockCache::publish); the old
+ * frame stays as it is for whoever has it pinned, and is only claimed again
+ * once its pins are gone.
+ *
+ * Every handle attached to the segment takes one of SHARED_CACHE_HANDLES
+ * slots, owned by its process, which is told apart by its id and start time
+ * so that a reused id isn't mistaken for it. Frames count the pins of each
+ * slot, and a claimed frame records the slot of whoever claimed it. When a
+ * handle attaches, or can't find a frame to claim, the slots of processes
+ * that are gone are swept: their pins are taken off and their claimed frames
+ * made free, so a process dying with blocks pinned doesn't keep them from
+ * being evicted.
+ */
+class SharedBlockCache {
+public:
+	//! File a block belongs to
+	struct FileKey {
+		std::uint64_t device; //!< Device holding the file
+		std::uint64_t inode; //!< File's inode
+		std::int64_t changed; //!< Time the file was last changed, in nanoseconds
+		
+		bool operator== (const FileKey& that) const {
+			return device == that.device && inode == that.inode && changed == that.changed;
+		}
+	};
+	
+	//! Key of the file open with a descriptor
+	/*!
+	 * @return True if the file could be looked at
+	 */
+	static bool keyOf(int fd, FileKey& key);
+	
+	//! Creates a handle attached to no segment
+	SharedBlockCache();
+	
+	//! Destructor
+	/*! Detaches from the segment, which stays for the other processes */
+	~SharedBlockCache();
+	
+	SharedBlockCache(const SharedBlockCache&) = delete;
+	SharedBlockCache& operator=(const SharedBlockCache&) = delete;
+	
+	//! Attaches to a segment, creating it if there isn't one with that name yet
+	/*!
+	 * @param name Name of the segment, as given to `shm_open`; a leading slash
+	 * is added if missing
+	 * @param capacity Quantity of frames, if the segment is created;
+	 * otherwise, the segment keeps its own
+	 * @param blockSize %Block size in bytes, which must be the segment's
+	 *
+	 * @return False if the segment couldn't be created or attached to, has
+	 * blocks of another size, or has no handle slot left
+	 */
+	bool attach(const char *name, std::size_t capacity, std::size_t blockSize);
+	
+	//! Removes a segment
+	/*!
+	 * Processes attached to it keep using it until they detach.
+	 *
+	 * @param name Name of the segment, see SharedBlockCache::attach
+	 *
+	 * @return True if there was a segment with that name
+	 */
+	static bool remove(const char *name);
+	
+	//! Quantity of frames
+	std::size_t capacity() const;
+	
+	//! Looks for a block, pinning it if it's there
+	/*!
+	 * @param file File the block belongs to
+	 * @param offset %Block offset in the file
+	 *
+	 * @return The block, pinned, or null if it isn't cached
+	 */
+	const char* lookup(const FileKey& file, long offset);
+	
+	//! Takes a frame for a new block
+	/*!
+	 * The frame is the caller's until it's handed back to
+	 * SharedBlockCache::publish or SharedBlockCache::abandon; no other
+	 * process sees it meanwhile.
+	 *
+	 * @param priority Priority of the block that will be in it
+	 * @param evicted Set to true if a block was evicted to make room
+	 *
+	 * @return The frame, or null if the block can't be cached, see BlockCache
+	 */
+	char* claim(BlockCache::Priority priority, bool& evicted);
+	
+	//! Makes a claimed frame available to every process
+	/*!
+	 * If another process cached the same block meanwhile, the frame is given
+	 * back and that block is returned instead, unless the frame replaces it.
+	 *
+	 * @param frame Frame returned by SharedBlockCache::claim, holding the block
+	 * @param file File the block belongs to
+	 * @param offset %Block offset in the file
+	 * @param priority Priority of the block
+	 * @param replace True if the frame holds a newer version of the block,
+	 * which takes the place of the one cached, if any
+	 *
+	 * @return The cached block, pinned
+	 */
+	const char* publish(char *frame, const FileKey& file, long offset, BlockCache::Priority priority, bool replace = false);
+	
+	//! Stops looking a block up, if it's cached
+	/*!
+	 * Its frame is left as it is for whoever has it pinned, see
+	 * SharedBlockCache::publish.
+	 *
+	 * @param file File the block belongs to
+	 * @param offset %Block offset in the file
+	 */
+	void discard(const FileKey& file, long offset);
+	
+	//! Gives back a claimed frame without caching anything in it
+	void abandon(char *frame);
+	
+	//! Adds a pin to a block the caller already has pinned
+	void pin(const char *block);
+	
+	//! Removes a pin from a block
+	void unpin(const char *block);
+	
+	//! True if the block is in one of the segment's frames
+	bool holds(const char *block) const;
+
+private:
+	struct Header;
+	struct Frame;
+	
+	std::string m_name; //!< Name of the segment attached to
+	char *m_segment; //!< Segment mapping, null if not attached
+	std::size_t m_size; //!< Size of the mapping in bytes
+	Header *m_header; //!< Segment header
+	Frame *m_frames; //!< Bookkeeping of each frame
+	std::atomic<std::uint16_t> *m_pins; //!< Pins of each slot on each frame, SHARED_CACHE_HANDLES per frame
+	std::int64_t *m_buckets; //!< First frame of each bucket, -1 for none
+	char *m_data; //!< Frames, aligned to the block size
+	std::size_t m_slot; //!< Slot of the handle, SHARED_CACHE_HANDLES if it has none
+	
+	//! Index of a frame from its address
+	std::size_t frameOf(const char *block) const;
+	
+	//! Pins of a slot on a frame
+	std::atomic<std::uint16_t>& slotPins(std::size_t frame, std::size_t slot) const;
+	
+	//! Adds a pin of the handle's slot to a frame
+	void addPin(std::size_t frame);
+	
+	//! Takes the pins of a slot off every frame, and frees the frames it claimed
+	void sweep(std::size_t slot);
+	
+	//! Sweeps the slots owned by processes that are gone, and frees them
+	/*!
+	 * @return True if any slot was swept
+	 */
+	bool sweepDead();
+	
+	//! Bucket of a block
+	std::size_t bucketOf(const FileKey& file, long offset) const;
+	
+	//! Locks the latch guarding a bucket
+	void lock(std::size_t bucket);
+	
+	//! Unlocks the latch guarding a bucket
+	void unlock(std::size_t bucket);
+	
+	//! Finds a block in its bucket, whose latch must be held
+	/*!
+	 * @return Index of its frame, -1 if it isn't there
+	 */
+	std::int64_t find(std::size_t bucket, const FileKey& file, long offset) const;
+	
+	//! Takes a cached frame out of its bucket, whose latch must be held
+	/*!
+	 * The frame is left stale: it's claimed again once it isn't pinned.
+	 */
+	void unlink(std::size_t bucket, std::size_t index);
+	
+	//! Evicts the block in a frame, if it can be, and claims the frame
+	/*!
+	 * @return True if the frame was claimed
+	 */
+	bool evict(std::size_t index);
+	
+	//! Detaches from the segment
+	void detach();
+};
+
+#endif // _SHAREDBLOCKCACHE_HPP_INCLUDED_
@@ -0,0 +1,337 @@
+#include "AsyncReader.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+// --- //
+
+AsyncReader::AsyncReader(unsigned int queueDepth)
+	: m_queueDepth(queueDepth)
+	, m_ringFd(-1)
+	, m_ring()
+	, m_stopping(false)
+{
+	if (!setupRing()) {
+		for (int i = 0; i < ASYNC_FALLBACK_THREADS; ++i) {
+			m_workers.emplace_back(&AsyncReader::work, this);
+		}
+	}
+}
+
+AsyncReader::~AsyncReader() {
+	if (m_ringFd >= 0) {
+		releaseRing();
+	}
+	else {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		
+		m_submitted.notify_all();
+		
+		for (auto& worker : m_workers) {
+			worker.join();
+		}
+	}
+}
+
+std::size_t AsyncReader::queueDepth() const {
+	return m_queueDepth;
+}
+
+bool AsyncReader::usingIoUring() const {
+	return m_ringFd >= 0;
+}
+
+#ifdef __linux__
+
+bool AsyncReader::setupRing() {
+	io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+	
+	int fd = syscall(__NR_io_uring_setup, m_queueDepth, &params);
+	if (fd < 0) return false;
+	
+	// Rings exist since 5.1, but IORING_OP_READ only since 5.6, as does the
+	// probe: on the kernels in between, every read would fail with EINVAL
+	std::vector<char> memory(sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op));
+	auto probe = reinterpret_cast<io_uring_probe*>(memory.data());
+	
+	if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0
+		|| probe->last_op < IORING_OP_READ
+		|| !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)) {
+		close(fd);
+		return false;
+	}
+	
+	Ring& r = m_ring;
+	r.sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	r.cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	
+	// Newer kernels map both rings with a single mmap call
+	bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (singleMap) {
+		r.sqMapSize = r.cqMapSize = std::max(r.sqMapSize, r.cqMapSize);
+	}
+	
+	r.sqMap = mmap(nullptr, r.sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (r.sqMap == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+	
+	if (singleMap) {
+		r.cqMap = r.sqMap;
+	}
+	else {
+		r.cqMap = mmap(nullptr, r.cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (r.cqMap == MAP_FAILED) {
+			munmap(r.sqMap, r.sqMapSize);
+			close(fd);
+			return false;
+		}
+	}
+	
+	r.sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	r.sqes = mmap(nullptr, r.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (r.sqes == MAP_FAILED) {
+		if (!singleMap) munmap(r.cqMap, r.cqMapSize);
+		munmap(r.sqMap, r.sqMapSize);
+		close(fd);
+		return false;
+	}
+	
+	char *sq = static_cast<char*>(r.sqMap);
+	r.sqTail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+	r.sqMask = reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+	r.sqArray = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+	
+	char *cq = static_cast<char*>(r.cqMap);
+	r.cqHead = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+	r.cqTail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+	r.cqMask = reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+	r.cqes = cq + params.cq_off.cqes;
+	
+	m_queueDepth = params.sq_entries;
+	m_ringFd = fd;
+	return true;
+}
+
+void AsyncReader::releaseRing() {
+	if (m_ring.cqMap != m_ring.sqMap) munmap(m_ring.cqMap, m_ring.cqMapSize);
+	munmap(m_ring.sqMap, m_ring.sqMapSize);
+	munmap(m_ring.sqes, m_ring.sqesSize);
+	close(m_ringFd);
+	m_ringFd = -1;
+}
+
+void AsyncReader::abandonRing() {
+	Ring& r = m_ring;
+	
+	// Reads the kernel already took may still land in their buffers, even
+	// after the ring is closed, so none of them is served again before it's
+	// reaped. Each one is asked to be cancelled; cancellations complete with
+	// a user_data of 0, which no request has.
+	unsigned int tail = *r.sqTail;
+	
+	for (auto request : m_inRing) {
+		unsigned int index = tail & *r.sqMask;
+		
+		auto sqe = static_cast<io_uring_sqe*>(r.sqes) + index;
+		std::memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = reinterpret_cast<unsigned long>(request);
+		sqe->user_data = 0;
+		
+		r.sqArray[index] = index;
+		++tail;
+	}
+	
+	__atomic_store_n(r.sqTail, tail, __ATOMIC_RELEASE);
+	syscall(__NR_io_uring_enter, m_ringFd, static_cast<unsigned int>(m_inRing.size()), 0, 0, nullptr, 0);
+	
+	// Completions are still posted if the ring can't be entered anymore, the
+	// kernel just isn't waited on for them
+	std::vector<Request*> unfinished;
+	
+	while (!m_inRing.empty()) {
+		unsigned int head = *r.cqHead;
+		
+		if (head == __atomic_load_n(r.cqTail, __ATOMIC_ACQUIRE)) {
+			if (syscall(__NR_io_uring_enter, m_ringFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0) sched_yield();
+			continue;
+		}
+		
+		auto cqe = static_cast<io_uring_cqe*>(r.cqes) + (head & *r.cqMask);
+		auto request = reinterpret_cast<Request*>(cqe->user_data);
+		auto result = cqe->res;
+		__atomic_store_n(r.cqHead, head + 1, __ATOMIC_RELEASE);
+		
+		if (!request) continue;
+		
+		m_inRing.erase(std::find(m_inRing.begin(), m_inRing.end(), request));
+		
+		// Cancelled reads fail with ECANCELED or EINTR, and are read again
+		// below; the others are done
+		if (result < 0) {
+			unfinished.push_back(request);
+		}
+		else {
+			request->result = result;
+			m_done.push_back(request);
+		}
+	}
+	
+	releaseRing();
+	
+	for (auto request : unfinished) {
+		serve(*request);
+		m_done.push_back(request);
+	}
+	
+	for (int i = 0; i < ASYNC_FALLBACK_THREADS; ++i) {
+		m_workers.emplace_back(&AsyncReader::work, this);
+	}
+}
+
+#else
+
+bool AsyncReader::setupRing() {
+	return false;
+}
+
+void AsyncReader::releaseRing() {
+}
+
+void AsyncReader::abandonRing() {
+}
+
+#endif
+
+void AsyncReader::submit(Request& request) {
+	#ifdef __linux__
+	if (m_ringFd >= 0) {
+		Ring& r = m_ring;
+		unsigned int tail = *r.sqTail;
+		unsigned int index = tail & *r.sqMask;
+		
+		auto sqe = static_cast<io_uring_sqe*>(r.sqes) + index;
+		std::memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = request.fd;
+		sqe->addr = reinterpret_cast<unsigned long>(request.buffer);
+		sqe->len = request.size;
+		sqe->off = request.offset;
+		sqe->user_data = reinterpret_cast<unsigned long>(&request);
+		
+		r.sqArray[index] = index;
+		__atomic_store_n(r.sqTail, tail + 1, __ATOMIC_RELEASE);
+		
+		long submitted;
+		while ((submitted = syscall(__NR_io_uring_enter, m_ringFd, 1, 0, 0, nullptr, 0)) < 0 && errno == EINTR);
+		
+		if (submitted > 0) {
+			m_inRing.push_back(&request);
+			return;
+		}
+		
+		// The kernel didn't take the entry, and only reads the queue when
+		// entered, so it can be taken back. The read is served right away.
+		__atomic_store_n(r.sqTail, tail, __ATOMIC_RELEASE);
+		serve(request);
+		
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_done.push_back(&request);
+		return;
+	}
+	#endif
+	
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending.push_back(&request);
+	}
+	
+	m_submitted.notify_one();
+}
+
+AsyncReader::Request& AsyncReader::wait() {
+	#ifdef __linux__
+	if (m_ringFd >= 0 && !m_inRing.empty()) {
+		Ring& r = m_ring;
+		unsigned int head = *r.cqHead;
+		bool broken = false;
+		
+		// Interruptions and a lack of kernel resources are worth another try.
+		// Any other failure means the ring is unusable, and the reads in it
+		// are served by the thread pool from then on.
+		while (!broken && head == __atomic_load_n(r.cqTail, __ATOMIC_ACQUIRE)) {
+			if (syscall(__NR_io_uring_enter, m_ringFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0) {
+				broken = errno != EINTR && errno != EAGAIN && errno != EBUSY;
+			}
+		}
+		
+		if (broken) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			abandonRing();
+		}
+		else {
+			auto cqe = static_cast<io_uring_cqe*>(r.cqes) + (head & *r.cqMask);
+			auto request = reinterpret_cast<Request*>(cqe->user_data);
+			request->result = cqe->res;
+			
+			__atomic_store_n(r.cqHead, head + 1, __ATOMIC_RELEASE);
+			m_inRing.erase(std::find(m_inRing.begin(), m_inRing.end(), request));
+			return *request;
+		}
+	}
+	#endif
+	
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_completed.wait(lock, [this] { return !m_done.empty(); });
+	
+	Request *request = m_done.front();
+	m_done.pop_front();
+	return *request;
+}
+
+void AsyncReader::work() {
+	while (true) {
+		Request *request;
+		
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_submitted.wait(lock, [this] { return m_stopping || !m_pending.empty(); });
+			
+			if (m_pending.empty()) return;
+			
+			request = m_pending.front();
+			m_pending.pop_front();
+		}
+		
+		serve(*request);
+		
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_done.push_back(request);
+		}
+		
+		m_completed.notify_one();
+	}
+}
+
+void AsyncReader::serve(Request& request) {
+	auto result = pread(request.fd, request.buffer, request.size, request.offset);
+	request.result = result < 0? -errno : result;
+}
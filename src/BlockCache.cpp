@@ -0,0 +1,457 @@
+#include "BlockCache.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+#include "SharedBlockCache.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// --- //
+
+AlignedBuffer allocateAligned(std::size_t size, std::size_t alignment) {
+	void *memory = nullptr;
+	if (posix_memalign(&memory, alignment, size) != 0) memory = nullptr;
+	return AlignedBuffer(static_cast<char*>(memory));
+}
+
+int openDirect(const char *filepath, int flags) {
+	#ifdef O_DIRECT
+	flags |= O_DIRECT;
+	#endif
+	
+	return open(filepath, flags, 0644);
+}
+
+// --- //
+
+struct BlockCache::Shared {
+	//! Block kept pinned in the segment
+	struct Held {
+		int fd; //!< File descriptor
+		const char *block; //!< Pinned block, null for none
+	};
+	
+	SharedBlockCache segment; //!< Segment holding the frames
+	std::unordered_map<int, SharedBlockCache::FileKey> files; //!< Key of each file descriptor in the segment
+	Held held[BLOCK_CACHE_SHARED_HELD] = {}; //!< Blocks returned last, pinned
+	std::size_t nextHeld = 0; //!< Position in Shared::held of the next block returned
+	
+	//! Key of a file in the segment
+	/*!
+	 * @return False if the file can't be told apart from others, in which case
+	 * its blocks aren't cached
+	 */
+	bool keyOf(int fd, SharedBlockCache::FileKey& key) {
+		auto it = files.find(fd);
+		
+		if (it == files.end()) {
+			if (!SharedBlockCache::keyOf(fd, key)) return false;
+			files[fd] = key;
+		}
+		else {
+			key = it->second;
+		}
+		
+		return true;
+	}
+	
+	//! Keeps a pinned block pinned until BLOCK_CACHE_SHARED_HELD others are returned
+	const char* hold(int fd, const char *block) {
+		auto& slot = held[nextHeld];
+		if (slot.block) segment.unpin(slot.block);
+		
+		slot = { fd, block };
+		nextHeld = (nextHeld + 1) % BLOCK_CACHE_SHARED_HELD;
+		return block;
+	}
+	
+	//! Unpins the held blocks of a file, or of every file if fd is -1
+	void release(int fd) {
+		for (auto& slot : held) {
+			if (!slot.block || (fd >= 0 && slot.fd != fd)) continue;
+			
+			segment.unpin(slot.block);
+			slot.block = nullptr;
+		}
+	}
+};
+
+BlockCache::BlockCache(std::size_t capacity, std::size_t blockSize)
+	: m_capacity(capacity)
+	, m_blockSize(blockSize)
+	, m_memory(allocateAligned((capacity + 1) * blockSize, blockSize))
+	, m_frames(capacity)
+	, m_stats({ 0, 0, 0, 0 })
+{
+	m_free.reserve(capacity);
+	
+	for (std::size_t i = capacity; i > 0; --i) {
+		m_free.push_back(i - 1);
+	}
+	
+	for (auto& list : m_lru) {
+		list = { capacity, capacity };
+	}
+	
+	std::size_t slots = 2;
+	m_tableShift = 63;
+	
+	while (slots < 2 * capacity) {
+		slots *= 2;
+		--m_tableShift;
+	}
+	
+	m_table.assign(slots, capacity);
+}
+
+BlockCache::~BlockCache() {
+	if (m_shared) m_shared->release(-1);
+}
+
+bool BlockCache::attachShared(const char *name) {
+	std::unique_ptr<Shared> shared(new Shared());
+	if (!shared->segment.attach(name, m_capacity, m_blockSize)) return false;
+	
+	// Only the scratch frame is still needed
+	m_capacity = 0;
+	m_memory = allocateAligned(m_blockSize, m_blockSize);
+	m_frames.clear();
+	m_free.clear();
+	m_table.clear();
+	m_shared = std::move(shared);
+	
+	return true;
+}
+
+std::size_t BlockCache::blockSize() const {
+	return m_blockSize;
+}
+
+const char* BlockCache::lookup(int fd, long offset) {
+	if (m_shared) {
+		SharedBlockCache::FileKey key;
+		auto block = m_shared->keyOf(fd, key)? m_shared->segment.lookup(key, offset) : nullptr;
+		if (!block) return nullptr;
+		
+		++m_stats.hits;
+		return m_shared->hold(fd, block);
+	}
+	
+	auto index = find({ fd, offset });
+	if (index == m_capacity) return nullptr;
+	
+	++m_stats.hits;
+	touch(index);
+	return frame(index);
+}
+
+const char* BlockCache::read(int fd, long offset, Priority priority, bool& fetched) {
+	fetched = false;
+	
+	if (auto cached = lookup(fd, offset)) return cached;
+	if (m_shared) return readShared(fd, offset, priority, fetched);
+	
+	auto index = acquire(priority);
+	char *data = index < m_capacity? frame(index) : scratch();
+	
+	if (pread(fd, data, m_blockSize, offset) != static_cast<ssize_t>(m_blockSize)) {
+		if (index < m_capacity) m_free.push_back(index);
+		return nullptr;
+	}
+	
+	++m_stats.misses;
+	fetched = true;
+	
+	if (index < m_capacity) bind(index, { fd, offset }, priority);
+	return data;
+}
+
+void BlockCache::insert(int fd, long offset, const void *data, Priority priority) {
+	if (m_shared) {
+		writeShared(fd, offset, data, m_blockSize, priority, false);
+		return;
+	}
+	
+	Key key = { fd, offset };
+	auto cached = find(key);
+	
+	if (cached < m_capacity) {
+		std::memcpy(frame(cached), data, m_blockSize);
+		touch(cached);
+		return;
+	}
+	
+	// Only a block that wasn't cached yet is a miss
+	++m_stats.misses;
+	
+	auto index = acquire(priority);
+	if (index == m_capacity) return;
+	
+	std::memcpy(frame(index), data, m_blockSize);
+	bind(index, key, priority);
+}
+
+bool BlockCache::write(int fd, long offset, const void *data, std::size_t size, Priority priority) {
+	if (m_shared) return writeShared(fd, offset, data, size, priority, true);
+	
+	Key key = { fd, offset };
+	auto index = find(key);
+	
+	if (index < m_capacity) {
+		touch(index);
+	}
+	else {
+		index = acquire(priority);
+		if (index < m_capacity) bind(index, key, priority);
+	}
+	
+	char *block = index < m_capacity? frame(index) : scratch();
+	std::memcpy(block, data, size);
+	std::memset(block + size, 0, m_blockSize - size);
+	
+	return pwrite(fd, block, m_blockSize, offset) == static_cast<ssize_t>(m_blockSize);
+}
+
+void BlockCache::forget(int fd) {
+	if (m_shared) {
+		// Blocks stay in the segment for the other processes
+		m_shared->release(fd);
+		m_shared->files.erase(fd);
+		return;
+	}
+	
+	for (auto& list : m_lru) {
+		for (auto index = list.first; index < m_capacity;) {
+			auto next = m_frames[index].next;
+			if (m_frames[index].key.fd == fd) release(index);
+			index = next;
+		}
+	}
+}
+
+void BlockCache::pin(const char *block) {
+	if (m_shared) {
+		if (m_shared->segment.holds(block)) m_shared->segment.pin(block);
+		return;
+	}
+	
+	auto index = frameOf(block);
+	if (index < m_capacity) ++m_frames[index].pins;
+}
+
+void BlockCache::unpin(const char *block) {
+	if (m_shared) {
+		if (m_shared->segment.holds(block)) m_shared->segment.unpin(block);
+		return;
+	}
+	
+	auto index = frameOf(block);
+	if (index < m_capacity && m_frames[index].pins > 0) --m_frames[index].pins;
+}
+
+const BlockCache::Statistics& BlockCache::getStatistics() const {
+	return m_stats;
+}
+
+char* BlockCache::frame(std::size_t index) const {
+	return m_memory.get() + index * m_blockSize;
+}
+
+char* BlockCache::scratch() const {
+	return frame(m_capacity);
+}
+
+std::size_t BlockCache::frameOf(const char *block) const {
+	return (block - m_memory.get()) / m_blockSize;
+}
+
+void BlockCache::touch(std::size_t index) {
+	unlink(index);
+	link(index);
+}
+
+void BlockCache::link(std::size_t index) {
+	auto& list = m_lru[m_frames[index].priority];
+	auto& frame = m_frames[index];
+	
+	frame.previous = m_capacity;
+	frame.next = list.first;
+	
+	if (list.first < m_capacity) m_frames[list.first].previous = index;
+	else list.last = index;
+	
+	list.first = index;
+}
+
+void BlockCache::unlink(std::size_t index) {
+	auto& list = m_lru[m_frames[index].priority];
+	auto& frame = m_frames[index];
+	
+	if (frame.previous < m_capacity) m_frames[frame.previous].next = frame.next;
+	else list.first = frame.next;
+	
+	if (frame.next < m_capacity) m_frames[frame.next].previous = frame.previous;
+	else list.last = frame.previous;
+}
+
+std::size_t BlockCache::homeOf(const Key& key) const {
+	// Offsets are multiples of the block size, so the hash is spread over
+	// every bit before taking the top ones (Fibonacci hashing)
+	return static_cast<std::size_t>((static_cast<std::uint64_t>(KeyHash()(key)) * 0x9E3779B97F4A7C15ull) >> m_tableShift);
+}
+
+std::size_t BlockCache::find(const Key& key) const {
+	if (m_table.empty()) return m_capacity;
+	
+	auto mask = m_table.size() - 1;
+	
+	for (auto slot = homeOf(key); m_table[slot] < m_capacity; slot = (slot + 1) & mask) {
+		if (m_frames[m_table[slot]].key == key) return m_table[slot];
+	}
+	
+	return m_capacity;
+}
+
+void BlockCache::enter(std::size_t index) {
+	auto mask = m_table.size() - 1;
+	auto slot = homeOf(m_frames[index].key);
+	
+	while (m_table[slot] < m_capacity) slot = (slot + 1) & mask;
+	m_table[slot] = index;
+}
+
+void BlockCache::remove(std::size_t index) {
+	auto mask = m_table.size() - 1;
+	auto hole = homeOf(m_frames[index].key);
+	
+	while (m_table[hole] != index) hole = (hole + 1) & mask;
+	
+	// A frame further on moves into the hole unless its search starts after
+	// the hole, in which case it would no longer be found there
+	for (auto slot = (hole + 1) & mask; m_table[slot] < m_capacity; slot = (slot + 1) & mask) {
+		auto home = homeOf(m_frames[m_table[slot]].key);
+		
+		if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+			m_table[hole] = m_table[slot];
+			hole = slot;
+		}
+	}
+	
+	m_table[hole] = m_capacity;
+}
+
+std::size_t BlockCache::acquire(Priority priority) {
+	if (!m_free.empty()) {
+		auto index = m_free.back();
+		m_free.pop_back();
+		return index;
+	}
+	
+	// Record pages are always the first to go. Index pages can only be evicted
+	// to make room for other index pages. Pinned blocks are passed over; they
+	// are few, since handles only live for the length of a lookup.
+	for (auto victims : { RecordPage, IndexPage }) {
+		if (priority == RecordPage && victims == IndexPage) break;
+		
+		for (auto index = m_lru[victims].last; index < m_capacity; index = m_frames[index].previous) {
+			if (m_frames[index].pins > 0) continue;
+			
+			remove(index);
+			unlink(index);
+			++m_stats.evictions;
+			return index;
+		}
+	}
+	
+	++m_stats.bypasses;
+	return m_capacity;
+}
+
+void BlockCache::bind(std::size_t index, const Key& key, Priority priority) {
+	m_frames[index].key = key;
+	m_frames[index].priority = priority;
+	m_frames[index].pins = 0;
+	
+	link(index);
+	enter(index);
+}
+
+void BlockCache::release(std::size_t index) {
+	remove(index);
+	unlink(index);
+	m_free.push_back(index);
+}
+
+const char* BlockCache::readShared(int fd, long offset, Priority priority, bool& fetched) {
+	SharedBlockCache::FileKey key;
+	bool evicted = false;
+	
+	char *claimed = m_shared->keyOf(fd, key)? m_shared->segment.claim(priority, evicted) : nullptr;
+	char *data = claimed? claimed : scratch();
+	
+	if (evicted) ++m_stats.evictions;
+	if (!claimed) ++m_stats.bypasses;
+	
+	if (pread(fd, data, m_blockSize, offset) != static_cast<ssize_t>(m_blockSize)) {
+		if (claimed) m_shared->segment.abandon(claimed);
+		return nullptr;
+	}
+	
+	++m_stats.misses;
+	fetched = true;
+	
+	if (!claimed) return data;
+	return m_shared->hold(fd, m_shared->segment.publish(claimed, key, offset, priority));
+}
+
+bool BlockCache::writeShared(int fd, long offset, const void *data, std::size_t size, Priority priority, bool toDevice) {
+	SharedBlockCache::FileKey key;
+	bool known = m_shared->keyOf(fd, key), evicted = false;
+	
+	auto& segment = m_shared->segment;
+	
+	// A block only being cached is the same as the one on the device, so a
+	// copy already in the segment is as good
+	if (!toDevice && known) {
+		if (auto cached = segment.lookup(key, offset)) {
+			segment.unpin(cached);
+			return true;
+		}
+	}
+	
+	// Other processes may be reading the frame the block is in, so the block
+	// goes to a frame of its own, which then takes the old one's place
+	char *claimed = known? segment.claim(priority, evicted) : nullptr;
+	
+	if (evicted) ++m_stats.evictions;
+	if (!toDevice) ++m_stats.misses;
+	
+	if (!claimed) {
+		if (known) ++m_stats.bypasses;
+		if (!toDevice) return true;
+		
+		// The copy in the segment, if any, would be out of date
+		if (known) segment.discard(key, offset);
+	}
+	
+	char *block = claimed? claimed : scratch();
+	std::memcpy(block, data, size);
+	std::memset(block + size, 0, m_blockSize - size);
+	
+	bool written = !toDevice || pwrite(fd, block, m_blockSize, offset) == static_cast<ssize_t>(m_blockSize);
+	
+	if (claimed) {
+		if (written) {
+			segment.unpin(segment.publish(claimed, key, offset, priority, toDevice));
+		}
+		else {
+			segment.abandon(claimed);
+			segment.discard(key, offset);
+		}
+	}
+	
+	return written;
+}
@@ -0,0 +1,198 @@
+#include "BlockFile.hpp"
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Offsets are kept in longs everywhere, and files can grow well past 2GB
+static_assert(sizeof(long) >= sizeof(off_t) && sizeof(off_t) >= 8, "Offsets need 64-bit longs and a 64-bit off_t");
+
+// --- //
+
+PageRef::PageRef()
+	: m_data(nullptr)
+	, m_cache(nullptr)
+{	}
+
+PageRef::PageRef(const char *data, BlockCache *cache)
+	: m_data(data)
+	, m_cache(cache)
+{
+	if (m_cache) m_cache->pin(m_data);
+}
+
+PageRef::~PageRef() {
+	reset();
+}
+
+PageRef::PageRef(PageRef&& that)
+	: m_data(that.m_data)
+	, m_cache(that.m_cache)
+{
+	that.m_data = nullptr;
+	that.m_cache = nullptr;
+}
+
+PageRef& PageRef::operator=(PageRef&& that) {
+	if (this != &that) {
+		reset();
+		
+		m_data = that.m_data;
+		m_cache = that.m_cache;
+		that.m_data = nullptr;
+		that.m_cache = nullptr;
+	}
+	
+	return *this;
+}
+
+const char* PageRef::data() const {
+	return m_data;
+}
+
+PageRef::operator bool() const {
+	return m_data != nullptr;
+}
+
+void PageRef::reset() {
+	if (m_cache) m_cache->unpin(m_data);
+	
+	m_data = nullptr;
+	m_cache = nullptr;
+}
+
+// --- //
+
+BlockFile::BlockFile()
+	: m_file(nullptr)
+	, m_cache(nullptr)
+	, m_priority(BlockCache::IndexPage)
+	, m_blockSize(0)
+	, m_fd(-1)
+{	}
+
+BlockFile::~BlockFile() {
+	close();
+}
+
+void BlockFile::useCache(BlockCache *cache, BlockCache::Priority priority) {
+	m_cache = cache;
+	m_priority = priority;
+}
+
+void BlockFile::setBlockSize(std::size_t blockSize) {
+	m_blockSize = blockSize;
+}
+
+bool BlockFile::create(const char *filepath) {
+	close();
+	
+	if (m_cache) {
+		m_fd = openDirect(filepath, O_RDWR | O_CREAT | O_TRUNC);
+		return m_fd >= 0;
+	}
+	else {
+		m_file = std::fopen(filepath, "wb+");
+		return m_file;
+	}
+}
+
+bool BlockFile::open(const char *filepath, bool writable) {
+	close();
+	
+	if (m_cache) {
+		m_fd = openDirect(filepath, writable? O_RDWR : O_RDONLY);
+		return m_fd >= 0;
+	}
+	else {
+		m_file = std::fopen(filepath, writable? "rb+" : "rb");
+		return m_file;
+	}
+}
+
+void BlockFile::close() {
+	if (m_file) {
+		std::fclose(m_file);
+		m_file = nullptr;
+	}
+	
+	if (m_fd >= 0) {
+		m_cache->forget(m_fd);
+		::close(m_fd);
+		m_fd = -1;
+	}
+}
+
+bool BlockFile::isOpen() const {
+	return m_file || m_fd >= 0;
+}
+
+bool BlockFile::read(long offset, void *data, std::size_t size, bool *fetched) const {
+	if (m_cache) {
+		bool f;
+		auto block = m_cache->read(m_fd, offset, m_priority, f);
+		if (fetched) *fetched = f;
+		
+		if (!block) return false;
+		
+		std::copy(block, block + size, static_cast<char*>(data));
+		return true;
+	}
+	
+	if (fetched) *fetched = true;
+	
+	return !fseeko(m_file, offset, SEEK_SET)
+		&& std::fread(data, 1, size, m_file) == size;
+}
+
+PageRef BlockFile::view(long offset, void *buffer, std::size_t size, bool *fetched) const {
+	if (m_cache) {
+		bool f;
+		auto block = m_cache->read(m_fd, offset, m_priority, f);
+		if (fetched) *fetched = f;
+		
+		return PageRef(block, block? m_cache : nullptr);
+	}
+	
+	if (!read(offset, buffer, size, fetched)) return PageRef();
+	return PageRef(static_cast<const char*>(buffer), nullptr);
+}
+
+void BlockFile::write(long offset, const void *data, std::size_t size) {
+	if (m_cache) {
+		m_cache->write(m_fd, offset, data, size, m_priority);
+		return;
+	}
+	
+	fseeko(m_file, offset, SEEK_SET);
+	std::fwrite(data, 1, size, m_file);
+	
+	// Writing the last byte is enough to have the whole block in the file
+	if (size < m_blockSize) {
+		fseeko(m_file, offset + m_blockSize - 1, SEEK_SET);
+		std::fputc(0, m_file);
+	}
+}
+
+long BlockFile::end() const {
+	if (m_cache) {
+		return lseek(m_fd, 0, SEEK_END);
+	}
+	
+	fseeko(m_file, 0, SEEK_END);
+	return ftello(m_file);
+}
+
+int BlockFile::descriptor() const {
+	if (m_file) {
+		std::fflush(m_file);
+		return fileno(m_file);
+	}
+	
+	return m_fd;
+}
+
+BlockCache* BlockFile::cache() const {
+	return m_cache;
+}
@@ -0,0 +1,143 @@
+#include "BloomFilter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "Block.hpp"
+
+// --- //
+
+//! Distance between the bits a key sets within its block
+/*!
+ * The block is chosen from the hash's upper half and the first bit from its
+ * lower half, so the stride comes from another mix of the whole hash: taken
+ * from the upper half as well, keys sharing a block would nearly share it,
+ * and set the same bits more often than the sizing assumes.
+ *
+ * @param keyHash Hash of the key
+ *
+ * @return Odd stride, so that the bits only repeat after the whole block
+ */
+static std::uint32_t probeStride(std::uint64_t keyHash) {
+	// MurmurHash3's finalizer with other constants (Stafford's variant 13)
+	keyHash ^= keyHash >> 30;
+	keyHash *= 0xbf58476d1ce4e5b9ull;
+	keyHash ^= keyHash >> 27;
+	keyHash *= 0x94d049bb133111ebull;
+	keyHash ^= keyHash >> 31;
+	return static_cast<std::uint32_t>(keyHash) | 1;
+}
+
+BloomFilter::BloomFilter()
+	: m_blockCount(0)
+	, m_hashCount(0)
+	, m_stats({ 0, 0, 0 })
+{	}
+
+BloomFilter::BloomFilter(std::size_t keyCount, double falsePositiveRate)
+	: m_stats({ 0, 0, 0 })
+{
+	// Classic sizing: m = -n ln(p) / ln(2)^2 bits and k = -log2(p) hashes.
+	// Blocking raises the actual rate a little, which the extra 10% makes up for.
+	double bitsPerKey = -std::log(falsePositiveRate) / (std::log(2.0) * std::log(2.0)) * 1.1;
+	auto bitCount = static_cast<std::uint64_t>(std::max<std::size_t>(keyCount, 1) * bitsPerKey);
+	
+	m_blockCount = std::max<std::uint64_t>(1, (bitCount + 511) / 512);
+	m_hashCount = std::min(16, std::max(1, static_cast<int>(std::round(-std::log2(falsePositiveRate)))));
+	m_bits.assign(m_blockCount * BlockWords, 0);
+}
+
+std::uint64_t BloomFilter::hash(const void *data, std::size_t size) {
+	// FNV-1a followed by MurmurHash3's finalizer for better bit dispersion
+	auto bytes = static_cast<const unsigned char*>(data);
+	std::uint64_t h = 14695981039346656037ull;
+	
+	for (std::size_t i = 0; i < size; ++i) {
+		h = (h ^ bytes[i]) * 1099511628211ull;
+	}
+	
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+void BloomFilter::add(std::uint64_t keyHash) {
+	auto block = m_bits.data() + ((keyHash >> 32) * m_blockCount >> 32) * BlockWords;
+	auto a = static_cast<std::uint32_t>(keyHash);
+	auto b = probeStride(keyHash);
+	
+	for (std::uint32_t i = 0; i < m_hashCount; ++i) {
+		auto bit = (a + i * b) & 511;
+		block[bit >> 6] |= std::uint64_t(1) << (bit & 63);
+	}
+}
+
+bool BloomFilter::mayContain(std::uint64_t keyHash) const {
+	++m_stats.lookups;
+	
+	auto block = m_bits.data() + ((keyHash >> 32) * m_blockCount >> 32) * BlockWords;
+	auto a = static_cast<std::uint32_t>(keyHash);
+	auto b = probeStride(keyHash);
+	
+	for (std::uint32_t i = 0; i < m_hashCount; ++i) {
+		auto bit = (a + i * b) & 511;
+		
+		if (!(block[bit >> 6] & (std::uint64_t(1) << (bit & 63)))) {
+			++m_stats.negatives;
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+void BloomFilter::reportFalsePositive() const {
+	++m_stats.falsePositives;
+}
+
+bool BloomFilter::save(const char *filepath) const {
+	std::FILE *file = std::fopen(filepath, "wb");
+	if (!file) return false;
+	
+	FileHeader header = { FORMAT_VERSION, m_hashCount, m_blockCount };
+	bool written = std::fwrite(&header, sizeof(header), 1, file)
+		&& std::fwrite(m_bits.data(), sizeof(std::uint64_t), m_bits.size(), file) == m_bits.size();
+	
+	std::fclose(file);
+	return written;
+}
+
+bool BloomFilter::load(const char *filepath) {
+	std::FILE *file = std::fopen(filepath, "rb");
+	if (!file) return false;
+	
+	FileHeader header;
+	// Filters of another format would set and probe other bits
+	bool read = std::fread(&header, sizeof(header), 1, file) && header.version == FORMAT_VERSION && header.blockCount > 0;
+	
+	if (read) {
+		m_bits.resize(header.blockCount * BlockWords);
+		read = std::fread(m_bits.data(), sizeof(std::uint64_t), m_bits.size(), file) == m_bits.size();
+	}
+	
+	std::fclose(file);
+	
+	if (read) {
+		m_blockCount = header.blockCount;
+		m_hashCount = header.hashCount;
+	}
+	
+	return read;
+}
+
+std::size_t BloomFilter::byteSize() const {
+	return m_bits.size() * sizeof(std::uint64_t);
+}
+
+const BloomFilter::Statistics& BloomFilter::getStatistics() const {
+	return m_stats;
+}
@@ -1,10 +1,35 @@
 #include "Commands.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
-#include "IdealBTree.hpp"
+#include "AsyncReader.hpp"
+#include "BloomFilter.hpp"
+#include "CoveringIndex.hpp"
 #include "Entry.hpp"
+#include "ExtendibleHash.hpp"
+#include "ExternalSorter.hpp"
+#include "Hashfile.hpp"
+#include "IdealBTree.hpp"
+#include "LsmTree.hpp"
+#include "PackedPostingFile.hpp"
+#include "PartitionedHashfile.hpp"
+#include "PartitionMap.hpp"
+#include "PostingFile.hpp"
+#include "PostingIntersection.hpp"
 
 // --- //
 
@@ -16,51 +41,169 @@
 //! Full filepath to the primary index file
 #define ID_TREE_FILEPATH ROOT ID_TREE_FILENAME
 
+//! Prefix of the files of the primary index runs written by append
+#define ID_LSM_PREFIX "bd-idruns"
+//! Full filepath prefix of the primary index runs, see LsmTree
+#define ID_LSM_FILEPATH_PREFIX ROOT ID_LSM_PREFIX
+
 //! Secondary index data filename
 #define TITLE_TREE_FILENAME "bd-titletree.bin"
 //! Full filepath to the secondary index file
 #define TITLE_TREE_FILEPATH ROOT TITLE_TREE_FILENAME
 
+//! Secondary index data filename, when uploaded as an extendible hash
+#define TITLE_HASH_FILENAME "bd-titlehash.bin"
+//! Full filepath to the secondary index file, when uploaded as an extendible hash
+#define TITLE_HASH_FILEPATH ROOT TITLE_HASH_FILENAME
+
+//! Secondary index posting lists filename
+#define TITLE_POSTINGS_FILENAME "bd-titlepostings.bin"
+//! Full filepath to the secondary index posting lists
+#define TITLE_POSTINGS_FILEPATH ROOT TITLE_POSTINGS_FILENAME
+
+//! Author index data filename
+#define AUTHOR_TREE_FILENAME "bd-authortree.bin"
+//! Full filepath to the author index file
+#define AUTHOR_TREE_FILEPATH ROOT AUTHOR_TREE_FILENAME
+
+//! Author index posting lists filename
+#define AUTHOR_POSTINGS_FILENAME "bd-authorpostings.bin"
+//! Full filepath to the author index posting lists
+#define AUTHOR_POSTINGS_FILEPATH ROOT AUTHOR_POSTINGS_FILENAME
+
+//! Full-text index data filename
+#define TERM_TREE_FILENAME "bd-termtree.bin"
+//! Full filepath to the full-text index file
+#define TERM_TREE_FILEPATH ROOT TERM_TREE_FILENAME
+
+//! Full-text index posting lists filename
+#define TERM_POSTINGS_FILENAME "bd-termpostings.bin"
+//! Full filepath to the full-text index posting lists
+#define TERM_POSTINGS_FILEPATH ROOT TERM_POSTINGS_FILENAME
+
+//! Primary index Bloom filter filename
+#define ID_FILTER_FILENAME "bd-idtree.bloom"
+//! Full filepath to the primary index Bloom filter
+#define ID_FILTER_FILEPATH ROOT ID_FILTER_FILENAME
+
+//! Secondary index Bloom filter filename
+#define TITLE_FILTER_FILENAME "bd-titletree.bloom"
+//! Full filepath to the secondary index Bloom filter
+#define TITLE_FILTER_FILEPATH ROOT TITLE_FILTER_FILENAME
+
+//! Covering index declarations filename
+#define CATALOG_FILENAME "bd-catalog.bin"
+//! Full filepath to the covering index declarations
+#define CATALOG_FILEPATH ROOT CATALOG_FILENAME
+
 //! Hashing file filename
 #define HASHFILE_FILENAME "bd-hashfile.bin"
 //! Full filepath to the hashing file
 #define HASHFILE_FILEPATH ROOT HASHFILE_FILENAME
 
-//! %Block size in bytes to be used in the hashing file
-#define HASHFILE_BLOCK_SIZE BLOCK_SIZE
+//! Partition map filename, for databases uploaded in partitions
+#define PARTITION_MAP_FILENAME "bd-partitions.bin"
+//! Full filepath to the partition map
+#define PARTITION_MAP_FILEPATH ROOT PARTITION_MAP_FILENAME
 
 //! Show how many entries have already been read and indexed every once in a while
 #define PATIENCE_STEP 10000
 
+//! Entries handed at once to the builder of a partition, see PartitionFeed
+#define PARTITION_FEED_BATCH 256
+
+//! Batches that can wait for the builder of a partition before reading the input stops, see PartitionFeed
+#define PARTITION_FEED_DEPTH 4
+
+//! Quantity of hashfile offsets kept inside a TitleIndex
+/*!
+ * Titles shared by more entries than this keep the other offsets in the
+ * secondary index posting lists.
+ */
+#define TITLE_INLINE_POSTINGS 3
+
+//! Max size in characters of an author name in the author index
+/*!
+ * Longer names are cut, both when they're indexed and when they're sought.
+ */
+#define AUTHOR_CHAR_MAX 100
+
+//! Separator of the author names in Entry::authors
+#define AUTHOR_SEPARATOR '|'
+
+//! Max size in characters of a term in the full-text index
+/*!
+ * Longer words are cut, both when they're indexed and when they're searched.
+ */
+#define TERM_CHAR_MAX 32
+
 // --- //
 
 //! Helper struct to store primary indexes
 struct IdIndex {
-	int id; //!< Entry id
+	std::int64_t id; //!< Entry id
 	long offset; //!< Entry offset in the hashfile
 	
-	//! Less-than comparator so that IdIndex can be used in BTree
+	//! Less-than comparator so that IdIndex can be used in BPlusTree
 	bool operator< (const IdIndex& that) const {
 		return id < that.id;
 	}
 };
 
-//! Less-than comparator between IdIndex::id and int
-bool operator< (const IdIndex& index, int i) {
+//! Less-than comparator between IdIndex::id and an id
+bool operator< (const IdIndex& index, std::int64_t i) {
 	return index.id < i;
 }
 
-//! Less-than comparator between int and IdIndex::id
-bool operator< (int i, const IdIndex& index) {
+//! Less-than comparator between an id and IdIndex::id
+bool operator< (std::int64_t i, const IdIndex& index) {
 	return i < index.id;
 }
 
+//! Functor returning IdIndex::id, the separator of the primary index internal nodes
+struct IdIndexKey {
+	std::int64_t operator() (const IdIndex& index) const {
+		return index.id;
+	}
+};
+
+//! Describes IdIndex to DeltaLeaf, so that the primary index leaves are compressed
+/*!
+ * Entries are usually at their home block in the hashfile, which is derived
+ * from the id the same way findrec does, so their offset isn't stored.
+ *
+ * @tparam BlockSize %Block size of the hashfile
+ */
+template <unsigned int BlockSize>
+struct IdIndexCodec {
+	static std::int64_t key(const IdIndex& index) { return index.id; }
+	
+	static long payload(const IdIndex& index) { return index.offset; }
+	
+	static long derivedPayload(std::int64_t id) {
+		return BlockSize /* header */ + BlockSize * static_cast<long>(id);
+	}
+	
+	static IdIndex make(std::int64_t id, long offset) {
+		IdIndex index;
+		index.id = id;
+		index.offset = offset;
+		return index;
+	}
+};
+
 //! Helper struct to store secondary indexes
+/*!
+ * There's a single TitleIndex per title, pointing to all the entries with the
+ * title.
+ */
 struct TitleIndex {
 	char title[TITLE_CHAR_MAX]; //!< Entry title
-	long offset; //!< Entry offset in the hashfile
-
-	//! Less-than comparator so that TitleIndex can be used in BTree
+	std::uint64_t count; //!< Quantity of entries with the title
+	long offsets[TITLE_INLINE_POSTINGS]; //!< Offsets in the hashfile of the first entries with the title
+	long postings; //!< Posting list with the offsets of the other entries, -1 if there's none
+	
+	//! Less-than comparator so that TitleIndex can be used in BPlusTree
 	bool operator< (const TitleIndex& that) const {
 		return std::strcmp(title, that.title) < 0;
 	}
@@ -76,406 +219,3166 @@ bool operator< (const char* title, const TitleIndex& index) {
 	return std::strcmp(title, index.title) < 0;
 }
 
-//! Primary index B-tree
-typedef IdealBTree<IdIndex> IdBTree;
-
-//! Secondary index B-tree
-typedef IdealBTree<TitleIndex> TitleBTree;
+//! Separator of the secondary index internal nodes
+/*!
+ * Only the title of a TitleIndex, without the offsets of its entries.
+ */
+struct TitleKey {
+	char title[TITLE_CHAR_MAX]; //!< Entry title
+	
+	//! Less-than comparator so that TitleKey can be used in BPlusTree
+	bool operator< (const TitleKey& that) const {
+		return std::strcmp(title, that.title) < 0;
+	}
+};
 
-// --- //
+//! Less-than comparator between TitleKey::title and string
+bool operator< (const TitleKey& key, const char* title) {
+	return std::strcmp(key.title, title) < 0;
+}
 
-//! Header data for the hashfile
-struct HashfileHeader {
-	int blockCount;
-};
+//! Less-than comparator between string and TitleKey::title
+bool operator< (const char* title, const TitleKey& key) {
+	return std::strcmp(title, key.title) < 0;
+}
 
-//! HashfileHeader block
-typedef Block<HashfileHeader, HASHFILE_BLOCK_SIZE> HashfileHeaderBlock;
+//! Less-than comparator between TitleKey and TitleIndex
+bool operator< (const TitleKey& key, const TitleIndex& index) {
+	return std::strcmp(key.title, index.title) < 0;
+}
 
-//! Entry block
-typedef Block<Entry, HASHFILE_BLOCK_SIZE> EntryBlock;
+//! Less-than comparator between TitleIndex and TitleKey
+bool operator< (const TitleIndex& index, const TitleKey& key) {
+	return std::strcmp(index.title, key.title) < 0;
+}
 
-// --- //
+//! Functor returning the TitleKey of a TitleIndex
+struct TitleIndexKey {
+	TitleKey operator() (const TitleIndex& index) const {
+		TitleKey key;
+		std::memcpy(key.title, index.title, TITLE_CHAR_MAX);
+		return key;
+	}
+};
 
-//! Reads a string field from a line in the CSV file
+//! Order in which the secondary index is built: by title, then by offset
 /*!
- * Will read the quotes-enclosed value from a column in the `;`-delimited CSV
- * file and put it into a char* buffer.
- *
- * Allows the column to be left blank or as `NULL` (no quotes).
- *
- * @param field Buffer to store the read string (must be at least as big as `fieldSize`)
- * @param file File where the contents will be read
- * @param fieldSize Maximum field size in characters
+ * Entries with the same title come one after the other in id order, so that
+ * they're grouped under the first one in the order they'd have been inserted.
  */
-static void readStringField(char *field, std::FILE *file, int fieldSize) {
-	char previous = ';';
-	char current = std::fgetc(file);
-	int index = 0;
+struct TitleIndexBuildOrder {
+	bool operator() (const TitleIndex& a, const TitleIndex& b) const {
+		int difference = std::strcmp(a.title, b.title);
+		return difference < 0 || (difference == 0 && a.offsets[0] < b.offsets[0]);
+	}
+};
 
-	switch (current) {
-	// Case in which the field has no characters: ;;
-	case ';':
-		break;
-	
-	// Case in which the last field has no characters, so there's only an LF line break
-	case '\n':
-		break;
-	
-	// Case in which the last field has no characters, but there's still a CRLF line break
-	case '\r':
-		std::fgetc(file); // '\n'
-		break;
-	
-	// Case in which instead of a field there's only NULL
-	case 'N':
-		std::fgetc(file); // 'U'
-		std::fgetc(file); // 'L'
-		std::fgetc(file); // 'L'
-		if (std::fgetc(file) == '\r') std::fgetc(file); // Skips the line break, be it LF or CRLF
-		break;
+//! Secondary index value pointing to a single entry
+/*!
+ * @param e Entry
+ * @param offset Entry offset in the hashfile
+ */
+static TitleIndex makeTitleIndex(const Entry& e, long offset) {
+	TitleIndex index;
+	std::memcpy(index.title, e.title, TITLE_CHAR_MAX);
+	index.count = 1;
+	index.offsets[0] = offset;
+	std::fill(index.offsets + 1, index.offsets + TITLE_INLINE_POSTINGS, -1);
+	index.postings = -1;
 	
-	// Case in which there's a string in the field
-	case '"':
-		while (true) {
-			previous = current;
-			current = fgetc(file);
-			
-			if (previous == '"') {
-				bool fieldEnded = false;
-				
-				// If the quotes are followed by either of these elements, then we've reached the end of the field
-				switch (current) {
-				case '\r':
-					std::fgetc(file); // '\n'
-				case ';':
-				case '\n':
-				case EOF:
-					--index;
-					fieldEnded = true;
-					break;
-				}
-				
-				if (fieldEnded) break;
-			}
-			
-			if (current >= 0) {
-				// Only insert the character in the buffer if there's still
-				// space left (taking into account the '\0' end character).
-				// We'll keep reading the file until the end of the column.
-				if (index < fieldSize - 1) {
-					field[index] = current;
-				}
+	return index;
+}
 
-				++index;
-			}
-		}
-		
-		break;
+//! Adds an entry with a title that's already indexed to its TitleIndex
+/*!
+ * @param index Value of the title
+ * @param offset Entry offset in the hashfile
+ * @param postings Posting lists, for the offsets that don't fit in the value
+ */
+static void addTitleEntry(TitleIndex& index, long offset, PostingFile& postings) {
+	if (index.count < TITLE_INLINE_POSTINGS) {
+		index.offsets[index.count] = offset;
 	}
-	
-	if (index >= fieldSize) {
-		index = fieldSize - 1;
+	else {
+		index.postings = postings.append(index.postings, offset);
 	}
 	
-	field[index] = '\0';
+	++index.count;
 }
 
-//! Reads a whole line, field by field, from the CSV file
+//! Helper struct to store author indexes
 /*!
- * @param e Entry to read
- * @param file File with contents
- *
- * @return True if the entry was successfully read, false if we've reached the end of the file
+ * There's a single AuthorIndex per author, pointing to the posting list of
+ * all the entries with the author.
  */
-static bool readEntry(Entry& e, std::FILE *file) {
-	int endChecker = std::fscanf(file, "\"%d\";", &e.id);
+struct AuthorIndex {
+	char author[AUTHOR_CHAR_MAX]; //!< Author name
+	long postings; //!< Posting list with the offsets of the entries, see PackedPostingFile
 	
-	if (endChecker < 0) {
-		e.valid = false;
-		return false;
+	//! Less-than comparator so that AuthorIndex can be used in BPlusTree
+	bool operator< (const AuthorIndex& that) const {
+		return std::strcmp(author, that.author) < 0;
 	}
+};
 
-	readStringField(e.title, file, TITLE_CHAR_MAX);
-	std::fscanf(file, "\"%d\";", &e.year);
-	readStringField(e.authors, file, AUTHORS_CHAR_MAX);
-	std::fscanf(file, "\"%d\";", &e.citations);
-	readStringField(e.updateTimestamp, file, TIMESTAMP_CHAR_MAX);
-	readStringField(e.snippet, file, SNIPPET_CHAR_MAX);
+//! Less-than comparator between AuthorIndex::author and string
+bool operator< (const AuthorIndex& index, const char* author) {
+	return std::strcmp(index.author, author) < 0;
+}
+
+//! Less-than comparator between string and AuthorIndex::author
+bool operator< (const char* author, const AuthorIndex& index) {
+	return std::strcmp(author, index.author) < 0;
+}
+
+//! Separator of the author index internal nodes
+struct AuthorKey {
+	char author[AUTHOR_CHAR_MAX]; //!< Author name
 	
-	e.valid = true;
-	return true;
+	//! Less-than comparator so that AuthorKey can be used in BPlusTree
+	bool operator< (const AuthorKey& that) const {
+		return std::strcmp(author, that.author) < 0;
+	}
+};
+
+//! Less-than comparator between AuthorKey::author and string
+bool operator< (const AuthorKey& key, const char* author) {
+	return std::strcmp(key.author, author) < 0;
 }
 
-//! Prints an entry field by field
-/*!
- * @param e Entry to print
- */
-static void printEntry(const Entry& e) {
-	std::cout << "id        : " << e.id << '\n';
-	std::cout << "title     : " << e.title << '\n';
-	std::cout << "year      : " << e.year << '\n';
-	std::cout << "authors   : " << e.authors << '\n';
-	std::cout << "citations : " << e.citations << '\n';
-	std::cout << "timestamp : " << e.updateTimestamp << '\n';
-	std::cout << "snippet   : " << e.snippet << '\n' << std::endl;
+//! Less-than comparator between string and AuthorKey::author
+bool operator< (const char* author, const AuthorKey& key) {
+	return std::strcmp(author, key.author) < 0;
 }
 
-// ---
+//! Less-than comparator between AuthorKey and AuthorIndex
+bool operator< (const AuthorKey& key, const AuthorIndex& index) {
+	return std::strcmp(key.author, index.author) < 0;
+}
 
-void upload(const char* filePath) {
-	// Phantom entry that'll be used to pad the spaces between id's
-	static auto phantomEntry = []{
-			EntryBlock pe;
-			pe.var.valid = false;
-			return pe;
-		}();
-	
-	#ifdef DEBUG
-	std::cout << "[DEBUG]\n";
-	#endif
-	
-	std::cout << "Default block size in use : " << BLOCK_SIZE << " bytes\n";
-	std::cout << "Id B-tree order (M)       : " << IdBTree::Order << '\n';
-	std::cout << "Title B-tree order (M)    : " << TitleBTree::Order << "\n\n";
-	
-	std::cout << "Opening files...\n\n";
+//! Less-than comparator between AuthorIndex and AuthorKey
+bool operator< (const AuthorIndex& index, const AuthorKey& key) {
+	return std::strcmp(index.author, key.author) < 0;
+}
 
-	std::FILE *input = std::fopen(filePath, "rb");
-	if (!input) {
-		std::cout << "Couldn't open input file.\n";
-		std::cout << "Filepath: \"" << filePath << "\"\n";
-		std::cout << "Aborting." << std::endl;
-		return;
+//! Functor returning the AuthorKey of an AuthorIndex
+struct AuthorIndexKey {
+	AuthorKey operator() (const AuthorIndex& index) const {
+		AuthorKey key;
+		std::memcpy(key.author, index.author, AUTHOR_CHAR_MAX);
+		return key;
 	}
-	
-	IdBTree idTree;
-	if (!idTree.create(ID_TREE_FILEPATH)) {
-		std::cout << "Couldn't create the primary index file.\n";
-		std::cout << "Filepath: \"" << ID_TREE_FILEPATH << "\"\n";
-		std::cout << "Aborting." << std::endl;
-		return;
-	}
-	
-	std::cout << "Primary index file created at \"" << ID_TREE_FILEPATH << "\"\n";
-	
-	TitleBTree titleTree;
-	if (!titleTree.create(TITLE_TREE_FILEPATH)) {
-		std::cout << "Couldn't create the secondary index file.\n";
-		std::cout << "Filepath: \"" << TITLE_TREE_FILEPATH << "\"\n";
-		std::cout << "Aborting." << std::endl;
-		return;
+};
+
+//! An author of an entry, as sorted to build the author index
+struct AuthorPosting {
+	char author[AUTHOR_CHAR_MAX]; //!< Author name
+	long offset; //!< Entry offset in the hashfile
+};
+
+//! Order in which the author index is built: by author, then by offset
+struct AuthorPostingOrder {
+	bool operator() (const AuthorPosting& a, const AuthorPosting& b) const {
+		int difference = std::strcmp(a.author, b.author);
+		return difference < 0 || (difference == 0 && a.offset < b.offset);
 	}
-	
-	std::cout << "Secondary index file created at \"" << TITLE_TREE_FILEPATH << "\"\n";
-	
-	std::FILE *output = std::fopen(HASHFILE_FILEPATH, "wb");
-	if (!output) {
-		std::cout << "Couldn't create the hashing file.\n";
-		std::cout << "Filepath: \"" << HASHFILE_FILEPATH << "\"\n";
-		std::cout << "Aborting." << std::endl;
-		return;
+};
+
+//! Cuts an author name to the size kept by the author index, without spaces around it
+/*!
+ * @param name First character of the name
+ * @param size Size of the name in characters
+ * @param author Buffer of AUTHOR_CHAR_MAX characters where the name is written
+ *
+ * @return False if the name is blank
+ */
+static bool authorName(const char* name, std::size_t size, char* author) {
+	while (size && std::isspace(static_cast<unsigned char>(name[0]))) {
+		++name;
+		--size;
 	}
 	
-	std::cout << "Hashing file created at \"" << HASHFILE_FILEPATH << "\"\n\n";
-	
-	std::cout << "Begin uploading...\n\n";
+	while (size && std::isspace(static_cast<unsigned char>(name[size - 1]))) --size;
 	
-	HashfileHeaderBlock header;
-	header.var.blockCount = 1;
-	std::fwrite(reinterpret_cast<const char*>(&header), sizeof(header), 1, output);
+	size = std::min<std::size_t>(size, AUTHOR_CHAR_MAX - 1);
+	std::memset(author, 0, AUTHOR_CHAR_MAX);
+	std::memcpy(author, name, size);
 	
-	EntryBlock e;
-	int lastId = -1;
-	unsigned int entriesFound = 0;
+	return size > 0;
+}
+
+//! Adds each author of an entry to the sorter building the author index
+/*!
+ * @param e Entry, whose authors are separated by AUTHOR_SEPARATOR
+ * @param offset Entry offset in the hashfile
+ * @param sorter Sorter of the author index
+ *
+ * @return False if the sorter couldn't write its temporary files
+ */
+static bool addAuthors(const Entry& e, long offset, ExternalSorter<AuthorPosting, AuthorPostingOrder>& sorter) {
+	AuthorPosting posting;
+	posting.offset = offset;
 	
-	while (readEntry(e.var, input)) {
-		if (++entriesFound % PATIENCE_STEP == 0) {
-			std::cout << entriesFound << " entries read so far, patience.\n";
-		}
-		
-		int idDifference = e.var.id - lastId - 1;
-		
-		for (int i = 0; i < idDifference; ++i) {
-			std::fwrite(reinterpret_cast<const char*>(&phantomEntry), sizeof(phantomEntry), 1, output);
-		}
-		
-		header.var.blockCount += idDifference;
-		
-		auto offset = std::ftell(output);
-		std::fwrite(reinterpret_cast<const char*>(&e), sizeof(e), 1, output);
-		++header.var.blockCount;
+	for (const char* name = e.authors; *name; ) {
+		auto end = std::strchr(name, AUTHOR_SEPARATOR);
+		auto size = end? end - name : std::strlen(name);
 		
-		IdIndex idPointer;
-		idPointer.id = e.var.id;
-		idPointer.offset = offset;
-		idTree.insert(idPointer);
+		if (authorName(name, size, posting.author) && !sorter.add(posting)) return false;
 		
-		TitleIndex titlePointer;
-		std::memcpy(titlePointer.title, e.var.title, TITLE_CHAR_MAX);
-		titlePointer.offset = offset;
-		titleTree.insert(titlePointer);
-		
-		lastId = e.var.id;
+		name += size;
+		if (*name) ++name;
 	}
 	
-	titleTree.finishInsertions();
-	idTree.finishInsertions();
+	return true;
+}
+
+//! Helper struct to store full-text indexes
+/*!
+ * There's a single TermIndex per term, pointing to the posting list of all
+ * the entries with the term in their title or snippet.
+ */
+struct TermIndex {
+	char term[TERM_CHAR_MAX]; //!< Term, see forEachTerm
+	std::uint64_t count; //!< Quantity of entries with the term
+	long postings; //!< Posting list with the offsets of the entries, see PackedPostingFile
+	
+	//! Less-than comparator so that TermIndex can be used in BPlusTree
+	bool operator< (const TermIndex& that) const {
+		return std::strcmp(term, that.term) < 0;
+	}
+};
+
+//! Less-than comparator between TermIndex::term and string
+bool operator< (const TermIndex& index, const char* term) {
+	return std::strcmp(index.term, term) < 0;
+}
+
+//! Less-than comparator between string and TermIndex::term
+bool operator< (const char* term, const TermIndex& index) {
+	return std::strcmp(term, index.term) < 0;
+}
+
+//! Separator of the full-text index internal nodes
+struct TermKey {
+	char term[TERM_CHAR_MAX]; //!< Term
+	
+	//! Less-than comparator so that TermKey can be used in BPlusTree
+	bool operator< (const TermKey& that) const {
+		return std::strcmp(term, that.term) < 0;
+	}
+};
+
+//! Less-than comparator between TermKey::term and string
+bool operator< (const TermKey& key, const char* term) {
+	return std::strcmp(key.term, term) < 0;
+}
+
+//! Less-than comparator between string and TermKey::term
+bool operator< (const char* term, const TermKey& key) {
+	return std::strcmp(term, key.term) < 0;
+}
+
+//! Less-than comparator between TermKey and TermIndex
+bool operator< (const TermKey& key, const TermIndex& index) {
+	return std::strcmp(key.term, index.term) < 0;
+}
+
+//! Less-than comparator between TermIndex and TermKey
+bool operator< (const TermIndex& index, const TermKey& key) {
+	return std::strcmp(index.term, key.term) < 0;
+}
+
+//! Functor returning the TermKey of a TermIndex
+struct TermIndexKey {
+	TermKey operator() (const TermIndex& index) const {
+		TermKey key;
+		std::memcpy(key.term, index.term, TERM_CHAR_MAX);
+		return key;
+	}
+};
+
+//! A term of an entry, as sorted to build the full-text index
+struct TermPosting {
+	char term[TERM_CHAR_MAX]; //!< Term
+	long offset; //!< Entry offset in the hashfile
+};
+
+//! Order in which the full-text index is built: by term, then by offset
+struct TermPostingOrder {
+	bool operator() (const TermPosting& a, const TermPosting& b) const {
+		int difference = std::strcmp(a.term, b.term);
+		return difference < 0 || (difference == 0 && a.offset < b.offset);
+	}
+};
+
+//! Splits text in the terms of the full-text index
+/*!
+ * Terms are the runs of letters and digits, lowercased, so that searches
+ * ignore case and punctuation. Bytes past ASCII are taken as letters, so
+ * that words with accented letters aren't split. Terms are cut to
+ * TERM_CHAR_MAX - 1 characters.
+ *
+ * @tparam Visit Callable receiving each term, as a buffer of TERM_CHAR_MAX
+ * characters padded with zeros
+ *
+ * @param text Text to split
+ * @param visit Called with each term, as often as it's in the text
+ */
+template <typename Visit>
+static void forEachTerm(const char* text, Visit visit) {
+	char term[TERM_CHAR_MAX];
+	std::size_t size = 0;
+	
+	for (;; ++text) {
+		auto c = static_cast<unsigned char>(*text);
+		
+		if (c >= 0x80 || std::isalnum(c)) {
+			if (size < TERM_CHAR_MAX - 1) term[size++] = static_cast<char>(std::tolower(c));
+			continue;
+		}
+		
+		if (size) {
+			std::memset(term + size, 0, TERM_CHAR_MAX - size);
+			visit(static_cast<const char*>(term));
+			size = 0;
+		}
+		
+		if (!c) break;
+	}
+}
+
+//! Adds each term of an entry's title and snippet to the sorter building the full-text index
+/*!
+ * Terms are only added once per entry.
+ *
+ * @param e Entry
+ * @param offset Entry offset in the hashfile
+ * @param sorter Sorter of the full-text index
+ *
+ * @return False if the sorter couldn't write its temporary files
+ */
+static bool addTerms(const Entry& e, long offset, ExternalSorter<TermPosting, TermPostingOrder>& sorter) {
+	std::vector<TermPosting> terms;
+	
+	auto gather = [&](const char* term) {
+		terms.emplace_back();
+		std::memcpy(terms.back().term, term, TERM_CHAR_MAX);
+		terms.back().offset = offset;
+	};
+	
+	forEachTerm(e.title, gather);
+	forEachTerm(e.snippet, gather);
+	
+	std::sort(terms.begin(), terms.end(), TermPostingOrder());
+	
+	auto same = [](const TermPosting& a, const TermPosting& b) {
+		return std::strcmp(a.term, b.term) == 0;
+	};
+	
+	terms.erase(std::unique(terms.begin(), terms.end(), same), terms.end());
+	
+	for (auto& posting : terms) {
+		if (!sorter.add(posting)) return false;
+	}
+	
+	return true;
+}
+
+//! Primary index B+ tree
+/*!
+ * Internal nodes only keep the ids, so they have about three times as many
+ * children as they would with whole IdIndex values.
+ *
+ * Keeps subtree counts so that ids in a range can be counted, see count1.
+ *
+ * Leaves are frame-of-reference encoded: ids are mostly consecutive, so they
+ * take a few bits each, and offsets are only kept when the entry isn't at its
+ * home block.
+ *
+ * Like every index type below, it's instantiated for each block size the
+ * database can be uploaded with, see withDatabaseBlockSize.
+ */
+template <unsigned int BlockSize>
+using IdBTree = IdealBPlusTree<IdIndex, std::int64_t, IdIndexKey, BlockSize, true,
+	DeltaLeaf<IdIndex, IdIndexCodec<BlockSize>, maxBPlusTreeLeafBytes<BlockSize>()>>;
+
+//! Secondary index B+ tree
+/*!
+ * Keeps subtree counts so that titles can be found by position, see select2.
+ */
+template <unsigned int BlockSize>
+using TitleBTree = IdealBPlusTree<TitleIndex, TitleKey, TitleIndexKey, BlockSize, true>;
+
+//! Author index B+ tree
+/*!
+ * Values only keep where the author's posting list is, so they're small and
+ * leaves hold many authors.
+ */
+template <unsigned int BlockSize>
+using AuthorBTree = IdealBPlusTree<AuthorIndex, AuthorKey, AuthorIndexKey, BlockSize>;
+
+//! Full-text index B+ tree, the dictionary of the terms
+template <unsigned int BlockSize>
+using TermBTree = IdealBPlusTree<TermIndex, TermKey, TermIndexKey, BlockSize>;
+
+//! Hash of an id as seen by the primary index Bloom filter
+static std::uint64_t filterHash(std::int64_t id) {
+	return BloomFilter::hash(&id, sizeof(id));
+}
+
+//! Hash of an id for the filters of the primary index runs, see LsmTree
+struct IdIndexHash {
+	std::uint64_t operator() (std::int64_t id) const {
+		return filterHash(id);
+	}
+	
+	std::uint64_t operator() (const IdIndex& index) const {
+		return filterHash(index.id);
+	}
+};
+
+//! Primary index runs, holding the entries added by append since the last upload
+template <unsigned int BlockSize>
+using IdLsmTree = LsmTree<IdBTree<BlockSize>, IdIndexHash>;
+
+//! Hash of a title as seen by the secondary index Bloom filter
+static std::uint64_t filterHash(const char* title) {
+	return BloomFilter::hash(title, std::strlen(title));
+}
+
+//! Hash function for TitleIndex, so that titles can be indexed by ExtendibleHash
+/*!
+ * The Bloom filter hash is remixed so that the bits picking the bucket aren't
+ * the ones that picked the filter block: titles that got through the filter
+ * still spread evenly among the buckets.
+ */
+struct TitleHash {
+	std::uint64_t operator() (const char* title) const {
+		auto h = filterHash(title) * 0x9e3779b97f4a7c15ull;
+		return h ^ h >> 29;
+	}
+	
+	std::uint64_t operator() (const TitleIndex& index) const {
+		return (*this)(index.title);
+	}
+};
+
+//! Secondary index extendible hash
+template <unsigned int BlockSize>
+using TitleHashTable = ExtendibleHash<TitleIndex, TitleHash, BlockSize>;
+
+//! Covering index tree, for indexes without the title
+/*!
+ * Entries come in id order, which is random order for a covering index's
+ * keys, so covering indexes are B-epsilon trees: entries are buffered in the
+ * upper nodes and moved down to the leaves in batches.
+ */
+template <unsigned int BlockSize>
+using NarrowCoveringBTree = IdealBEpsilonTree<NarrowCoveringValue, CoveringKey, CoveringKeyOf, BlockSize>;
+
+//! Covering index tree, for indexes including the title
+template <unsigned int BlockSize>
+using TitledCoveringBTree = IdealBEpsilonTree<TitledCoveringValue, CoveringKey, CoveringKeyOf, BlockSize>;
+
+//! Covering index declared on upload, with its B-tree
+/*!
+ * The tree type depends on the declaration, so that only the indexes which
+ * include the title pay for the space it takes.
+ */
+template <unsigned int BlockSize>
+struct DeclaredIndex {
+	IndexDefinition definition; //!< Index declaration
+	std::unique_ptr<NarrowCoveringBTree<BlockSize>> narrow; //!< Tree, if the title isn't included
+	std::unique_ptr<TitledCoveringBTree<BlockSize>> titled; //!< Tree, if the title is included
+	
+	//! Creates the tree matching the declaration, without opening any file
+	explicit DeclaredIndex(const IndexDefinition& definition)
+		: definition(definition)
+	{
+		if (definition.includesTitle) titled.reset(new TitledCoveringBTree<BlockSize>);
+		else narrow.reset(new NarrowCoveringBTree<BlockSize>);
+	}
+	
+	//! Calls f with the tree in use
+	template <typename F>
+	void apply(F f) {
+		if (titled) f(*titled);
+		else f(*narrow);
+	}
+	
+	//! Indexes an entry
+	void insert(const Entry& e, long offset) {
+		apply([&](auto& tree) {
+			typename std::decay_t<decltype(tree)>::ValueType value;
+			definition.fill(e, offset, value);
+			tree.insert(value);
+		});
+	}
+	
+	//! Full filepath to the index file of a declaration
+	static std::string filepath(const IndexDefinition& definition) {
+		return std::string(ROOT "bd-index-") + definition.name + ".bin";
+	}
+};
+
+// --- //
+
+//! I/O settings in use by the commands, see setIoOptions
+static IoOptions ioOptions = { false, BLOCK_CACHE_DEFAULT_BLOCKS };
+
+void setIoOptions(const IoOptions& options) {
+	ioOptions = options;
+}
+
+//! %Block size of the database the command works on, see readDatabaseBlockSize
+static unsigned int databaseBlockSize = BLOCK_SIZE;
+
+//! Partitions of the database the command works on, empty if it wasn't uploaded in partitions
+static PartitionMap databasePartitions;
+
+//! Partitions of the database, see readDatabaseBlockSize
+/*!
+ * @return The partition map, or null if the database isn't partitioned
+ */
+static const PartitionMap* partitions() {
+	return databasePartitions.size()? &databasePartitions : nullptr;
+}
+
+//! Full filepath to one of the database's files
+/*!
+ * @param map Partitions of the database, null if it isn't partitioned
+ * @param partition Partition the file belongs to, if the database is partitioned
+ * @param filename Name of the file
+ */
+static std::string databaseFilepath(const PartitionMap* map, std::size_t partition, const char* filename) {
+	return map? map->filepath(partition, filename) : std::string(ROOT) + filename;
+}
+
+//! Creates a cache with blocks of the database's size
+/*!
+ * Its frames are in the shared segment named in the I/O settings, if there's
+ * one, see IoOptions::sharedCache. If the segment can't be attached to, the
+ * cache keeps frames of its own, after saying so.
+ *
+ * @param capacity Quantity of frames, if the cache keeps its own
+ */
+static std::unique_ptr<BlockCache> newCache(std::size_t capacity) {
+	std::unique_ptr<BlockCache> cache(new BlockCache(capacity, databaseBlockSize));
+	
+	if (ioOptions.sharedCache && !cache->attachShared(ioOptions.sharedCache)) {
+		static std::once_flag warned;
+		
+		std::call_once(warned, [] {
+			std::cout << "Couldn't attach to the shared cache \"" << ioOptions.sharedCache
+				<< "\" (it may have blocks of another size, or too many handles attached), so the command uses its own." << std::endl;
+		});
+	}
+	
+	return cache;
+}
+
+//! Cache shared by all the files opened by a command
+/*!
+ * Created on first use, with blocks of the database's size.
+ *
+ * @return The cache, or null if direct I/O is off
+ */
+static BlockCache* commandCache() {
+	static std::unique_ptr<BlockCache> cache;
+	
+	if (!ioOptions.directIO) return nullptr;
+	if (!cache) cache = newCache(ioOptions.cacheBlocks);
+	return cache.get();
+}
+
+//! Cache for a thread working on one of several partitions at the same time
+/*!
+ * BlockCache isn't thread-safe, so instead of sharing the command's cache,
+ * each thread gets its own, with a share of the capacity set in the I/O
+ * options. With a shared segment, they all keep their blocks in it.
+ *
+ * @param threads Quantity of threads, each with its own cache
+ *
+ * @return The cache, or null if direct I/O is off
+ */
+static std::unique_ptr<BlockCache> partitionCache(std::size_t threads) {
+	if (!ioOptions.directIO) return nullptr;
+	
+	// Enough frames for a path down a tree and a pinned node or two
+	auto capacity = std::max<std::size_t>(ioOptions.cacheBlocks / threads, 64);
+	return newCache(ioOptions.sharedCache? ioOptions.cacheBlocks : capacity);
+}
+
+//! Reads the database's partitions and block size, for the command to use
+/*!
+ * The block size is read from the hashfile header, or from the first
+ * segment's if the database is partitioned. Without a hashfile, the default
+ * block size is kept, and the command finds out there's nothing uploaded as
+ * usual. Must be called before the cache is first used.
+ *
+ * @return False, after saying so, if the block size isn't supported
+ */
+static bool readDatabaseBlockSize() {
+	databasePartitions.load(PARTITION_MAP_FILEPATH);
+	
+	Hashfile hashfile;
+	if (hashfile.open(databaseFilepath(partitions(), 0, HASHFILE_FILENAME).c_str())) databaseBlockSize = hashfile.blockSize();
+	
+	if (!withBlockSize(databaseBlockSize, [](auto) {})) {
+		std::cout << "The hashfile has blocks of " << databaseBlockSize << " bytes, which isn't a supported size. Consider uploading your data again." << std::endl;
+		return false;
+	}
+	
+	return true;
+}
+
+//! Runs a command with the database's block size as a compile-time constant
+/*!
+ * The indexes are templates on the block size, so the command is run with the
+ * instantiation matching the size in the hashfile header, see
+ * readDatabaseBlockSize and withBlockSize.
+ *
+ * @tparam Command Callable taking an `std::integral_constant<unsigned int, size>`
+ *
+ * @param command Command to run
+ */
+template <typename Command>
+static void withDatabaseBlockSize(Command command) {
+	if (readDatabaseBlockSize()) withBlockSize(databaseBlockSize, command);
+}
+
+//! Keeps the top levels of a loaded B-tree index in memory, if the I/O settings ask for it
+/*!
+ * See IoOptions::pinnedLevels. Prints how many nodes were pinned.
+ *
+ * @param tree Loaded index
+ */
+template <typename Tree>
+static void pinIndex(Tree& tree) {
+	if (ioOptions.pinnedLevels <= 1) return;
+	
+	auto pinned = tree.pin(ioOptions.pinnedLevels, ioOptions.pinMemory);
+	std::cout << "Pinned " << pinned << " index node" << (pinned == 1? "" : "s") << " below the root ("
+		<< pinned * Tree::BlockSizeInUse / 1024 << " KiB) in memory.\n";
+}
+
+//! Prints the cache statistics, if direct I/O is on
+static void printCacheStatistics() {
+	if (auto cache = commandCache()) {
+		auto& stats = cache->getStatistics();
+		std::cout << "Cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+			<< stats.evictions << " evictions, " << stats.bypasses << " uncached records." << std::endl;
+	}
+}
+
+//! Prints the Bloom filter statistics, if the filter was loaded
+/*!
+ * @param filter Filter used by the command
+ * @param loaded False if the filter couldn't be loaded
+ */
+static void printFilterStatistics(const BloomFilter& filter, bool loaded) {
+	if (loaded) {
+		auto& stats = filter.getStatistics();
+		std::cout << "Bloom filter: " << stats.lookups << " lookups, " << stats.negatives
+			<< " ruled out without reading the index, " << stats.falsePositives << " false positives." << std::endl;
+	}
+}
+
+//! Opens the hashfile, or every segment of it in a partitioned database, and runs a command on it
+/*!
+ * Meant for the commands whose index may point to entries in any segment.
+ * Says so if it couldn't be opened.
+ *
+ * @tparam Command Callable taking a Hashfile or a PartitionedHashfile
+ *
+ * @param command Command to run
+ */
+template <typename Command>
+static void withHashfile(Command command) {
+	if (auto map = partitions()) {
+		PartitionedHashfile hashfile;
+		hashfile.useCache(commandCache());
+		
+		if (hashfile.open(*map, HASHFILE_FILENAME)) return command(hashfile);
+	}
+	else {
+		Hashfile hashfile;
+		hashfile.useCache(commandCache());
+		
+		if (hashfile.open(HASHFILE_FILEPATH)) return command(hashfile);
+	}
+	
+	std::cout << "No hashfile found. Consider uploading your data first." << std::endl;
+}
+
+// --- //
+
+//! Reads a string field from a line in the CSV file
+/*!
+ * Will read the quotes-enclosed value from a column in the `;`-delimited CSV
+ * file and put it into a char* buffer.
+ *
+ * Allows the column to be left blank or as `NULL` (no quotes).
+ *
+ * @param field Buffer to store the read string (must be at least as big as `fieldSize`)
+ * @param file File where the contents will be read
+ * @param fieldSize Maximum field size in characters
+ */
+static void readStringField(char *field, std::FILE *file, int fieldSize) {
+	char previous = ';';
+	char current = std::fgetc(file);
+	int index = 0;
+	
+	switch (current) {
+	// Case in which the field has no characters: ;;
+	case ';':
+		break;
+	
+	// Case in which the last field has no characters, so there's only an LF line break
+	case '\n':
+		break;
+	
+	// Case in which the last field has no characters, but there's still a CRLF line break
+	case '\r':
+		std::fgetc(file); // '\n'
+		break;
+	
+	// Case in which instead of a field there's only NULL
+	case 'N':
+		std::fgetc(file); // 'U'
+		std::fgetc(file); // 'L'
+		std::fgetc(file); // 'L'
+		if (std::fgetc(file) == '\r') std::fgetc(file); // Skips the line break, be it LF or CRLF
+		break;
+	
+	// Case in which there's a string in the field
+	case '"':
+		while (true) {
+			previous = current;
+			current = fgetc(file);
+			
+			if (previous == '"') {
+				bool fieldEnded = false;
+				
+				// If the quotes are followed by either of these elements, then we've reached the end of the field
+				switch (current) {
+				case '\r':
+					std::fgetc(file); // '\n'
+				case ';':
+				case '\n':
+				case EOF:
+					--index;
+					fieldEnded = true;
+					break;
+				}
+				
+				if (fieldEnded) break;
+			}
+			
+			if (current >= 0) {
+				// Only insert the character in the buffer if there's still
+				// space left (taking into account the '\0' end character).
+				// We'll keep reading the file until the end of the column.
+				if (index < fieldSize - 1) {
+					field[index] = current;
+				}
+				
+				++index;
+			}
+		}
+		
+		break;
+	}
+	
+	if (index >= fieldSize) {
+		index = fieldSize - 1;
+	}
+	
+	field[index] = '\0';
+}
+
+//! Reads a whole line, field by field, from the CSV file
+/*!
+ * @param e Entry to read
+ * @param file File with contents
+ *
+ * @return True if the entry was successfully read, false if we've reached the end of the file
+ */
+static bool readEntry(Entry& e, std::FILE *file) {
+	int endChecker = std::fscanf(file, "\"%" SCNd64 "\";", &e.id);
+	
+	if (endChecker < 0) {
+		e.valid = false;
+		return false;
+	}
+	
+	readStringField(e.title, file, TITLE_CHAR_MAX);
+	std::fscanf(file, "\"%d\";", &e.year);
+	readStringField(e.authors, file, AUTHORS_CHAR_MAX);
+	std::fscanf(file, "\"%d\";", &e.citations);
+	readStringField(e.updateTimestamp, file, TIMESTAMP_CHAR_MAX);
+	readStringField(e.snippet, file, SNIPPET_CHAR_MAX);
+	
+	e.valid = true;
+	return true;
+}
+
+//! Prints an entry field by field
+/*!
+ * @param e Entry to print
+ */
+static void printEntry(const Entry& e) {
+	std::cout << "id        : " << e.id << '\n';
+	std::cout << "title     : " << e.title << '\n';
+	std::cout << "year      : " << e.year << '\n';
+	std::cout << "authors   : " << e.authors << '\n';
+	std::cout << "citations : " << e.citations << '\n';
+	std::cout << "timestamp : " << e.updateTimestamp << '\n';
+	std::cout << "snippet   : " << e.snippet << '\n' << std::endl;
+}
+
+// ---
+
+//! Files of a database, or of each of its partitions, besides the covering indexes and the runs
+static const char* const databaseFilenames[] = {
+	HASHFILE_FILENAME, ID_TREE_FILENAME, TITLE_TREE_FILENAME, TITLE_HASH_FILENAME,
+	TITLE_POSTINGS_FILENAME, AUTHOR_TREE_FILENAME, AUTHOR_POSTINGS_FILENAME,
+	TERM_TREE_FILENAME, TERM_POSTINGS_FILENAME, ID_FILTER_FILENAME, TITLE_FILTER_FILENAME
+};
+
+//! Compresses a hashfile just written, if the upload options ask for it
+/*!
+ * See Hashfile::compress.
+ *
+ * @param filepath Path to the hashfile, which must be closed
+ * @param options Upload options
+ *
+ * @return Blocks the hashfile takes once compressed, 0 if it wasn't
+ */
+static std::int64_t compressHashfile(const std::string& filepath, const UploadOptions& options) {
+	if (!options.compress || !Hashfile::compress(filepath.c_str())) return 0;
+	
+	Hashfile hashfile;
+	return hashfile.open(filepath.c_str())? hashfile.readHeader().var.storedBlocks : 0;
+}
+
+//! Removes the files a new upload would leave stale without overwriting them
+/*!
+ * Covering indexes from a previous upload are removed even if they aren't
+ * declared again, and so are the entries appended since then, which point to
+ * the old hashfile.
+ */
+template <unsigned int BlockSize>
+static void removeStaleFiles() {
+	std::vector<IndexDefinition> previousIndexes;
+	loadCatalog(CATALOG_FILEPATH, previousIndexes);
+	
+	for (auto& definition : previousIndexes) {
+		std::remove(DeclaredIndex<BlockSize>::filepath(definition).c_str());
+	}
+	
+	std::remove(CATALOG_FILEPATH);
+	
+	IdLsmTree<BlockSize>::remove(ID_LSM_FILEPATH_PREFIX);
+}
+
+//! Removes the files of a database uploaded in partitions, and its partition map
+static void removePartitions() {
+	PartitionMap map;
+	if (!map.load(PARTITION_MAP_FILEPATH)) return;
+	
+	for (std::size_t i = 0; i < map.size(); ++i) {
+		for (auto filename : databaseFilenames) {
+			std::remove(map.filepath(i, filename).c_str());
+		}
+	}
+	
+	std::remove(PARTITION_MAP_FILEPATH);
+}
+
+//! Builds a secondary index B+ tree from sorted titles
+/*!
+ * Values of the same title are merged into a single TitleIndex as they come
+ * out of the sorter, see TitleIndexBuildOrder.
+ *
+ * @param tree Tree just created
+ * @param sorter Sorter with a value for each entry, already sorted
+ * @param postings Posting lists, for the offsets that don't fit in the values
+ * @param hashes Where the filter hash of each title is appended, null to skip
+ * them
+ *
+ * @return Quantity of distinct titles
+ */
+template <typename Tree>
+static std::uint64_t buildTitleTree(Tree& tree, ExternalSorter<TitleIndex, TitleIndexBuildOrder>& sorter, PostingFile& postings, std::vector<std::uint64_t>* hashes) {
+	std::uint64_t titles = 0;
+	TitleIndex pending;
+	bool hasPending = sorter.next(pending);
+	
+	tree.bulkLoad([&](TitleIndex& index) {
+		if (!hasPending) return false;
+		index = pending;
+		
+		while ((hasPending = sorter.next(pending)) && std::strcmp(pending.title, index.title) == 0) {
+			addTitleEntry(index, pending.offsets[0], postings);
+		}
+		
+		++titles;
+		if (hashes) hashes->push_back(filterHash(index.title));
+		
+		return true;
+	});
+	
+	return titles;
+}
+
+//! Builds an author index B+ tree from sorted authors
+/*!
+ * The offsets of each author are gathered as they come out of the sorter,
+ * and written to the posting lists at once.
+ *
+ * @param tree Tree just created
+ * @param sorter Sorter with a value for each author of each entry, already
+ * sorted
+ * @param postings Posting lists, just created
+ *
+ * @return Quantity of distinct authors
+ */
+template <typename Tree>
+static std::uint64_t buildAuthorTree(Tree& tree, ExternalSorter<AuthorPosting, AuthorPostingOrder>& sorter, PackedPostingFile& postings) {
+	std::uint64_t authors = 0;
+	AuthorPosting pending;
+	bool hasPending = sorter.next(pending);
+	std::vector<long> offsets;
+	
+	tree.bulkLoad([&](AuthorIndex& index) {
+		if (!hasPending) return false;
+		std::memcpy(index.author, pending.author, AUTHOR_CHAR_MAX);
+		
+		offsets.clear();
+		
+		do {
+			// An author named twice in the same entry is indexed once
+			if (offsets.empty() || offsets.back() != pending.offset) offsets.push_back(pending.offset);
+		} while ((hasPending = sorter.next(pending)) && std::strcmp(pending.author, index.author) == 0);
+		
+		index.postings = postings.write(offsets);
+		++authors;
+		
+		return true;
+	});
+	
+	return authors;
+}
+
+//! Builds a full-text index B+ tree from sorted terms
+/*!
+ * Same as buildAuthorTree.
+ *
+ * @param tree Tree just created
+ * @param sorter Sorter with a value for each term of each entry, already
+ * sorted
+ * @param postings Posting lists, just created
+ *
+ * @return Quantity of distinct terms
+ */
+template <typename Tree>
+static std::uint64_t buildTermTree(Tree& tree, ExternalSorter<TermPosting, TermPostingOrder>& sorter, PackedPostingFile& postings) {
+	std::uint64_t terms = 0;
+	TermPosting pending;
+	bool hasPending = sorter.next(pending);
+	std::vector<long> offsets;
+	
+	tree.bulkLoad([&](TermIndex& index) {
+		if (!hasPending) return false;
+		std::memcpy(index.term, pending.term, TERM_CHAR_MAX);
+		
+		offsets.clear();
+		
+		do {
+			offsets.push_back(pending.offset);
+		} while ((hasPending = sorter.next(pending)) && std::strcmp(pending.term, index.term) == 0);
+		
+		index.count = offsets.size();
+		index.postings = postings.write(offsets);
+		++terms;
+		
+		return true;
+	});
+	
+	return terms;
+}
+
+//! upload, building the indexes with blocks of BlockSize bytes
+template <unsigned int BlockSize>
+static void upload(const char* filePath, const UploadOptions& options) {
+	// Phantom entry that'll be used to pad the spaces between id's
+	static auto phantomEntry = []{
+			EntryBlock pe;
+			pe.var.valid = false;
+			return pe;
+		}();
+	
+	#ifdef DEBUG
+	std::cout << "[DEBUG]\n";
+	#endif
+	
+	std::cout << "Block size in use         : " << BlockSize << " bytes\n";
+	std::cout << "Id B+ tree internal order : " << IdBTree<BlockSize>::InternalOrder << " (compressed leaves)\n";
+	
+	if (options.titleIndex == HashTitleIndex)
+		std::cout << "Title hash bucket size    : " << TitleHashTable<BlockSize>::Capacity << "\n\n";
+	else
+		std::cout << "Title B+ tree orders      : " << TitleBTree<BlockSize>::InternalOrder << " internal, " << TitleBTree<BlockSize>::LeafCapacity << " values per leaf\n\n";
+	
+	std::cout << "Opening files...\n\n";
+	
+	std::FILE *input = std::fopen(filePath, "rb");
+	if (!input) {
+		std::cout << "Couldn't open input file.\n";
+		std::cout << "Filepath: \"" << filePath << "\"\n";
+		std::cout << "Aborting." << std::endl;
+		return;
+	}
+	
+	IdBTree<BlockSize> idTree;
+	idTree.useCache(commandCache());
+	if (!idTree.create(ID_TREE_FILEPATH)) {
+		std::cout << "Couldn't create the primary index file.\n";
+		std::cout << "Filepath: \"" << ID_TREE_FILEPATH << "\"\n";
+		std::cout << "Aborting." << std::endl;
+		return;
+	}
+	
+	std::cout << "Primary index file created at \"" << ID_TREE_FILEPATH << "\"\n";
+	
+	// Only one of the secondary index structures is used, and the other one's
+	// file is removed so that seek2 doesn't pick up a stale index
+	bool titleHashed = options.titleIndex == HashTitleIndex;
+	auto titleFilepath = titleHashed? TITLE_HASH_FILEPATH : TITLE_TREE_FILEPATH;
+	std::remove(titleHashed? TITLE_TREE_FILEPATH : TITLE_HASH_FILEPATH);
+	
+	TitleBTree<BlockSize> titleTree;
+	TitleHashTable<BlockSize> titleHash;
+	titleTree.useCache(commandCache());
+	titleHash.useCache(commandCache());
+	
+	if (!(titleHashed? titleHash.create(titleFilepath) : titleTree.create(titleFilepath))) {
+		std::cout << "Couldn't create the secondary index file.\n";
+		std::cout << "Filepath: \"" << titleFilepath << "\"\n";
+		std::cout << "Aborting." << std::endl;
+		return;
+	}
+	
+	std::cout << "Secondary index file created at \"" << titleFilepath << "\"\n";
+	
+	PostingFile titlePostings;
+	titlePostings.useCache(commandCache());
+	if (!titlePostings.create(TITLE_POSTINGS_FILEPATH, BlockSize)) {
+		std::cout << "Couldn't create the secondary index posting lists file.\n";
+		std::cout << "Filepath: \"" << TITLE_POSTINGS_FILEPATH << "\"\n";
+		std::cout << "Aborting." << std::endl;
+		return;
+	}
+	
+	std::cout << "Secondary index posting lists created at \"" << TITLE_POSTINGS_FILEPATH << "\"\n";
+	
+	AuthorBTree<BlockSize> authorTree;
+	authorTree.useCache(commandCache());
+	if (!authorTree.create(AUTHOR_TREE_FILEPATH)) {
+		std::cout << "Couldn't create the author index file.\n";
+		std::cout << "Filepath: \"" << AUTHOR_TREE_FILEPATH << "\"\n";
+		std::cout << "Aborting." << std::endl;
+		return;
+	}
+	
+	std::cout << "Author index file created at \"" << AUTHOR_TREE_FILEPATH << "\"\n";
+	
+	PackedPostingFile authorPostings;
+	authorPostings.useCache(commandCache());
+	if (!authorPostings.create(AUTHOR_POSTINGS_FILEPATH, BlockSize)) {
+		std::cout << "Couldn't create the author index posting lists file.\n";
+		std::cout << "Filepath: \"" << AUTHOR_POSTINGS_FILEPATH << "\"\n";
+		std::cout << "Aborting." << std::endl;
+		return;
+	}
+	
+	std::cout << "Author index posting lists created at \"" << AUTHOR_POSTINGS_FILEPATH << "\"\n";
+	
+	// The full-text index is optional, and one from a previous upload would be
+	// stale
+	TermBTree<BlockSize> termTree;
+	PackedPostingFile termPostings;
+	termTree.useCache(commandCache());
+	termPostings.useCache(commandCache());
+	
+	if (!options.textIndex) {
+		std::remove(TERM_TREE_FILEPATH);
+		std::remove(TERM_POSTINGS_FILEPATH);
+	}
+	else if (!termTree.create(TERM_TREE_FILEPATH) || !termPostings.create(TERM_POSTINGS_FILEPATH, BlockSize)) {
+		std::cout << "Couldn't create the full-text index files.\n";
+		std::cout << "Filepaths: \"" << TERM_TREE_FILEPATH << "\", \"" << TERM_POSTINGS_FILEPATH << "\"\n";
+		std::cout << "Aborting." << std::endl;
+		return;
+	}
+	else {
+		std::cout << "Full-text index files created at \"" << TERM_TREE_FILEPATH << "\" and \"" << TERM_POSTINGS_FILEPATH << "\"\n";
+	}
+	
+	Hashfile output;
+	output.useCache(commandCache());
+	if (!output.create(HASHFILE_FILEPATH, BlockSize)) {
+		std::cout << "Couldn't create the hashing file.\n";
+		std::cout << "Filepath: \"" << HASHFILE_FILEPATH << "\"\n";
+		std::cout << "Aborting." << std::endl;
+		return;
+	}
+	
+	std::cout << "Hashing file created at \"" << HASHFILE_FILEPATH << "\"\n";
+	
+	removeStaleFiles<BlockSize>();
+	removePartitions();
+	
+	std::vector<DeclaredIndex<BlockSize>> coveringIndexes;
+	
+	for (auto& definition : options.indexes) {
+		coveringIndexes.emplace_back(definition);
+		
+		auto filepath = DeclaredIndex<BlockSize>::filepath(definition);
+		bool created;
+		
+		coveringIndexes.back().apply([&](auto& tree) {
+			tree.useCache(commandCache());
+			created = tree.create(filepath.c_str());
+		});
+		
+		if (!created) {
+			std::cout << "Couldn't create the covering index file.\n";
+			std::cout << "Filepath: \"" << filepath << "\"\n";
+			std::cout << "Aborting." << std::endl;
+			return;
+		}
+		
+		std::cout << "Covering index \"" << definition.name << "\" created at \"" << filepath << "\"\n";
+	}
+	
+	std::cout << '\n';
+	
+	std::cout << "Begin uploading...\n\n";
+	
+	HashfileHeaderBlock header = output.readHeader();
+	
+	EntryBlock e;
+	std::int64_t lastId = -1;
+	std::uint64_t entriesFound = 0;
+	std::uint64_t titlesFound = 0;
+	
+	// Key hashes are kept until the end, once we know how big the filters must be
+	std::vector<std::uint64_t> idHashes;
+	std::vector<std::uint64_t> titleHashes;
+	
+	// Titles come in id order, so inserting them in the B+ tree as they're
+	// read would touch leaves all over the file. They're sorted instead, in
+	// runs written to temporary files if they don't fit in memory, and the
+	// tree is built bottom-up from the sorted titles.
+	ExternalSorter<TitleIndex, TitleIndexBuildOrder> titleSorter(options.sortMemory);
+	bool titlesSorted = true;
+	
+	// Authors are sorted the same way, so that each author's offsets come
+	// together and its posting list is written at once
+	ExternalSorter<AuthorPosting, AuthorPostingOrder> authorSorter(options.sortMemory);
+	bool authorsSorted = true;
+	std::uint64_t authorsFound = 0;
+	
+	ExternalSorter<TermPosting, TermPostingOrder> termSorter(options.sortMemory);
+	bool termsSorted = true;
+	std::uint64_t termsFound = 0;
+	
+	while (readEntry(e.var, input)) {
+		if (++entriesFound % PATIENCE_STEP == 0) {
+			std::cout << entriesFound << " entries read so far, patience.\n";
+		}
+		
+		std::int64_t idDifference = e.var.id - lastId - 1;
+		
+		for (std::int64_t i = 0; i < idDifference; ++i) {
+			output.append(phantomEntry);
+		}
+		
+		header.var.blockCount += idDifference;
+		
+		auto offset = output.append(e);
+		++header.var.blockCount;
+		
+		IdIndex idPointer;
+		idPointer.id = e.var.id;
+		idPointer.offset = offset;
+		idTree.insert(idPointer);
+		
+		auto titlePointer = makeTitleIndex(e.var, offset);
+		
+		// The title B+ tree is built once every title is known, see below
+		if (titleHashed) {
+			bool newTitle = titleHash.insertOrMerge(titlePointer, [&](TitleIndex& existing) {
+				addTitleEntry(existing, offset, titlePostings);
+			});
+			
+			if (newTitle) ++titlesFound;
+			if (newTitle && options.bloomFalsePositiveRate > 0) titleHashes.push_back(filterHash(titlePointer.title));
+		}
+		else if (!titleSorter.add(titlePointer)) {
+			titlesSorted = false;
+		}
+		
+		if (!addAuthors(e.var, offset, authorSorter)) authorsSorted = false;
+		if (options.textIndex && !addTerms(e.var, offset, termSorter)) termsSorted = false;
+		
+		if (options.bloomFalsePositiveRate > 0) idHashes.push_back(filterHash(e.var.id));
+		
+		for (auto& index : coveringIndexes) {
+			index.insert(e.var, offset);
+		}
+		
+		lastId = e.var.id;
+	}
+	
+	if (!titleHashed && !(titlesSorted && titleSorter.sort())) {
+		std::cout << "Couldn't write the temporary files to sort the titles.\n";
+		std::cout << "Aborting." << std::endl;
+		return;
+	}
+	
+	if (!titleHashed) {
+		titlesFound = buildTitleTree(titleTree, titleSorter, titlePostings, options.bloomFalsePositiveRate > 0? &titleHashes : nullptr);
+	}
+	
+	if (!(authorsSorted && authorSorter.sort())) {
+		std::cout << "Couldn't write the temporary files to sort the authors.\n";
+		std::cout << "Aborting." << std::endl;
+		return;
+	}
+	
+	authorsFound = buildAuthorTree(authorTree, authorSorter, authorPostings);
+	authorTree.finishInsertions();
+	authorPostings.close();
+	
+	if (options.textIndex) {
+		if (!(termsSorted && termSorter.sort())) {
+			std::cout << "Couldn't write the temporary files to sort the terms.\n";
+			std::cout << "Aborting." << std::endl;
+			return;
+		}
+		
+		termsFound = buildTermTree(termTree, termSorter, termPostings);
+		termTree.finishInsertions();
+		termPostings.close();
+	}
+	
+	if (titleHashed) titleHash.finishInsertions();
+	else titleTree.finishInsertions();
+	
+	idTree.finishInsertions();
+	
+	for (auto& index : coveringIndexes) {
+		index.apply([](auto& tree) { tree.finishInsertions(); });
+	}
+	
+	if (!options.indexes.empty() && !saveCatalog(CATALOG_FILEPATH, options.indexes)) {
+		std::cout << "Couldn't write the covering index declarations, the indexes can't be scanned.\n";
+	}
+	
+	output.writeHeader(header);
+	
+	output.close();
+	std::fclose(input);
+	
+	auto storedBlocks = compressHashfile(HASHFILE_FILEPATH, options);
+	
+	// Filters from a previous upload would be stale, so they're removed even if
+	// new ones won't be built
+	std::remove(ID_FILTER_FILEPATH);
+	std::remove(TITLE_FILTER_FILEPATH);
+	
+	BloomFilter idFilter;
+	BloomFilter titleFilter;
+	
+	if (options.bloomFalsePositiveRate > 0) {
+		idFilter = BloomFilter(idHashes.size(), options.bloomFalsePositiveRate);
+		titleFilter = BloomFilter(titleHashes.size(), options.bloomFalsePositiveRate);
+		
+		for (auto h : idHashes) idFilter.add(h);
+		for (auto h : titleHashes) titleFilter.add(h);
+		
+		if (!idFilter.save(ID_FILTER_FILEPATH) || !titleFilter.save(TITLE_FILTER_FILEPATH)) {
+			std::cout << "Couldn't write the Bloom filters, lookups will go straight to the indexes.\n";
+		}
+	}
+	
+	auto idStats = idTree.getStatistics();
+	auto titleBlocks = titleHashed? titleHash.getStatistics().blocksCreated : titleTree.getStatistics().blocksCreated;
+	
+	if (entriesFound >= 1000) std::cout << '\n';
+	
+	std::cout << "Uploading finished.\n";
+	std::cout << entriesFound << " entries read in total.\n\n";
+	
+	std::cout << "Hashing file:         " << header.var.blockCount << " blocks";
+	if (storedBlocks) std::cout << ", compressed into " << storedBlocks << " blocks";
+	std::cout << ".\n";
+	std::cout << "Primary index file:   " << idStats.blocksCreated << " blocks.\n";
+	std::cout << "Secondary index file: " << titleBlocks << " blocks";
+	
+	if (titleHashed) std::cout << " (extendible hash, global depth " << titleHash.globalDepth() << ")";
+	std::cout << ", " << titlesFound << " distinct titles";
+	
+	if (!titleHashed) std::cout << ", sorted in " << std::max<std::size_t>(titleSorter.runCount(), 1) << " run(s)";
+	std::cout << ".\n";
+	std::cout << "Title posting lists:  " << titlePostings.blockCount() << " blocks." << std::endl;
+	std::cout << "Author index file:    " << authorTree.getStatistics().blocksCreated << " blocks, " << authorsFound << " distinct authors.\n";
+	std::cout << "Author posting lists: " << authorPostings.blockCount() << " blocks." << std::endl;
+	
+	if (options.textIndex) {
+		std::cout << "Full-text index file: " << termTree.getStatistics().blocksCreated << " blocks, " << termsFound << " distinct terms.\n";
+		std::cout << "Term posting lists:   " << termPostings.blockCount() << " blocks." << std::endl;
+	}
+	
+	for (auto& index : coveringIndexes) {
+		index.apply([&](auto& tree) {
+			auto stats = tree.getStatistics();
+			std::cout << "Covering index \"" << index.definition.name << "\": "
+				<< stats.blocksCreated << " blocks, " << stats.blocksWritten << " block writes." << std::endl;
+		});
+	}
+	
+	if (options.bloomFalsePositiveRate > 0) {
+		std::cout << "Bloom filters:        " << idFilter.byteSize() + titleFilter.byteSize()
+			<< " bytes (" << options.bloomFalsePositiveRate << " false-positive rate)." << std::endl;
+	}
+	
+	printCacheStatistics();
+}
+
+//! What came out of building a partition, see buildPartition
+struct PartitionBuild {
+	std::string error; //!< Why the partition couldn't be built, empty if it was
+	std::uint64_t entries; //!< Entries in the partition's hashfile segment
+	std::uint64_t titles; //!< Distinct titles in the partition's secondary index
+	std::int64_t hashfileBlocks; //!< Blocks of the hashfile segment
+	std::int64_t storedBlocks; //!< Blocks the hashfile segment takes once compressed, 0 if it isn't
+	std::uint64_t idBlocks; //!< Blocks of the primary index
+	std::uint64_t titleBlocks; //!< Blocks of the secondary index
+	std::size_t postingBlocks; //!< Blocks of the posting lists
+	std::uint64_t authors; //!< Distinct authors in the partition's author index
+	std::uint64_t authorBlocks; //!< Blocks of the author index
+	std::size_t authorPostingBlocks; //!< Blocks of the author index posting lists
+	std::uint64_t terms; //!< Distinct terms in the partition's full-text index, if it was built
+	std::uint64_t termBlocks; //!< Blocks of the full-text index
+	std::size_t termPostingBlocks; //!< Blocks of the full-text index posting lists
+	std::size_t filterBytes; //!< Bytes of both Bloom filters
+};
+
+//! Entries of the input going to the builder of a partition, see buildPartition
+/*!
+ * The input is read once, by uploadPartitioned, which hands each partition
+ * the entries it takes, in batches. Only a few batches wait in the queue, so
+ * a partition that's slower to build holds the reading back, instead of
+ * piling entries up in memory.
+ */
+struct PartitionFeed {
+	//! Entries handed over together, in input order
+	struct Batch {
+		std::vector<Entry> entries; //!< Entries with their id or title in the partition's range
+		std::vector<bool> byId; //!< True for the entries with their id in the partition's range, false for those with only their title in it
+	};
+	
+	std::mutex mutex; //!< Guards the members below
+	std::condition_variable changed; //!< Signals that a batch was pushed or popped, or that there won't be more
+	std::deque<Batch> batches; //!< Batches waiting for the builder
+	bool finished = false; //!< True once the whole input was handed over
+	bool abandoned = false; //!< True once the builder stopped taking batches
+	
+	//! Queues a batch, waiting until there's room for it
+	/*!
+	 * The batch is dropped if the builder stopped taking them.
+	 */
+	void push(Batch&& batch) {
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&] { return abandoned || batches.size() < PARTITION_FEED_DEPTH; });
+		
+		if (!abandoned) batches.push_back(std::move(batch));
+		changed.notify_all();
+	}
+	
+	//! Takes the next batch, waiting until there's one
+	/*!
+	 * @return False once the whole input was handed over
+	 */
+	bool pop(Batch& batch) {
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&] { return finished || !batches.empty(); });
+		
+		if (batches.empty()) return false;
+		
+		batch = std::move(batches.front());
+		batches.pop_front();
+		changed.notify_all();
+		return true;
+	}
+	
+	//! Tells the builder there are no more batches
+	void finish() {
+		std::lock_guard<std::mutex> lock(mutex);
+		finished = true;
+		changed.notify_all();
+	}
+	
+	//! Tells the reader to drop the batches from now on, once the builder is done
+	void abandon() {
+		std::lock_guard<std::mutex> lock(mutex);
+		abandoned = true;
+		batches.clear();
+		changed.notify_all();
+	}
+};
+
+//! Builds the files of one partition, for upload
+/*!
+ * Takes the entries with ids in the partition's range for its hashfile
+ * segment, primary index and author index, and the ones with titles in its
+ * range for its secondary index, as uploadPartitioned hands them over. Prints
+ * nothing, so that it can run on its own thread.
+ *
+ * @param feed Entries of the partition
+ * @param map Partitions of the database
+ * @param partition Partition to build
+ * @param options Upload settings
+ * @param result Where the outcome is stored
+ */
+template <unsigned int BlockSize>
+static void buildPartition(PartitionFeed& feed, const PartitionMap& map, std::size_t partition, const UploadOptions& options, PartitionBuild& result) {
+	static auto phantomEntry = []{
+			EntryBlock pe;
+			pe.var.valid = false;
+			return pe;
+		}();
+	
+	result = PartitionBuild();
+	
+	// Declared first, so that it outlives the files using it
+	auto cache = partitionCache(map.size());
+	
+	auto path = [&](const char* filename) {
+		return map.filepath(partition, filename);
+	};
+	
+	auto failed = [&](const char* what, const std::string& filepath) {
+		result.error = std::string("Couldn't create the ") + what + ".\nFilepath: \"" + filepath + '"';
+	};
+	
+	IdBTree<BlockSize> idTree;
+	TitleBTree<BlockSize> titleTree;
+	PostingFile titlePostings;
+	AuthorBTree<BlockSize> authorTree;
+	PackedPostingFile authorPostings;
+	TermBTree<BlockSize> termTree;
+	PackedPostingFile termPostings;
+	Hashfile output;
+	
+	idTree.useCache(cache.get());
+	titleTree.useCache(cache.get());
+	titlePostings.useCache(cache.get());
+	authorTree.useCache(cache.get());
+	authorPostings.useCache(cache.get());
+	termTree.useCache(cache.get());
+	termPostings.useCache(cache.get());
+	output.useCache(cache.get());
+	
+	if (!idTree.create(path(ID_TREE_FILENAME).c_str())) return failed("primary index file", path(ID_TREE_FILENAME));
+	if (!titleTree.create(path(TITLE_TREE_FILENAME).c_str())) return failed("secondary index file", path(TITLE_TREE_FILENAME));
+	
+	if (!titlePostings.create(path(TITLE_POSTINGS_FILENAME).c_str(), BlockSize)) {
+		return failed("secondary index posting lists file", path(TITLE_POSTINGS_FILENAME));
+	}
+	
+	if (!authorTree.create(path(AUTHOR_TREE_FILENAME).c_str())) return failed("author index file", path(AUTHOR_TREE_FILENAME));
+	
+	if (!authorPostings.create(path(AUTHOR_POSTINGS_FILENAME).c_str(), BlockSize)) {
+		return failed("author index posting lists file", path(AUTHOR_POSTINGS_FILENAME));
+	}
+	
+	if (options.textIndex) {
+		if (!termTree.create(path(TERM_TREE_FILENAME).c_str())) return failed("full-text index file", path(TERM_TREE_FILENAME));
+		
+		if (!termPostings.create(path(TERM_POSTINGS_FILENAME).c_str(), BlockSize)) {
+			return failed("full-text index posting lists file", path(TERM_POSTINGS_FILENAME));
+		}
+	}
+	
+	// The segment leaves out the ids of the partitions before, see Hashfile
+	auto firstId = map[partition].firstId;
+	
+	if (!output.create(path(HASHFILE_FILENAME).c_str(), BlockSize, firstId)) {
+		return failed("hashing file segment", path(HASHFILE_FILENAME));
+	}
+	
+	HashfileHeaderBlock header = output.readHeader();
+	
+	// Each partition's sorter gets its share of the memory, and a single thread
+	ExternalSorter<TitleIndex, TitleIndexBuildOrder> titleSorter(options.sortMemory / map.size(), 1);
+	bool titlesSorted = true;
+	
+	// Each partition indexes the authors of its own entries, so seekauthor
+	// looks them up in every partition
+	ExternalSorter<AuthorPosting, AuthorPostingOrder> authorSorter(options.sortMemory / map.size(), 1);
+	bool authorsSorted = true;
+	
+	// And so are the terms of the full-text index, for search
+	ExternalSorter<TermPosting, TermPostingOrder> termSorter(options.sortMemory / map.size(), 1);
+	bool termsSorted = true;
+	
+	std::vector<std::uint64_t> idHashes;
+	std::vector<std::uint64_t> titleHashes;
+	
+	EntryBlock e;
+	std::int64_t lastId = firstId - 1;
+	PartitionFeed::Batch batch;
+	
+	while (feed.pop(batch)) {
+		for (std::size_t n = 0; n < batch.entries.size(); ++n) {
+			const Entry& entry = batch.entries[n];
+			
+			// Offsets are the same in every segment, so titles can point to
+			// entries in other partitions' segments
+			long offset = output.entryOffset(entry.id);
+			
+			if (batch.byId[n]) {
+				e.var = entry;
+				
+				std::int64_t idDifference = e.var.id - lastId - 1;
+				
+				for (std::int64_t i = 0; i < idDifference; ++i) {
+					output.append(phantomEntry);
+				}
+				
+				header.var.blockCount += std::max<std::int64_t>(idDifference, 0);
+				
+				offset = output.append(e);
+				++header.var.blockCount;
+				++result.entries;
+				
+				IdIndex idPointer;
+				idPointer.id = e.var.id;
+				idPointer.offset = offset;
+				idTree.insert(idPointer);
+				
+				if (options.bloomFalsePositiveRate > 0) idHashes.push_back(filterHash(e.var.id));
+				if (!addAuthors(e.var, offset, authorSorter)) authorsSorted = false;
+				if (options.textIndex && !addTerms(e.var, offset, termSorter)) termsSorted = false;
+				
+				lastId = e.var.id;
+			}
+			
+			if (map.ofTitle(entry.title) == partition && !titleSorter.add(makeTitleIndex(entry, offset))) {
+				titlesSorted = false;
+			}
+		}
+	}
+	
+	if (!(titlesSorted && titleSorter.sort())) {
+		result.error = "Couldn't write the temporary files to sort the titles.";
+		return;
+	}
+	
+	if (!(authorsSorted && authorSorter.sort())) {
+		result.error = "Couldn't write the temporary files to sort the authors.";
+		return;
+	}
+	
+	if (options.textIndex && !(termsSorted && termSorter.sort())) {
+		result.error = "Couldn't write the temporary files to sort the terms.";
+		return;
+	}
+	
+	result.titles = buildTitleTree(titleTree, titleSorter, titlePostings, options.bloomFalsePositiveRate > 0? &titleHashes : nullptr);
+	result.authors = buildAuthorTree(authorTree, authorSorter, authorPostings);
+	
+	titleTree.finishInsertions();
+	authorTree.finishInsertions();
+	authorPostings.close();
+	idTree.finishInsertions();
+	
+	if (options.textIndex) {
+		result.terms = buildTermTree(termTree, termSorter, termPostings);
+		termTree.finishInsertions();
+		termPostings.close();
+	}
+	
+	output.writeHeader(header);
+	output.close();
+	
+	result.storedBlocks = compressHashfile(path(HASHFILE_FILENAME), options);
+	
+	std::remove(path(ID_FILTER_FILENAME).c_str());
+	std::remove(path(TITLE_FILTER_FILENAME).c_str());
+	
+	if (options.bloomFalsePositiveRate > 0) {
+		BloomFilter idFilter(idHashes.size(), options.bloomFalsePositiveRate);
+		BloomFilter titleFilter(titleHashes.size(), options.bloomFalsePositiveRate);
+		
+		for (auto h : idHashes) idFilter.add(h);
+		for (auto h : titleHashes) titleFilter.add(h);
+		
+		if (idFilter.save(path(ID_FILTER_FILENAME).c_str()) && titleFilter.save(path(TITLE_FILTER_FILENAME).c_str())) {
+			result.filterBytes = idFilter.byteSize() + titleFilter.byteSize();
+		}
+	}
+	
+	result.hashfileBlocks = header.var.blockCount;
+	result.idBlocks = idTree.getStatistics().blocksCreated;
+	result.titleBlocks = titleTree.getStatistics().blocksCreated;
+	result.postingBlocks = titlePostings.blockCount();
+	result.authorBlocks = authorTree.getStatistics().blocksCreated;
+	result.authorPostingBlocks = authorPostings.blockCount();
+	result.termBlocks = termTree.getStatistics().blocksCreated;
+	result.termPostingBlocks = termPostings.blockCount();
+}
+
+//! upload in several partitions, building the indexes with blocks of BlockSize bytes
+/*!
+ * The input is read once to sample ids and titles, from which the partitions'
+ * ranges are chosen. Then it's read again, handing every entry to the
+ * partitions taking it, each built on its own thread, see buildPartition.
+ */
+template <unsigned int BlockSize>
+static void uploadPartitioned(const char* filePath, const UploadOptions& options) {
+	if (options.titleIndex == HashTitleIndex || !options.indexes.empty()) {
+		std::cout << "A database uploaded in partitions only has B-tree primary and secondary indexes: "
+			<< "--title-index=hash and --index aren't available with --partitions." << std::endl;
+		return;
+	}
+	
+	auto directories = options.partitionDirectories;
+	if (directories.empty()) directories.push_back(ROOT);
+	
+	for (auto& directory : directories) {
+		if (directory.size() >= PARTITION_DIRECTORY_MAX) {
+			std::cout << "Partition directory too long: \"" << directory << "\"" << std::endl;
+			return;
+		}
+	}
+	
+	std::cout << "Block size in use         : " << BlockSize << " bytes\n";
+	std::cout << "Partitions                : " << options.partitions << ", in " << directories.size() << " director" << (directories.size() == 1? "y" : "ies") << "\n\n";
+	
+	std::FILE *input = std::fopen(filePath, "rb");
+	if (!input) {
+		std::cout << "Couldn't open input file.\n";
+		std::cout << "Filepath: \"" << filePath << "\"\n";
+		std::cout << "Aborting." << std::endl;
+		return;
+	}
+	
+	std::cout << "Sampling ids and titles...\n\n";
+	
+	// Reservoir sampling: every entry read so far is as likely to be in the
+	// samples. The seed is fixed, so that the same input is always split the
+	// same way.
+	std::vector<std::int64_t> ids;
+	std::vector<std::string> titles;
+	std::mt19937_64 random(PARTITION_SAMPLE_SIZE);
+	std::uint64_t entriesFound = 0;
+	EntryBlock e;
+	
+	while (readEntry(e.var, input)) {
+		auto slot = random() % (entriesFound + 1);
+		
+		if (ids.size() < PARTITION_SAMPLE_SIZE) {
+			ids.push_back(e.var.id);
+			titles.push_back(e.var.title);
+		}
+		else if (slot < PARTITION_SAMPLE_SIZE) {
+			ids[slot] = e.var.id;
+			titles[slot] = e.var.title;
+		}
+		
+		if (++entriesFound % PATIENCE_STEP == 0) {
+			std::cout << entriesFound << " entries read so far, patience.\n";
+		}
+	}
+	
+	std::rewind(input);
+	
+	auto map = PartitionMap::split(ids, titles, options.partitions, directories);
+	
+	// Files of the previous upload, partitioned or not, would be picked up by
+	// the other commands instead of the new ones
+	removeStaleFiles<BlockSize>();
+	removePartitions();
+	
+	for (auto filename : databaseFilenames) {
+		std::remove((std::string(ROOT) + filename).c_str());
+	}
+	
+	std::cout << "Building " << map.size() << " partitions...\n\n";
+	
+	std::vector<PartitionBuild> builds(map.size());
+	std::vector<PartitionFeed> feeds(map.size());
+	std::vector<std::thread> workers;
+	
+	for (std::size_t i = 0; i < map.size(); ++i) {
+		workers.emplace_back([&, i] {
+			buildPartition<BlockSize>(feeds[i], map, i, options, builds[i]);
+			
+			// A partition that failed early mustn't hold the reading back
+			feeds[i].abandon();
+		});
+	}
+	
+	std::vector<PartitionFeed::Batch> batches(map.size());
+	Entry entry;
+	
+	auto hand = [&](std::size_t partition, bool byId) {
+		auto& batch = batches[partition];
+		batch.entries.push_back(entry);
+		batch.byId.push_back(byId);
+		
+		if (batch.entries.size() == PARTITION_FEED_BATCH) {
+			feeds[partition].push(std::move(batch));
+			batch = PartitionFeed::Batch();
+		}
+	};
+	
+	while (readEntry(entry, input)) {
+		auto idPartition = map.ofId(entry.id);
+		auto titlePartition = map.ofTitle(entry.title);
+		
+		hand(idPartition, true);
+		if (titlePartition != idPartition) hand(titlePartition, false);
+	}
+	
+	std::fclose(input);
+	
+	for (std::size_t i = 0; i < map.size(); ++i) {
+		if (!batches[i].entries.empty()) feeds[i].push(std::move(batches[i]));
+		feeds[i].finish();
+	}
+	
+	for (auto& worker : workers) worker.join();
+	
+	bool built = true;
+	
+	for (std::size_t i = 0; i < builds.size(); ++i) {
+		if (builds[i].error.empty()) continue;
+		
+		std::cout << "Partition " << i << ": " << builds[i].error << '\n';
+		built = false;
+	}
+	
+	// The map is only saved once every partition is there, so that a failed
+	// upload doesn't leave a database missing some of its entries
+	if (!built || !map.save(PARTITION_MAP_FILEPATH)) {
+		if (built) std::cout << "Couldn't write the partition map.\nFilepath: \"" << PARTITION_MAP_FILEPATH << "\"\n";
+		std::cout << "Aborting." << std::endl;
+		return;
+	}
+	
+	if (entriesFound >= 1000) std::cout << '\n';
+	
+	std::cout << "Uploading finished.\n";
+	std::cout << entriesFound << " entries read in total.\n\n";
+	
+	for (std::size_t i = 0; i < builds.size(); ++i) {
+		auto& build = builds[i];
+		
+		std::cout << "Partition " << i << " (" << map.filepath(i, "*") << "): ids from " << map[i].firstId
+			<< ", titles from \"" << map[i].firstTitle << "\"\n";
+		std::cout << "  Hashing file segment: " << build.hashfileBlocks << " blocks, " << build.entries << " entries";
+		if (build.storedBlocks) std::cout << ", compressed into " << build.storedBlocks << " blocks";
+		std::cout << ".\n";
+		std::cout << "  Primary index file:   " << build.idBlocks << " blocks.\n";
+		std::cout << "  Secondary index file: " << build.titleBlocks << " blocks, " << build.titles << " distinct titles.\n";
+		std::cout << "  Title posting lists:  " << build.postingBlocks << " blocks.\n";
+		std::cout << "  Author index file:    " << build.authorBlocks << " blocks, " << build.authors << " distinct authors.\n";
+		std::cout << "  Author posting lists: " << build.authorPostingBlocks << " blocks.\n";
+		
+		if (options.textIndex) {
+			std::cout << "  Full-text index file: " << build.termBlocks << " blocks, " << build.terms << " distinct terms.\n";
+			std::cout << "  Term posting lists:   " << build.termPostingBlocks << " blocks.\n";
+		}
+		
+		
+		if (options.bloomFalsePositiveRate > 0) std::cout << "  Bloom filters:        " << build.filterBytes << " bytes.\n";
+	}
+	
+	std::cout << "Partition map saved at \"" << PARTITION_MAP_FILEPATH << "\"." << std::endl;
+}
+
+void upload(const char* filePath, const UploadOptions& options) {
+	databaseBlockSize = options.blockSize;
+	
+	bool supported = withBlockSize(options.blockSize, [&](auto blockSize) {
+		if (options.partitions > 1) uploadPartitioned<decltype(blockSize)::value>(filePath, options);
+		else upload<decltype(blockSize)::value>(filePath, options);
+	});
+	
+	if (!supported) std::cout << "Unsupported block size: " << options.blockSize << " bytes." << std::endl;
+}
+
+//! append, for a database with blocks of BlockSize bytes
+template <unsigned int BlockSize>
+static void append(const char* filePath, const AppendOptions& options) {
+	// Ids past the last segment's range would land in it, and its index
+	// segment wouldn't be balanced with the others anymore
+	if (partitions()) {
+		std::cout << "Appending isn't available for a database uploaded in partitions. Consider uploading all of it again." << std::endl;
+		return;
+	}
+	
+	// Compressed entries are packed together, with no room for new ones
+	Hashfile existing;
+	if (existing.open(HASHFILE_FILEPATH) && existing.compressed()) {
+		std::cout << "Appending isn't available for a compressed hashfile. Consider uploading all of it again." << std::endl;
+		return;
+	}
+	
+	existing.close();
+	
+	std::FILE *input = std::fopen(filePath, "rb");
+	if (!input) {
+		std::cout << "Couldn't open input file.\n";
+		std::cout << "Filepath: \"" << filePath << "\"\n";
+		std::cout << "Aborting." << std::endl;
+		return;
+	}
+	
+	Hashfile output;
+	output.useCache(commandCache());
+	if (!output.open(HASHFILE_FILEPATH, true)) {
+		std::cout << "No hashfile found. Consider uploading your data first." << std::endl;
+		std::fclose(input);
+		return;
+	}
+	
+	IdLsmTree<BlockSize> runs(options.memtableCapacity);
+	runs.useCache(commandCache());
+	if (!runs.open(ID_LSM_FILEPATH_PREFIX)) {
+		std::cout << "Couldn't open the primary index runs.\n";
+		std::cout << "Filepath prefix: \"" << ID_LSM_FILEPATH_PREFIX << "\"\n";
+		std::cout << "Aborting." << std::endl;
+		std::fclose(input);
+		return;
+	}
+	
+	std::cout << "Begin appending...\n\n";
+	
+	EntryBlock phantomEntry;
+	phantomEntry.var.valid = false;
+	
+	HashfileHeaderBlock header = output.readHeader();
 	
-	std::fseek(output, 0, SEEK_SET);
-	std::fwrite(reinterpret_cast<const char*>(&header), sizeof(header), 1, output);
+	EntryBlock e;
+	std::uint64_t entriesFound = 0;
+	std::uint64_t entriesAppended = 0;
+	bool indexed = true;
+	
+	while (indexed && readEntry(e.var, input)) {
+		if (++entriesFound % PATIENCE_STEP == 0) {
+			std::cout << entriesFound << " entries read so far, patience.\n";
+		}
+		
+		if (e.var.id < 0) {
+			std::cout << "Entry with id " << e.var.id << " can't be stored, skipped.\n";
+			continue;
+		}
+		
+		// Entries keep their place given by the id: past the end, the file is
+		// padded as in upload, and before it, only a phantom entry's place can
+		// be taken
+		long offset = output.entryOffset(e.var.id);
+		
+		if (offset < output.end()) {
+			EntryBlock existing;
+			
+			if (output.read(offset, existing) && existing.var.valid) {
+				std::cout << "Entry with id " << e.var.id << " is already in the database, skipped.\n";
+				continue;
+			}
+			
+			output.write(offset, e);
+		}
+		else {
+			while (output.end() < offset) {
+				output.append(phantomEntry);
+				++header.var.blockCount;
+			}
+			
+			output.append(e);
+			++header.var.blockCount;
+		}
+		
+		IdIndex idPointer;
+		idPointer.id = e.var.id;
+		idPointer.offset = offset;
+		indexed = runs.insert(idPointer);
+		
+		++entriesAppended;
+	}
+	
+	output.writeHeader(header);
+	
+	output.close();
+	std::fclose(input);
+	
+	if (!indexed || !runs.flush()) {
+		std::cout << "Couldn't write a primary index run, the last entries appended can't be sought by id." << std::endl;
+	}
+	
+	runs.waitForCompaction();
+	auto stats = runs.getStatistics();
+	
+	if (entriesFound >= 1000) std::cout << '\n';
+	
+	std::cout << "Appending finished.\n";
+	std::cout << entriesFound << " entries read in total, " << entriesAppended << " appended.\n\n";
+	
+	std::cout << "Hashing file:         " << header.var.blockCount << " blocks.\n";
+	std::cout << "Primary index runs:   " << runs.runCount() << " (" << stats.flushes << " written, "
+		<< stats.compactions << " compaction" << (stats.compactions == 1? "" : "s") << ")." << std::endl;
+	
+	// Only the primary index has runs, the other indexes are left as uploaded
+	if (entriesAppended > 0) {
+		std::cout << "\nAppended entries can only be found by id, with seek1 and findrec, until the next upload.\n";
+		std::cout << "seek2, seekauthor, search, count1, select2 and scan don't see them." << std::endl;
+	}
+	
+	printCacheStatistics();
+}
+
+void append(const char* filePath, const AppendOptions& options) {
+	withDatabaseBlockSize([&](auto blockSize) {
+		append<decltype(blockSize)::value>(filePath, options);
+	});
+}
+
+//! Function that prints a found entry and associated data
+/*!
+ * Prints how many blocks were read to find it and how many blocks the file
+ * currently contains as a whole
+ *
+ * @param e Found entry
+ * @param blocksRead Blocks read
+ * @param blockCount Blocks in the file
+ */
+static void foundEntryMessage(const Entry& e, std::size_t blocksRead, std::size_t blockCount) {
+	std::cout << "Entry found:\n\n";
+	printEntry(e);
+	std::cout << blocksRead << " block" << (blocksRead > 1? "s were" : " was") << " read.\n";
+	std::cout << "The file currently has " << blockCount << " total blocks." << std::endl;
+}
+
+//! Function that seeks an entry by offset in the hashfile and prints it if successful
+/*!
+ * In case of failure, it'll inform you
+ *
+ * @tparam Records Hashfile, or PartitionedHashfile if the database is partitioned
+ *
+ * @param hashfile The hashfile
+ * @param offset Entry offset
+ * @param blocksReadSoFar Blocks read so far
+ * @param blockCount Blocks in the file
+ *
+ * @return True in case of success, false otherwise
+ */
+template <typename Records>
+static bool findEntryAndPrint(Records& hashfile, long offset, std::size_t blocksReadSoFar, std::size_t blockCount) {
+	std::cout << "Reading entry in offset " << offset << '\n';
+	
+	if (offset >= 0) {
+		// Printed straight from the cache frame when there's a cache
+		EntryBlock buffer;
+		PageRef page = hashfile.view(offset, buffer);
+		
+		if (page && page.as<EntryBlock>().var.valid) {
+			++blocksReadSoFar; // +1 because the entry block has been read
+			
+			foundEntryMessage(page.as<EntryBlock>().var, blocksReadSoFar, blockCount);
+			return true;
+		}
+		else {
+			std::cout << "Read failure. ";
+		}
+	}
+	else {
+		std::cout << "Seek failure (" << offset << "). ";
+	}
+	
+	return false;
+}
+
+//! Function that seeks several entries by offset in the hashfile and prints them
+/*!
+ * Works like findEntryAndPrint, for index keys shared by many entries.
+ *
+ * @tparam Records See findEntryAndPrint
+ *
+ * @param hashfile The hashfile
+ * @param offsets Entry offsets
+ * @param blocksReadSoFar Blocks read so far
+ * @param blockCount Blocks in the index file
+ */
+template <typename Records>
+static void findEntriesAndPrint(Records& hashfile, const std::vector<long>& offsets, std::size_t blocksReadSoFar, std::size_t blockCount) {
+	std::cout << offsets.size() << " entries found:\n\n";
+	
+	EntryBlock buffer;
+	
+	for (auto offset : offsets) {
+		PageRef page = hashfile.view(offset, buffer);
+		
+		if (page && page.as<EntryBlock>().var.valid) {
+			++blocksReadSoFar;
+			printEntry(page.as<EntryBlock>().var);
+		}
+		else {
+			std::cout << "Entry in offset " << offset << " not found in the hashfile.\n\n";
+		}
+	}
+	
+	std::cout << blocksReadSoFar << " blocks were read.\n";
+	std::cout << "The file currently has " << blockCount << " total blocks." << std::endl;
+}
+
+//! Hashfile offset of the entry a primary index value points to
+/*!
+ * @param index Value found in the primary index
+ * @param offsets Vector where the offset will be appended
+ *
+ * @return Quantity of posting list blocks read, always 0
+ */
+static std::size_t entryOffsets(const IdIndex& index, const PostingFile*, std::vector<long>& offsets) {
+	offsets.push_back(index.offset);
+	return 0;
+}
+
+//! Hashfile offsets of all the entries a secondary index value points to
+/*!
+ * Offsets are sorted, which puts the entries in id order.
+ *
+ * @param index Value found in the secondary index
+ * @param postings Posting lists of the secondary index, or null if they
+ * couldn't be opened
+ * @param offsets Vector where the offsets will be appended
+ *
+ * @return Quantity of posting list blocks read
+ */
+static std::size_t entryOffsets(const TitleIndex& index, const PostingFile* postings, std::vector<long>& offsets) {
+	auto first = offsets.size();
+	std::size_t blocksRead = 0;
+	
+	offsets.insert(offsets.end(), index.offsets, index.offsets + std::min<std::uint64_t>(index.count, TITLE_INLINE_POSTINGS));
+	if (postings) blocksRead = postings->read(index.postings, offsets);
+	
+	std::sort(offsets.begin() + first, offsets.end());
+	return blocksRead;
+}
+
+void findrec(long id) {
+	if (!readDatabaseBlockSize()) return;
+	
+	// In a partitioned database, the id's partition has its entry
+	auto map = partitions();
+	auto hashfilePath = databaseFilepath(map, map? map->ofId(id) : 0, HASHFILE_FILENAME);
+	
+	Hashfile hashfile;
+	hashfile.useCache(commandCache());
+	
+	if (!hashfile.open(hashfilePath.c_str())) {
+		std::cout << "No hashfile found. Consider uploading your data first." << std::endl;
+		return;
+	}
+	
+	long offset = hashfile.entryOffset(id);
+	
+	// The block read for the header doesn't count because it's not used in the
+	// entry search. The header is only used to provide the total blocks in the
+	// file.
+	HashfileHeaderBlock header = hashfile.readHeader();
+	
+	if (!findEntryAndPrint(hashfile, offset, 0, header.var.blockCount)) {
+		std::cout << "Entry with id " << id << " not found." << std::endl;
+	}
+	
+	printCacheStatistics();
+}
+
+//! seek1 of a single id, for a database with blocks of BlockSize bytes
+template <unsigned int BlockSize>
+static void seek1(long id) {
+	// In a partitioned database, only the id's partition is read: its index
+	// points to entries in its own hashfile segment
+	auto map = partitions();
+	auto partition = map? map->ofId(id) : 0;
+	
+	auto path = [&](const char* filename) {
+		return databaseFilepath(map, partition, filename);
+	};
+	
+	Hashfile hashfile;
+	hashfile.useCache(commandCache());
+	
+	if (!hashfile.open(path(HASHFILE_FILENAME).c_str())) {
+		std::cout << "No hashfile found. Consider uploading your data first." << std::endl;
+		return;
+	}
+	
+	IdBTree<BlockSize> tree;
+	tree.useCache(commandCache());
+	
+	if (!tree.load(path(ID_TREE_FILENAME).c_str())) {
+		std::cout << "No primary index file found." << std::endl;
+		return;
+	}
+	
+	pinIndex(tree);
+	
+	BloomFilter filter;
+	bool filtered = filter.load(path(ID_FILTER_FILENAME).c_str());
+	bool ruledOut = filtered && !filter.mayContain(filterHash(id));
+	
+	IdIndex found;
+	bool isFound = false;
+	
+	if (!ruledOut) {
+		isFound = tree.seek(id, found);
+		if (!isFound && filtered) filter.reportFalsePositive();
+	}
+	
+	// Ids appended since the upload are only in the runs
+	IdLsmTree<BlockSize> runs;
+	runs.useCache(commandCache());
+	
+	if (!isFound && runs.open(ID_LSM_FILEPATH_PREFIX)) {
+		auto appended = runs.seek(static_cast<std::int64_t>(id));
+		
+		if (appended) {
+			found = *appended;
+			isFound = true;
+		}
+	}
+	
+	if (isFound) {
+		auto stats = tree.getStatistics(true);
+		
+		if (!findEntryAndPrint(hashfile, found.offset, stats.blocksRead + runs.getStatistics().blocksRead, stats.blocksInDisk)) {
+			std::cout << "Entry with id " << id << " (offset=" << found.offset
+				<< ") not found in the hashfile." << std::endl;
+		}
+	}
+	else if (ruledOut) {
+		std::cout << "Entry with id " << id << " not found in the primary index (ruled out by its Bloom filter)." << std::endl;
+	}
+	else {
+		std::cout << "Entry with id " << id << " not found in the primary index." << std::endl;
+	}
+	
+	printFilterStatistics(filter, filtered);
+	printCacheStatistics();
+}
+
+void seek1(long id) {
+	withDatabaseBlockSize([&](auto blockSize) {
+		seek1<decltype(blockSize)::value>(id);
+	});
+}
+
+//! seek2 of a single title, once the hashfile is open
+/*!
+ * @tparam Records See findEntryAndPrint
+ */
+template <unsigned int BlockSize, typename Records>
+static void seek2(Records& hashfile, const char* title) {
+	// In a partitioned database, only the title's partition is sought
+	auto map = partitions();
+	auto partition = map? map->ofTitle(title) : 0;
+	
+	auto path = [&](const char* filename) {
+		return databaseFilepath(map, partition, filename);
+	};
+	
+	BloomFilter filter;
+	bool filtered = filter.load(path(TITLE_FILTER_FILENAME).c_str());
+	
+	if (filtered && !filter.mayContain(filterHash(title))) {
+		std::cout << "Entry with title \"" << title << "\" not found in the secondary index file (ruled out by its Bloom filter)." << std::endl;
+		printFilterStatistics(filter, filtered);
+		return;
+	}
+	
+	PostingFile postings;
+	postings.useCache(commandCache());
+	bool postingsOpen = postings.open(path(TITLE_POSTINGS_FILENAME).c_str(), hashfile.blockSize());
+	
+	// Both secondary index structures are sought the same way
+	auto seekTitle = [&](auto& index) {
+		TitleIndex found;
+		
+		if (index.seek(title, found)) {
+			std::vector<long> offsets;
+			auto postingBlocksRead = entryOffsets(found, postingsOpen? &postings : nullptr, offsets);
+			auto stats = index.getStatistics(true);
+			
+			if (offsets.size() > 1) {
+				findEntriesAndPrint(hashfile, offsets, stats.blocksRead + postingBlocksRead, stats.blocksInDisk);
+			}
+			else if (!findEntryAndPrint(hashfile, offsets[0], stats.blocksRead, stats.blocksInDisk)) {
+				std::cout << "Entry with title \"" << title
+					<< "\" (offset=" << offsets[0]
+					<< ") not found in the hashfile." << std::endl;
+			}
+		}
+		else {
+			if (filtered) filter.reportFalsePositive();
+			std::cout << "Entry with title \"" << title << "\" not found in the secondary index file." << std::endl;
+		}
+	};
+	
+	TitleHashTable<BlockSize> hash;
+	hash.useCache(commandCache());
+	
+	if (hash.load(path(TITLE_HASH_FILENAME).c_str())) {
+		seekTitle(hash);
+	}
+	else {
+		TitleBTree<BlockSize> tree;
+		tree.useCache(commandCache());
+		
+		if (!tree.load(path(TITLE_TREE_FILENAME).c_str())) {
+			std::cout << "No secondary index file found." << std::endl;
+			return;
+		}
+		
+		pinIndex(tree);
+		
+		seekTitle(tree);
+	}
+	
+	printFilterStatistics(filter, filtered);
+	printCacheStatistics();
+}
+
+//! seek2 of a single title, for a database with blocks of BlockSize bytes
+template <unsigned int BlockSize>
+static void seek2(const char* title) {
+	withHashfile([&](auto& hashfile) {
+		seek2<BlockSize>(hashfile, title);
+	});
+}
+
+void seek2(const char* title) {
+	withDatabaseBlockSize([&](auto blockSize) {
+		seek2<decltype(blockSize)::value>(title);
+	});
+}
+
+//! File holding the entry at an offset, for readEntries
+static Hashfile& segmentOf(Hashfile& hashfile, long) {
+	return hashfile;
+}
+
+//! Segment holding the entry at an offset, for readEntries
+static Hashfile& segmentOf(PartitionedHashfile& hashfile, long offset) {
+	return hashfile.segment(offset);
+}
+
+//! Reads many entries from the hashfile, keeping all the reads in flight together
+/*!
+ * Offsets equal to -1 are skipped and their entries are marked as invalid, as
+ * are the entries that couldn't be read. Entries already in the hashfile's
+ * cache, if any, aren't read again.
+ *
+ * @tparam Records See findEntryAndPrint
+ *
+ * @param hashfile The hashfile
+ * @param offsets Offset of each entry
+ * @param blocks Where each entry's block will be read into, one hashfile
+ * block after the other; must be as big as offsets and block-aligned
+ * @param reader Reader used to submit the reads
+ *
+ * @return Quantity of blocks read
+ */
+template <typename Records>
+static std::size_t readEntries(Records& hashfile, const std::vector<long>& offsets, char *blocks, AsyncReader& reader) {
+	std::vector<AsyncReader::Request> requests(offsets.size());
+	auto blockSize = hashfile.blockSize();
+	std::size_t next = 0;
+	std::size_t inFlight = 0;
+	std::size_t blocksRead = 0;
+	
+	auto entry = [&](std::size_t i) -> EntryBlock& {
+		return *reinterpret_cast<EntryBlock*>(blocks + i * blockSize);
+	};
+	
+	// Blocks are read and cached by their position in the file holding them,
+	// and the entries taken out of them, which in a compressed file means
+	// decompressing them
+	auto submitNext = [&] {
+		while (next < offsets.size()) {
+			auto& file = segmentOf(hashfile, offsets[next]);
+			auto cache = file.cache();
+			
+			if (offsets[next] == -1 || file.fileOffset(offsets[next]) < 0) {
+				entry(next).var.valid = false;
+			}
+			else if (auto cached = cache? cache->lookup(file.descriptor(), file.fileOffset(offsets[next])) : nullptr) {
+				file.unpack(offsets[next], cached, entry(next));
+			}
+			else {
+				break;
+			}
+			
+			++next;
+		}
+		
+		if (next == offsets.size()) return false;
+		
+		auto& file = segmentOf(hashfile, offsets[next]);
+		auto& r = requests[next];
+		r.fd = file.descriptor();
+		r.offset = file.fileOffset(offsets[next]);
+		r.buffer = &entry(next);
+		r.size = blockSize;
+		r.userData = nullptr;
+		reader.submit(r);
+		
+		++next;
+		++inFlight;
+		return true;
+	};
+	
+	while (inFlight < reader.queueDepth() && submitNext());
+	
+	while (inFlight) {
+		auto& r = reader.wait();
+		--inFlight;
+		++blocksRead;
+		
+		auto i = &r - requests.data();
+		auto& read = entry(i);
+		auto& file = segmentOf(hashfile, offsets[i]);
+		
+		if (r.result != static_cast<long>(blockSize)) {
+			read.var.valid = false;
+		}
+		else {
+			if (file.cache()) file.cache()->insert(r.fd, r.offset, &read, BlockCache::RecordPage);
+			file.unpack(offsets[i], reinterpret_cast<const char*>(&read), read);
+		}
+		
+		submitNext();
+	}
+	
+	return blocksRead;
+}
+
+//! Seeks many keys in an index, fetches the entries found and prints them
+/*!
+ * @tparam Records See findEntryAndPrint
+ * @tparam Tree BPlusTree or ExtendibleHash type of the index
+ * @tparam Key Type of the keys to seek in the index
+ * @tparam Describe Callable that prints the key at the index it receives
+ * @tparam Fallback Callable seeking a key that isn't in the index elsewhere,
+ * returning a pointer with the value found or null, and adding the blocks it
+ * read to its second argument
+ *
+ * Keys ruled out by the index's Bloom filter, if there's one, aren't sought
+ * in the index at all. Every entry a key points to is printed.
+ *
+ * @param hashfile The hashfile
+ * @param tree Loaded index
+ * @param filter Bloom filter of the index, or null if there's none
+ * @param postings Posting lists of the index, or null if there are none
+ * @param keys Keys to seek
+ * @param describe Prints a key, as in "id 42", so it can be used in messages
+ * @param fallback Seeks the keys that aren't found in the index
+ */
+template <typename Records, typename Tree, typename Key, typename Describe, typename Fallback>
+static void seekManyAndPrint(Records& hashfile, Tree& tree, const BloomFilter* filter, const PostingFile* postings, const std::vector<Key>& keys, Describe describe, Fallback fallback) {
+	std::vector<bool> ruledOut(keys.size(), false);
+	std::vector<Key> candidates;
+	
+	for (std::size_t i = 0; i < keys.size(); ++i) {
+		ruledOut[i] = filter && !filter->mayContain(filterHash(keys[i]));
+		if (!ruledOut[i]) candidates.push_back(keys[i]);
+	}
+	
+	AsyncReader reader;
+	auto candidatesFound = tree.seekMany(candidates, reader);
+	
+	std::vector<std::unique_ptr<typename Tree::ValueType>> found(keys.size());
+	
+	// The offsets of key i's entries go from firstOffset[i] to firstOffset[i + 1]
+	std::vector<long> offsets;
+	std::vector<std::size_t> firstOffset(keys.size() + 1);
+	std::size_t postingBlocksRead = 0;
+	std::size_t fallbackBlocksRead = 0;
+	
+	for (std::size_t i = 0, j = 0; i < keys.size(); ++i) {
+		firstOffset[i] = offsets.size();
+		
+		if (!ruledOut[i]) {
+			found[i] = std::move(candidatesFound[j++]);
+			if (!found[i] && filter) filter->reportFalsePositive();
+		}
+		
+		if (!found[i]) found[i] = fallback(keys[i], fallbackBlocksRead);
+		if (found[i]) postingBlocksRead += entryOffsets(*found[i], postings, offsets);
+	}
+	
+	firstOffset[keys.size()] = offsets.size();
+	
+	auto blockSize = hashfile.blockSize();
+	auto buffer = allocateAligned(std::max<std::size_t>(offsets.size(), 1) * blockSize, blockSize);
+	auto entryBlocksRead = readEntries(hashfile, offsets, buffer.get(), reader);
+	
+	auto entry = [&](std::size_t j) -> const Entry& {
+		return reinterpret_cast<const EntryBlock*>(buffer.get() + j * blockSize)->var;
+	};
+	
+	for (std::size_t i = 0; i < keys.size(); ++i) {
+		if (!found[i] && ruledOut[i]) {
+			std::cout << "Entry with ";
+			describe(i);
+			std::cout << " not found in the index (ruled out by its Bloom filter).\n\n";
+		}
+		else if (!found[i]) {
+			std::cout << "Entry with ";
+			describe(i);
+			std::cout << " not found in the index.\n\n";
+		}
+		
+		for (auto j = firstOffset[i]; j < firstOffset[i + 1]; ++j) {
+			if (!entry(j).valid) {
+				std::cout << "Entry with ";
+				describe(i);
+				std::cout << " (offset=" << offsets[j] << ") not found in the hashfile.\n\n";
+			}
+			else {
+				printEntry(entry(j));
+			}
+		}
+	}
 	
-	std::fclose(output);
-	std::fclose(input);
+	auto stats = tree.getStatistics(true);
+	auto indexBlocksRead = stats.blocksRead + fallbackBlocksRead;
 	
-	auto idStats = idTree.getStatistics();
-	auto titleStats = titleTree.getStatistics();
+	std::cout << indexBlocksRead + postingBlocksRead + entryBlocksRead << " blocks were read ("
+		<< indexBlocksRead << " from the index, ";
 	
-	if (entriesFound >= 1000) std::cout << '\n';
+	if (postings) std::cout << postingBlocksRead << " from the posting lists, ";
 	
-	std::cout << "Uploading finished.\n";
-	std::cout << entriesFound << " entries read in total.\n\n";
+	std::cout << entryBlocksRead << " from the hashfile, "
+		<< (reader.usingIoUring()? "through io_uring" : "through the thread pool") << ").\n";
+	std::cout << "The index file currently has " << stats.blocksInDisk << " total blocks." << std::endl;
 	
-	std::cout << "Hashing file:         " << header.var.blockCount << " blocks.\n";
-	std::cout << "Primary index file:   " << idStats.blocksCreated << " blocks.\n";
-	std::cout << "Secondary index file: " << titleStats.blocksCreated << " blocks." << std::endl;
+	if (filter) printFilterStatistics(*filter, true);
 }
 
-//! Function that prints a found entry and associated data
+//! Groups keys by the partition holding them, see the partitioned seek1 and seek2
 /*!
- * Prints how many blocks were read to find it and how many blocks the file
- * currently contains as a whole
+ * @param map Partitions of the database, null if it isn't partitioned
+ * @param keys Keys to group
+ * @param partitionOf Returns the partition holding a key
  *
- * @param e Found entry
- * @param blocksRead Blocks read
- * @param blockCount Blocks in the file
+ * @return Keys of each partition, in their original order; a single group
+ * with all of them if the database isn't partitioned
  */
-static void foundEntryMessage(const Entry& e, std::size_t blocksRead, std::size_t blockCount) {
-	std::cout << "Entry found:\n\n";
-	printEntry(e);
-	std::cout << blocksRead << " block" << (blocksRead > 1? "s were" : " was") << " read.\n";
-	std::cout << "The file currently has " << blockCount << " total blocks." << std::endl;
+template <typename Key, typename PartitionOf>
+static std::vector<std::vector<Key>> groupByPartition(const PartitionMap* map, const std::vector<Key>& keys, PartitionOf partitionOf) {
+	if (!map) return { keys };
+	
+	std::vector<std::vector<Key>> groups(map->size());
+	for (auto& key : keys) groups[partitionOf(key)].push_back(key);
+	
+	return groups;
 }
 
-//! Function that seeks an entry by offset in the hashfile and prints it if successful
+//! Says which partition the following results come from, if the database is partitioned
+static void printPartitionHeading(const PartitionMap* map, std::size_t partition, std::size_t keyCount) {
+	if (!map) return;
+	
+	std::cout << "--- Partition " << partition << " (" << keyCount << (keyCount == 1? " key" : " keys") << ") ---\n";
+}
+
+//! seek1 of many ids in a single partition
 /*!
- * In case of failure, it'll inform you
- *
- * @param hashfile File pointer to the hashfile
- * @param offset Entry offset
- * @param blocksReadSoFar Blocks read so far
- * @param blockCount Blocks in the file
+ * @param map Partitions of the database, null if it isn't partitioned
+ * @param partition Partition holding the ids
+ * @param keys Ids to seek
+ */
+template <unsigned int BlockSize>
+static void seek1(const PartitionMap* map, std::size_t partition, const std::vector<std::int64_t>& keys) {
+	auto path = [&](const char* filename) {
+		return databaseFilepath(map, partition, filename);
+	};
+	
+	Hashfile hashfile;
+	hashfile.useCache(commandCache());
+	
+	if (!hashfile.open(path(HASHFILE_FILENAME).c_str())) {
+		std::cout << "No hashfile found. Consider uploading your data first." << std::endl;
+		return;
+	}
+	
+	IdBTree<BlockSize> tree;
+	tree.useCache(commandCache());
+	
+	if (!tree.load(path(ID_TREE_FILENAME).c_str())) {
+		std::cout << "No primary index file found." << std::endl;
+		return;
+	}
+	
+	pinIndex(tree);
+	
+	BloomFilter filter;
+	bool filtered = filter.load(path(ID_FILTER_FILENAME).c_str());
+	
+	// Ids appended since the upload are only in the runs
+	IdLsmTree<BlockSize> runs;
+	runs.useCache(commandCache());
+	bool runsOpen = runs.open(ID_LSM_FILEPATH_PREFIX);
+	
+	auto describe = [&](std::size_t i) {
+		std::cout << "id " << keys[i];
+	};
+	
+	auto seekRuns = [&](std::int64_t id, std::size_t& blocksRead) {
+		if (!runsOpen) return std::unique_ptr<IdIndex>();
+		
+		auto before = runs.getStatistics().blocksRead;
+		auto found = runs.seek(id);
+		
+		blocksRead += runs.getStatistics().blocksRead - before;
+		return found;
+	};
+	
+	seekManyAndPrint(hashfile, tree, filtered? &filter : nullptr, nullptr, keys, describe, seekRuns);
+}
+
+//! seek1 of many ids, for a database with blocks of BlockSize bytes
+template <unsigned int BlockSize>
+static void seek1(const long* ids, std::size_t count) {
+	// In a partitioned database, each partition's index only points to its
+	// own hashfile segment, so the ids are sought one partition at a time
+	auto map = partitions();
+	auto groups = groupByPartition(map, std::vector<std::int64_t>(ids, ids + count), [&](std::int64_t id) {
+		return map->ofId(id);
+	});
+	
+	for (std::size_t k = 0; k < groups.size(); ++k) {
+		if (groups[k].empty()) continue;
+		
+		printPartitionHeading(map, k, groups[k].size());
+		seek1<BlockSize>(map, k, groups[k]);
+	}
+	
+	printCacheStatistics();
+}
+
+void seek1(const long* ids, std::size_t count) {
+	withDatabaseBlockSize([&](auto blockSize) {
+		seek1<decltype(blockSize)::value>(ids, count);
+	});
+}
+
+//! seek2 of many titles in a single partition, once the hashfile is open
+/*!
+ * @tparam Records See findEntryAndPrint
  *
- * @return True in case of success, false otherwise
+ * @param map Partitions of the database, null if it isn't partitioned
+ * @param partition Partition holding the titles
+ * @param keys Titles to seek
  */
-static bool findEntryAndPrint(std::FILE *hashfile, long offset, std::size_t blocksReadSoFar, std::size_t blockCount) {
-	std::cout << "Reading entry in offset " << offset << '\n';
+template <unsigned int BlockSize, typename Records>
+static void seek2(Records& hashfile, const PartitionMap* map, std::size_t partition, const std::vector<const char*>& keys) {
+	auto path = [&](const char* filename) {
+		return databaseFilepath(map, partition, filename);
+	};
+	
+	BloomFilter filter;
+	bool filtered = filter.load(path(TITLE_FILTER_FILENAME).c_str());
+	
+	auto describe = [&](std::size_t i) {
+		std::cout << "title \"" << keys[i] << '"';
+	};
 	
-	if (!std::fseek(hashfile, offset, SEEK_SET)) {
-		EntryBlock e;
+	// Titles are only in the secondary index
+	auto noFallback = [](const char*, std::size_t&) {
+		return std::unique_ptr<TitleIndex>();
+	};
+	
+	PostingFile postings;
+	postings.useCache(commandCache());
+	bool postingsOpen = postings.open(path(TITLE_POSTINGS_FILENAME).c_str(), hashfile.blockSize());
+	
+	TitleHashTable<BlockSize> hash;
+	hash.useCache(commandCache());
+	
+	if (hash.load(path(TITLE_HASH_FILENAME).c_str())) {
+		seekManyAndPrint(hashfile, hash, filtered? &filter : nullptr, postingsOpen? &postings : nullptr, keys, describe, noFallback);
+	}
+	else {
+		TitleBTree<BlockSize> tree;
+		tree.useCache(commandCache());
 		
-		if (std::fread(reinterpret_cast<char*>(&e), sizeof(e), 1, hashfile) && e.var.valid) {
-			++blocksReadSoFar; // +1 because the entry block has been read
+		if (!tree.load(path(TITLE_TREE_FILENAME).c_str())) {
+			std::cout << "No secondary index file found." << std::endl;
+			return;
+		}
+		
+		pinIndex(tree);
+		
+		seekManyAndPrint(hashfile, tree, filtered? &filter : nullptr, postingsOpen? &postings : nullptr, keys, describe, noFallback);
+	}
+}
+
+//! seek2 of many titles, for a database with blocks of BlockSize bytes
+template <unsigned int BlockSize>
+static void seek2(const char* const* titles, std::size_t count) {
+	// Each partition's secondary index holds a range of titles, but their
+	// entries may be in any segment, so the whole hashfile is opened
+	auto map = partitions();
+	auto groups = groupByPartition(map, std::vector<const char*>(titles, titles + count), [&](const char* title) {
+		return map->ofTitle(title);
+	});
+	
+	withHashfile([&](auto& hashfile) {
+		for (std::size_t k = 0; k < groups.size(); ++k) {
+			if (groups[k].empty()) continue;
 			
-			foundEntryMessage(e.var, blocksReadSoFar, blockCount);
-			return true;
+			printPartitionHeading(map, k, groups[k].size());
+			seek2<BlockSize>(hashfile, map, k, groups[k]);
 		}
-		else {
-			std::cout << "Read failure. ";
+		
+		printCacheStatistics();
+	});
+}
+
+void seek2(const char* const* titles, std::size_t count) {
+	withDatabaseBlockSize([&](auto blockSize) {
+		seek2<decltype(blockSize)::value>(titles, count);
+	});
+}
+
+//! seekauthor, once the hashfile is open
+/*!
+ * @tparam Records See findEntryAndPrint
+ */
+template <unsigned int BlockSize, typename Records>
+static void seekauthor(Records& hashfile, const char* author) {
+	char name[AUTHOR_CHAR_MAX];
+	
+	if (!authorName(author, std::strlen(author), name)) {
+		std::cout << "The author name is blank." << std::endl;
+		return;
+	}
+	
+	const char* key = name;
+	
+	// In a partitioned database, each partition indexes the authors of its
+	// own entries, and partitions hold consecutive ranges of ids, so the
+	// offsets found in each partition in turn are still in id order
+	auto map = partitions();
+	auto count = map? map->size() : 1;
+	
+	std::vector<long> offsets;
+	std::size_t blocksRead = 0, blocksInDisk = 0;
+	
+	for (std::size_t k = 0; k < count; ++k) {
+		auto path = [&](const char* filename) {
+			return databaseFilepath(map, k, filename);
+		};
+		
+		AuthorBTree<BlockSize> tree;
+		tree.useCache(commandCache());
+		
+		if (!tree.load(path(AUTHOR_TREE_FILENAME).c_str())) {
+			std::cout << "No author index file found. Consider uploading your data again." << std::endl;
+			return;
+		}
+		
+		pinIndex(tree);
+		
+		AuthorIndex found;
+		
+		if (tree.seek(key, found)) {
+			PackedPostingFile postings;
+			postings.useCache(commandCache());
+			
+			if (postings.open(path(AUTHOR_POSTINGS_FILENAME).c_str(), hashfile.blockSize())) {
+				blocksRead += postings.read(found.postings, offsets);
+			}
 		}
+		
+		auto stats = tree.getStatistics(true);
+		blocksRead += stats.blocksRead;
+		blocksInDisk += stats.blocksInDisk;
 	}
-	else {
-		std::cout << "Seek failure (" << offset << "). ";
+	
+	if (offsets.empty()) {
+		std::cout << "No entry by \"" << name << "\" found in the author index file." << std::endl;
+	}
+	else if (offsets.size() > 1) {
+		findEntriesAndPrint(hashfile, offsets, blocksRead, blocksInDisk);
+	}
+	else if (!findEntryAndPrint(hashfile, offsets[0], blocksRead, blocksInDisk)) {
+		std::cout << "Entry by \"" << name
+			<< "\" (offset=" << offsets[0]
+			<< ") not found in the hashfile." << std::endl;
 	}
 	
-	return false;
+	printCacheStatistics();
 }
 
-void findrec(long id) {
-	std::FILE *hashfile = std::fopen(HASHFILE_FILEPATH, "rb");
+//! seekauthor, for a database with blocks of BlockSize bytes
+template <unsigned int BlockSize>
+static void seekauthor(const char* author) {
+	withHashfile([&](auto& hashfile) {
+		seekauthor<BlockSize>(hashfile, author);
+	});
+}
+
+void seekauthor(const char* author) {
+	withDatabaseBlockSize([&](auto blockSize) {
+		seekauthor<decltype(blockSize)::value>(author);
+	});
+}
+
+//! search, once the hashfile is open
+/*!
+ * @tparam Records See findEntryAndPrint
+ *
+ * @param terms Terms to search, normalized and without repetitions
+ */
+template <unsigned int BlockSize, typename Records>
+static void search(Records& hashfile, const std::vector<std::string>& terms, std::size_t limit) {
+	// As for seekauthor, each partition indexes its own entries, in id order
+	auto map = partitions();
+	auto count = map? map->size() : 1;
 	
-	if (!hashfile) {
-		std::cout << "No hashfile found. Consider uploading your data first." << std::endl;
-		return;
+	std::vector<long> matches;
+	std::size_t blocksRead = 0, blocksInDisk = 0;
+	
+	for (std::size_t k = 0; k < count; ++k) {
+		auto path = [&](const char* filename) {
+			return databaseFilepath(map, k, filename);
+		};
+		
+		TermBTree<BlockSize> tree;
+		tree.useCache(commandCache());
+		
+		if (!tree.load(path(TERM_TREE_FILENAME).c_str())) {
+			std::cout << "No full-text index file found. Consider uploading your data again with --text-index." << std::endl;
+			return;
+		}
+		
+		pinIndex(tree);
+		
+		// The whole dictionary lookup is done before any list is read, so that
+		// a missing term costs no posting list read at all
+		std::vector<TermIndex> found(terms.size());
+		bool everyTerm = true;
+		
+		for (std::size_t i = 0; i < terms.size() && everyTerm; ++i) {
+			everyTerm = tree.seek(terms[i].c_str(), found[i]);
+		}
+		
+		auto stats = tree.getStatistics(true);
+		blocksRead += stats.blocksRead;
+		blocksInDisk += stats.blocksInDisk;
+		
+		if (!everyTerm) continue;
+		
+		PackedPostingFile postings;
+		postings.useCache(commandCache());
+		if (!postings.open(path(TERM_POSTINGS_FILENAME).c_str(), hashfile.blockSize())) continue;
+		
+		// Shortest lists first: the intersection only shrinks, and each longer
+		// list is galloped through, see intersectPostings
+		std::sort(found.begin(), found.end(), [](const TermIndex& a, const TermIndex& b) {
+			return a.count < b.count;
+		});
+		
+		std::vector<long> result;
+		blocksRead += postings.read(found[0].postings, result);
+		
+		// The longer lists are only read where the offsets left may be
+		for (std::size_t i = 1; i < found.size() && !result.empty(); ++i) {
+			PackedPostingFile::Cursor list;
+			list.open(postings, found[i].postings);
+			intersectPostings(result, list);
+			blocksRead += list.blocksRead();
+		}
+		
+		matches.insert(matches.end(), result.begin(), result.end());
+	}
+	
+	if (matches.empty()) {
+		std::cout << "No entry has all the terms." << std::endl;
+	}
+	else {
+		if (limit && matches.size() > limit) {
+			std::cout << matches.size() << " entries have all the terms, the first " << limit << " are listed.\n";
+			matches.resize(limit);
+		}
+		
+		findEntriesAndPrint(hashfile, matches, blocksRead, blocksInDisk);
 	}
 	
-	long offset = BLOCK_SIZE /* header */ + BLOCK_SIZE * id;
+	printCacheStatistics();
+}
+
+//! search, for a database with blocks of BlockSize bytes
+template <unsigned int BlockSize>
+static void search(const std::vector<std::string>& terms, std::size_t limit) {
+	withHashfile([&](auto& hashfile) {
+		search<BlockSize>(hashfile, terms, limit);
+	});
+}
+
+void search(const char* const* words, std::size_t count, std::size_t limit) {
+	std::vector<std::string> terms;
 	
-	// The block read for the header doesn't count because it's not used in the
-	// entry search. The header is only used to provide the total blocks in the
-	// file.
-	HashfileHeaderBlock header;
-	std::fseek(hashfile, 0, SEEK_SET);
-	std::fread(reinterpret_cast<char*>(&header), sizeof(header), 1, hashfile);
+	for (std::size_t i = 0; i < count; ++i) {
+		forEachTerm(words[i], [&](const char* term) {
+			if (std::find(terms.begin(), terms.end(), term) == terms.end()) terms.push_back(term);
+		});
+	}
 	
-	if (!findEntryAndPrint(hashfile, offset, 0, header.var.blockCount)) {
-		std::cout << "Entry with id " << id << " not found." << std::endl;
+	if (terms.empty()) {
+		std::cout << "No term to search: terms are made of letters and digits." << std::endl;
+		return;
 	}
 	
-	std::fclose(hashfile);
+	withDatabaseBlockSize([&](auto blockSize) {
+		search<decltype(blockSize)::value>(terms, limit);
+	});
 }
 
-void seek1(long id) {
-	std::FILE *hashfile = std::fopen(HASHFILE_FILEPATH, "rb");
+//! scan, for a database with blocks of BlockSize bytes
+template <unsigned int BlockSize>
+static void scan(const char* name, const std::int64_t* prefix, std::size_t prefixSize, std::size_t limit) {
+	std::vector<IndexDefinition> definitions;
+	loadCatalog(CATALOG_FILEPATH, definitions);
 	
-	if (!hashfile) {
-		std::cout << "No hashfile found. Consider uploading your data first." << std::endl;
+	auto definition = std::find_if(definitions.begin(), definitions.end(), [&](const IndexDefinition& d) {
+		return std::strcmp(d.name, name) == 0;
+	});
+	
+	if (definition == definitions.end()) {
+		std::cout << "No covering index named \"" << name << "\".";
+		
+		if (definitions.empty()) {
+			std::cout << " Declare them on upload." << std::endl;
+		}
+		else {
+			std::cout << " Declared indexes:\n";
+			
+			for (auto& d : definitions) {
+				std::cout << "  ";
+				d.printDeclaration();
+				std::cout << '\n';
+			}
+			
+			std::cout << std::flush;
+		}
+		
 		return;
 	}
 	
-	IdBTree tree;
-	
-	if (!tree.load(ID_TREE_FILEPATH)) {
-		std::cout << "No primary index file found." << std::endl;
+	if (prefixSize > definition->keyCount) {
+		std::cout << "Index \"" << name << "\" has only " << definition->keyCount << " key columns." << std::endl;
 		return;
 	}
 	
-	auto found = tree.seek(id);
+	DeclaredIndex<BlockSize> index(*definition);
+	auto filepath = DeclaredIndex<BlockSize>::filepath(*definition);
+	
+	index.apply([&](auto& tree) {
+		tree.useCache(commandCache());
+		
+		if (!tree.load(filepath.c_str())) {
+			std::cout << "No covering index file found." << std::endl;
+			return;
+		}
+		
+		typename std::decay_t<decltype(tree)>::ValueType lo, hi;
+		index.definition.range(prefix, prefixSize, lo, hi);
+		
+		std::size_t listed = 0;
+		tree.scan(lo, hi, [&](const auto& value) {
+			index.definition.print(value);
+			return ++listed != limit;
+		});
+		
+		auto stats = tree.getStatistics(true);
+		std::cout << '\n' << listed << (listed == 1? " entry" : " entries") << " listed.\n";
+		std::cout << stats.blocksRead << " block" << (stats.blocksRead > 1? "s were" : " was") << " read, all from the index.\n";
+		std::cout << "The file currently has " << stats.blocksInDisk << " total blocks." << std::endl;
+	});
+	
+	printCacheStatistics();
+}
+
+void scan(const char* name, const std::int64_t* prefix, std::size_t prefixSize, std::size_t limit) {
+	withDatabaseBlockSize([&](auto blockSize) {
+		scan<decltype(blockSize)::value>(name, prefix, prefixSize, limit);
+	});
+}
+
+//! count1, for a database with blocks of BlockSize bytes
+template <unsigned int BlockSize>
+static void count1(long lo, long hi) {
+	//! Count in a single partition's primary index
+	struct Count {
+		bool loaded;
+		std::uint64_t found, size, blocksRead, blocksInDisk;
+	};
+	
+	auto map = partitions();
 	
-	if (found) {
+	// Only the partitions whose range overlaps [lo, hi] are counted in; the
+	// others only give their size, which is in the tree's header
+	auto countIn = [&](std::size_t partition, BlockCache* cache, bool pin) {
+		IdBTree<BlockSize> tree;
+		tree.useCache(cache);
+		
+		Count count = { false, 0, 0, 0, 0 };
+		if (!tree.load(databaseFilepath(map, partition, ID_TREE_FILENAME).c_str())) return count;
+		
+		if (pin) pinIndex(tree);
+		
+		bool overlaps = !map || (map->ofId(lo) <= partition && partition <= map->ofId(hi));
+		if (overlaps) count.found = tree.count(static_cast<std::int64_t>(lo), static_cast<std::int64_t>(hi));
+		
 		auto stats = tree.getStatistics(true);
+		count = { true, count.found, tree.size(), stats.blocksRead, stats.blocksInDisk };
+		return count;
+	};
+	
+	std::vector<Count> counts;
+	
+	if (map) {
+		// Partitions are counted in parallel, each thread with its own cache
+		counts.resize(map->size());
+		std::vector<std::thread> workers;
 		
-		if (!findEntryAndPrint(hashfile, found->offset, stats.blocksRead, stats.blocksInDisk)) {
-			std::cout << "Entry with id " << id << " (offset=" << found->offset
-				<< ") not found in the hashfile." << std::endl;
+		for (std::size_t k = 0; k < map->size(); ++k) {
+			workers.emplace_back([&, k] {
+				auto cache = partitionCache(map->size());
+				counts[k] = countIn(k, cache.get(), false);
+			});
 		}
+		
+		for (auto& worker : workers) worker.join();
 	}
 	else {
-		std::cout << "Entry with id " << id << " not found in the primary index." << std::endl;
+		counts.push_back(countIn(0, commandCache(), true));
+	}
+	
+	Count total = { true, 0, 0, 0, 0 };
+	
+	for (auto& count : counts) {
+		if (!count.loaded) {
+			std::cout << "No primary index file found. Consider uploading your data first." << std::endl;
+			return;
+		}
+		
+		total.found += count.found;
+		total.size += count.size;
+		total.blocksRead += count.blocksRead;
+		total.blocksInDisk += count.blocksInDisk;
 	}
 	
-	std::fclose(hashfile);
+	std::cout << total.found << " of " << total.size << " entries have ids from " << lo << " to " << hi << ".\n";
+	std::cout << total.blocksRead << " block" << (total.blocksRead > 1? "s were" : " was") << " read";
+	if (map) std::cout << ", across " << map->size() << " partitions counted in parallel";
+	std::cout << ".\n";
+	std::cout << (map? "The files currently have " : "The file currently has ") << total.blocksInDisk << " total blocks." << std::endl;
+	
+	printCacheStatistics();
 }
 
-void seek2(const char* title) {
-	std::FILE *hashfile = std::fopen(HASHFILE_FILEPATH, "rb");
+void count1(long lo, long hi) {
+	withDatabaseBlockSize([&](auto blockSize) {
+		count1<decltype(blockSize)::value>(lo, hi);
+	});
+}
+
+//! select2, once the hashfile is open
+/*!
+ * @tparam Records See findEntryAndPrint
+ */
+template <unsigned int BlockSize, typename Records>
+static void select2(Records& hashfile, std::size_t position) {
+	// Partitions hold consecutive ranges of titles, so the position is
+	// found in the partition where the titles before it add up past it
+	auto map = partitions();
+	auto count = map? map->size() : 1;
 	
-	if (!hashfile) {
-		std::cout << "No hashfile found. Consider uploading your data first." << std::endl;
+	std::vector<std::uint64_t> sizes(count);
+	std::uint64_t total = 0, skipped = 0;
+	std::size_t partition = count;
+	
+	for (std::size_t k = 0; k < count; ++k) {
+		TitleBTree<BlockSize> tree;
+		
+		if (!tree.load(databaseFilepath(map, k, TITLE_TREE_FILENAME).c_str())) {
+			std::cout << "No secondary index B-tree found. The titles are only sorted if uploaded with --title-index=btree." << std::endl;
+			return;
+		}
+		
+		sizes[k] = tree.size();
+		
+		if (partition == count && position > total && position <= total + sizes[k]) {
+			partition = k;
+			skipped = total;
+		}
+		
+		total += sizes[k];
+	}
+	
+	if (partition == count) {
+		std::cout << "There are only " << total << " distinct titles." << std::endl;
 		return;
 	}
 	
-	TitleBTree tree;
+	auto path = [&](const char* filename) {
+		return databaseFilepath(map, partition, filename);
+	};
 	
-	if (!tree.load(TITLE_TREE_FILEPATH)) {
-		std::cout << "No secondary index file found." << std::endl;
-		return;
+	TitleBTree<BlockSize> tree;
+	tree.useCache(commandCache());
+	tree.load(path(TITLE_TREE_FILENAME).c_str());
+	
+	pinIndex(tree);
+	
+	auto found = tree.select(position - skipped - 1);
+	
+	PostingFile postings;
+	postings.useCache(commandCache());
+	bool postingsOpen = postings.open(path(TITLE_POSTINGS_FILENAME).c_str(), hashfile.blockSize());
+	
+	std::vector<long> offsets;
+	auto postingBlocksRead = entryOffsets(*found, postingsOpen? &postings : nullptr, offsets);
+	auto stats = tree.getStatistics(true);
+	
+	std::cout << "Title " << position << " of " << total << ": \"" << found->title << "\"";
+	if (map) std::cout << " (title " << position - skipped << " of partition " << partition << ")";
+	std::cout << '\n';
+	
+	if (offsets.size() > 1) {
+		findEntriesAndPrint(hashfile, offsets, stats.blocksRead + postingBlocksRead, stats.blocksInDisk);
+	}
+	else if (!findEntryAndPrint(hashfile, offsets[0], stats.blocksRead, stats.blocksInDisk)) {
+		std::cout << "Entry with title \"" << found->title
+			<< "\" (offset=" << offsets[0]
+			<< ") not found in the hashfile." << std::endl;
 	}
 	
-	auto found = tree.seek(title);
+	printCacheStatistics();
+}
+
+//! select2, for a database with blocks of BlockSize bytes
+template <unsigned int BlockSize>
+static void select2(std::size_t position) {
+	withHashfile([&](auto& hashfile) {
+		select2<BlockSize>(hashfile, position);
+	});
+}
+
+void select2(std::size_t position) {
+	withDatabaseBlockSize([&](auto blockSize) {
+		select2<decltype(blockSize)::value>(position);
+	});
+}
+
+//! Replaces a B-tree index with its reorganized copy, see reorg
+/*!
+ * @tparam Tree BPlusTree type of the index
+ *
+ * @param filepath Path to the index file
+ * @param description Name of the index in messages, as in "primary index"
+ */
+template <typename Tree>
+static void reorganizeIndex(const char* filepath, const char* description) {
+	auto temporaryPath = std::string(filepath) + ".reorg";
+	std::size_t blocksBefore, blocksRead;
 	
-	if (found) {
-		auto stats = tree.getStatistics(true);
+	{
+		Tree tree;
+		tree.useCache(commandCache());
 		
-		if (!findEntryAndPrint(hashfile, found->offset, stats.blocksRead, stats.blocksInDisk)) {
-			std::cout << "Entry with title \"" << title
-				<< "\" (offset=" << found->offset
-				<< ") not found in the hashfile." << std::endl;
+		if (!tree.load(filepath)) {
+			std::cout << "No " << description << " file found. Consider uploading your data first." << std::endl;
+			return;
+		}
+		
+		blocksBefore = tree.getStatistics(true).blocksInDisk;
+		
+		if (!tree.reorganize(temporaryPath.c_str())) {
+			std::cout << "Couldn't create the reorganized " << description << " file.\n";
+			std::cout << "Filepath: \"" << temporaryPath << "\"" << std::endl;
+			return;
 		}
+		
+		blocksRead = tree.getStatistics().blocksRead;
 	}
-	else {
-		std::cout << "Entry with title \"" << title << "\" not found in the secondary index file." << std::endl;
+	
+	if (std::rename(temporaryPath.c_str(), filepath) != 0) {
+		std::cout << "Couldn't replace the " << description << " file with the reorganized one.\n";
+		std::cout << "Filepath: \"" << temporaryPath << "\"" << std::endl;
+		return;
 	}
 	
-	std::fclose(hashfile);
+	Tree tree;
+	tree.load(filepath);
+	
+	std::cout << "The " << description << " was reorganized: " << blocksBefore << " blocks before, "
+		<< tree.getStatistics(true).blocksInDisk << " blocks now (" << blocksRead << " blocks read)." << std::endl;
+}
+
+//! reorg, for a database with blocks of BlockSize bytes
+template <unsigned int BlockSize>
+static void reorg(const char* index) {
+	bool isId = std::strcmp(index, "id") == 0;
+	
+	if (!isId && std::strcmp(index, "title") != 0) {
+		std::cout << "Unknown index \"" << index << "\". Only the B-tree indexes can be reorganized: id and title." << std::endl;
+		return;
+	}
+	
+	// Each partition has its own copy of the index, reorganized in turn
+	auto map = partitions();
+	auto count = map? map->size() : 1;
+	
+	for (std::size_t k = 0; k < count; ++k) {
+		std::string description = isId? "primary index" : "secondary index B-tree";
+		if (map) description += " of partition " + std::to_string(k);
+		
+		if (isId) {
+			reorganizeIndex<IdBTree<BlockSize>>(databaseFilepath(map, k, ID_TREE_FILENAME).c_str(), description.c_str());
+		}
+		else {
+			reorganizeIndex<TitleBTree<BlockSize>>(databaseFilepath(map, k, TITLE_TREE_FILENAME).c_str(), description.c_str());
+		}
+	}
+	
+	printCacheStatistics();
+}
+
+void reorg(const char* index) {
+	withDatabaseBlockSize([&](auto blockSize) {
+		reorg<decltype(blockSize)::value>(index);
+	});
 }
@@ -0,0 +1,142 @@
+#include "CoveringIndex.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+// --- //
+
+//! Reads a column name from a declaration
+/*!
+ * @param text Where the name begins; moved past it
+ * @param column Where the column will be read into
+ *
+ * @return True if there was a valid column name
+ */
+static bool parseColumn(const char*& text, Column& column) {
+	static const Column columns[] = { IdColumn, TitleColumn, YearColumn, CitationsColumn };
+	
+	for (auto c : columns) {
+		auto name = columnName(c);
+		auto size = std::strlen(name);
+		
+		if (std::strncmp(text, name, size) == 0 && (text[size] == '\0' || text[size] == ',' || text[size] == '+')) {
+			column = c;
+			text += size;
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+bool IndexDefinition::parse(const char *declaration, IndexDefinition& definition) {
+	definition = IndexDefinition();
+	
+	auto text = declaration;
+	std::size_t nameSize = 0;
+	
+	while (std::isalnum(static_cast<unsigned char>(*text)) || *text == '_' || *text == '-') {
+		if (nameSize + 1 >= COVERING_NAME_MAX) return false;
+		definition.name[nameSize++] = *text++;
+	}
+	
+	definition.name[nameSize] = '\0';
+	if (nameSize == 0 || *text++ != ':') return false;
+	
+	// Key columns
+	do {
+		if (definition.keyCount == COVERING_MAX_KEYS) return false;
+		
+		auto& key = definition.keys[definition.keyCount++];
+		key.descending = *text == '-';
+		if (key.descending) ++text;
+		
+		if (!parseColumn(text, key.column) || key.column == TitleColumn) return false;
+	} while (*text == ',' && ++text);
+	
+	// Included columns
+	if (*text == '+') {
+		do {
+			Column column;
+			if (!parseColumn(++text, column)) return false;
+			
+			if (column == TitleColumn) {
+				definition.includesTitle = true;
+			}
+			else if (definition.includedCount == COVERING_MAX_INCLUDED) {
+				return false;
+			}
+			else {
+				definition.included[definition.includedCount++] = column;
+			}
+		} while (*text == ',');
+	}
+	
+	return *text == '\0';
+}
+
+void IndexDefinition::printDeclaration() const {
+	std::cout << name << ':';
+	
+	for (unsigned int i = 0; i < keyCount; ++i) {
+		std::cout << (i? "," : "") << (keys[i].descending? "-" : "") << columnName(keys[i].column);
+	}
+	
+	for (unsigned int i = 0; i < includedCount; ++i) {
+		std::cout << (i? ',' : '+') << columnName(included[i]);
+	}
+	
+	if (includesTitle) std::cout << (includedCount? ',' : '+') << "title";
+}
+
+const char* columnName(Column column) {
+	switch (column) {
+	case IdColumn:
+		return "id";
+	case TitleColumn:
+		return "title";
+	case YearColumn:
+		return "year";
+	case CitationsColumn:
+		return "citations";
+	}
+	
+	return "";
+}
+
+std::int64_t columnValue(const Entry& e, Column column) {
+	switch (column) {
+	case IdColumn:
+		return e.id;
+	case YearColumn:
+		return e.year;
+	case CitationsColumn:
+		return e.citations;
+	default:
+		return 0;
+	}
+}
+
+bool saveCatalog(const char *filepath, const std::vector<IndexDefinition>& definitions) {
+	std::FILE *file = std::fopen(filepath, "wb");
+	if (!file) return false;
+	
+	bool written = std::fwrite(definitions.data(), sizeof(IndexDefinition), definitions.size(), file) == definitions.size();
+	
+	std::fclose(file);
+	return written;
+}
+
+bool loadCatalog(const char *filepath, std::vector<IndexDefinition>& definitions) {
+	std::FILE *file = std::fopen(filepath, "rb");
+	if (!file) return false;
+	
+	IndexDefinition definition;
+	while (std::fread(&definition, sizeof(definition), 1, file)) {
+		definitions.push_back(definition);
+	}
+	
+	std::fclose(file);
+	return true;
+}
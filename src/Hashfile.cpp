@@ -0,0 +1,382 @@
+#include "Hashfile.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// --- //
+
+//! Copies a string field, zeroing the rest of it
+static void copyField(char *to, const char *from, std::size_t size) {
+	auto length = strnlen(from, size);
+	std::memcpy(to, from, length);
+	std::memset(to + length, 0, size - length);
+}
+
+//! Copy of an entry with every byte that isn't part of its values zeroed
+/*!
+ * Entries are read from the input into fields of fixed size, leaving whatever
+ * was in memory past each string and between fields. Those bytes don't
+ * matter, but they'd have to be compressed like the rest.
+ */
+static void normalize(const Entry& entry, Entry& normal) {
+	std::memset(&normal, 0, sizeof(normal));
+	
+	normal.valid = entry.valid;
+	normal.id = entry.id;
+	normal.year = entry.year;
+	normal.citations = entry.citations;
+	
+	copyField(normal.title, entry.title, TITLE_CHAR_MAX);
+	copyField(normal.authors, entry.authors, AUTHORS_CHAR_MAX);
+	copyField(normal.updateTimestamp, entry.updateTimestamp, TIMESTAMP_CHAR_MAX);
+	copyField(normal.snippet, entry.snippet, SNIPPET_CHAR_MAX);
+}
+
+// --- //
+
+Hashfile::Hashfile()
+	: m_end(0), m_skipped(0), m_blockSize(HASHFILE_BLOCK_SIZE), m_compressed(false), m_dataOffset(0)
+	, m_directoryOffset(0), m_slots(0), m_directoryPosition(-1)
+{	}
+
+Hashfile::~Hashfile() {
+	close();
+}
+
+void Hashfile::useCache(BlockCache *cache) {
+	m_file.useCache(cache, BlockCache::RecordPage);
+}
+
+bool Hashfile::create(const char *filepath, unsigned int blockSize, std::int64_t firstId) {
+	if (!m_file.create(filepath)) return false;
+	
+	m_blockSize = blockSize;
+	m_file.setBlockSize(m_blockSize);
+	
+	HashfileHeaderBlock header;
+	header.var.version = FORMAT_VERSION;
+	header.var.blockCount = 1;
+	header.var.blockSize = m_blockSize;
+	header.var.firstId = firstId;
+	header.var.compressed = 0;
+	header.var.dictionarySize = 0;
+	header.var.dataOffset = 0;
+	header.var.directoryOffset = 0;
+	header.var.storedBlocks = 0;
+	writeHeader(header);
+	
+	m_compressed = false;
+	m_skipped = static_cast<long>(m_blockSize) * firstId;
+	m_end = m_skipped + m_blockSize;
+	return true;
+}
+
+bool Hashfile::open(const char *filepath, bool writable) {
+	if (!m_file.open(filepath, writable)) return false;
+	
+	auto header = readHeader();
+	m_blockSize = header.var.blockSize;
+	m_file.setBlockSize(m_blockSize);
+	
+	// Entries couldn't be found at the offsets given by their ids otherwise
+	bool compatible = header.var.version == FORMAT_VERSION && m_blockSize >= sizeof(EntryBlock);
+	
+	if (!compatible || (cache() && cache()->blockSize() != m_blockSize)) {
+		close();
+		return false;
+	}
+	
+	m_skipped = header.var.firstId * m_blockSize;
+	m_end = m_skipped + header.var.blockCount * m_blockSize;
+	
+	// Compressed entries are packed, so there's no room to write any
+	m_compressed = header.var.compressed != 0;
+	
+	if (m_compressed && (writable || !loadCompressed(header.var))) {
+		close();
+		return false;
+	}
+	
+	return true;
+}
+
+void Hashfile::close() {
+	m_file.close();
+	
+	m_compressed = false;
+	m_slots = 0;
+	m_directoryPosition = -1;
+	m_codec = LzCodec();
+}
+
+bool Hashfile::compress(const char *filepath) {
+	Hashfile source;
+	if (!source.open(filepath) || source.compressed()) return false;
+	
+	auto header = source.readHeader();
+	auto blockSize = source.blockSize();
+	std::int64_t slots = header.var.blockCount - 1;
+	long first = source.m_skipped + blockSize;
+	
+	EntryBlock e;
+	Entry normal;
+	
+	// Entries spread over the whole file make for a dictionary that suits all of them
+	std::vector<std::string> samples;
+	auto step = std::max<std::int64_t>(slots / HASHFILE_DICTIONARY_SAMPLES, 1);
+	
+	for (std::int64_t slot = 0; slot < slots; slot += step) {
+		if (!source.read(first + slot * blockSize, e) || !e.var.valid) continue;
+		
+		normalize(e.var, normal);
+		samples.emplace_back(reinterpret_cast<const char*>(&normal), sizeof(normal));
+	}
+	
+	LzCodec codec(LzCodec::train(samples, HASHFILE_DICTIONARY_SIZE));
+	auto& dictionary = codec.dictionary();
+	
+	auto temporaryPath = std::string(filepath) + ".tmp";
+	BlockFile output;
+	if (!output.create(temporaryPath.c_str())) return false;
+	output.setBlockSize(blockSize);
+	
+	for (std::size_t i = 0; i < dictionary.size(); i += blockSize) {
+		output.write(blockSize + i, dictionary.data() + i, std::min<std::size_t>(blockSize, dictionary.size() - i));
+	}
+	
+	// The directory goes before the entries: its size is known up front, so
+	// each of its blocks can be written as soon as its slots are filled,
+	// instead of keeping 8 bytes per id in memory until the end
+	auto perBlock = blockSize / sizeof(std::uint64_t);
+	std::int64_t directoryBlocks = (slots + perBlock - 1) / perBlock;
+	long directoryOffset = blockSize * (1 + (dictionary.size() + blockSize - 1) / blockSize);
+	long dataOffset = directoryOffset + directoryBlocks * blockSize;
+	
+	std::vector<std::uint64_t> directory(perBlock, HASHFILE_NO_ENTRY);
+	
+	auto flushDirectory = [&](std::int64_t index, std::size_t count) {
+		output.write(directoryOffset + index * blockSize, directory.data(), count * sizeof(std::uint64_t));
+		std::fill(directory.begin(), directory.end(), HASHFILE_NO_ENTRY);
+	};
+	
+	// Each block starts with how many entries it holds and where each ends,
+	// followed by the entries
+	std::vector<std::uint16_t> ends;
+	std::string entries;
+	std::vector<char> block(blockSize);
+	std::vector<char> packed(LzCodec::bound(sizeof(Entry)));
+	std::int64_t blocks = 0;
+	
+	auto flush = [&] {
+		std::uint16_t count = ends.size();
+		auto headerSize = sizeof(count) + count * sizeof(std::uint16_t);
+		
+		std::memcpy(block.data(), &count, sizeof(count));
+		std::memcpy(block.data() + sizeof(count), ends.data(), count * sizeof(std::uint16_t));
+		std::memcpy(block.data() + headerSize, entries.data(), entries.size());
+		output.write(dataOffset + blocks * blockSize, block.data(), headerSize + entries.size());
+		
+		++blocks;
+		ends.clear();
+		entries.clear();
+	};
+	
+	bool valid = true;
+	
+	for (std::int64_t slot = 0; slot < slots && valid; ++slot) {
+		if (slot > 0 && slot % perBlock == 0) flushDirectory(slot / perBlock - 1, perBlock);
+		
+		valid = source.read(first + slot * blockSize, e);
+		if (!valid || !e.var.valid) continue;
+		
+		normalize(e.var, normal);
+		auto size = codec.compress(reinterpret_cast<const char*>(&normal), sizeof(normal), packed.data(), packed.size());
+		
+		auto headerSize = sizeof(std::uint16_t) * (ends.size() + 2);
+		if (headerSize + entries.size() + size > blockSize) flush();
+		
+		directory[slot % perBlock] = static_cast<std::uint64_t>(blocks) << 16 | ends.size();
+		entries.append(packed.data(), size);
+		ends.push_back(entries.size());
+	}
+	
+	if (directoryBlocks > 0) flushDirectory(directoryBlocks - 1, slots - (directoryBlocks - 1) * perBlock);
+	if (!ends.empty()) flush();
+	
+	header.var.compressed = 1;
+	header.var.dictionarySize = dictionary.size();
+	header.var.dataOffset = dataOffset;
+	header.var.directoryOffset = directoryOffset;
+	header.var.storedBlocks = dataOffset / blockSize + blocks;
+	output.write(0, &header, sizeof(header));
+	
+	output.close();
+	source.close();
+	
+	if (!valid || std::rename(temporaryPath.c_str(), filepath) != 0) {
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+	
+	return true;
+}
+
+bool Hashfile::compressed() const {
+	return m_compressed;
+}
+
+HashfileHeaderBlock Hashfile::readHeader() {
+	HashfileHeaderBlock header;
+	m_file.read(0, &header, sizeof(header));
+	return header;
+}
+
+void Hashfile::writeHeader(const HashfileHeaderBlock& header) {
+	m_file.write(0, &header, sizeof(header));
+}
+
+long Hashfile::append(const EntryBlock& entry) {
+	long offset = m_end;
+	
+	m_file.write(fileOffset(offset), &entry, sizeof(entry));
+	
+	m_end += m_blockSize;
+	return offset;
+}
+
+void Hashfile::write(long offset, const EntryBlock& entry) {
+	m_file.write(fileOffset(offset), &entry, sizeof(entry));
+}
+
+long Hashfile::end() const {
+	return m_end;
+}
+
+unsigned int Hashfile::blockSize() const {
+	return m_blockSize;
+}
+
+long Hashfile::entryOffset(long id) const {
+	return static_cast<long>(m_blockSize) * (id + 1);
+}
+
+bool Hashfile::read(long offset, EntryBlock& entry) {
+	if (!m_compressed) return fileOffset(offset) > 0 && m_file.read(fileOffset(offset), &entry, sizeof(entry));
+	if (slotOf(offset) < 0) return false;
+	
+	// Ids without an entry are read as phantom entries, as they'd be in full
+	auto position = fileOffset(offset);
+	
+	if (position < 0) {
+		entry.var.valid = false;
+		return true;
+	}
+	
+	return m_file.read(position, m_packed.data(), m_blockSize) && unpack(offset, m_packed.data(), entry);
+}
+
+PageRef Hashfile::view(long offset, EntryBlock& buffer) {
+	// Compressed entries can't be seen in place, so they're decompressed into the buffer
+	if (m_compressed) return read(offset, buffer)? PageRef(reinterpret_cast<const char*>(&buffer), nullptr) : PageRef();
+	
+	if (fileOffset(offset) <= 0) return PageRef();
+	return m_file.view(fileOffset(offset), &buffer, sizeof(buffer));
+}
+
+int Hashfile::descriptor() const {
+	return m_file.descriptor();
+}
+
+long Hashfile::fileOffset(long offset) const {
+	if (!m_compressed) return offset - m_skipped;
+	
+	auto place = directoryEntry(offset);
+	if (place == HASHFILE_NO_ENTRY) return -1;
+	
+	return m_dataOffset + static_cast<long>(place >> 16) * m_blockSize;
+}
+
+bool Hashfile::unpack(long offset, const char *block, EntryBlock& entry) const {
+	if (!m_compressed) {
+		if (block != reinterpret_cast<const char*>(&entry)) std::memmove(&entry, block, sizeof(entry));
+		return true;
+	}
+	
+	// Decompressed on the side, since the block may be where the entry goes
+	Entry decompressed;
+	auto directoryPlace = directoryEntry(offset);
+	bool found = directoryPlace != HASHFILE_NO_ENTRY;
+	
+	if (found) {
+		std::size_t place = directoryPlace & 0xFFFF;
+		std::uint16_t count, start = 0, end = 0;
+		std::memcpy(&count, block, sizeof(count));
+		
+		auto ends = block + sizeof(count);
+		auto entries = ends + count * sizeof(std::uint16_t);
+		found = place < count;
+		
+		if (found && place > 0) std::memcpy(&start, ends + (place - 1) * sizeof(start), sizeof(start));
+		if (found) std::memcpy(&end, ends + place * sizeof(end), sizeof(end));
+		
+		found = found && start <= end && static_cast<std::size_t>(entries - block) + end <= m_blockSize
+			&& m_codec.decompress(entries + start, end - start, reinterpret_cast<char*>(&decompressed), sizeof(decompressed));
+	}
+	
+	if (found) entry.var = decompressed;
+	else entry.var.valid = false;
+	
+	return found;
+}
+
+BlockCache* Hashfile::cache() const {
+	return m_file.cache();
+}
+
+std::int64_t Hashfile::slotOf(long offset) const {
+	std::int64_t slot = (offset - m_skipped) / m_blockSize - 1;
+	return slot >= 0 && slot < m_slots? slot : -1;
+}
+
+std::uint64_t Hashfile::directoryEntry(long offset) const {
+	auto slot = slotOf(offset);
+	if (slot < 0) return HASHFILE_NO_ENTRY;
+	
+	// Only the directory block holding the slot is read, through the cache if
+	// there's one, and kept for the lookups of the ids next to it
+	auto perBlock = m_blockSize / sizeof(std::uint64_t);
+	long position = m_directoryOffset + static_cast<long>(slot / perBlock) * m_blockSize;
+	
+	if (position != m_directoryPosition) {
+		m_directoryPosition = -1;
+		if (!m_file.read(position, m_directoryBlock.data(), m_blockSize)) return HASHFILE_NO_ENTRY;
+		m_directoryPosition = position;
+	}
+	
+	std::uint64_t place;
+	std::memcpy(&place, m_directoryBlock.data() + slot % perBlock * sizeof(place), sizeof(place));
+	return place;
+}
+
+bool Hashfile::loadCompressed(const HashfileHeader& header) {
+	std::string dictionary(header.dictionarySize, '\0');
+	m_packed.resize(m_blockSize);
+	m_directoryBlock.resize(m_blockSize);
+	
+	// Read a whole block at a time, as direct I/O needs
+	for (std::size_t i = 0; i < dictionary.size(); i += m_blockSize) {
+		if (!m_file.read(m_blockSize + i, m_packed.data(), m_blockSize)) return false;
+		std::memcpy(&dictionary[i], m_packed.data(), std::min<std::size_t>(m_blockSize, dictionary.size() - i));
+	}
+	
+	// The directory takes 8 bytes per id, so it's left on disk and read a
+	// block at a time, see Hashfile::directoryEntry
+	m_codec = LzCodec(std::move(dictionary));
+	m_dataOffset = header.dataOffset;
+	m_directoryOffset = header.directoryOffset;
+	m_slots = header.blockCount - 1;
+	m_directoryPosition = -1;
+	return true;
+}
@@ -0,0 +1,277 @@
+#include "LzCodec.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "BloomFilter.hpp"
+
+//! Shortest match worth encoding, in bytes
+#define LZ_MIN_MATCH 4
+
+// --- //
+
+//! Reads 4 bytes in native order, wherever they are
+static std::uint32_t read32(const char *p) {
+	std::uint32_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+//! Writes a length past the 15 its token nibble holds, in bytes of 255 and a last smaller one
+static char* writeLength(char *out, std::size_t length) {
+	for (; length >= 255; length -= 255) *out++ = static_cast<char>(255);
+	*out++ = static_cast<char>(length);
+	return out;
+}
+
+//! Reads a length written by writeLength
+/*!
+ * @return False if the data ends before the length does
+ */
+static bool readLength(const unsigned char *&in, const unsigned char *end, std::size_t& length) {
+	unsigned char byte;
+	
+	do {
+		if (in == end) return false;
+		byte = *in++;
+		length += byte;
+	} while (byte == 255);
+	
+	return true;
+}
+
+// --- //
+
+LzCodec::LzCodec()
+	: m_table(std::size_t(1) << LZ_HASH_BITS, -1)
+{	}
+
+LzCodec::LzCodec(std::string dictionary)
+	: LzCodec()
+{
+	if (dictionary.size() > LZ_MAX_DISTANCE) dictionary.erase(0, dictionary.size() - LZ_MAX_DISTANCE);
+	m_dictionary = std::move(dictionary);
+	
+	for (std::size_t i = 0; i + LZ_MIN_MATCH <= m_dictionary.size(); ++i) {
+		m_table[hash(&m_dictionary[i])] = i;
+	}
+}
+
+const std::string& LzCodec::dictionary() const {
+	return m_dictionary;
+}
+
+std::size_t LzCodec::bound(std::size_t size) {
+	// At worst, everything is a single literal run
+	return size + size / 255 + 16;
+}
+
+std::size_t LzCodec::compress(const char *data, std::size_t size, char *output, std::size_t capacity) const {
+	// The data goes right after the dictionary, so that positions in both can
+	// be told apart by a single number
+	std::string window;
+	window.reserve(m_dictionary.size() + size);
+	window.append(m_dictionary);
+	window.append(data, size);
+	
+	auto table = m_table;
+	const char *base = window.data();
+	std::size_t end = window.size();
+	std::size_t position = m_dictionary.size();
+	std::size_t anchor = position;
+	
+	char *out = output;
+	char *outEnd = output + capacity;
+	
+	// Writes the literals since the anchor and a match, if length isn't 0
+	auto emit = [&](std::size_t length, std::size_t distance) {
+		std::size_t literals = position - anchor;
+		if (static_cast<std::size_t>(outEnd - out) < bound(literals) + 3 + length / 255) return false;
+		
+		auto token = out++;
+		*token = static_cast<char>(std::min<std::size_t>(literals, 15) << 4);
+		if (literals >= 15) out = writeLength(out, literals - 15);
+		
+		std::memcpy(out, base + anchor, literals);
+		out += literals;
+		
+		if (length == 0) return true;
+		
+		*out++ = static_cast<char>(distance & 0xFF);
+		*out++ = static_cast<char>(distance >> 8);
+		
+		*token |= static_cast<char>(std::min<std::size_t>(length - LZ_MIN_MATCH, 15));
+		if (length - LZ_MIN_MATCH >= 15) out = writeLength(out, length - LZ_MIN_MATCH - 15);
+		
+		return true;
+	};
+	
+	while (position + LZ_MIN_MATCH <= end) {
+		auto h = hash(base + position);
+		auto candidate = table[h];
+		table[h] = position;
+		
+		if (candidate < 0 || position - candidate > LZ_MAX_DISTANCE || read32(base + candidate) != read32(base + position)) {
+			++position;
+			continue;
+		}
+		
+		std::size_t length = LZ_MIN_MATCH;
+		while (position + length < end && base[candidate + length] == base[position + length]) ++length;
+		
+		if (!emit(length, position - candidate)) return 0;
+		
+		// Positions inside the match are remembered too, for the matches after it
+		for (std::size_t i = position + 1; i < position + length && i + LZ_MIN_MATCH <= end; ++i) {
+			table[hash(base + i)] = i;
+		}
+		
+		position += length;
+		anchor = position;
+	}
+	
+	// The last run has no match after it, which is how the end is recognized
+	position = end;
+	if (!emit(0, 0)) return 0;
+	
+	return out - output;
+}
+
+bool LzCodec::decompress(const char *data, std::size_t size, char *output, std::size_t outputSize) const {
+	auto in = reinterpret_cast<const unsigned char*>(data);
+	auto inEnd = in + size;
+	std::size_t produced = 0;
+	
+	while (in < inEnd) {
+		unsigned int token = *in++;
+		std::size_t literals = token >> 4;
+		
+		if (literals == 15 && !readLength(in, inEnd, literals)) return false;
+		if (literals > static_cast<std::size_t>(inEnd - in) || literals > outputSize - produced) return false;
+		
+		std::memcpy(output + produced, in, literals);
+		in += literals;
+		produced += literals;
+		
+		if (in == inEnd) break;
+		if (inEnd - in < 2) return false;
+		
+		std::size_t distance = in[0] | (in[1] << 8);
+		in += 2;
+		
+		std::size_t length = token & 15;
+		if (length == 15 && !readLength(in, inEnd, length)) return false;
+		length += LZ_MIN_MATCH;
+		
+		if (distance == 0 || distance > produced + m_dictionary.size() || length > outputSize - produced) return false;
+		
+		// Byte by byte, since a match may overlap the bytes it produces
+		for (std::size_t i = 0; i < length; ++i, ++produced) {
+			output[produced] = produced >= distance? output[produced - distance]
+				: m_dictionary[m_dictionary.size() + produced - distance];
+		}
+	}
+	
+	return produced == outputSize;
+}
+
+std::string LzCodec::train(const std::vector<std::string>& samples, std::size_t size) {
+	size = std::min<std::size_t>(size, LZ_MAX_DISTANCE);
+	
+	auto kmer = [](const std::string& sample, std::size_t i) {
+		return BloomFilter::hash(sample.data() + i, LZ_TRAIN_KMER);
+	};
+	
+	auto isRun = [](const std::string& sample, std::size_t i) {
+		return std::count(sample.begin() + i, sample.begin() + i + LZ_TRAIN_KMER, sample[i]) == LZ_TRAIN_KMER;
+	};
+	
+	// Samples each substring appears in
+	std::unordered_map<std::uint64_t, std::uint32_t> frequency;
+	
+	for (auto& sample : samples) {
+		std::unordered_set<std::uint64_t> seen;
+		
+		for (std::size_t i = 0; i + LZ_TRAIN_KMER <= sample.size(); ++i) {
+			if (!isRun(sample, i) && seen.insert(kmer(sample, i)).second) ++frequency[kmer(sample, i)];
+		}
+	}
+	
+	struct Piece {
+		std::uint64_t score; //!< Sum of the frequencies of the substrings in the piece, when it was last scored
+		std::size_t sample; //!< Sample the piece is in
+		std::size_t start; //!< Position of the piece in the sample
+		
+		bool operator< (const Piece& that) const {
+			return score < that.score;
+		}
+	};
+	
+	// Only substrings in more than one sample are worth having
+	auto score = [&](const Piece& piece) {
+		auto& sample = samples[piece.sample];
+		std::uint64_t total = 0;
+		
+		for (std::size_t i = piece.start; i + LZ_TRAIN_KMER <= piece.start + LZ_TRAIN_SEGMENT; ++i) {
+			if (isRun(sample, i)) continue;
+			
+			auto it = frequency.find(kmer(sample, i));
+			if (it != frequency.end() && it->second > 1) total += it->second;
+		}
+		
+		return total;
+	};
+	
+	std::priority_queue<Piece> pieces;
+	
+	for (std::size_t s = 0; s < samples.size(); ++s) {
+		for (std::size_t start = 0; start + LZ_TRAIN_SEGMENT <= samples[s].size(); start += LZ_TRAIN_SEGMENT / 2) {
+			Piece piece = { 0, s, start };
+			piece.score = score(piece);
+			if (piece.score > 0) pieces.push(piece);
+		}
+	}
+	
+	// Scores only go down as pieces are taken, so a piece scored again that's
+	// still the best is the best indeed
+	std::vector<Piece> chosen;
+	std::size_t total = 0;
+	
+	while (!pieces.empty() && total < size) {
+		auto piece = pieces.top();
+		pieces.pop();
+		
+		auto current = score(piece);
+		if (current == 0) continue;
+		
+		if (current < piece.score && !pieces.empty() && current < pieces.top().score) {
+			piece.score = current;
+			pieces.push(piece);
+			continue;
+		}
+		
+		auto& sample = samples[piece.sample];
+		for (std::size_t i = piece.start; i + LZ_TRAIN_KMER <= piece.start + LZ_TRAIN_SEGMENT; ++i) {
+			frequency.erase(kmer(sample, i));
+		}
+		
+		chosen.push_back(piece);
+		total += LZ_TRAIN_SEGMENT;
+	}
+	
+	std::string dictionary;
+	
+	for (auto piece = chosen.rbegin(); piece != chosen.rend(); ++piece) {
+		dictionary.append(samples[piece->sample], piece->start, LZ_TRAIN_SEGMENT);
+	}
+	
+	if (dictionary.size() > size) dictionary.erase(0, dictionary.size() - size);
+	return dictionary;
+}
+
+std::uint32_t LzCodec::hash(const char *p) {
+	return (read32(p) * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
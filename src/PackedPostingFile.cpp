@@ -0,0 +1,276 @@
+#include "PackedPostingFile.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "PostingIntersection.hpp"
+
+// --- //
+
+//! Appends a number as a variable-length integer, 7 bits per byte, lowest first
+static void putNumber(std::vector<char>& bytes, std::uint64_t number) {
+	for (; number >= 0x80; number >>= 7) bytes.push_back(static_cast<char>(number | 0x80));
+	bytes.push_back(static_cast<char>(number));
+}
+
+// --- //
+
+PackedPostingFile::PackedPostingFile()
+	: m_end(0), m_blockSize(BLOCK_SIZE)
+{	}
+
+PackedPostingFile::~PackedPostingFile() {
+	close();
+}
+
+void PackedPostingFile::useCache(BlockCache *cache) {
+	m_file.useCache(cache);
+}
+
+bool PackedPostingFile::create(const char *filepath, unsigned int blockSize) {
+	close();
+	
+	m_end = 0;
+	m_blockSize = blockSize;
+	m_file.setBlockSize(m_blockSize);
+	
+	if (!m_file.create(filepath)) return false;
+	
+	m_tail.reserve(m_blockSize);
+	return true;
+}
+
+bool PackedPostingFile::open(const char *filepath, unsigned int blockSize) {
+	close();
+	
+	if (!m_file.open(filepath)) return false;
+	
+	m_blockSize = blockSize;
+	m_file.setBlockSize(m_blockSize);
+	
+	m_end = m_file.end();
+	return true;
+}
+
+void PackedPostingFile::close() {
+	if (!m_tail.empty()) {
+		m_file.write(m_end - m_tail.size(), m_tail.data(), m_tail.size());
+		m_tail.clear();
+	}
+	
+	m_file.close();
+}
+
+long PackedPostingFile::write(const std::vector<long>& offsets) {
+	// The first offset of each posting block goes in its skip entry, and the
+	// others in the block, as gaps
+	std::vector<char> blocks;
+	std::vector<std::size_t> ends;
+	
+	for (std::size_t i = 1; i < offsets.size(); ++i) {
+		if (i % POSTING_SKIP_INTERVAL == 0) ends.push_back(blocks.size());
+		else putNumber(blocks, (offsets[i] - offsets[i - 1]) / m_blockSize);
+	}
+	
+	std::vector<char> bytes;
+	putNumber(bytes, offsets.size());
+	
+	for (std::size_t i = 0; i < offsets.size(); i += POSTING_SKIP_INTERVAL) {
+		auto block = i / POSTING_SKIP_INTERVAL;
+		putNumber(bytes, (offsets[i] - (block > 0? offsets[i - POSTING_SKIP_INTERVAL] : 0)) / m_blockSize);
+		
+		if (block > 0) putNumber(bytes, ends[block - 1] - (block > 1? ends[block - 2] : 0));
+	}
+	
+	bytes.insert(bytes.end(), blocks.begin(), blocks.end());
+	long list = m_end;
+	
+	// Full blocks are written as soon as they're filled, and the file grows
+	// sequentially
+	for (std::size_t written = 0; written < bytes.size(); ) {
+		auto chunk = std::min<std::size_t>(bytes.size() - written, m_blockSize - m_tail.size());
+		m_tail.insert(m_tail.end(), bytes.begin() + written, bytes.begin() + written + chunk);
+		
+		written += chunk;
+		m_end += chunk;
+		
+		if (m_tail.size() == m_blockSize) {
+			m_file.write(m_end - m_blockSize, m_tail.data(), m_blockSize);
+			m_tail.clear();
+		}
+	}
+	
+	return list;
+}
+
+std::size_t PackedPostingFile::read(long list, std::vector<long>& offsets) const {
+	Cursor cursor;
+	
+	for (bool more = cursor.open(*this, list); more; more = cursor.next()) {
+		offsets.push_back(cursor.offset());
+	}
+	
+	return cursor.blocksRead();
+}
+
+std::size_t PackedPostingFile::blockCount() const {
+	return (m_end + m_blockSize - 1) / m_blockSize;
+}
+
+// --- //
+
+PackedPostingFile::Cursor::Cursor()
+	: m_file(nullptr), m_size(0), m_block(0), m_position(0), m_pageOffset(-1), m_byte(0), m_blocksRead(0)
+{	}
+
+bool PackedPostingFile::Cursor::open(const PackedPostingFile& file, long list) {
+	m_file = &file;
+	m_size = 0;
+	m_skips.clear();
+	m_offsets.clear();
+	m_position = 0;
+	m_buffer.resize(file.m_blockSize);
+	m_page = PageRef();
+	m_pageOffset = -1;
+	
+	std::uint64_t count, gap, size;
+	if (list < 0 || list >= file.m_end) return false;
+	
+	moveTo(list);
+	if (!nextNumber(count)) return false;
+	
+	long first = 0, position = 0;
+	
+	for (std::uint64_t i = 0; i < count; i += POSTING_SKIP_INTERVAL) {
+		if (!nextNumber(gap)) return false;
+		if (i > 0 && !nextNumber(size)) return false;
+		
+		first += static_cast<long>(gap) * file.m_blockSize;
+		if (i > 0) position += static_cast<long>(size);
+		m_skips.push_back({ first, position });
+	}
+	
+	// The posting blocks start right after the skip entries
+	long start = m_pageOffset + m_byte;
+	
+	for (auto& skip : m_skips) {
+		skip.position += start;
+	}
+	
+	m_size = count;
+	return load(0);
+}
+
+bool PackedPostingFile::Cursor::valid() const {
+	return m_position < m_offsets.size();
+}
+
+long PackedPostingFile::Cursor::offset() const {
+	return m_offsets[m_position];
+}
+
+bool PackedPostingFile::Cursor::next() {
+	if (!valid()) return false;
+	if (++m_position < m_offsets.size()) return true;
+	
+	return load(m_block + 1);
+}
+
+bool PackedPostingFile::Cursor::seek(long offset) {
+	if (!valid()) return false;
+	if (m_offsets[m_position] >= offset) return true;
+	
+	// Gallops until the range of posting blocks [low, low + step] ends with
+	// one starting past the offset, if there's one
+	std::size_t low = m_block, step = 1;
+	
+	while (low + step < m_skips.size() && m_skips[low + step].first <= offset) {
+		low += step;
+		step *= 2;
+	}
+	
+	auto high = std::min(low + step, m_skips.size());
+	auto startsPast = std::upper_bound(m_skips.begin() + low + 1, m_skips.begin() + high, offset, [](long o, const Skip& skip) {
+		return o < skip.first;
+	});
+	
+	std::size_t block = startsPast - m_skips.begin() - 1;
+	if (block != m_block && !load(block)) return false;
+	
+	m_position += postingsBelow(m_offsets.data() + m_position, m_offsets.size() - m_position, offset);
+	
+	// Every offset of the posting block is below the one sought, so it's the
+	// first of the next one
+	return valid() || load(m_block + 1);
+}
+
+std::uint64_t PackedPostingFile::Cursor::size() const {
+	return m_size;
+}
+
+std::size_t PackedPostingFile::Cursor::blocksRead() const {
+	return m_blocksRead;
+}
+
+void PackedPostingFile::Cursor::moveTo(long position) {
+	auto blockSize = m_file->m_blockSize;
+	long pageOffset = position - position % blockSize;
+	
+	if (pageOffset != m_pageOffset) {
+		m_page = PageRef();
+		m_pageOffset = pageOffset;
+	}
+	
+	m_byte = position % blockSize;
+}
+
+bool PackedPostingFile::Cursor::nextNumber(std::uint64_t& number) {
+	auto blockSize = m_file->m_blockSize;
+	number = 0;
+	
+	for (unsigned int shift = 0; shift < 64; shift += 7) {
+		if (m_byte == blockSize) moveTo(m_pageOffset + blockSize);
+		
+		if (!m_page) {
+			bool fetched;
+			m_page = m_file->m_file.view(m_pageOffset, m_buffer.data(), blockSize, &fetched);
+			
+			if (!m_page) return false;
+			if (fetched) ++m_blocksRead;
+		}
+		
+		auto byte = static_cast<unsigned char>(m_page.data()[m_byte++]);
+		number |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+		
+		if (byte < 0x80) return true;
+	}
+	
+	return false;
+}
+
+bool PackedPostingFile::Cursor::load(std::size_t block) {
+	m_block = block;
+	m_offsets.clear();
+	m_position = 0;
+	
+	if (block >= m_skips.size()) return false;
+	
+	auto count = std::min<std::uint64_t>(POSTING_SKIP_INTERVAL, m_size - block * POSTING_SKIP_INTERVAL);
+	long offset = m_skips[block].first;
+	std::uint64_t gap;
+	
+	m_offsets.push_back(offset);
+	if (count > 1) moveTo(m_skips[block].position);
+	
+	for (std::uint64_t i = 1; i < count; ++i) {
+		if (!nextNumber(gap)) {
+			m_offsets.clear();
+			return false;
+		}
+		
+		offset += static_cast<long>(gap) * m_file->m_blockSize;
+		m_offsets.push_back(offset);
+	}
+	
+	return true;
+}
@@ -0,0 +1,95 @@
+#include "PartitionMap.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "Block.hpp"
+
+// --- //
+
+PartitionMap::PartitionMap()
+{	}
+
+PartitionMap PartitionMap::split(std::vector<std::int64_t> ids, std::vector<std::string> titles, std::size_t count, const std::vector<std::string>& directories) {
+	std::sort(ids.begin(), ids.end());
+	std::sort(titles.begin(), titles.end());
+	
+	PartitionMap map;
+	map.m_partitions.resize(count);
+	
+	for (std::size_t i = 0; i < count; ++i) {
+		auto& partition = map.m_partitions[i];
+		std::memset(&partition, 0, sizeof(partition));
+		
+		// Partition i starts at the sample's i-th quantile, and the first one
+		// takes everything below the second
+		if (i > 0 && !ids.empty()) partition.firstId = ids[i * ids.size() / count];
+		if (i > 0 && !titles.empty()) std::strncpy(partition.firstTitle, titles[i * titles.size() / count].c_str(), TITLE_CHAR_MAX - 1);
+		
+		std::strncpy(partition.directory, directories[i % directories.size()].c_str(), PARTITION_DIRECTORY_MAX - 1);
+	}
+	
+	return map;
+}
+
+bool PartitionMap::load(const char *filepath) {
+	std::FILE *file = std::fopen(filepath, "rb");
+	if (!file) return false;
+	
+	FileHeader header;
+	bool read = std::fread(&header, sizeof(header), 1, file) && header.version == FORMAT_VERSION && header.count > 0;
+	
+	if (read) {
+		m_partitions.resize(header.count);
+		read = std::fread(m_partitions.data(), sizeof(Partition), m_partitions.size(), file) == m_partitions.size();
+	}
+	
+	std::fclose(file);
+	
+	if (!read) m_partitions.clear();
+	return read;
+}
+
+bool PartitionMap::save(const char *filepath) const {
+	std::FILE *file = std::fopen(filepath, "wb");
+	if (!file) return false;
+	
+	FileHeader header = { FORMAT_VERSION, static_cast<std::uint32_t>(m_partitions.size()) };
+	bool written = std::fwrite(&header, sizeof(header), 1, file)
+		&& std::fwrite(m_partitions.data(), sizeof(Partition), m_partitions.size(), file) == m_partitions.size();
+	
+	written = std::fclose(file) == 0 && written;
+	return written;
+}
+
+std::size_t PartitionMap::size() const {
+	return m_partitions.size();
+}
+
+const Partition& PartitionMap::operator[] (std::size_t i) const {
+	return m_partitions[i];
+}
+
+std::size_t PartitionMap::ofId(std::int64_t id) const {
+	auto after = std::upper_bound(m_partitions.begin() + 1, m_partitions.end(), id, [](std::int64_t id, const Partition& p) {
+		return id < p.firstId;
+	});
+	
+	return after - m_partitions.begin() - 1;
+}
+
+std::size_t PartitionMap::ofTitle(const char *title) const {
+	auto after = std::upper_bound(m_partitions.begin() + 1, m_partitions.end(), title, [](const char *title, const Partition& p) {
+		return std::strcmp(title, p.firstTitle) < 0;
+	});
+	
+	return after - m_partitions.begin() - 1;
+}
+
+std::string PartitionMap::filepath(std::size_t i, const char *filename) const {
+	std::string directory = m_partitions[i].directory;
+	if (!directory.empty() && directory.back() != '/') directory += '/';
+	
+	return directory + "part" + std::to_string(i) + "-" + filename;
+}
@@ -0,0 +1,40 @@
+#include "PartitionedHashfile.hpp"
+
+// --- //
+
+PartitionedHashfile::PartitionedHashfile()
+	: m_map(nullptr), m_cache(nullptr)
+{	}
+
+void PartitionedHashfile::useCache(BlockCache *cache) {
+	m_cache = cache;
+}
+
+bool PartitionedHashfile::open(const PartitionMap& map, const char *filename) {
+	m_map = &map;
+	m_segments.clear();
+	
+	for (std::size_t i = 0; i < map.size(); ++i) {
+		m_segments.emplace_back(new Hashfile);
+		m_segments.back()->useCache(m_cache);
+		
+		if (!m_segments.back()->open(map.filepath(i, filename).c_str())) return false;
+		
+		// Ids only map to the same offsets in every segment with the same block size
+		if (m_segments.back()->blockSize() != m_segments[0]->blockSize()) return false;
+	}
+	
+	return !m_segments.empty();
+}
+
+Hashfile& PartitionedHashfile::segment(long offset) {
+	return *m_segments[m_map->ofId(offset / blockSize() - 1)];
+}
+
+PageRef PartitionedHashfile::view(long offset, EntryBlock& buffer) {
+	return segment(offset).view(offset, buffer);
+}
+
+unsigned int PartitionedHashfile::blockSize() const {
+	return m_segments[0]->blockSize();
+}
@@ -0,0 +1,72 @@
+#include "PostingFile.hpp"
+
+// --- //
+
+PostingFile::PostingFile()
+	: m_end(0), m_blockSize(BLOCK_SIZE)
+{	}
+
+void PostingFile::useCache(BlockCache *cache) {
+	m_file.useCache(cache);
+}
+
+bool PostingFile::create(const char *filepath, unsigned int blockSize) {
+	m_end = 0;
+	m_blockSize = blockSize;
+	m_file.setBlockSize(m_blockSize);
+	
+	return m_file.create(filepath);
+}
+
+bool PostingFile::open(const char *filepath, unsigned int blockSize) {
+	if (!m_file.open(filepath)) return false;
+	
+	m_blockSize = blockSize;
+	m_file.setBlockSize(m_blockSize);
+	
+	m_end = m_file.end();
+	return true;
+}
+
+void PostingFile::close() {
+	m_file.close();
+}
+
+long PostingFile::append(long list, long offset) {
+	PostingBlockBlock head;
+	
+	if (list != -1 && m_file.read(list, &head, sizeof(head)) && head.var.size < POSTINGS_PER_BLOCK) {
+		head.var.offsets[head.var.size++] = offset;
+		m_file.write(list, &head, sizeof(head));
+		return list;
+	}
+	
+	head.var.next = list;
+	head.var.size = 1;
+	head.var.offsets[0] = offset;
+	
+	list = m_end;
+	m_file.write(list, &head, sizeof(head));
+	m_end += m_blockSize;
+	
+	return list;
+}
+
+std::size_t PostingFile::read(long list, std::vector<long>& offsets) const {
+	std::size_t blocksRead = 0;
+	PostingBlockBlock block;
+	bool fetched;
+	
+	while (list != -1 && m_file.read(list, &block, sizeof(block), &fetched)) {
+		offsets.insert(offsets.end(), block.var.offsets, block.var.offsets + block.var.size);
+		list = block.var.next;
+		
+		if (fetched) ++blocksRead;
+	}
+	
+	return blocksRead;
+}
+
+std::size_t PostingFile::blockCount() const {
+	return m_end / m_blockSize;
+}
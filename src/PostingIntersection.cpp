@@ -0,0 +1,53 @@
+#include "PostingIntersection.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// --- //
+
+std::size_t postingsBelow(const long *offsets, std::size_t size, long value) {
+	std::size_t low = 0, high = size;
+	
+	while (high - low > POSTING_SCAN_WINDOW) {
+		auto middle = low + (high - low) / 2;
+		
+		if (offsets[middle] < value) low = middle + 1;
+		else high = middle;
+	}
+	
+	std::size_t count = low;
+	std::size_t i = low;
+	
+	// An offset is less than the value if subtracting the value leaves it
+	// negative, which the sign bits of both lanes tell at once. Offsets aren't
+	// negative, so the subtraction can't overflow.
+	#ifdef __SSE2__
+	static_assert(sizeof(long) == 8, "Offsets are compared as 64-bit lanes");
+	
+	auto key = _mm_set1_epi64x(value);
+	
+	for (; i + 2 <= high; i += 2) {
+		auto lanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(offsets + i));
+		auto signs = _mm_movemask_pd(_mm_castsi128_pd(_mm_sub_epi64(lanes, key)));
+		count += (signs & 1) + (signs >> 1);
+	}
+	#endif
+	
+	for (; i < high; ++i) {
+		count += offsets[i] < value;
+	}
+	
+	return count;
+}
+
+void intersectPostings(std::vector<long>& result, PackedPostingFile::Cursor& list) {
+	std::size_t kept = 0;
+	
+	for (auto offset : result) {
+		if (!list.seek(offset)) break;
+		if (list.offset() == offset) result[kept++] = offset;
+	}
+	
+	result.resize(kept);
+}
@@ -0,0 +1,554 @@
+#include "SharedBlockCache.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//! Value of SharedBlockCache::Header::ready once the segment is set up
+#define SHARED_CACHE_MAGIC 0x53424303
+
+//! Times a process looks for a segment that's still being set up before giving up
+#define SHARED_CACHE_SETUP_TRIES 100000
+
+//! Owner of a slot that's being swept, see SharedBlockCache::Header::owners
+#define SHARED_CACHE_SWEEPING UINT64_MAX
+
+// Frames are changed by several processes at once through these, with no lock
+static_assert(ATOMIC_SHORT_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "Shared cache needs lock-free atomics");
+
+// --- //
+
+//! Start of the segment
+struct SharedBlockCache::Header {
+	std::atomic<std::uint32_t> ready; //!< SHARED_CACHE_MAGIC once the segment is set up
+	std::uint32_t blockSize; //!< Frame size in bytes
+	std::uint64_t capacity; //!< Quantity of frames
+	std::uint64_t bucketCount; //!< Quantity of buckets, a power of two
+	std::atomic<std::uint64_t> unused; //!< Frames never claimed so far are the ones from here on
+	std::atomic<std::uint64_t> hand; //!< Position of the clock, modulo the capacity
+	pthread_mutex_t stripes[SHARED_CACHE_STRIPES]; //!< Latches guarding the buckets
+	std::atomic<std::uint64_t> owners[SHARED_CACHE_HANDLES]; //!< Process owning each handle slot (see ownerOf), 0 if the slot is free
+};
+
+//! Frame bookkeeping
+struct SharedBlockCache::Frame {
+	//! Whether the frame holds a block
+	enum State : std::uint32_t {
+		Empty, //!< Free for anyone to claim
+		Cached, //!< Holding a block, in its bucket
+		Stale, //!< Holding a block that was replaced or discarded, out of its bucket, until its pins are gone
+		Claimed //!< Taken by a process that's filling it; the state is Claimed plus the slot of its handle
+	};
+	
+	std::atomic<std::uint32_t> state; //!< Frame state, see Frame::State
+	std::atomic<std::uint32_t> pins; //!< Quantity of pins keeping the block from being evicted, in every process; the sum of the slots' pins
+	std::atomic<std::uint32_t> referenced; //!< Set when the block is used, cleared when the clock passes
+	std::uint32_t priority; //!< Priority of the block
+	FileKey key; //!< File the block belongs to
+	std::int64_t offset; //!< %Block offset in the file
+	std::int64_t next; //!< Next frame in the same bucket, -1 for none
+};
+
+//! Rounds up to a multiple of the alignment
+static std::size_t alignUp(std::size_t size, std::size_t alignment) {
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+//! Positions of each part of a segment
+struct SegmentLayout {
+	std::size_t frames; //!< Offset of the frame bookkeeping
+	std::size_t pins; //!< Offset of the pins of each slot on each frame
+	std::size_t buckets; //!< Offset of the buckets
+	std::size_t data; //!< Offset of the frames
+	std::size_t size; //!< Whole segment size
+	
+	SegmentLayout(std::size_t headerSize, std::size_t frameSize, std::size_t capacity, std::size_t bucketCount, std::size_t blockSize) {
+		frames = alignUp(headerSize, 64);
+		pins = alignUp(frames + capacity * frameSize, 64);
+		buckets = alignUp(pins + capacity * SHARED_CACHE_HANDLES * sizeof(std::uint16_t), 64);
+		data = alignUp(buckets + bucketCount * sizeof(std::int64_t), blockSize);
+		size = data + capacity * blockSize;
+	}
+};
+
+//! Name as given to `shm_open`
+static std::string segmentName(const char *name) {
+	std::string segment(name);
+	if (segment.empty() || segment[0] != '/') segment.insert(0, "/");
+	return segment;
+}
+
+//! Identifies a running process: its start time, in clock ticks since boot, in the upper 32 bits, and its id in the lower 32
+/*!
+ * Ids are reused once a process is gone, but not by a process started at the
+ * same time. Without /proc, the start time is left as 0.
+ */
+static std::uint64_t ownerOf(pid_t pid) {
+	std::uint64_t started = 0;
+	char path[32], stat[1024];
+	std::snprintf(path, sizeof(path), "/proc/%d/stat", static_cast<int>(pid));
+	
+	if (auto file = std::fopen(path, "r")) {
+		auto size = std::fread(stat, 1, sizeof(stat) - 1, file);
+		std::fclose(file);
+		stat[size] = '\0';
+		
+		// The start time is the 22nd field, the 20th after the name, which is
+		// in parentheses and may hold spaces
+		auto field = std::strrchr(stat, ')');
+		
+		for (int i = 0; field && i < 20; ++i) {
+			field = std::strchr(field + 1, ' ');
+		}
+		
+		if (field) started = std::strtoull(field + 1, nullptr, 10);
+	}
+	
+	return (started & 0xFFFFFFFF) << 32 | static_cast<std::uint32_t>(pid);
+}
+
+//! True if the process identified by an owner (see ownerOf) is still running
+static bool running(std::uint64_t owner) {
+	pid_t pid = static_cast<pid_t>(owner & 0xFFFFFFFF);
+	if (kill(pid, 0) != 0 && errno == ESRCH) return false;
+	
+	return ownerOf(pid) == owner;
+}
+
+// --- //
+
+bool SharedBlockCache::keyOf(int fd, FileKey& key) {
+	struct stat status;
+	if (fstat(fd, &status) != 0) return false;
+	
+	key.device = status.st_dev;
+	key.inode = status.st_ino;
+	key.changed = static_cast<std::int64_t>(status.st_ctim.tv_sec) * 1000000000 + status.st_ctim.tv_nsec;
+	return true;
+}
+
+SharedBlockCache::SharedBlockCache()
+	: m_segment(nullptr), m_size(0), m_header(nullptr), m_frames(nullptr), m_pins(nullptr), m_buckets(nullptr), m_data(nullptr)
+	, m_slot(SHARED_CACHE_HANDLES)
+{	}
+
+SharedBlockCache::~SharedBlockCache() {
+	detach();
+}
+
+bool SharedBlockCache::attach(const char *name, std::size_t capacity, std::size_t blockSize) {
+	detach();
+	
+	if (capacity == 0 || blockSize == 0) return false;
+	m_name = segmentName(name);
+	
+	// Whoever creates the segment sets it up, and the others wait for it
+	bool creator = true;
+	int fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	
+	if (fd < 0 && errno == EEXIST) {
+		creator = false;
+		fd = shm_open(m_name.c_str(), O_RDWR, 0600);
+	}
+	
+	if (fd < 0) return false;
+	
+	std::size_t bucketCount = 1;
+	while (bucketCount < capacity) bucketCount *= 2;
+	
+	if (creator) {
+		SegmentLayout layout(sizeof(Header), sizeof(Frame), capacity, bucketCount, blockSize);
+		m_size = layout.size;
+		
+		if (ftruncate(fd, m_size) != 0) {
+			close(fd);
+			shm_unlink(m_name.c_str());
+			return false;
+		}
+	}
+	else {
+		struct stat status;
+		int tries = 0;
+		
+		while (fstat(fd, &status) == 0 && status.st_size == 0 && ++tries < SHARED_CACHE_SETUP_TRIES) {
+			sched_yield();
+		}
+		
+		m_size = status.st_size;
+	}
+	
+	void *segment = m_size > 0? mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	close(fd);
+	
+	if (segment == MAP_FAILED) {
+		if (creator) shm_unlink(m_name.c_str());
+		return false;
+	}
+	
+	m_segment = static_cast<char*>(segment);
+	m_header = reinterpret_cast<Header*>(m_segment);
+	
+	if (creator) {
+		new (&m_header->ready) std::atomic<std::uint32_t>(0);
+		m_header->blockSize = blockSize;
+		m_header->capacity = capacity;
+		m_header->bucketCount = bucketCount;
+		new (&m_header->unused) std::atomic<std::uint64_t>(0);
+		new (&m_header->hand) std::atomic<std::uint64_t>(0);
+		
+		// A process dying with a latch held mustn't block the others forever
+		pthread_mutexattr_t attributes;
+		pthread_mutexattr_init(&attributes);
+		pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+		pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+		
+		for (auto& stripe : m_header->stripes) {
+			pthread_mutex_init(&stripe, &attributes);
+		}
+		
+		pthread_mutexattr_destroy(&attributes);
+		
+		for (auto& owner : m_header->owners) {
+			new (&owner) std::atomic<std::uint64_t>(0);
+		}
+	}
+	else {
+		int tries = 0;
+		
+		while (m_header->ready.load(std::memory_order_acquire) != SHARED_CACHE_MAGIC && ++tries < SHARED_CACHE_SETUP_TRIES) {
+			sched_yield();
+		}
+		
+		if (tries == SHARED_CACHE_SETUP_TRIES || m_header->blockSize != blockSize) {
+			detach();
+			return false;
+		}
+		
+		capacity = m_header->capacity;
+		bucketCount = m_header->bucketCount;
+	}
+	
+	SegmentLayout layout(sizeof(Header), sizeof(Frame), capacity, bucketCount, blockSize);
+	
+	if (layout.size != m_size) {
+		detach();
+		return false;
+	}
+	
+	m_frames = reinterpret_cast<Frame*>(m_segment + layout.frames);
+	m_pins = reinterpret_cast<std::atomic<std::uint16_t>*>(m_segment + layout.pins);
+	m_buckets = reinterpret_cast<std::int64_t*>(m_segment + layout.buckets);
+	m_data = m_segment + layout.data;
+	
+	if (creator) {
+		for (std::size_t i = 0; i < capacity; ++i) {
+			new (&m_frames[i].state) std::atomic<std::uint32_t>(Frame::Empty);
+			new (&m_frames[i].pins) std::atomic<std::uint32_t>(0);
+			new (&m_frames[i].referenced) std::atomic<std::uint32_t>(0);
+			m_frames[i].next = -1;
+		}
+		
+		for (std::size_t i = 0; i < capacity * SHARED_CACHE_HANDLES; ++i) {
+			new (&m_pins[i]) std::atomic<std::uint16_t>(0);
+		}
+		
+		for (std::size_t i = 0; i < bucketCount; ++i) {
+			m_buckets[i] = -1;
+		}
+		
+		m_header->ready.store(SHARED_CACHE_MAGIC, std::memory_order_release);
+	}
+	
+	// The slots of processes that died attached are freed before taking one
+	sweepDead();
+	
+	auto owner = ownerOf(getpid());
+	
+	for (std::size_t slot = 0; slot < SHARED_CACHE_HANDLES && m_slot == SHARED_CACHE_HANDLES; ++slot) {
+		std::uint64_t free = 0;
+		if (m_header->owners[slot].compare_exchange_strong(free, owner)) m_slot = slot;
+	}
+	
+	if (m_slot == SHARED_CACHE_HANDLES) {
+		detach();
+		return false;
+	}
+	
+	return true;
+}
+
+bool SharedBlockCache::remove(const char *name) {
+	return shm_unlink(segmentName(name).c_str()) == 0;
+}
+
+std::size_t SharedBlockCache::capacity() const {
+	return m_header? m_header->capacity : 0;
+}
+
+const char* SharedBlockCache::lookup(const FileKey& file, long offset) {
+	auto bucket = bucketOf(file, offset);
+	
+	lock(bucket);
+	auto index = find(bucket, file, offset);
+	
+	if (index >= 0) {
+		addPin(index);
+		m_frames[index].referenced.store(1, std::memory_order_relaxed);
+	}
+	
+	unlock(bucket);
+	
+	return index >= 0? m_data + index * m_header->blockSize : nullptr;
+}
+
+char* SharedBlockCache::claim(BlockCache::Priority priority, bool& evicted) {
+	evicted = false;
+	auto capacity = m_header->capacity;
+	std::uint32_t claimed = Frame::Claimed + m_slot;
+	
+	// Frames never used are handed out first, in order
+	auto unused = m_header->unused.load(std::memory_order_relaxed);
+	
+	if (unused < capacity && (unused = m_header->unused.fetch_add(1)) < capacity) {
+		m_frames[unused].state.store(claimed, std::memory_order_relaxed);
+		return m_data + unused * m_header->blockSize;
+	}
+	
+	// Record pages are always the first to go: index pages are passed over for
+	// two turns of the clock, so that every record page had its second chance,
+	// and never evicted for a record page. If every frame is kept, it may be
+	// by processes that are gone, whose frames are then recovered for another
+	// try.
+	for (bool retry = true; retry; retry = sweepDead()) {
+		for (std::size_t step = 0; step < 4 * capacity; ++step) {
+			auto index = m_header->hand.fetch_add(1, std::memory_order_relaxed) % capacity;
+			auto& frame = m_frames[index];
+			
+			std::uint32_t state = Frame::Empty;
+			if (frame.state.compare_exchange_strong(state, claimed)) {
+				return m_data + index * m_header->blockSize;
+			}
+			
+			// Stale frames can't be found anymore, so no pin is added once
+			// they have none
+			if (state == Frame::Stale && frame.pins.load() == 0 && frame.state.compare_exchange_strong(state, claimed)) {
+				return m_data + index * m_header->blockSize;
+			}
+			
+			if (state != Frame::Cached || frame.pins.load() > 0) continue;
+			if (frame.priority == BlockCache::IndexPage && (priority == BlockCache::RecordPage || step < 2 * capacity)) continue;
+			if (frame.referenced.exchange(0, std::memory_order_relaxed)) continue;
+			
+			if (evict(index)) {
+				evicted = true;
+				return m_data + index * m_header->blockSize;
+			}
+		}
+	}
+	
+	return nullptr;
+}
+
+const char* SharedBlockCache::publish(char *frame, const FileKey& file, long offset, BlockCache::Priority priority, bool replace) {
+	auto bucket = bucketOf(file, offset);
+	auto claimed = frameOf(frame);
+	
+	lock(bucket);
+	auto index = find(bucket, file, offset);
+	
+	if (index >= 0 && replace) {
+		unlink(bucket, index);
+	}
+	else if (index >= 0) {
+		// Another process was quicker, so its copy is used instead
+		addPin(index);
+		m_frames[index].referenced.store(1, std::memory_order_relaxed);
+		unlock(bucket);
+		
+		abandon(frame);
+		return m_data + index * m_header->blockSize;
+	}
+	
+	auto& bookkeeping = m_frames[claimed];
+	bookkeeping.key = file;
+	bookkeeping.offset = offset;
+	bookkeeping.priority = priority;
+	bookkeeping.referenced.store(1, std::memory_order_relaxed);
+	addPin(claimed);
+	bookkeeping.next = m_buckets[bucket];
+	m_buckets[bucket] = claimed;
+	bookkeeping.state.store(Frame::Cached, std::memory_order_release);
+	
+	unlock(bucket);
+	return frame;
+}
+
+void SharedBlockCache::discard(const FileKey& file, long offset) {
+	auto bucket = bucketOf(file, offset);
+	
+	lock(bucket);
+	auto index = find(bucket, file, offset);
+	if (index >= 0) unlink(bucket, index);
+	unlock(bucket);
+}
+
+void SharedBlockCache::abandon(char *frame) {
+	m_frames[frameOf(frame)].state.store(Frame::Empty, std::memory_order_release);
+}
+
+void SharedBlockCache::pin(const char *block) {
+	addPin(frameOf(block));
+}
+
+void SharedBlockCache::unpin(const char *block) {
+	auto frame = frameOf(block);
+	auto& mine = slotPins(frame, m_slot);
+	
+	// Only this handle changes its slot's pins, as long as it's attached
+	if (mine.load(std::memory_order_relaxed) == 0) return;
+	
+	mine.fetch_sub(1);
+	m_frames[frame].pins.fetch_sub(1);
+}
+
+bool SharedBlockCache::holds(const char *block) const {
+	return m_data && block >= m_data && block < m_data + m_header->capacity * m_header->blockSize;
+}
+
+std::size_t SharedBlockCache::frameOf(const char *block) const {
+	return (block - m_data) / m_header->blockSize;
+}
+
+std::atomic<std::uint16_t>& SharedBlockCache::slotPins(std::size_t frame, std::size_t slot) const {
+	return m_pins[frame * SHARED_CACHE_HANDLES + slot];
+}
+
+void SharedBlockCache::addPin(std::size_t frame) {
+	// Counted in the frame first, and taken off it last (see unpin), so that
+	// a process dying in between leaves a pin too many rather than one that
+	// another process still holds taken off by a sweep
+	m_frames[frame].pins.fetch_add(1);
+	slotPins(frame, m_slot).fetch_add(1);
+}
+
+void SharedBlockCache::sweep(std::size_t slot) {
+	for (std::size_t i = 0; i < m_header->capacity; ++i) {
+		auto pins = slotPins(i, slot).exchange(0);
+		if (pins > 0) m_frames[i].pins.fetch_sub(pins);
+		
+		std::uint32_t claimed = Frame::Claimed + slot;
+		m_frames[i].state.compare_exchange_strong(claimed, Frame::Empty);
+	}
+}
+
+bool SharedBlockCache::sweepDead() {
+	bool swept = false;
+	
+	for (std::size_t slot = 0; slot < SHARED_CACHE_HANDLES; ++slot) {
+		auto& owner = m_header->owners[slot];
+		auto current = owner.load();
+		
+		if (current == 0 || current == SHARED_CACHE_SWEEPING || running(current)) continue;
+		
+		// Only one process sweeps a slot
+		if (!owner.compare_exchange_strong(current, SHARED_CACHE_SWEEPING)) continue;
+		
+		sweep(slot);
+		owner.store(0);
+		swept = true;
+	}
+	
+	return swept;
+}
+
+std::size_t SharedBlockCache::bucketOf(const FileKey& file, long offset) const {
+	std::uint64_t hash = file.inode * 0x9E3779B97F4A7C15ull ^ file.device ^ file.changed;
+	hash ^= static_cast<std::uint64_t>(offset / m_header->blockSize) * 0xC2B2AE3D27D4EB4Full;
+	hash ^= hash >> 29;
+	
+	return hash & (m_header->bucketCount - 1);
+}
+
+void SharedBlockCache::lock(std::size_t bucket) {
+	auto mutex = &m_header->stripes[bucket % SHARED_CACHE_STRIPES];
+	
+	// The previous owner died holding it; its bucket may be left half-changed,
+	// which at worst loses a few cached blocks
+	if (pthread_mutex_lock(mutex) == EOWNERDEAD) pthread_mutex_consistent(mutex);
+}
+
+void SharedBlockCache::unlock(std::size_t bucket) {
+	pthread_mutex_unlock(&m_header->stripes[bucket % SHARED_CACHE_STRIPES]);
+}
+
+std::int64_t SharedBlockCache::find(std::size_t bucket, const FileKey& file, long offset) const {
+	for (auto index = m_buckets[bucket]; index >= 0; index = m_frames[index].next) {
+		if (m_frames[index].offset == offset && m_frames[index].key == file) return index;
+	}
+	
+	return -1;
+}
+
+void SharedBlockCache::unlink(std::size_t bucket, std::size_t index) {
+	std::int64_t *link = &m_buckets[bucket];
+	while (*link != static_cast<std::int64_t>(index)) link = &m_frames[*link].next;
+	
+	*link = m_frames[index].next;
+	m_frames[index].state.store(Frame::Stale, std::memory_order_release);
+}
+
+bool SharedBlockCache::evict(std::size_t index) {
+	auto& frame = m_frames[index];
+	
+	// The block may change before the latch is held, so everything is checked
+	// again afterwards
+	auto bucket = bucketOf(frame.key, frame.offset);
+	lock(bucket);
+	
+	bool evictable = frame.state.load(std::memory_order_acquire) == Frame::Cached && frame.pins.load() == 0;
+	std::int64_t *link = &m_buckets[bucket];
+	
+	while (evictable && *link >= 0 && *link != static_cast<std::int64_t>(index)) {
+		link = &m_frames[*link].next;
+	}
+	
+	evictable = evictable && *link == static_cast<std::int64_t>(index);
+	
+	if (evictable) {
+		*link = frame.next;
+		frame.state.store(Frame::Claimed + m_slot, std::memory_order_relaxed);
+	}
+	
+	unlock(bucket);
+	return evictable;
+}
+
+void SharedBlockCache::detach() {
+	// Pins and claims left behind are given back along with the slot
+	if (m_slot < SHARED_CACHE_HANDLES) {
+		sweep(m_slot);
+		m_header->owners[m_slot].store(0);
+		m_slot = SHARED_CACHE_HANDLES;
+	}
+	
+	if (m_segment) munmap(m_segment, m_size);
+	
+	m_segment = nullptr;
+	m_size = 0;
+	m_header = nullptr;
+	m_frames = nullptr;
+	m_pins = nullptr;
+	m_buckets = nullptr;
+	m_data = nullptr;
+}
@@ -1,6 +1,9 @@
+#include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <vector>
 
+#include "BlockCache.hpp"
 #include "Commands.hpp"
 
 //! Program main
@@ -12,31 +15,284 @@
  * Program usage:
  *
  * ```
- * $ <exec-name> upload <input-file : string>
+ * $ <exec-name> [--direct[=<cache-blocks : int>]] [--shared-cache=<name : string>] [--pin=<levels : int>] [--pin-memory=<MiB : float>] <command> <args...>
+ * $ <exec-name> upload <input-file : string> [--bloom-fp=<rate : float>] [--title-index=btree|hash] [--sort-memory=<MiB : float>] [--block-size=<KiB : int>] [--index=<declaration : string>...] [--partitions=<n : int> [--partition-dir=<directory : string>...]] [--compress] [--text-index]
+ * $ <exec-name> append <input-file : string> [--memtable=<ids : int>]
  * $ <exec-name> findrec <id : int>
- * $ <exec-name> seek1 <id : int>
- * $ <exec-name> seek2 <title : string>
+ * $ <exec-name> seek1 <id : int> [<id : int>...]
+ * $ <exec-name> seek2 <title : string> [<title : string>...]
+ * $ <exec-name> seekauthor <author : string>
+ * $ <exec-name> search <word : string> [<word : string>...] [--limit=<n : int>]
+ * $ <exec-name> count1 <lo-id : int> <hi-id : int>
+ * $ <exec-name> select2 <position : int>
+ * $ <exec-name> scan <index : string> [<key : int>...] [--limit=<n : int>]
+ * $ <exec-name> reorg id|title
  * ```
+ *
+ * When several ids or titles are given, the lookups are done all at once.
+ *
+ * The `--direct` option makes the command bypass the kernel page cache, using
+ * an application cache of `cache-blocks` blocks instead.
+ *
+ * The `--shared-cache` option implies `--direct`, and keeps the cache in the
+ * shared memory segment `name`, so that commands running at the same time, or
+ * one after the other, share the blocks they read. The segment is created
+ * with `cache-blocks` blocks by the first command using it, and stays until
+ * it's removed (from `/dev/shm` on Linux) or the host restarts.
+ *
+ * The `--pin` option makes the command read the top `levels` levels of each
+ * B-tree index it loads, counting the root, and keep them in memory, as long
+ * as they take at most `--pin-memory` MiB (64 by default).
+ *
+ * The `--bloom-fp` upload option sets the false-positive rate of the indexes'
+ * Bloom filters (0 to build no filters).
+ *
+ * The `--title-index` upload option picks the structure of the secondary
+ * index: a B-tree (default) or an extendible hash.
+ *
+ * The `--sort-memory` upload option sets how much memory, in MiB, the titles
+ * can take while they're sorted to build the secondary index B-tree.
+ *
+ * The `--block-size` upload option sets the block size, in KiB, of every file
+ * of the database: 4 (default), 8, 16, 32 or 64. The other commands read it
+ * from the hashfile, and `--direct` caches blocks of that size.
+ *
+ * The `--partitions` upload option splits the database in `n` partitions by
+ * ranges of ids and of titles, built in parallel, each in the next of the
+ * `--partition-dir` directories in turn (the current one by default).
+ * Lookups only read the partitions holding their keys, and `count1` counts in
+ * all of them in parallel. A partitioned database can't be appended to, and
+ * has no covering indexes nor a hash secondary index.
+ *
+ * The `--compress` upload option compresses the entries once the hashfile is
+ * written, see Hashfile::compress. Lookups still read a single hashfile block
+ * per entry, but the database can't be appended to afterwards.
+ *
+ * The `--text-index` upload option builds the full-text index over the titles
+ * and snippets, which `search` needs. `search` lists the entries with every
+ * word given, at most `--limit` of them if set.
+ *
+ * The `--memtable` append option sets how many ids are gathered in memory
+ * before they're written as a primary index run.
+ *
+ * Each `--index` upload option declares a covering index (see
+ * IndexDefinition::parse for the format), which can then be listed with
+ * `scan`. The keys given to `scan` are the values of the index's first key
+ * columns.
+ *
  * @param argc Argument count
  * @param argv Argument values
  */
 int main(int argc, char **argv) {
 	auto usageExamples = [] {
 		std::cout << "Usage:\n";
-		std::cout << "$ <program> upload  <input-file>\n";
+		std::cout << "$ <program> [--direct[=<cache-blocks>]] [--shared-cache=<name>] [--pin=<levels>] [--pin-memory=<MiB>] <command> <args...>\n";
+		std::cout << "$ <program> upload  <input-file> [--bloom-fp=<rate>] [--title-index=btree|hash] [--sort-memory=<MiB>] [--block-size=<KiB>] [--index=<name>:<keys>[+<included>]...] [--partitions=<n> [--partition-dir=<dir>...]] [--compress] [--text-index]\n";
+		std::cout << "$ <program> append  <input-file> [--memtable=<ids>]\n";
 		std::cout << "$ <program> findrec <id>\n";
-		std::cout << "$ <program> seek1   <id>\n";
-		std::cout << "$ <program> seek2   <title>" << std::endl;
+		std::cout << "$ <program> seek1   <id> [<id>...]\n";
+		std::cout << "$ <program> seek2   <title> [<title>...]\n";
+		std::cout << "$ <program> seekauthor <author>\n";
+		std::cout << "$ <program> search  <word> [<word>...] [--limit=<n>]\n";
+		std::cout << "$ <program> count1  <lo-id> <hi-id>\n";
+		std::cout << "$ <program> select2 <position>\n";
+		std::cout << "$ <program> scan    <index> [<key>...] [--limit=<n>]\n";
+		std::cout << "$ <program> reorg   id|title" << std::endl;
 	};
-
-	if (argc == 3) {
+	
+	IoOptions ioOptions = { false, BLOCK_CACHE_DEFAULT_BLOCKS };
+	
+	while (argc > 1 && strncmp(argv[1], "--", 2) == 0) {
+		if (strncmp(argv[1], "--direct", 8) == 0) {
+			ioOptions.directIO = true;
+			if (argv[1][8] == '=') ioOptions.cacheBlocks = atol(argv[1] + 9);
+		}
+		else if (strncmp(argv[1], "--shared-cache=", 15) == 0 && argv[1][15]) {
+			ioOptions.directIO = true;
+			ioOptions.sharedCache = argv[1] + 15;
+		}
+		else if (strncmp(argv[1], "--pin=", 6) == 0) {
+			ioOptions.pinnedLevels = atol(argv[1] + 6);
+		}
+		else if (strncmp(argv[1], "--pin-memory=", 13) == 0) {
+			double mebibytes = atof(argv[1] + 13);
+			
+			if (mebibytes <= 0) {
+				std::cout << "The pin memory must be greater than 0.\n";
+				return 0;
+			}
+			
+			ioOptions.pinMemory = static_cast<std::size_t>(mebibytes * 1024 * 1024);
+		}
+		else {
+			std::cout << "Unknown option: " << argv[1] << '\n';
+			usageExamples();
+			return 0;
+		}
+		
+		// The remaining arguments are handled as if the option wasn't there
+		argv[1] = argv[0];
+		++argv;
+		--argc;
+	}
+	
+	setIoOptions(ioOptions);
+	
+	if (argc >= 3 && strcmp(argv[1], "upload") == 0) {
+		UploadOptions options;
+		
+		for (int i = 3; i < argc; ++i) {
+			if (strncmp(argv[i], "--bloom-fp=", 11) == 0) {
+				options.bloomFalsePositiveRate = atof(argv[i] + 11);
+				
+				if (options.bloomFalsePositiveRate < 0 || options.bloomFalsePositiveRate >= 1) {
+					std::cout << "The Bloom filter false-positive rate must be at least 0 and less than 1.\n";
+					return 0;
+				}
+			}
+			else if (strcmp(argv[i], "--title-index=btree") == 0) {
+				options.titleIndex = BTreeTitleIndex;
+			}
+			else if (strcmp(argv[i], "--title-index=hash") == 0) {
+				options.titleIndex = HashTitleIndex;
+			}
+			else if (strncmp(argv[i], "--sort-memory=", 14) == 0) {
+				double mebibytes = atof(argv[i] + 14);
+				
+				if (mebibytes <= 0) {
+					std::cout << "The sort memory must be greater than 0.\n";
+					return 0;
+				}
+				
+				options.sortMemory = static_cast<std::size_t>(mebibytes * 1024 * 1024);
+			}
+			else if (strncmp(argv[i], "--block-size=", 13) == 0) {
+				options.blockSize = atol(argv[i] + 13) * 1024;
+				
+				if (!withBlockSize(options.blockSize, [](auto) {})) {
+					std::cout << "The block size must be 4, 8, 16, 32 or 64 KiB.\n";
+					return 0;
+				}
+			}
+			else if (strncmp(argv[i], "--index=", 8) == 0) {
+				IndexDefinition definition;
+				
+				if (!IndexDefinition::parse(argv[i] + 8, definition)) {
+					std::cout << "Invalid index declaration: " << argv[i] + 8 << '\n';
+					std::cout << "Expected <name>:<keys>[+<included>], as in topcited:year,-citations,id+title.\n";
+					return 0;
+				}
+				
+				for (auto& other : options.indexes) {
+					if (strcmp(other.name, definition.name) == 0) {
+						std::cout << "Index \"" << definition.name << "\" declared twice.\n";
+						return 0;
+					}
+				}
+				
+				options.indexes.push_back(definition);
+			}
+			else if (strncmp(argv[i], "--partitions=", 13) == 0) {
+				long partitions = atol(argv[i] + 13);
+				
+				if (partitions < 1) {
+					std::cout << "The quantity of partitions must be at least 1.\n";
+					return 0;
+				}
+				
+				options.partitions = partitions;
+			}
+			else if (strncmp(argv[i], "--partition-dir=", 16) == 0) {
+				options.partitionDirectories.push_back(argv[i] + 16);
+			}
+			else if (strcmp(argv[i], "--compress") == 0) {
+				options.compress = true;
+			}
+			else if (strcmp(argv[i], "--text-index") == 0) {
+				options.textIndex = true;
+			}
+			else {
+				std::cout << "Unknown upload option: " << argv[i] << '\n';
+				usageExamples();
+				return 0;
+			}
+		}
+		
+		upload(argv[2], options);
+	}
+	else if (argc >= 3 && strcmp(argv[1], "append") == 0) {
+		AppendOptions options;
+		
+		for (int i = 3; i < argc; ++i) {
+			if (strncmp(argv[i], "--memtable=", 11) == 0) {
+				long capacity = atol(argv[i] + 11);
+				
+				if (capacity <= 0) {
+					std::cout << "The memtable capacity must be greater than 0.\n";
+					return 0;
+				}
+				
+				options.memtableCapacity = capacity;
+			}
+			else {
+				std::cout << "Unknown append option: " << argv[i] << '\n';
+				usageExamples();
+				return 0;
+			}
+		}
+		
+		append(argv[2], options);
+	}
+	else if (argc >= 3 && strcmp(argv[1], "scan") == 0) {
+		std::vector<std::int64_t> prefix;
+		std::size_t limit = 0;
+		
+		for (int i = 3; i < argc; ++i) {
+			if (strncmp(argv[i], "--limit=", 8) == 0) {
+				limit = atol(argv[i] + 8);
+			}
+			else {
+				prefix.push_back(atoll(argv[i]));
+			}
+		}
+		
+		scan(argv[2], prefix.data(), prefix.size(), limit);
+	}
+	else if (argc >= 3 && strcmp(argv[1], "search") == 0) {
+		std::vector<const char*> words;
+		std::size_t limit = 0;
+		
+		for (int i = 2; i < argc; ++i) {
+			if (strncmp(argv[i], "--limit=", 8) == 0) {
+				limit = atol(argv[i] + 8);
+			}
+			else {
+				words.push_back(argv[i]);
+			}
+		}
+		
+		search(words.data(), words.size(), limit);
+	}
+	else if (argc == 4 && strcmp(argv[1], "count1") == 0) {
+		count1(atol(argv[2]), atol(argv[3]));
+	}
+	else if (argc > 3 && strcmp(argv[1], "seek1") == 0) {
+		std::vector<long> ids;
+		
+		for (int i = 2; i < argc; ++i) {
+			ids.push_back(atol(argv[i]));
+		}
+		
+		seek1(ids.data(), ids.size());
+	}
+	else if (argc > 3 && strcmp(argv[1], "seek2") == 0) {
+		seek2(argv + 2, argc - 2);
+	}
+	else if (argc == 3) {
 		char *command = argv[1];
 		char *arg = argv[2];
 		
-		if (strcmp(command, "upload") == 0) {
-			upload(arg);
-		}
-		else if (strcmp(command, "findrec") == 0) {
+		if (strcmp(command, "findrec") == 0) {
 			long id = atol(arg);
 			findrec(id);
 		}
@@ -47,6 +303,22 @@ int main(int argc, char **argv) {
 		else if (strcmp(command, "seek2") == 0) {
 			seek2(arg);
 		}
+		else if (strcmp(command, "seekauthor") == 0) {
+			seekauthor(arg);
+		}
+		else if (strcmp(command, "select2") == 0) {
+			long position = atol(arg);
+			
+			if (position < 1) {
+				std::cout << "The position must be at least 1: positions start at 1.\n";
+				return 0;
+			}
+			
+			select2(position);
+		}
+		else if (strcmp(command, "reorg") == 0) {
+			reorg(arg);
+		}
 		else {
 			std::cout << "Unknown command: " << command << '\n';
 			usageExamples();